@@ -0,0 +1,589 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/congestion_control/bbr_tcp_sender.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "net/quic/congestion_control/rtt_stats.h"
+#include "net/quic/crypto/crypto_protocol.h"
+#include "net/quic/crypto/quic_random.h"
+#include "net/quic/proto/cached_network_parameters.pb.h"
+
+using std::max;
+using std::min;
+
+namespace net {
+
+namespace {
+
+const QuicByteCount kMaxSegmentSize = kDefaultTCPMSS;
+// The minimum window, which is also the window during PROBE_RTT.
+const QuicByteCount kMinimumCongestionWindow = 4 * kMaxSegmentSize;
+
+// 2/ln(2), the smallest gain which doubles the sending rate every round trip
+// in STARTUP.
+const float kHighGain = 2.885f;
+// The inverse of kHighGain, which drains the STARTUP queue in one round trip.
+const float kDrainGain = 1.f / kHighGain;
+// The window in PROBE_BW is twice the bandwidth-delay product, which leaves
+// room for delayed and aggregated acks.
+const float kCongestionWindowGain = 2.f;
+// PROBE_BW spends one min RTT probing for more bandwidth, one draining the
+// queue that probing built, and six cruising at the estimated bandwidth.
+const float kPacingGain[] = {1.25f, 0.75f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f};
+const int kGainCycleLength = arraysize(kPacingGain);
+
+// The bandwidth estimate is the maximum delivery rate over this many round
+// trips.
+const QuicRoundTripCount kBandwidthWindowSize = kGainCycleLength + 2;
+
+// STARTUP ends after this many round trips without the bandwidth estimate
+// growing by kStartupGrowthTarget.
+const int kRoundTripsWithoutGrowthBeforeExitingStartup = 3;
+const float kStartupGrowthTarget = 1.25f;
+
+// The min RTT expires after this long, and PROBE_RTT lasts at least this long.
+const int64 kMinRttExpirySeconds = 10;
+const int64 kProbeRttTimeMs = 200;
+
+// The most packets whose send state is kept.  Packets which are neither acked
+// nor lost, such as those abandoned by a retransmission timeout, are forgotten
+// once this many newer packets are tracked.
+const size_t kMaxTrackedSentPackets = 10000;
+
+}  // namespace
+
+BbrTcpSender::SentPacketState::SentPacketState()
+    : tracked(false),
+      sent_time(QuicTime::Zero()),
+      total_bytes_acked_at_send(0),
+      last_acked_packet_ack_time(QuicTime::Zero()),
+      last_acked_packet_sent_time(QuicTime::Zero()) {}
+
+BbrTcpSender::BbrTcpSender(const QuicClock* clock,
+                           const RttStats* rtt_stats,
+                           QuicRandom* random,
+                           QuicPacketCount initial_tcp_congestion_window,
+                           QuicPacketCount max_congestion_window,
+                           QuicConnectionStats* stats)
+    : clock_(clock),
+      rtt_stats_(rtt_stats),
+      random_(random),
+      stats_(stats),
+      mode_(STARTUP),
+      total_bytes_acked_(0),
+      last_acked_packet_ack_time_(QuicTime::Zero()),
+      last_acked_packet_sent_time_(QuicTime::Zero()),
+      first_sent_packet_(0),
+      last_sent_packet_(0),
+      round_trip_count_(0),
+      current_round_trip_end_(0),
+      max_bandwidth_(kBandwidthWindowSize, QuicBandwidth::Zero(), 0),
+      min_rtt_(QuicTime::Delta::Zero()),
+      min_rtt_timestamp_(QuicTime::Zero()),
+      congestion_window_(initial_tcp_congestion_window * kMaxSegmentSize),
+      initial_congestion_window_(initial_tcp_congestion_window *
+                                 kMaxSegmentSize),
+      min_congestion_window_(kMinimumCongestionWindow),
+      max_congestion_window_(max_congestion_window * kMaxSegmentSize),
+      pacing_gain_(1),
+      congestion_window_gain_(1),
+      cycle_current_offset_(0),
+      last_cycle_start_(QuicTime::Zero()),
+      is_at_full_bandwidth_(false),
+      rounds_without_bandwidth_gain_(0),
+      bandwidth_at_last_round_(QuicBandwidth::Zero()),
+      exit_probe_rtt_at_(QuicTime::Zero()),
+      probe_rtt_round_passed_(false),
+      recovery_state_(NOT_IN_RECOVERY),
+      end_recovery_at_(0),
+      recovery_window_(0) {
+  EnterStartupMode();
+}
+
+BbrTcpSender::~BbrTcpSender() {}
+
+void BbrTcpSender::SetFromConfig(const QuicConfig& config,
+                                 Perspective perspective) {
+  if (perspective == Perspective::IS_SERVER &&
+      config.HasReceivedConnectionOptions() &&
+      ContainsQuicTag(config.ReceivedConnectionOptions(), kIW10)) {
+    // Initial window experiment.
+    congestion_window_ = 10 * kMaxSegmentSize;
+    initial_congestion_window_ = congestion_window_;
+  }
+}
+
+void BbrTcpSender::ResumeConnectionState(
+    const CachedNetworkParameters& cached_network_params,
+    bool max_bandwidth_resumption) {
+  QuicBandwidth bandwidth = QuicBandwidth::FromBytesPerSecond(
+      max_bandwidth_resumption
+          ? cached_network_params.max_bandwidth_estimate_bytes_per_second()
+          : cached_network_params.bandwidth_estimate_bytes_per_second());
+  QuicTime::Delta rtt_ms =
+      QuicTime::Delta::FromMilliseconds(cached_network_params.min_rtt_ms());
+
+  // Make sure CWND is in appropriate range (in case of bad data).
+  QuicByteCount new_congestion_window = bandwidth.ToBytesPerPeriod(rtt_ms);
+  congestion_window_ =
+      max(min(new_congestion_window, kMaxCongestionWindow * kMaxSegmentSize),
+          kMinCongestionWindowForBandwidthResumption * kMaxSegmentSize);
+}
+
+void BbrTcpSender::SetNumEmulatedConnections(int num_connections) {
+  // BBR does not emulate multiple connections.
+}
+
+void BbrTcpSender::SetMaxCongestionWindow(
+    QuicByteCount max_congestion_window) {
+  max_congestion_window_ = max_congestion_window;
+}
+
+void BbrTcpSender::OnCongestionEvent(bool rtt_updated,
+                                     QuicByteCount bytes_in_flight,
+                                     const CongestionVector& acked_packets,
+                                     const CongestionVector& lost_packets) {
+  const QuicTime now = clock_->ApproximateNow();
+  const QuicByteCount prior_in_flight = bytes_in_flight;
+
+  QuicByteCount bytes_lost = 0;
+  for (CongestionVector::const_iterator it = lost_packets.begin();
+       it != lost_packets.end(); ++it) {
+    bytes_lost += it->second.bytes_sent;
+    OnPacketLost(it->first);
+  }
+
+  QuicByteCount bytes_acked = 0;
+  bool is_round_start = false;
+  for (CongestionVector::const_iterator it = acked_packets.begin();
+       it != acked_packets.end(); ++it) {
+    bytes_acked += it->second.bytes_sent;
+    is_round_start |= UpdateRoundTripCounter(it->first);
+    QuicBandwidth sample = OnPacketAcked(it->first, it->second.bytes_sent, now);
+    if (!sample.IsZero()) {
+      max_bandwidth_.Update(sample, round_trip_count_);
+    }
+  }
+  RemoveObsoletePackets();
+
+  bool min_rtt_expired = false;
+  if (rtt_updated) {
+    min_rtt_expired = UpdateMinRtt(now, rtt_stats_->latest_rtt());
+  }
+
+  const bool has_losses = !lost_packets.empty();
+  if (!acked_packets.empty()) {
+    UpdateRecoveryState(acked_packets.back().first, has_losses,
+                        is_round_start);
+  }
+
+  bytes_in_flight -= min(bytes_in_flight, bytes_acked + bytes_lost);
+
+  if (mode_ == PROBE_BW) {
+    UpdateGainCyclePhase(now, prior_in_flight, has_losses);
+  }
+  if (is_round_start && !is_at_full_bandwidth_) {
+    CheckIfFullBandwidthReached();
+  }
+  MaybeExitStartupOrDrain(now, bytes_in_flight);
+  MaybeEnterOrExitProbeRtt(now, is_round_start, min_rtt_expired,
+                           bytes_in_flight);
+
+  CalculateCongestionWindow(bytes_acked);
+  CalculateRecoveryWindow(bytes_acked, bytes_lost, bytes_in_flight);
+}
+
+bool BbrTcpSender::OnPacketSent(QuicTime sent_time,
+                                QuicByteCount bytes_in_flight,
+                                QuicPacketSequenceNumber sequence_number,
+                                QuicByteCount bytes,
+                                HasRetransmittableData is_retransmittable) {
+  if (InSlowStart()) {
+    ++(stats_->slowstart_packets_sent);
+  }
+  DCHECK_LT(last_sent_packet_, sequence_number);
+  last_sent_packet_ = sequence_number;
+
+  if (is_retransmittable != HAS_RETRANSMITTABLE_DATA) {
+    return false;
+  }
+
+  // Leaving quiescence restarts the delivery rate measurement, so that the
+  // idle time is not counted against the next sample.
+  if (bytes_in_flight == 0) {
+    last_acked_packet_ack_time_ = sent_time;
+    last_acked_packet_sent_time_ = sent_time;
+  }
+
+  if (sent_packets_.empty()) {
+    first_sent_packet_ = sequence_number;
+  }
+  while (first_sent_packet_ + sent_packets_.size() <= sequence_number) {
+    sent_packets_.push_back(SentPacketState());
+  }
+  SentPacketState& state = sent_packets_.back();
+  state.tracked = true;
+  state.sent_time = sent_time;
+  state.total_bytes_acked_at_send = total_bytes_acked_;
+  state.last_acked_packet_ack_time = last_acked_packet_ack_time_;
+  state.last_acked_packet_sent_time = last_acked_packet_sent_time_;
+
+  while (sent_packets_.size() > kMaxTrackedSentPackets) {
+    sent_packets_.pop_front();
+    ++first_sent_packet_;
+  }
+  return true;
+}
+
+void BbrTcpSender::OnRetransmissionTimeout(bool packets_retransmitted) {
+  if (!packets_retransmitted) {
+    return;
+  }
+  // The abandoned packets will not be acked or lost, so stop tracking them.
+  sent_packets_.clear();
+}
+
+QuicTime::Delta BbrTcpSender::TimeUntilSend(
+    QuicTime /* now */,
+    QuicByteCount bytes_in_flight,
+    HasRetransmittableData has_retransmittable_data) const {
+  if (has_retransmittable_data == NO_RETRANSMITTABLE_DATA) {
+    return QuicTime::Delta::Zero();
+  }
+  if (bytes_in_flight < GetCongestionWindow()) {
+    return QuicTime::Delta::Zero();
+  }
+  return QuicTime::Delta::Infinite();
+}
+
+QuicBandwidth BbrTcpSender::PacingRate() const {
+  if (BandwidthEstimate().IsZero()) {
+    // Until the first sample, pace the initial window out over the initial
+    // RTT at the STARTUP gain.
+    return QuicBandwidth::FromBytesAndTimeDelta(initial_congestion_window_,
+                                                GetMinRtt())
+        .Scale(kHighGain);
+  }
+  return BandwidthEstimate().Scale(pacing_gain_);
+}
+
+QuicBandwidth BbrTcpSender::BandwidthEstimate() const {
+  return max_bandwidth_.GetBest();
+}
+
+QuicTime::Delta BbrTcpSender::RetransmissionDelay() const {
+  if (rtt_stats_->smoothed_rtt().IsZero()) {
+    return QuicTime::Delta::Zero();
+  }
+  return rtt_stats_->smoothed_rtt().Add(
+      rtt_stats_->mean_deviation().Multiply(4));
+}
+
+QuicByteCount BbrTcpSender::GetCongestionWindow() const {
+  if (mode_ == PROBE_RTT) {
+    return min_congestion_window_;
+  }
+  if (InRecovery() && recovery_window_ > 0) {
+    return min(congestion_window_, recovery_window_);
+  }
+  return congestion_window_;
+}
+
+bool BbrTcpSender::InSlowStart() const {
+  return mode_ == STARTUP;
+}
+
+bool BbrTcpSender::InRecovery() const {
+  return recovery_state_ != NOT_IN_RECOVERY;
+}
+
+QuicByteCount BbrTcpSender::GetSlowStartThreshold() const {
+  return 0;
+}
+
+CongestionControlType BbrTcpSender::GetCongestionControlType() const {
+  return kBBR;
+}
+
+QuicTime::Delta BbrTcpSender::GetMinRtt() const {
+  if (min_rtt_.IsZero()) {
+    return QuicTime::Delta::FromMicroseconds(rtt_stats_->initial_rtt_us());
+  }
+  return min_rtt_;
+}
+
+QuicBandwidth BbrTcpSender::OnPacketAcked(
+    QuicPacketSequenceNumber sequence_number,
+    QuicByteCount bytes,
+    QuicTime ack_time) {
+  total_bytes_acked_ += bytes;
+  SentPacketState* state = GetSentPacketState(sequence_number);
+  if (state == nullptr) {
+    return QuicBandwidth::Zero();
+  }
+  last_acked_packet_ack_time_ = ack_time;
+  last_acked_packet_sent_time_ = state->sent_time;
+  state->tracked = false;
+
+  // The delivery rate is the data acked since the packet was sent, over the
+  // longer of the send and ack intervals it spans, so that neither bursty
+  // sending nor compressed acks inflate it.
+  if (!state->last_acked_packet_sent_time.IsInitialized() ||
+      !state->last_acked_packet_ack_time.IsInitialized()) {
+    return QuicBandwidth::Zero();
+  }
+  QuicTime::Delta send_interval =
+      state->sent_time.Subtract(state->last_acked_packet_sent_time);
+  QuicTime::Delta ack_interval =
+      ack_time.Subtract(state->last_acked_packet_ack_time);
+  QuicTime::Delta interval = QuicTime::Delta::Max(send_interval, ack_interval);
+  if (interval.IsZero()) {
+    return QuicBandwidth::Zero();
+  }
+  return QuicBandwidth::FromBytesAndTimeDelta(
+      total_bytes_acked_ - state->total_bytes_acked_at_send, interval);
+}
+
+void BbrTcpSender::OnPacketLost(QuicPacketSequenceNumber sequence_number) {
+  SentPacketState* state = GetSentPacketState(sequence_number);
+  if (state != nullptr) {
+    state->tracked = false;
+  }
+}
+
+BbrTcpSender::SentPacketState* BbrTcpSender::GetSentPacketState(
+    QuicPacketSequenceNumber sequence_number) {
+  if (sequence_number < first_sent_packet_ ||
+      sequence_number - first_sent_packet_ >= sent_packets_.size()) {
+    return nullptr;
+  }
+  SentPacketState* state = &sent_packets_[sequence_number - first_sent_packet_];
+  return state->tracked ? state : nullptr;
+}
+
+void BbrTcpSender::RemoveObsoletePackets() {
+  while (!sent_packets_.empty() && !sent_packets_.front().tracked) {
+    sent_packets_.pop_front();
+    ++first_sent_packet_;
+  }
+}
+
+bool BbrTcpSender::UpdateRoundTripCounter(
+    QuicPacketSequenceNumber last_acked) {
+  if (last_acked <= current_round_trip_end_) {
+    return false;
+  }
+  ++round_trip_count_;
+  current_round_trip_end_ = last_sent_packet_;
+  return true;
+}
+
+bool BbrTcpSender::UpdateMinRtt(QuicTime now, QuicTime::Delta sample) {
+  if (sample.IsZero()) {
+    return false;
+  }
+  const bool expired =
+      !min_rtt_.IsZero() &&
+      now > min_rtt_timestamp_.Add(
+                QuicTime::Delta::FromSeconds(kMinRttExpirySeconds));
+  if (expired || min_rtt_.IsZero() || sample <= min_rtt_) {
+    min_rtt_ = sample;
+    min_rtt_timestamp_ = now;
+  }
+  return expired;
+}
+
+void BbrTcpSender::EnterStartupMode() {
+  mode_ = STARTUP;
+  pacing_gain_ = kHighGain;
+  congestion_window_gain_ = kHighGain;
+}
+
+void BbrTcpSender::EnterProbeBandwidthMode(QuicTime now) {
+  mode_ = PROBE_BW;
+  congestion_window_gain_ = kCongestionWindowGain;
+
+  // Start at a random phase, other than the draining one, so that flows
+  // sharing a bottleneck do not probe in lockstep.
+  cycle_current_offset_ =
+      random_->RandUint64() % (kGainCycleLength - 1);
+  if (cycle_current_offset_ >= 1) {
+    ++cycle_current_offset_;
+  }
+  last_cycle_start_ = now;
+  pacing_gain_ = kPacingGain[cycle_current_offset_];
+}
+
+void BbrTcpSender::UpdateGainCyclePhase(QuicTime now,
+                                        QuicByteCount prior_in_flight,
+                                        bool has_losses) {
+  // Each phase normally lasts one min RTT.
+  bool should_advance = now.Subtract(last_cycle_start_) > GetMinRtt();
+
+  // Keep probing until the extra data is actually in flight, unless that
+  // already caused losses.
+  if (pacing_gain_ > 1.f && !has_losses &&
+      prior_in_flight < GetTargetCongestionWindow(pacing_gain_)) {
+    should_advance = false;
+  }
+  // Stop draining as soon as the queue is gone.
+  if (pacing_gain_ < 1.f &&
+      prior_in_flight <= GetTargetCongestionWindow(1.f)) {
+    should_advance = true;
+  }
+
+  if (should_advance) {
+    cycle_current_offset_ = (cycle_current_offset_ + 1) % kGainCycleLength;
+    last_cycle_start_ = now;
+    pacing_gain_ = kPacingGain[cycle_current_offset_];
+  }
+}
+
+void BbrTcpSender::CheckIfFullBandwidthReached() {
+  QuicBandwidth target = bandwidth_at_last_round_.Scale(kStartupGrowthTarget);
+  if (BandwidthEstimate() >= target) {
+    bandwidth_at_last_round_ = BandwidthEstimate();
+    rounds_without_bandwidth_gain_ = 0;
+    return;
+  }
+  ++rounds_without_bandwidth_gain_;
+  if (rounds_without_bandwidth_gain_ >=
+      kRoundTripsWithoutGrowthBeforeExitingStartup) {
+    is_at_full_bandwidth_ = true;
+  }
+}
+
+void BbrTcpSender::MaybeExitStartupOrDrain(QuicTime now,
+                                           QuicByteCount bytes_in_flight) {
+  if (mode_ == STARTUP && is_at_full_bandwidth_) {
+    mode_ = DRAIN;
+    pacing_gain_ = kDrainGain;
+    congestion_window_gain_ = kHighGain;
+  }
+  if (mode_ == DRAIN && bytes_in_flight <= GetTargetCongestionWindow(1.f)) {
+    EnterProbeBandwidthMode(now);
+  }
+}
+
+void BbrTcpSender::MaybeEnterOrExitProbeRtt(QuicTime now,
+                                            bool is_round_start,
+                                            bool min_rtt_expired,
+                                            QuicByteCount bytes_in_flight) {
+  if (min_rtt_expired && mode_ != PROBE_RTT) {
+    mode_ = PROBE_RTT;
+    pacing_gain_ = 1.f;
+    exit_probe_rtt_at_ = QuicTime::Zero();
+  }
+  if (mode_ != PROBE_RTT) {
+    return;
+  }
+
+  if (!exit_probe_rtt_at_.IsInitialized()) {
+    // Wait for the data in flight to drop to the PROBE_RTT window before
+    // timing the probe.
+    if (bytes_in_flight < min_congestion_window_ + kMaxPacketSize) {
+      exit_probe_rtt_at_ =
+          now.Add(QuicTime::Delta::FromMilliseconds(kProbeRttTimeMs));
+      probe_rtt_round_passed_ = false;
+    }
+    return;
+  }
+  if (is_round_start) {
+    probe_rtt_round_passed_ = true;
+  }
+  if (now >= exit_probe_rtt_at_ && probe_rtt_round_passed_) {
+    min_rtt_timestamp_ = now;
+    if (is_at_full_bandwidth_) {
+      EnterProbeBandwidthMode(now);
+    } else {
+      EnterStartupMode();
+    }
+  }
+}
+
+void BbrTcpSender::UpdateRecoveryState(QuicPacketSequenceNumber last_acked,
+                                       bool has_losses,
+                                       bool is_round_start) {
+  // Recovery lasts until a packet sent after the latest loss is acked.
+  if (has_losses) {
+    end_recovery_at_ = last_sent_packet_;
+  }
+
+  switch (recovery_state_) {
+    case NOT_IN_RECOVERY:
+      if (has_losses) {
+        recovery_state_ = CONSERVATION;
+        recovery_window_ = 0;
+        // Conservation lasts for one full round trip from now.
+        current_round_trip_end_ = last_sent_packet_;
+      }
+      break;
+    case CONSERVATION:
+      if (is_round_start) {
+        recovery_state_ = GROWTH;
+      }
+      // Fall through.
+    case GROWTH:
+      if (!has_losses && last_acked > end_recovery_at_) {
+        recovery_state_ = NOT_IN_RECOVERY;
+      }
+      break;
+  }
+}
+
+void BbrTcpSender::CalculateCongestionWindow(QuicByteCount bytes_acked) {
+  if (mode_ == PROBE_RTT) {
+    return;
+  }
+  QuicByteCount target_window =
+      GetTargetCongestionWindow(congestion_window_gain_);
+  if (is_at_full_bandwidth_) {
+    // Grow towards the target, but never beyond it.
+    congestion_window_ = min(target_window, congestion_window_ + bytes_acked);
+  } else if (congestion_window_ < target_window ||
+             total_bytes_acked_ < initial_congestion_window_) {
+    // Only grow in STARTUP, since the target is an underestimate until the
+    // bandwidth estimate has converged.
+    congestion_window_ += bytes_acked;
+  }
+  congestion_window_ = max(congestion_window_, min_congestion_window_);
+  congestion_window_ = min(congestion_window_, max_congestion_window_);
+}
+
+void BbrTcpSender::CalculateRecoveryWindow(QuicByteCount bytes_acked,
+                                           QuicByteCount bytes_lost,
+                                           QuicByteCount bytes_in_flight) {
+  if (recovery_state_ == NOT_IN_RECOVERY) {
+    return;
+  }
+  // On entering recovery, allow what is in flight plus what was just acked.
+  if (recovery_window_ == 0) {
+    recovery_window_ =
+        max(bytes_in_flight + bytes_acked, min_congestion_window_);
+    return;
+  }
+  recovery_window_ = recovery_window_ >= bytes_lost
+                         ? recovery_window_ - bytes_lost
+                         : kMaxSegmentSize;
+  if (recovery_state_ == GROWTH) {
+    recovery_window_ += bytes_acked;
+  }
+  // Always allow a packet out for each packet acked.
+  recovery_window_ = max(recovery_window_, bytes_in_flight + bytes_acked);
+  recovery_window_ = max(recovery_window_, min_congestion_window_);
+}
+
+QuicByteCount BbrTcpSender::GetTargetCongestionWindow(float gain) const {
+  if (BandwidthEstimate().IsZero()) {
+    return max(static_cast<QuicByteCount>(gain * initial_congestion_window_),
+               min_congestion_window_);
+  }
+  QuicByteCount bdp = BandwidthEstimate().ToBytesPerPeriod(GetMinRtt());
+  return max(static_cast<QuicByteCount>(gain * bdp), min_congestion_window_);
+}
+
+}  // namespace net
@@ -0,0 +1,221 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// BBR (Bottleneck Bandwidth and RTT) send side congestion algorithm.  Instead
+// of reacting to loss, BBR models the path from the delivery rate of acked
+// packets and the minimum RTT, paces at a gain over the estimated bottleneck
+// bandwidth, and caps the data in flight at a multiple of the estimated
+// bandwidth-delay product.
+
+#ifndef NET_QUIC_CONGESTION_CONTROL_BBR_TCP_SENDER_H_
+#define NET_QUIC_CONGESTION_CONTROL_BBR_TCP_SENDER_H_
+
+#include <deque>
+
+#include "base/basictypes.h"
+#include "net/base/net_export.h"
+#include "net/quic/congestion_control/send_algorithm_interface.h"
+#include "net/quic/congestion_control/windowed_filter.h"
+#include "net/quic/quic_bandwidth.h"
+#include "net/quic/quic_connection_stats.h"
+#include "net/quic/quic_protocol.h"
+#include "net/quic/quic_time.h"
+
+namespace net {
+
+class QuicRandom;
+class RttStats;
+
+typedef uint64 QuicRoundTripCount;
+
+class NET_EXPORT_PRIVATE BbrTcpSender : public SendAlgorithmInterface {
+ public:
+  enum Mode {
+    // Exponential growth until the bandwidth estimate stops increasing.
+    STARTUP,
+    // Drains the queue built up during STARTUP.
+    DRAIN,
+    // Cruises at the estimated bandwidth, periodically probing for more.
+    PROBE_BW,
+    // Briefly shrinks the window to measure the path's minimum RTT.
+    PROBE_RTT,
+  };
+
+  enum RecoveryState {
+    NOT_IN_RECOVERY,
+    // Sends one packet for every packet acked, for one round trip.
+    CONSERVATION,
+    // Allows the recovery window to grow with acks until recovery ends.
+    GROWTH,
+  };
+
+  BbrTcpSender(const QuicClock* clock,
+               const RttStats* rtt_stats,
+               QuicRandom* random,
+               QuicPacketCount initial_tcp_congestion_window,
+               QuicPacketCount max_congestion_window,
+               QuicConnectionStats* stats);
+  ~BbrTcpSender() override;
+
+  // Start implementation of SendAlgorithmInterface.
+  void SetFromConfig(const QuicConfig& config,
+                     Perspective perspective) override;
+  void ResumeConnectionState(
+      const CachedNetworkParameters& cached_network_params,
+      bool max_bandwidth_resumption) override;
+  void SetNumEmulatedConnections(int num_connections) override;
+  void SetMaxCongestionWindow(QuicByteCount max_congestion_window) override;
+  void OnCongestionEvent(bool rtt_updated,
+                         QuicByteCount bytes_in_flight,
+                         const CongestionVector& acked_packets,
+                         const CongestionVector& lost_packets) override;
+  bool OnPacketSent(QuicTime sent_time,
+                    QuicByteCount bytes_in_flight,
+                    QuicPacketSequenceNumber sequence_number,
+                    QuicByteCount bytes,
+                    HasRetransmittableData is_retransmittable) override;
+  void OnRetransmissionTimeout(bool packets_retransmitted) override;
+  QuicTime::Delta TimeUntilSend(
+      QuicTime now,
+      QuicByteCount bytes_in_flight,
+      HasRetransmittableData has_retransmittable_data) const override;
+  QuicBandwidth PacingRate() const override;
+  QuicBandwidth BandwidthEstimate() const override;
+  QuicTime::Delta RetransmissionDelay() const override;
+  QuicByteCount GetCongestionWindow() const override;
+  bool InSlowStart() const override;
+  bool InRecovery() const override;
+  QuicByteCount GetSlowStartThreshold() const override;
+  CongestionControlType GetCongestionControlType() const override;
+  // End implementation of SendAlgorithmInterface.
+
+  Mode mode() const { return mode_; }
+
+  // The minimum RTT used by the model, or the initial RTT if there is no
+  // sample yet.
+  QuicTime::Delta GetMinRtt() const;
+
+ private:
+  typedef WindowedFilter<QuicBandwidth,
+                         MaxFilter<QuicBandwidth>,
+                         QuicRoundTripCount,
+                         QuicRoundTripCount> MaxBandwidthFilter;
+
+  // The connection state when a packet was sent, from which the delivery rate
+  // is computed when it is acked.
+  struct SentPacketState {
+    SentPacketState();
+
+    bool tracked;
+    QuicTime sent_time;
+    // Bytes delivered, and the time of the latest ack, when the packet was
+    // sent.
+    QuicByteCount total_bytes_acked_at_send;
+    QuicTime last_acked_packet_ack_time;
+    // When the packet acked most recently before this one was sent.
+    QuicTime last_acked_packet_sent_time;
+  };
+
+  // Records an acked packet and returns the delivery rate it measures, or
+  // zero if there is no valid sample.
+  QuicBandwidth OnPacketAcked(QuicPacketSequenceNumber sequence_number,
+                              QuicByteCount bytes,
+                              QuicTime ack_time);
+  // Forgets a packet which was lost.
+  void OnPacketLost(QuicPacketSequenceNumber sequence_number);
+  // Returns the send state of |sequence_number|, or null if it is not tracked.
+  SentPacketState* GetSentPacketState(QuicPacketSequenceNumber sequence_number);
+  // Drops untracked packets from the front of |sent_packets_|.
+  void RemoveObsoletePackets();
+
+  // Starts a new round trip if |last_acked| was sent after the current round
+  // began.  Returns true if a new round started.
+  bool UpdateRoundTripCounter(QuicPacketSequenceNumber last_acked);
+  // Updates the min RTT with |sample| and returns true if the old one had
+  // expired.
+  bool UpdateMinRtt(QuicTime now, QuicTime::Delta sample);
+
+  void EnterStartupMode();
+  void EnterProbeBandwidthMode(QuicTime now);
+  void UpdateGainCyclePhase(QuicTime now,
+                            QuicByteCount prior_in_flight,
+                            bool has_losses);
+  void CheckIfFullBandwidthReached();
+  void MaybeExitStartupOrDrain(QuicTime now, QuicByteCount bytes_in_flight);
+  void MaybeEnterOrExitProbeRtt(QuicTime now,
+                                bool is_round_start,
+                                bool min_rtt_expired,
+                                QuicByteCount bytes_in_flight);
+  void UpdateRecoveryState(QuicPacketSequenceNumber last_acked,
+                           bool has_losses,
+                           bool is_round_start);
+  void CalculateCongestionWindow(QuicByteCount bytes_acked);
+  void CalculateRecoveryWindow(QuicByteCount bytes_acked,
+                               QuicByteCount bytes_lost,
+                               QuicByteCount bytes_in_flight);
+
+  // Returns |gain| times the estimated bandwidth-delay product.
+  QuicByteCount GetTargetCongestionWindow(float gain) const;
+
+  const QuicClock* clock_;
+  const RttStats* rtt_stats_;
+  QuicRandom* random_;
+  QuicConnectionStats* stats_;
+
+  Mode mode_;
+
+  // Delivery rate sampling.
+  QuicByteCount total_bytes_acked_;
+  QuicTime last_acked_packet_ack_time_;
+  QuicTime last_acked_packet_sent_time_;
+  // Send state of the packets from |first_sent_packet_| on.
+  QuicPacketSequenceNumber first_sent_packet_;
+  std::deque<SentPacketState> sent_packets_;
+  QuicPacketSequenceNumber last_sent_packet_;
+
+  // Round trips are counted from the acks of packets sent after the previous
+  // round began.
+  QuicRoundTripCount round_trip_count_;
+  QuicPacketSequenceNumber current_round_trip_end_;
+
+  // The maximum delivery rate over the last few round trips.
+  MaxBandwidthFilter max_bandwidth_;
+
+  QuicTime::Delta min_rtt_;
+  QuicTime min_rtt_timestamp_;
+
+  QuicByteCount congestion_window_;
+  QuicByteCount initial_congestion_window_;
+  QuicByteCount min_congestion_window_;
+  QuicByteCount max_congestion_window_;
+
+  float pacing_gain_;
+  float congestion_window_gain_;
+
+  // Position in the PROBE_BW pacing gain cycle, and when it was entered.
+  int cycle_current_offset_;
+  QuicTime last_cycle_start_;
+
+  // Startup ends once the bandwidth estimate stops growing.
+  bool is_at_full_bandwidth_;
+  int rounds_without_bandwidth_gain_;
+  QuicBandwidth bandwidth_at_last_round_;
+
+  // PROBE_RTT ends at |exit_probe_rtt_at_| once a round trip has passed.
+  QuicTime exit_probe_rtt_at_;
+  bool probe_rtt_round_passed_;
+
+  RecoveryState recovery_state_;
+  // Recovery ends when a packet sent after the last loss is acked.
+  QuicPacketSequenceNumber end_recovery_at_;
+  // Limits the data in flight during recovery.  Zero until the first ack
+  // after a loss sets it.
+  QuicByteCount recovery_window_;
+
+  DISALLOW_COPY_AND_ASSIGN(BbrTcpSender);
+};
+
+}  // namespace net
+
+#endif  // NET_QUIC_CONGESTION_CONTROL_BBR_TCP_SENDER_H_
@@ -4,6 +4,7 @@
 
 #include "net/quic/congestion_control/send_algorithm_interface.h"
 
+#include "net/quic/congestion_control/bbr_tcp_sender.h"
 #include "net/quic/congestion_control/tcp_cubic_bytes_sender.h"
 #include "net/quic/congestion_control/tcp_cubic_sender.h"
 #include "net/quic/quic_flags.h"
@@ -18,6 +19,7 @@ SendAlgorithmInterface* SendAlgorithmInterface::Create(
     const QuicClock* clock,
     const RttStats* rtt_stats,
     CongestionControlType congestion_control_type,
+    QuicRandom* random,
     QuicConnectionStats* stats,
     QuicPacketCount initial_congestion_window) {
   const QuicPacketCount max_congestion_window =
@@ -43,13 +45,9 @@ SendAlgorithmInterface* SendAlgorithmInterface::Create(
                                      initial_congestion_window,
                                      max_congestion_window, stats);
     case kBBR:
-  // TODO(rtenneti): Enable BbrTcpSender.
-#if 0
-      return new BbrTcpSender(clock, rtt_stats, initial_congestion_window,
-                              max_congestion_window, stats, true);
-#endif
-      LOG(DFATAL) << "BbrTcpSender is not supported.";
-      return nullptr;
+      return new BbrTcpSender(clock, rtt_stats, random,
+                              initial_congestion_window,
+                              max_congestion_window, stats);
   }
   return nullptr;
 }
@@ -22,6 +22,7 @@
 namespace net {
 
 class CachedNetworkParameters;
+class QuicRandom;
 class RttStats;
 
 class NET_EXPORT_PRIVATE SendAlgorithmInterface {
@@ -30,10 +31,12 @@ class NET_EXPORT_PRIVATE SendAlgorithmInterface {
   typedef std::vector<std::pair<QuicPacketSequenceNumber, TransmissionInfo>>
       CongestionVector;
 
+  // |random| picks BBR's gain cycle phase and must outlive the algorithm.
   static SendAlgorithmInterface* Create(
       const QuicClock* clock,
       const RttStats* rtt_stats,
       CongestionControlType type,
+      QuicRandom* random,
       QuicConnectionStats* stats,
       QuicPacketCount initial_congestion_window);
 
@@ -41,10 +44,6 @@ class NET_EXPORT_PRIVATE SendAlgorithmInterface {
 
   virtual void SetFromConfig(const QuicConfig& config,
                              Perspective perspective) = 0;
-  
-  // Added by jkhoury
-  // Sender reporting
-  virtual void PrintMyStats(QuicTime ack_receive_time) = 0;
 
   // Sets the number of connections to emulate when doing congestion control,
   // particularly for congestion avoidance.  Can be set any time.
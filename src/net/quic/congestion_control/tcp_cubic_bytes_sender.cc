@@ -10,7 +10,6 @@
 #include "net/quic/congestion_control/rtt_stats.h"
 #include "net/quic/crypto/crypto_protocol.h"
 #include "net/quic/proto/cached_network_parameters.pb.h"
-#include <iostream>
 
 using std::max;
 using std::min;
@@ -78,11 +77,6 @@ void TcpCubicBytesSender::SetFromConfig(const QuicConfig& config,
   }
 }
 
-    // added by jkhoury
-void TcpCubicBytesSender::PrintMyStats(QuicTime ack_receive_time){
-    std::cout << "Hello from bytes sender \n";
-}
-
 void TcpCubicBytesSender::ResumeConnectionState(
     const CachedNetworkParameters& cached_network_params,
     bool max_bandwidth_resumption) {
@@ -41,7 +41,6 @@ class NET_EXPORT_PRIVATE TcpCubicSender : public SendAlgorithmInterface {
   // Start implementation of SendAlgorithmInterface.
   void SetFromConfig(const QuicConfig& config,
                      Perspective perspective) override;
-  void PrintMyStats(QuicTime ack_receive_time) override; // added by jkhoury
   void ResumeConnectionState(
       const CachedNetworkParameters& cached_network_params,
       bool max_bandwidth_resumption) override;
@@ -131,12 +130,6 @@ class NET_EXPORT_PRIVATE TcpCubicSender : public SendAlgorithmInterface {
   // Maximum number of outstanding packets for tcp.
   QuicPacketCount max_tcp_congestion_window_;
 
-  const QuicClock* clock_;
-  // added by jkhoury for reporting
-  QuicTime lastRcvdAckTime_;
-  QuicPacketCount last_congestion_window_;
-  Perspective perspective_;
-
   DISALLOW_COPY_AND_ASSIGN(TcpCubicSender);
 };
 
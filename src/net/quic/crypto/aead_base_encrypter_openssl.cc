@@ -108,11 +108,14 @@ bool AeadBaseEncrypter::EncryptPacket(QuicPacketSequenceNumber sequence_number,
   }
   // TODO(ianswett): Introduce a check to ensure that we don't encrypt with the
   // same sequence number twice.
+  // The nonce is built on the stack rather than in |output|, which may hold
+  // the plaintext.
+  char nonce[kMaxNoncePrefixSize + sizeof(sequence_number)];
   const size_t nonce_size = nonce_prefix_size_ + sizeof(sequence_number);
-  memcpy(output, nonce_prefix_, nonce_prefix_size_);
-  memcpy(output + nonce_prefix_size_, &sequence_number,
+  memcpy(nonce, nonce_prefix_, nonce_prefix_size_);
+  memcpy(nonce + nonce_prefix_size_, &sequence_number,
          sizeof(sequence_number));
-  if (!Encrypt(StringPiece(output, nonce_size), associated_data, plaintext,
+  if (!Encrypt(StringPiece(nonce, nonce_size), associated_data, plaintext,
                reinterpret_cast<unsigned char*>(output))) {
     return false;
   }
@@ -0,0 +1,43 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_QUIC_CRYPTO_CACHED_STATE_STORE_H_
+#define NET_QUIC_CRYPTO_CACHED_STATE_STORE_H_
+
+#include <string>
+#include <vector>
+
+#include "net/base/net_export.h"
+
+namespace net {
+
+class QuicServerId;
+
+// CachedStateStore is an interface to persistent storage for the part of a
+// QuicCryptoClientConfig::CachedState that outlives a process: the server
+// config, the source address token and the proof.  With it a new client can
+// send a complete client hello to a server it has talked to before instead of
+// waiting a round trip for a REJ.
+class NET_EXPORT_PRIVATE CachedStateStore {
+ public:
+  struct State {
+    std::string server_config;
+    std::string source_address_token;
+    std::vector<std::string> certs;
+    std::string server_config_sig;
+  };
+
+  virtual ~CachedStateStore() {}
+
+  // Reads the state saved for |server_id| into |state|.  Returns false if
+  // there is none or it can not be read.
+  virtual bool Load(const QuicServerId& server_id, State* state) = 0;
+
+  // Saves |state| for |server_id|, replacing what was saved before.
+  virtual void Save(const QuicServerId& server_id, const State& state) = 0;
+};
+
+}  // namespace net
+
+#endif  // NET_QUIC_CRYPTO_CACHED_STATE_STORE_H_
@@ -8,6 +8,7 @@
 #include <string>
 #include <vector>
 
+#include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "net/base/net_export.h"
 #include "net/quic/quic_protocol.h"
@@ -92,11 +93,13 @@ struct NET_EXPORT_PRIVATE CrypterPair {
   scoped_ptr<QuicDecrypter> decrypter;
 };
 
-// Parameters negotiated by the crypto handshake.
-struct NET_EXPORT_PRIVATE QuicCryptoNegotiatedParameters {
+// Parameters negotiated by the crypto handshake.  Reference counted so that
+// a server can fill them in on a crypto worker thread while the stream that
+// owns them may go away.
+struct NET_EXPORT_PRIVATE QuicCryptoNegotiatedParameters
+    : public base::RefCountedThreadSafe<QuicCryptoNegotiatedParameters> {
   // Initializes the members to 0 or empty values.
   QuicCryptoNegotiatedParameters();
-  ~QuicCryptoNegotiatedParameters();
 
   QuicTag key_exchange;
   QuicTag aead;
@@ -133,6 +136,11 @@ struct NET_EXPORT_PRIVATE QuicCryptoNegotiatedParameters {
   // Used to generate cert chain when sending server config updates.
   std::string client_common_set_hashes;
   std::string client_cached_cert_hashes;
+
+ private:
+  friend class base::RefCountedThreadSafe<QuicCryptoNegotiatedParameters>;
+
+  ~QuicCryptoNegotiatedParameters();
 };
 
 // QuicCryptoConfig contains common configuration between clients and servers.
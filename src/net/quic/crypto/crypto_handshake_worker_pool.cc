@@ -0,0 +1,202 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/crypto/crypto_handshake_worker_pool.h"
+
+#include "base/logging.h"
+#include "base/stl_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/threading/platform_thread.h"
+#include "net/quic/crypto/quic_random.h"
+
+using std::string;
+
+namespace net {
+
+ProcessClientHelloResultCallback::ProcessClientHelloResultCallback() {
+}
+
+ProcessClientHelloResultCallback::~ProcessClientHelloResultCallback() {
+}
+
+// The inputs and outputs of one ProcessClientHello.  The inputs are copied,
+// or referenced, so that the job does not depend on the connection.
+struct CryptoHandshakeWorkerPool::Job {
+  Job(const ValidateClientHelloResultCallback::Result& result,
+      QuicConnectionId connection_id,
+      const IPAddressNumber& server_ip,
+      const IPEndPoint& client_address,
+      QuicVersion version,
+      const QuicVersionVector& supported_versions,
+      bool use_stateless_rejects,
+      QuicConnectionId server_designated_connection_id,
+      QuicCryptoNegotiatedParameters* params,
+      ProcessClientHelloResultCallback* done_cb)
+      : result(&result),
+        connection_id(connection_id),
+        server_ip(server_ip),
+        client_address(client_address),
+        version(version),
+        supported_versions(supported_versions),
+        use_stateless_rejects(use_stateless_rejects),
+        server_designated_connection_id(server_designated_connection_id),
+        params(params),
+        done_cb(done_cb),
+        error(QUIC_NO_ERROR) {}
+
+  scoped_refptr<const ValidateClientHelloResultCallback::Result> result;
+  const QuicConnectionId connection_id;
+  const IPAddressNumber server_ip;
+  const IPEndPoint client_address;
+  const QuicVersion version;
+  const QuicVersionVector supported_versions;
+  const bool use_stateless_rejects;
+  const QuicConnectionId server_designated_connection_id;
+  scoped_refptr<QuicCryptoNegotiatedParameters> params;
+  scoped_ptr<ProcessClientHelloResultCallback> done_cb;
+
+  QuicErrorCode error;
+  string error_details;
+  CryptoHandshakeMessage reply;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Job);
+};
+
+// Runs jobs until the pool shuts down.
+class CryptoHandshakeWorkerPool::Worker
+    : public base::PlatformThread::Delegate {
+ public:
+  Worker(CryptoHandshakeWorkerPool* pool, size_t index)
+      : pool_(pool), index_(index) {}
+  ~Worker() override {}
+
+  bool Start() {
+    return base::PlatformThread::Create(0, this, &handle_);
+  }
+
+  void Join() {
+    base::PlatformThread::Join(handle_);
+  }
+
+  // base::PlatformThread::Delegate implementation.
+  void ThreadMain() override {
+    base::PlatformThread::SetName(
+        base::StringPrintf("QuicCryptoWorker%u",
+                           static_cast<unsigned>(index_)));
+    while (Job* job = pool_->WaitForJob()) {
+      job->error = pool_->crypto_config_->ProcessClientHello(
+          *job->result, job->connection_id, job->server_ip,
+          job->client_address, job->version, job->supported_versions,
+          job->use_stateless_rejects, job->server_designated_connection_id,
+          &pool_->clock_, QuicRandom::GetInstance(), job->params.get(),
+          &job->reply, &job->error_details);
+      pool_->OnJobDone(job);
+    }
+  }
+
+ private:
+  CryptoHandshakeWorkerPool* pool_;  // Not owned.
+  const size_t index_;
+  base::PlatformThreadHandle handle_;
+
+  DISALLOW_COPY_AND_ASSIGN(Worker);
+};
+
+CryptoHandshakeWorkerPool::CryptoHandshakeWorkerPool(
+    const QuicCryptoServerConfig* crypto_config,
+    size_t num_threads,
+    Delegate* delegate)
+    : crypto_config_(crypto_config),
+      delegate_(delegate),
+      job_available_(&lock_),
+      num_running_jobs_(0),
+      shutting_down_(false) {
+  DCHECK_LT(0u, num_threads);
+  for (size_t i = 0; i < num_threads; ++i) {
+    Worker* worker = new Worker(this, i);
+    if (!worker->Start()) {
+      LOG(DFATAL) << "Failed to start crypto worker thread " << i;
+      delete worker;
+      break;
+    }
+    workers_.push_back(worker);
+  }
+}
+
+CryptoHandshakeWorkerPool::~CryptoHandshakeWorkerPool() {
+  {
+    base::AutoLock locked(lock_);
+    shutting_down_ = true;
+    job_available_.Broadcast();
+  }
+  for (Worker* worker : workers_) {
+    worker->Join();
+  }
+  STLDeleteElements(&workers_);
+  STLDeleteElements(&queued_jobs_);
+  STLDeleteElements(&completed_jobs_);
+}
+
+void CryptoHandshakeWorkerPool::ProcessClientHello(
+    const ValidateClientHelloResultCallback::Result& result,
+    QuicConnectionId connection_id,
+    const IPAddressNumber& server_ip,
+    const IPEndPoint& client_address,
+    QuicVersion version,
+    const QuicVersionVector& supported_versions,
+    bool use_stateless_rejects,
+    QuicConnectionId server_designated_connection_id,
+    QuicCryptoNegotiatedParameters* params,
+    ProcessClientHelloResultCallback* done_cb) {
+  Job* job = new Job(result, connection_id, server_ip, client_address,
+                     version, supported_versions, use_stateless_rejects,
+                     server_designated_connection_id, params, done_cb);
+  base::AutoLock locked(lock_);
+  queued_jobs_.push_back(job);
+  job_available_.Signal();
+}
+
+void CryptoHandshakeWorkerPool::RunCompletedCallbacks() {
+  std::vector<Job*> completed_jobs;
+  {
+    base::AutoLock locked(lock_);
+    completed_jobs.swap(completed_jobs_);
+  }
+  for (Job* job : completed_jobs) {
+    job->done_cb->Run(*job->result, job->error, job->error_details,
+                      &job->reply);
+    delete job;
+  }
+}
+
+size_t CryptoHandshakeWorkerPool::num_pending_jobs() const {
+  base::AutoLock locked(lock_);
+  return queued_jobs_.size() + num_running_jobs_;
+}
+
+CryptoHandshakeWorkerPool::Job* CryptoHandshakeWorkerPool::WaitForJob() {
+  base::AutoLock locked(lock_);
+  while (queued_jobs_.empty() && !shutting_down_) {
+    job_available_.Wait();
+  }
+  if (shutting_down_) {
+    return nullptr;
+  }
+  Job* job = queued_jobs_.front();
+  queued_jobs_.pop_front();
+  ++num_running_jobs_;
+  return job;
+}
+
+void CryptoHandshakeWorkerPool::OnJobDone(Job* job) {
+  {
+    base::AutoLock locked(lock_);
+    --num_running_jobs_;
+    completed_jobs_.push_back(job);
+  }
+  delegate_->OnJobCompleted();
+}
+
+}  // namespace net
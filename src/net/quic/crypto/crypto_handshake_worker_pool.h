@@ -0,0 +1,133 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_QUIC_CRYPTO_CRYPTO_HANDSHAKE_WORKER_POOL_H_
+#define NET_QUIC_CRYPTO_CRYPTO_HANDSHAKE_WORKER_POOL_H_
+
+// CryptoHandshakeWorkerPool runs QuicCryptoServerConfig::ProcessClientHello,
+// which does the key exchange, signs the server config and derives the
+// connection keys, on a pool of worker threads.  Without it a burst of new
+// connections holds up the packets of every established connection on the
+// network thread.
+//
+// Jobs are posted from the network thread.  When a job finishes, the Delegate
+// is told from the worker thread, and the network thread then calls
+// RunCompletedCallbacks() to deliver the results.  Results are only ever
+// delivered on the network thread, so the callbacks need no locking.
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "net/base/ip_endpoint.h"
+#include "net/base/net_export.h"
+#include "net/base/net_util.h"
+#include "net/quic/crypto/crypto_handshake.h"
+#include "net/quic/crypto/crypto_handshake_message.h"
+#include "net/quic/crypto/quic_crypto_server_config.h"
+#include "net/quic/quic_clock.h"
+#include "net/quic/quic_protocol.h"
+
+namespace net {
+
+// Receives the outcome of a ProcessClientHello run by a
+// CryptoHandshakeWorkerPool.  Run() is called exactly once, on the network
+// thread, after which the callback is deleted.
+class NET_EXPORT_PRIVATE ProcessClientHelloResultCallback {
+ public:
+  ProcessClientHelloResultCallback();
+  virtual ~ProcessClientHelloResultCallback();
+
+  // |result| is the validated client hello the job processed.  |error|,
+  // |error_details| and |reply| are as returned by ProcessClientHello;
+  // |reply| may be modified.
+  virtual void Run(const ValidateClientHelloResultCallback::Result& result,
+                   QuicErrorCode error,
+                   const std::string& error_details,
+                   CryptoHandshakeMessage* reply) = 0;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ProcessClientHelloResultCallback);
+};
+
+class NET_EXPORT_PRIVATE CryptoHandshakeWorkerPool {
+ public:
+  class NET_EXPORT_PRIVATE Delegate {
+   public:
+    virtual ~Delegate() {}
+
+    // Called on a worker thread when a job has finished.  Must arrange for
+    // RunCompletedCallbacks() to be called on the network thread soon.
+    virtual void OnJobCompleted() = 0;
+  };
+
+  // Starts |num_threads| worker threads.  |crypto_config| must outlive the
+  // pool.  Does not take ownership of |delegate|.
+  CryptoHandshakeWorkerPool(const QuicCryptoServerConfig* crypto_config,
+                            size_t num_threads,
+                            Delegate* delegate);
+  // Joins the worker threads.  Callbacks of jobs which have not been
+  // delivered are deleted without being run.
+  ~CryptoHandshakeWorkerPool();
+
+  // Queues a ProcessClientHello of |result| for a worker thread.  The
+  // arguments are those of QuicCryptoServerConfig::ProcessClientHello; the
+  // job keeps references to |result| and |params| until it is delivered.
+  // Takes ownership of |done_cb|.
+  void ProcessClientHello(
+      const ValidateClientHelloResultCallback::Result& result,
+      QuicConnectionId connection_id,
+      const IPAddressNumber& server_ip,
+      const IPEndPoint& client_address,
+      QuicVersion version,
+      const QuicVersionVector& supported_versions,
+      bool use_stateless_rejects,
+      QuicConnectionId server_designated_connection_id,
+      QuicCryptoNegotiatedParameters* params,
+      ProcessClientHelloResultCallback* done_cb);
+
+  // Runs the callbacks of the finished jobs.  Must be called on the network
+  // thread.
+  void RunCompletedCallbacks();
+
+  // Number of jobs queued or running.
+  size_t num_pending_jobs() const;
+
+ private:
+  struct Job;
+  class Worker;
+
+  // Called by the workers.  Blocks until there is a job or the pool is shut
+  // down, in which case it returns null.
+  Job* WaitForJob();
+  void OnJobDone(Job* job);
+
+  const QuicCryptoServerConfig* crypto_config_;  // Not owned.
+  Delegate* delegate_;  // Not owned.
+
+  // Used for the wall time on the workers, as the connection's clock may only
+  // be read on the network thread.
+  QuicClock clock_;
+
+  mutable base::Lock lock_;
+  // Signalled when a job is queued or the pool shuts down.
+  base::ConditionVariable job_available_;
+  std::deque<Job*> queued_jobs_;
+  std::vector<Job*> completed_jobs_;
+  size_t num_running_jobs_;
+  bool shutting_down_;
+
+  std::vector<Worker*> workers_;
+
+  DISALLOW_COPY_AND_ASSIGN(CryptoHandshakeWorkerPool);
+};
+
+}  // namespace net
+
+#endif  // NET_QUIC_CRYPTO_CRYPTO_HANDSHAKE_WORKER_POOL_H_
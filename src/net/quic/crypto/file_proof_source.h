@@ -0,0 +1,85 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_QUIC_CRYPTO_FILE_PROOF_SOURCE_H_
+#define NET_QUIC_CRYPTO_FILE_PROOF_SOURCE_H_
+
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/containers/hash_tables.h"
+#include "base/synchronization/lock.h"
+#include "net/base/net_export.h"
+#include "net/quic/crypto/proof_source.h"
+
+namespace net {
+
+// FileProofSource is a ProofSource that serves certificate chains and keys
+// loaded from PEM files, one per hostname.  Server config signatures are
+// cached, keyed by the resolved chain and server config, so that a key is
+// used once per server config rather than once per client hello, however many
+// hostnames map to the chain.  The cache holds at most |max_cached_signatures|
+// entries and evicts the least recently used one.
+class NET_EXPORT_PRIVATE FileProofSource : public ProofSource {
+ public:
+  explicit FileProofSource(size_t max_cached_signatures);
+  ~FileProofSource() override;
+
+  // Loads the PEM certificates in |chain_path|, leaf first, and the PEM
+  // private key of the leaf in |key_path|, and serves them for |hostname|.
+  // An empty |hostname| sets the chain used for hostnames without one of
+  // their own.  Returns false, and logs why, if the files can not be used.
+  // Must be called before the first GetProof().
+  bool AddCertificateChain(const std::string& hostname,
+                           const std::string& chain_path,
+                           const std::string& key_path);
+
+  // ProofSource interface.
+  bool GetProof(const IPAddressNumber& server_ip,
+                const std::string& hostname,
+                const std::string& server_config,
+                bool ecdsa_ok,
+                const std::vector<std::string>** out_certs,
+                std::string* out_signature) override;
+
+  // Counters of the signature cache.
+  uint64 num_signature_cache_hits() const;
+  uint64 num_signature_cache_misses() const;
+
+ private:
+  struct Chain;
+
+  // Most recently used first: (cache key, signature).
+  typedef std::list<std::pair<std::string, std::string>> SignatureList;
+
+  // Returns the chain for |hostname|, or null.
+  const Chain* FindChain(const std::string& hostname) const;
+
+  // Signs |server_config| with the key of |chain|.
+  static bool Sign(const Chain& chain,
+                   const std::string& server_config,
+                   std::string* out_signature);
+
+  // Chains by hostname.  Immutable once GetProof() has been called, so it is
+  // read without locking.
+  std::map<std::string, Chain*> chains_;
+
+  const size_t max_cached_signatures_;
+
+  mutable base::Lock signature_cache_lock_;
+  SignatureList signature_list_;
+  base::hash_map<std::string, SignatureList::iterator> signature_map_;
+  uint64 num_signature_cache_hits_;
+  uint64 num_signature_cache_misses_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileProofSource);
+};
+
+}  // namespace net
+
+#endif  // NET_QUIC_CRYPTO_FILE_PROOF_SOURCE_H_
@@ -0,0 +1,233 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/crypto/file_proof_source.h"
+
+#include <openssl/bio.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+
+#include "base/logging.h"
+#include "base/stl_util.h"
+#include "crypto/openssl_util.h"
+#include "crypto/scoped_openssl_types.h"
+#include "net/quic/crypto/crypto_protocol.h"
+
+using std::string;
+using std::vector;
+
+namespace net {
+
+namespace {
+
+typedef crypto::ScopedOpenSSL<X509, X509_free> ScopedX509;
+
+// Reads the PEM certificates in |path| into |certs| as DER.
+bool ReadCertificates(const string& path, vector<string>* certs) {
+  crypto::ScopedBIO bio(BIO_new_file(path.c_str(), "r"));
+  if (!bio) {
+    LOG(ERROR) << "Failed to open " << path;
+    return false;
+  }
+  while (true) {
+    ScopedX509 cert(PEM_read_bio_X509(bio.get(), nullptr, nullptr, nullptr));
+    if (!cert) {
+      break;
+    }
+    uint8_t* der = nullptr;
+    int der_len = i2d_X509(cert.get(), &der);
+    if (der_len <= 0) {
+      LOG(ERROR) << "Failed to encode a certificate of " << path;
+      return false;
+    }
+    crypto::ScopedOpenSSLBytes free_der(der);
+    certs->push_back(string(reinterpret_cast<char*>(der), der_len));
+  }
+  // Reading stops with an error at the end of the file.
+  crypto::ClearOpenSSLERRStack(FROM_HERE);
+  if (certs->empty()) {
+    LOG(ERROR) << "No certificates in " << path;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+struct FileProofSource::Chain {
+  vector<string> certs;
+  crypto::ScopedEVP_PKEY key;
+};
+
+FileProofSource::FileProofSource(size_t max_cached_signatures)
+    : max_cached_signatures_(max_cached_signatures),
+      num_signature_cache_hits_(0),
+      num_signature_cache_misses_(0) {
+  crypto::EnsureOpenSSLInit();
+}
+
+FileProofSource::~FileProofSource() {
+  STLDeleteValues(&chains_);
+}
+
+bool FileProofSource::AddCertificateChain(const string& hostname,
+                                          const string& chain_path,
+                                          const string& key_path) {
+  scoped_ptr<Chain> chain(new Chain);
+  if (!ReadCertificates(chain_path, &chain->certs)) {
+    return false;
+  }
+
+  crypto::ScopedBIO bio(BIO_new_file(key_path.c_str(), "r"));
+  if (!bio) {
+    LOG(ERROR) << "Failed to open " << key_path;
+    return false;
+  }
+  chain->key.reset(
+      PEM_read_bio_PrivateKey(bio.get(), nullptr, nullptr, nullptr));
+  if (!chain->key) {
+    LOG(ERROR) << "No private key in " << key_path;
+    return false;
+  }
+  const int key_type = EVP_PKEY_id(chain->key.get());
+  if (key_type != EVP_PKEY_RSA && key_type != EVP_PKEY_EC) {
+    LOG(ERROR) << "The key in " << key_path << " is neither RSA nor ECDSA";
+    return false;
+  }
+
+  const uint8_t* der =
+      reinterpret_cast<const uint8_t*>(chain->certs[0].data());
+  ScopedX509 leaf(d2i_X509(nullptr, &der, chain->certs[0].size()));
+  if (!leaf || X509_check_private_key(leaf.get(), chain->key.get()) != 1) {
+    crypto::ClearOpenSSLERRStack(FROM_HERE);
+    LOG(ERROR) << "The key in " << key_path << " does not belong to the "
+               << "first certificate of " << chain_path;
+    return false;
+  }
+
+  std::map<string, Chain*>::iterator it = chains_.find(hostname);
+  if (it != chains_.end()) {
+    delete it->second;
+    chains_.erase(it);
+  }
+  chains_[hostname] = chain.release();
+  return true;
+}
+
+bool FileProofSource::GetProof(const IPAddressNumber& server_ip,
+                               const string& hostname,
+                               const string& server_config,
+                               bool ecdsa_ok,
+                               const vector<string>** out_certs,
+                               string* out_signature) {
+  const Chain* chain = FindChain(hostname);
+  if (chain == nullptr) {
+    DVLOG(1) << "No certificate chain for " << hostname;
+    return false;
+  }
+  if (!ecdsa_ok && EVP_PKEY_id(chain->key.get()) != EVP_PKEY_RSA) {
+    DVLOG(1) << "Client does not accept the ECDSA chain of " << hostname;
+    return false;
+  }
+  *out_certs = &chain->certs;
+
+  // The signature depends only on the chain and the config.  Keying on the
+  // resolved chain lets every hostname that falls back to the same chain
+  // share one entry; |chains_| is immutable here, so the pointer is stable.
+  string key(reinterpret_cast<const char*>(&chain), sizeof(chain));
+  key.append(server_config);
+  {
+    base::AutoLock locked(signature_cache_lock_);
+    base::hash_map<string, SignatureList::iterator>::iterator it =
+        signature_map_.find(key);
+    if (it != signature_map_.end()) {
+      signature_list_.splice(signature_list_.begin(), signature_list_,
+                             it->second);
+      *out_signature = it->second->second;
+      ++num_signature_cache_hits_;
+      return true;
+    }
+    ++num_signature_cache_misses_;
+  }
+
+  // Sign without the lock, so that other hostnames and configs are not held
+  // up.  Concurrent misses of the same entry each sign; the first one to
+  // finish is cached.
+  if (!Sign(*chain, server_config, out_signature)) {
+    return false;
+  }
+
+  if (max_cached_signatures_ == 0) {
+    return true;
+  }
+  base::AutoLock locked(signature_cache_lock_);
+  if (ContainsKey(signature_map_, key)) {
+    return true;
+  }
+  signature_list_.push_front(std::make_pair(key, *out_signature));
+  signature_map_[key] = signature_list_.begin();
+  if (signature_list_.size() > max_cached_signatures_) {
+    signature_map_.erase(signature_list_.back().first);
+    signature_list_.pop_back();
+  }
+  return true;
+}
+
+uint64 FileProofSource::num_signature_cache_hits() const {
+  base::AutoLock locked(signature_cache_lock_);
+  return num_signature_cache_hits_;
+}
+
+uint64 FileProofSource::num_signature_cache_misses() const {
+  base::AutoLock locked(signature_cache_lock_);
+  return num_signature_cache_misses_;
+}
+
+const FileProofSource::Chain* FileProofSource::FindChain(
+    const string& hostname) const {
+  std::map<string, Chain*>::const_iterator it = chains_.find(hostname);
+  if (it == chains_.end()) {
+    it = chains_.find(string());
+  }
+  return it == chains_.end() ? nullptr : it->second;
+}
+
+// static
+bool FileProofSource::Sign(const Chain& chain,
+                           const string& server_config,
+                           string* out_signature) {
+  crypto::OpenSSLErrStackTracer err_tracer(FROM_HERE);
+  crypto::ScopedEVP_MD_CTX ctx(EVP_MD_CTX_create());
+  EVP_PKEY_CTX* pkey_ctx = nullptr;
+  if (!EVP_DigestSignInit(ctx.get(), &pkey_ctx, EVP_sha256(), nullptr,
+                          chain.key.get())) {
+    return false;
+  }
+  if (EVP_PKEY_id(chain.key.get()) == EVP_PKEY_RSA &&
+      (!EVP_PKEY_CTX_set_rsa_padding(pkey_ctx, RSA_PKCS1_PSS_PADDING) ||
+       !EVP_PKEY_CTX_set_rsa_pss_saltlen(pkey_ctx, -1))) {
+    return false;
+  }
+  // The label is signed with its terminating NUL.
+  size_t signature_len;
+  if (!EVP_DigestSignUpdate(ctx.get(), kProofSignatureLabel,
+                            sizeof(kProofSignatureLabel)) ||
+      !EVP_DigestSignUpdate(ctx.get(), server_config.data(),
+                            server_config.size()) ||
+      !EVP_DigestSignFinal(ctx.get(), nullptr, &signature_len)) {
+    return false;
+  }
+  out_signature->resize(signature_len);
+  if (!EVP_DigestSignFinal(
+          ctx.get(), reinterpret_cast<uint8_t*>(&(*out_signature)[0]),
+          &signature_len)) {
+    return false;
+  }
+  out_signature->resize(signature_len);
+  return true;
+}
+
+}  // namespace net
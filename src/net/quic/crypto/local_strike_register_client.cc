@@ -12,17 +12,17 @@ using std::string;
 namespace net {
 
 LocalStrikeRegisterClient::LocalStrikeRegisterClient(
+    unsigned num_shards,
     unsigned max_entries,
     uint32 current_time_external,
     uint32 window_secs,
     const uint8 orbit[8],
     StrikeRegister::StartupType startup)
-    : strike_register_(max_entries, current_time_external,  window_secs,
-                       orbit, startup) {
+    : strike_register_(num_shards, max_entries, current_time_external,
+                       window_secs, orbit, startup) {
 }
 
 bool LocalStrikeRegisterClient::IsKnownOrbit(StringPiece orbit) const {
-  base::AutoLock lock(m_);
   if (orbit.length() != kOrbitSize) {
     return false;
   }
@@ -37,13 +37,12 @@ void LocalStrikeRegisterClient::VerifyNonceIsValidAndUnique(
   if (nonce.length() != kNonceSize) {
     nonce_error = NONCE_INVALID_FAILURE;
   } else {
-    base::AutoLock lock(m_);
     nonce_error = strike_register_.Insert(
         reinterpret_cast<const uint8*>(nonce.data()),
         static_cast<uint32>(now.ToUNIXSeconds()));
   }
 
-  // m_ must not be held when the ResultCallback runs.
+  // No shard lock may be held when the ResultCallback runs.
   cb->Run((nonce_error == NONCE_OK), nonce_error);
 }
 
@@ -7,8 +7,8 @@
 
 #include "base/basictypes.h"
 #include "base/strings/string_piece.h"
-#include "base/synchronization/lock.h"
 #include "net/base/net_export.h"
+#include "net/quic/crypto/sharded_strike_register.h"
 #include "net/quic/crypto/strike_register.h"
 #include "net/quic/crypto/strike_register_client.h"
 #include "net/quic/quic_time.h"
@@ -16,11 +16,13 @@
 namespace net {
 
 // StrikeRegisterClient implementation that wraps a local in-memory
-// strike register.
+// strike register, split into |num_shards| independently locked shards so
+// that it may be used from several threads at once.
 class NET_EXPORT_PRIVATE LocalStrikeRegisterClient
     : public StrikeRegisterClient {
  public:
-  LocalStrikeRegisterClient(unsigned max_entries,
+  LocalStrikeRegisterClient(unsigned num_shards,
+                            unsigned max_entries,
                             uint32 current_time_external,
                             uint32 window_secs,
                             const uint8 orbit[8],
@@ -32,8 +34,7 @@ class NET_EXPORT_PRIVATE LocalStrikeRegisterClient
                                    ResultCallback* cb) override;
 
  private:
-  mutable base::Lock m_;
-  StrikeRegister strike_register_;
+  ShardedStrikeRegister strike_register_;
 
   DISALLOW_COPY_AND_ASSIGN(LocalStrikeRegisterClient);
 };
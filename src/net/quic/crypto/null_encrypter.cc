@@ -34,9 +34,11 @@ bool NullEncrypter::EncryptPacket(QuicPacketSequenceNumber /*sequence_number*/,
   uint128 hash = QuicUtils::FNV1a_128_Hash_Two(
       associated_data.data(), associated_data.size(), plaintext.data(),
       plaintext.size());
+  // |output| may hold the plaintext, so it is moved before the hash is
+  // written.
+  memmove(output + GetHashLength(), plaintext.data(), plaintext.length());
   QuicUtils::SerializeUint128Short(hash,
                                    reinterpret_cast<unsigned char*>(output));
-  memcpy(output + GetHashLength(), plaintext.data(), plaintext.length());
   *output_length = len;
   return true;
 }
@@ -0,0 +1,102 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/crypto/quic_compressed_certs_cache.h"
+
+#include "net/quic/crypto/cert_compressor.h"
+
+using base::StringPiece;
+using std::string;
+using std::vector;
+
+namespace net {
+
+namespace {
+
+// Appends |value| to |key| preceded by its length, so that the fields of a
+// key can not run into each other.
+void AppendToKey(StringPiece value, string* key) {
+  const uint32 length = value.size();
+  key->append(reinterpret_cast<const char*>(&length), sizeof(length));
+  value.AppendToString(key);
+}
+
+}  // namespace
+
+QuicCompressedCertsCache::QuicCompressedCertsCache(size_t max_entries)
+    : compressed_(max_entries),
+      decompressed_(max_entries),
+      num_hits_(0),
+      num_misses_(0) {
+}
+
+QuicCompressedCertsCache::~QuicCompressedCertsCache() {
+}
+
+string QuicCompressedCertsCache::CompressChain(
+    const vector<string>& certs,
+    StringPiece client_common_set_hashes,
+    StringPiece client_cached_cert_hashes,
+    const CommonCertSets* common_sets) {
+  const vector<string>* chain = &certs;
+  string key(reinterpret_cast<const char*>(&chain), sizeof(chain));
+  AppendToKey(client_common_set_hashes, &key);
+  AppendToKey(client_cached_cert_hashes, &key);
+  {
+    base::AutoLock locked(lock_);
+    const string* compressed = compressed_.Lookup(key);
+    if (compressed != nullptr) {
+      ++num_hits_;
+      return *compressed;
+    }
+    ++num_misses_;
+  }
+
+  // Compress without the lock; concurrent misses of the same key each
+  // compress and the first to finish is cached.
+  const string compressed = CertCompressor::CompressChain(
+      certs, client_common_set_hashes, client_cached_cert_hashes,
+      common_sets);
+  base::AutoLock locked(lock_);
+  compressed_.Insert(key, compressed);
+  return compressed;
+}
+
+bool QuicCompressedCertsCache::DecompressChain(
+    StringPiece in,
+    const vector<string>& cached_certs,
+    const CommonCertSets* common_sets,
+    vector<string>* out_certs) {
+  const string key = in.as_string();
+  {
+    base::AutoLock locked(lock_);
+    const vector<string>* certs = decompressed_.Lookup(key);
+    if (certs != nullptr) {
+      ++num_hits_;
+      *out_certs = *certs;
+      return true;
+    }
+    ++num_misses_;
+  }
+
+  if (!CertCompressor::DecompressChain(in, cached_certs, common_sets,
+                                       out_certs)) {
+    return false;
+  }
+  base::AutoLock locked(lock_);
+  decompressed_.Insert(key, *out_certs);
+  return true;
+}
+
+uint64 QuicCompressedCertsCache::num_hits() const {
+  base::AutoLock locked(lock_);
+  return num_hits_;
+}
+
+uint64 QuicCompressedCertsCache::num_misses() const {
+  base::AutoLock locked(lock_);
+  return num_misses_;
+}
+
+}  // namespace net
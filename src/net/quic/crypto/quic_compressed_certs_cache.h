@@ -0,0 +1,108 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_QUIC_CRYPTO_QUIC_COMPRESSED_CERTS_CACHE_H_
+#define NET_QUIC_CRYPTO_QUIC_COMPRESSED_CERTS_CACHE_H_
+
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/containers/hash_tables.h"
+#include "base/strings/string_piece.h"
+#include "base/synchronization/lock.h"
+#include "net/base/net_export.h"
+
+namespace net {
+
+class CommonCertSets;
+
+// QuicCompressedCertsCache remembers the results of CertCompressor, so that
+// a server under a flood of client hellos deflates its certificate chain
+// once per distinct set of client hashes instead of once per rejection, and
+// a client decompresses a chain it has already seen without inflating it.
+// Each direction keeps at most |max_entries| results and evicts the least
+// recently used one.  All methods may be called concurrently.
+class NET_EXPORT_PRIVATE QuicCompressedCertsCache {
+ public:
+  explicit QuicCompressedCertsCache(size_t max_entries);
+  ~QuicCompressedCertsCache();
+
+  // As CertCompressor::CompressChain.  |common_sets| must be the same for all
+  // calls.  |certs| is identified by its address, which is cheaper than
+  // hashing it on every hello, so it must be a chain which a ProofSource
+  // keeps for as long as the cache exists.
+  std::string CompressChain(const std::vector<std::string>& certs,
+                            base::StringPiece client_common_set_hashes,
+                            base::StringPiece client_cached_cert_hashes,
+                            const CommonCertSets* common_sets);
+
+  // As CertCompressor::DecompressChain.  |common_sets| must be the same for
+  // all calls.  A chain found in the cache is returned without checking
+  // |cached_certs|, as the certificates it refers to are identified by hash.
+  bool DecompressChain(base::StringPiece in,
+                       const std::vector<std::string>& cached_certs,
+                       const CommonCertSets* common_sets,
+                       std::vector<std::string>* out_certs);
+
+  uint64 num_hits() const;
+  uint64 num_misses() const;
+
+ private:
+  // A map from string keys to |Value|s which evicts the least recently used
+  // entry once it holds |max_entries| of them.
+  template <typename Value>
+  class LruCache {
+   public:
+    explicit LruCache(size_t max_entries) : max_entries_(max_entries) {}
+
+    // Returns the value of |key| and marks it most recently used, or returns
+    // null.  The value is valid until the next Insert().
+    const Value* Lookup(const std::string& key) {
+      typename Map::iterator it = map_.find(key);
+      if (it == map_.end()) {
+        return nullptr;
+      }
+      list_.splice(list_.begin(), list_, it->second);
+      return &it->second->second;
+    }
+
+    void Insert(const std::string& key, const Value& value) {
+      if (max_entries_ == 0 || map_.find(key) != map_.end()) {
+        return;
+      }
+      list_.push_front(std::make_pair(key, value));
+      map_[key] = list_.begin();
+      if (list_.size() > max_entries_) {
+        map_.erase(list_.back().first);
+        list_.pop_back();
+      }
+    }
+
+   private:
+    // Most recently used first.
+    typedef std::list<std::pair<std::string, Value>> List;
+    typedef base::hash_map<std::string, typename List::iterator> Map;
+
+    const size_t max_entries_;
+    List list_;
+    Map map_;
+
+    DISALLOW_COPY_AND_ASSIGN(LruCache);
+  };
+
+  mutable base::Lock lock_;
+  LruCache<std::string> compressed_;
+  LruCache<std::vector<std::string>> decompressed_;
+  uint64 num_hits_;
+  uint64 num_misses_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicCompressedCertsCache);
+};
+
+}  // namespace net
+
+#endif  // NET_QUIC_CRYPTO_QUIC_COMPRESSED_CERTS_CACHE_H_
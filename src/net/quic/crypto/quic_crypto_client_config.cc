@@ -8,7 +8,6 @@
 #include "base/metrics/sparse_histogram.h"
 #include "base/stl_util.h"
 #include "base/strings/string_util.h"
-#include "net/quic/crypto/cert_compressor.h"
 #include "net/quic/crypto/chacha20_poly1305_encrypter.h"
 #include "net/quic/crypto/channel_id.h"
 #include "net/quic/crypto/common_cert_set.h"
@@ -19,6 +18,7 @@
 #include "net/quic/crypto/p256_key_exchange.h"
 #include "net/quic/crypto/proof_verifier.h"
 #include "net/quic/crypto/quic_encrypter.h"
+#include "net/quic/quic_clock.h"
 #include "net/quic/quic_utils.h"
 
 using base::StringPiece;
@@ -48,10 +48,14 @@ void RecordDiskCacheServerConfigState(
       QuicCryptoClientConfig::CachedState::SERVER_CONFIG_COUNT);
 }
 
+// The number of decompressed certificate chains kept.
+const size_t kMaxCompressedCertsCacheEntries = 16;
+
 }  // namespace
 
 QuicCryptoClientConfig::QuicCryptoClientConfig()
-    : disable_ecdsa_(false) {
+    : compressed_certs_cache_(kMaxCompressedCertsCacheEntries),
+      disable_ecdsa_(false) {
   SetDefaults();
 }
 
@@ -370,6 +374,9 @@ QuicCryptoClientConfig::CachedState* QuicCryptoClientConfig::LookupOrCreate(
 
   CachedState* cached = new CachedState;
   cached_states_.insert(std::make_pair(server_id, cached));
+  if (PopulateFromCachedStateStore(server_id, cached)) {
+    return cached;
+  }
   bool cache_populated = PopulateFromCanonicalConfig(server_id, cached);
   UMA_HISTOGRAM_BOOLEAN(
       "Net.QuicCryptoClientConfig.PopulatedFromCanonicalConfig",
@@ -377,6 +384,19 @@ QuicCryptoClientConfig::CachedState* QuicCryptoClientConfig::LookupOrCreate(
   return cached;
 }
 
+void QuicCryptoClientConfig::PersistCachedState(const QuicServerId& server_id,
+                                                const CachedState& cached) {
+  if (cached_state_store_.get() == nullptr || cached.IsEmpty()) {
+    return;
+  }
+  CachedStateStore::State state;
+  state.server_config = cached.server_config();
+  state.source_address_token = cached.source_address_token();
+  state.certs = cached.certs();
+  state.server_config_sig = cached.signature();
+  cached_state_store_->Save(server_id, state);
+}
+
 void QuicCryptoClientConfig::ClearCachedStates() {
   for (CachedStateMap::const_iterator it = cached_states_.begin();
        it != cached_states_.end(); ++it) {
@@ -662,8 +682,8 @@ QuicErrorCode QuicCryptoClientConfig::CacheNewServerConfig(
   bool has_cert = message.GetStringPiece(kCertificateTag, &cert_bytes);
   if (has_proof && has_cert) {
     vector<string> certs;
-    if (!CertCompressor::DecompressChain(cert_bytes, cached_certs,
-                                         common_cert_sets, &certs)) {
+    if (!compressed_certs_cache_.DecompressChain(
+            cert_bytes, cached_certs, common_cert_sets, &certs)) {
       *error_details = "Certificate data invalid";
       return QUIC_INVALID_CRYPTO_MESSAGE_PARAMETER;
     }
@@ -865,6 +885,14 @@ void QuicCryptoClientConfig::SetChannelIDSource(ChannelIDSource* source) {
   channel_id_source_.reset(source);
 }
 
+CachedStateStore* QuicCryptoClientConfig::cached_state_store() const {
+  return cached_state_store_.get();
+}
+
+void QuicCryptoClientConfig::SetCachedStateStore(CachedStateStore* store) {
+  cached_state_store_.reset(store);
+}
+
 void QuicCryptoClientConfig::InitializeFrom(
     const QuicServerId& server_id,
     const QuicServerId& canonical_server_id,
@@ -937,4 +965,29 @@ bool QuicCryptoClientConfig::PopulateFromCanonicalConfig(
   return true;
 }
 
+bool QuicCryptoClientConfig::PopulateFromCachedStateStore(
+    const QuicServerId& server_id,
+    CachedState* cached) {
+  DCHECK(cached->IsEmpty());
+  CachedStateStore::State state;
+  if (cached_state_store_.get() == nullptr ||
+      !cached_state_store_->Load(server_id, &state)) {
+    return false;
+  }
+  QuicClock clock;
+  if (!cached->Initialize(state.server_config, state.source_address_token,
+                          state.certs, state.server_config_sig,
+                          clock.WallNow())) {
+    cached->Clear();
+    return false;
+  }
+  // The proof of an https server is verified again before the state is used.
+  // Nothing is verified for other servers, so the state is as good as when
+  // it was saved.
+  if (!server_id.is_https()) {
+    cached->SetProofValid();
+  }
+  return true;
+}
+
 }  // namespace net
@@ -13,7 +13,9 @@
 #include "base/memory/scoped_ptr.h"
 #include "base/strings/string_piece.h"
 #include "net/base/net_export.h"
+#include "net/quic/crypto/cached_state_store.h"
 #include "net/quic/crypto/crypto_handshake.h"
+#include "net/quic/crypto/quic_compressed_certs_cache.h"
 #include "net/quic/quic_protocol.h"
 #include "net/quic/quic_server_id.h"
 
@@ -185,9 +187,15 @@ class NET_EXPORT_PRIVATE QuicCryptoClientConfig : public QuicCryptoConfig {
   ~QuicCryptoClientConfig();
 
   // LookupOrCreate returns a CachedState for the given |server_id|. If no such
-  // CachedState currently exists, it will be created and cached.
+  // CachedState currently exists, it will be created and cached, and
+  // initialized from the CachedStateStore if there is one.
   CachedState* LookupOrCreate(const QuicServerId& server_id);
 
+  // Saves |cached| for |server_id| in the CachedStateStore, if there is one.
+  // Called when the server config or source address token changes.
+  void PersistCachedState(const QuicServerId& server_id,
+                          const CachedState& cached);
+
   // Delete all CachedState objects from cached_states_.
   void ClearCachedStates();
 
@@ -286,6 +294,13 @@ class NET_EXPORT_PRIVATE QuicCryptoClientConfig : public QuicCryptoConfig {
   // |source|.
   void SetChannelIDSource(ChannelIDSource* source);
 
+  CachedStateStore* cached_state_store() const;
+
+  // SetCachedStateStore sets the CachedStateStore that cached states are
+  // loaded from and saved to, so that they survive the process. This object
+  // takes ownership of |store|.
+  void SetCachedStateStore(CachedStateStore* store);
+
   // Initialize the CachedState from |canonical_crypto_config| for the
   // |canonical_server_id| as the initial CachedState for |server_id|. We will
   // copy config data only if |canonical_crypto_config| has valid proof.
@@ -338,6 +353,11 @@ class NET_EXPORT_PRIVATE QuicCryptoClientConfig : public QuicCryptoConfig {
   bool PopulateFromCanonicalConfig(const QuicServerId& server_id,
                                    CachedState* cached);
 
+  // Initializes |cached| from the state |cached_state_store_| holds for
+  // |server_id|.  Returns true if it held a usable state.
+  bool PopulateFromCachedStateStore(const QuicServerId& server_id,
+                                    CachedState* cached);
+
   // cached_states_ maps from the server_id to the cached information about
   // that server.
   CachedStateMap cached_states_;
@@ -354,6 +374,11 @@ class NET_EXPORT_PRIVATE QuicCryptoClientConfig : public QuicCryptoConfig {
 
   scoped_ptr<ProofVerifier> proof_verifier_;
   scoped_ptr<ChannelIDSource> channel_id_source_;
+  scoped_ptr<CachedStateStore> cached_state_store_;
+
+  // Certificate chains recently decompressed from server messages, which
+  // connections to the same server repeat.
+  QuicCompressedCertsCache compressed_certs_cache_;
 
   // True if ECDSA should be disabled.
   bool disable_ecdsa_;
@@ -14,7 +14,6 @@
 #include "net/base/net_util.h"
 #include "net/quic/crypto/aes_128_gcm_12_decrypter.h"
 #include "net/quic/crypto/aes_128_gcm_12_encrypter.h"
-#include "net/quic/crypto/cert_compressor.h"
 #include "net/quic/crypto/chacha20_poly1305_encrypter.h"
 #include "net/quic/crypto/channel_id.h"
 #include "net/quic/crypto/crypto_framer.h"
@@ -52,6 +51,11 @@ namespace {
 
 const int kMaxTokenAddresses = 4;
 
+// The number of compressed certificate chains kept.  A chain is compressed
+// anew for each combination of common sets and cached certificates clients
+// claim, of which there are only a handful in practice.
+const size_t kMaxCompressedCertsCacheEntries = 64;
+
 string DeriveSourceAddressTokenKey(StringPiece source_address_token_secret) {
   crypto::HKDF hkdf(source_address_token_secret,
                     StringPiece() /* no salt */,
@@ -203,8 +207,8 @@ ValidateClientHelloResultCallback::~ValidateClientHelloResultCallback() {
 }
 
 void ValidateClientHelloResultCallback::Run(const Result* result) {
+  scoped_refptr<const Result> result_ref(result);
   RunImpl(result->client_hello, *result);
-  delete result;
   delete this;
 }
 
@@ -221,6 +225,7 @@ QuicCryptoServerConfig::QuicCryptoServerConfig(
       primary_config_(nullptr),
       next_config_promotion_time_(QuicWallTime::Zero()),
       server_nonce_strike_register_lock_(),
+      compressed_certs_cache_(kMaxCompressedCertsCacheEntries),
       strike_register_no_startup_period_(false),
       strike_register_max_entries_(1 << 10),
       strike_register_window_secs_(600),
@@ -1037,6 +1042,7 @@ void QuicCryptoServerConfig::EvaluateClientHello(
 
     if (strike_register_client_.get() == nullptr) {
       strike_register_client_.reset(new LocalStrikeRegisterClient(
+          /*num_shards=*/1,
           strike_register_max_entries_,
           static_cast<uint32>(info->now.ToUNIXSeconds()),
           strike_register_window_secs_,
@@ -1087,7 +1093,7 @@ bool QuicCryptoServerConfig::BuildServerConfigUpdateMessage(
     return false;
   }
 
-  const string compressed = CertCompressor::CompressChain(
+  const string compressed = compressed_certs_cache_.CompressChain(
       *certs, params.client_common_set_hashes, params.client_cached_cert_hashes,
       primary_config_->common_cert_sets);
 
@@ -1175,7 +1181,7 @@ void QuicCryptoServerConfig::BuildRejection(
     params->client_cached_cert_hashes = client_cached_cert_hashes.as_string();
   }
 
-  const string compressed = CertCompressor::CompressChain(
+  const string compressed = compressed_certs_cache_.CompressChain(
       *certs, params->client_common_set_hashes,
       params->client_cached_cert_hashes, config.common_cert_sets);
 
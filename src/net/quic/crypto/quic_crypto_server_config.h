@@ -20,6 +20,7 @@
 #include "net/quic/crypto/crypto_handshake_message.h"
 #include "net/quic/crypto/crypto_protocol.h"
 #include "net/quic/crypto/crypto_secret_boxer.h"
+#include "net/quic/crypto/quic_compressed_certs_cache.h"
 #include "net/quic/proto/cached_network_parameters.pb.h"
 #include "net/quic/proto/source_address_token.pb.h"
 #include "net/quic/quic_time.h"
@@ -83,11 +84,12 @@ class NET_EXPORT_PRIVATE ValidateClientHelloResultCallback {
  public:
   // Opaque token that holds information about the client_hello and
   // its validity.  Can be interpreted by calling ProcessClientHello.
-  struct Result {
+  // Reference counted so that RunImpl() can keep it for processing the
+  // client hello later, possibly on another thread.
+  struct Result : public base::RefCountedThreadSafe<Result> {
     Result(const CryptoHandshakeMessage& in_client_hello,
            IPAddressNumber in_client_ip,
            QuicWallTime in_now);
-    ~Result();
 
     CryptoHandshakeMessage client_hello;
     ClientHelloInfo info;
@@ -96,6 +98,11 @@ class NET_EXPORT_PRIVATE ValidateClientHelloResultCallback {
 
     // Populated if the CHLO STK contained a CachedNetworkParameters proto.
     CachedNetworkParameters cached_network_params;
+
+   private:
+    friend class base::RefCountedThreadSafe<Result>;
+
+    ~Result();
   };
 
   ValidateClientHelloResultCallback();
@@ -345,9 +352,10 @@ class NET_EXPORT_PRIVATE QuicCryptoServerConfig {
   friend class test::QuicCryptoServerConfigPeer;
 
   // Config represents a server config: a collection of preferences and
-  // Diffie-Hellman public values.
+  // Diffie-Hellman public values.  Thread-safe reference counted, as client
+  // hellos may be processed on crypto worker threads.
   class NET_EXPORT_PRIVATE Config : public QuicCryptoConfig,
-                                    public base::RefCounted<Config> {
+                                    public base::RefCountedThreadSafe<Config> {
    public:
     Config();
 
@@ -400,7 +408,7 @@ class NET_EXPORT_PRIVATE QuicCryptoServerConfig {
     scoped_ptr<CryptoSecretBoxer> source_address_token_boxer_storage;
 
    private:
-    friend class base::RefCounted<Config>;
+    friend class base::RefCountedThreadSafe<Config>;
 
     virtual ~Config();
 
@@ -557,6 +565,10 @@ class NET_EXPORT_PRIVATE QuicCryptoServerConfig {
   // signatures.
   scoped_ptr<ProofSource> proof_source_;
 
+  // compressed_certs_cache_ holds the certificate chains recently compressed
+  // for rejections and server config updates.  It locks internally.
+  mutable QuicCompressedCertsCache compressed_certs_cache_;
+
   // ephemeral_key_source_ contains an object that caches ephemeral keys for a
   // short period of time.
   scoped_ptr<EphemeralKeySource> ephemeral_key_source_;
@@ -0,0 +1,163 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/crypto/sharded_strike_register.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/synchronization/lock.h"
+#include "net/quic/crypto/quic_random.h"
+
+namespace net {
+
+namespace {
+
+// Offsets of the fields of a nonce.
+const size_t kNonceTimeOffset = 0;
+const size_t kNonceOrbitOffset = 4;
+const size_t kNonceRandomOffset = 12;
+
+const size_t kNonceRandomLength = 20;
+
+uint32 TimeFromBytes(const uint8 d[4]) {
+  return static_cast<uint32>(d[0]) << 24 | static_cast<uint32>(d[1]) << 16 |
+         static_cast<uint32>(d[2]) << 8 | static_cast<uint32>(d[3]);
+}
+
+uint64 RotateLeft(uint64 x, int bits) {
+  return (x << bits) | (x >> (64 - bits));
+}
+
+void SipRound(uint64* v0, uint64* v1, uint64* v2, uint64* v3) {
+  *v0 += *v1;
+  *v1 = RotateLeft(*v1, 13);
+  *v1 ^= *v0;
+  *v0 = RotateLeft(*v0, 32);
+  *v2 += *v3;
+  *v3 = RotateLeft(*v3, 16);
+  *v3 ^= *v2;
+  *v0 += *v3;
+  *v3 = RotateLeft(*v3, 21);
+  *v3 ^= *v0;
+  *v2 += *v1;
+  *v1 = RotateLeft(*v1, 17);
+  *v1 ^= *v2;
+  *v2 = RotateLeft(*v2, 32);
+}
+
+// Returns the SipHash-2-4 of |length| bytes at |data| under |key|.
+uint64 SipHash24(const uint64 key[2], const uint8* data, size_t length) {
+  uint64 v0 = key[0] ^ UINT64_C(0x736f6d6570736575);
+  uint64 v1 = key[1] ^ UINT64_C(0x646f72616e646f6d);
+  uint64 v2 = key[0] ^ UINT64_C(0x6c7967656e657261);
+  uint64 v3 = key[1] ^ UINT64_C(0x7465646279746573);
+
+  const size_t whole_words = length / 8;
+  for (size_t i = 0; i < whole_words; ++i) {
+    uint64 m = 0;
+    for (int j = 7; j >= 0; --j) {
+      m = m << 8 | data[i * 8 + j];
+    }
+    v3 ^= m;
+    SipRound(&v0, &v1, &v2, &v3);
+    SipRound(&v0, &v1, &v2, &v3);
+    v0 ^= m;
+  }
+
+  uint64 last = static_cast<uint64>(length) << 56;
+  for (size_t j = length % 8; j > 0; --j) {
+    last |= static_cast<uint64>(data[whole_words * 8 + j - 1]) << (8 * (j - 1));
+  }
+  v3 ^= last;
+  SipRound(&v0, &v1, &v2, &v3);
+  SipRound(&v0, &v1, &v2, &v3);
+  v0 ^= last;
+
+  v2 ^= 0xff;
+  for (int i = 0; i < 4; ++i) {
+    SipRound(&v0, &v1, &v2, &v3);
+  }
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+
+}  // namespace
+
+struct ShardedStrikeRegister::Shard {
+  Shard(unsigned max_entries,
+        uint32 current_time_external,
+        uint32 window_secs,
+        const uint8 orbit[8],
+        StrikeRegister::StartupType startup)
+      : strike_register(max_entries, current_time_external, window_secs,
+                        orbit, startup) {}
+
+  base::Lock lock;
+  StrikeRegister strike_register;
+};
+
+ShardedStrikeRegister::ShardedStrikeRegister(
+    unsigned num_shards,
+    unsigned max_entries,
+    uint32 current_time_external,
+    uint32 window_secs,
+    const uint8 orbit[8],
+    StrikeRegister::StartupType startup)
+    : window_secs_(window_secs) {
+  DCHECK_LT(0u, num_shards);
+  memcpy(orbit_, orbit, sizeof(orbit_));
+  QuicRandom::GetInstance()->RandBytes(shard_key_, sizeof(shard_key_));
+  // A StrikeRegister needs at least two entries.
+  const unsigned max_entries_per_shard =
+      std::max(2u, (max_entries + num_shards - 1) / num_shards);
+  for (unsigned i = 0; i < num_shards; ++i) {
+    shards_.push_back(new Shard(max_entries_per_shard, current_time_external,
+                                window_secs, orbit, startup));
+  }
+}
+
+ShardedStrikeRegister::~ShardedStrikeRegister() {
+}
+
+InsertStatus ShardedStrikeRegister::Insert(const uint8 nonce[32],
+                                           uint32 current_time) {
+  // Reject what every shard would reject without taking a lock.  A shard's
+  // valid range never extends beyond |window_secs_| either side of now.
+  if (memcmp(nonce + kNonceOrbitOffset, orbit_, sizeof(orbit_)) != 0) {
+    return NONCE_INVALID_ORBIT_FAILURE;
+  }
+  const uint64 nonce_time = TimeFromBytes(nonce + kNonceTimeOffset);
+  if (nonce_time + window_secs_ < current_time ||
+      nonce_time > static_cast<uint64>(current_time) + window_secs_) {
+    return NONCE_INVALID_TIME_FAILURE;
+  }
+
+  // The random bytes are chosen by the client.  Every shard holds the nonces
+  // of all clients in 1/N of the entries, so a client able to steer its
+  // nonces into one shard could evict other clients' nonces and advance that
+  // shard's horizon at 1/N of the cost.  The shard is therefore chosen by a
+  // hash keyed with a random secret of this register.
+  Shard* shard = shards_.size() == 1
+                     ? shards_[0]
+                     : shards_[SipHash24(shard_key_, nonce + kNonceRandomOffset,
+                                         kNonceRandomLength) %
+                               shards_.size()];
+  base::AutoLock locked(shard->lock);
+  return shard->strike_register.Insert(nonce, current_time);
+}
+
+uint32 ShardedStrikeRegister::GetCurrentValidWindowSecs(
+    uint32 current_time_external) const {
+  uint32 window = window_secs_ + 1;
+  for (Shard* shard : shards_) {
+    base::AutoLock locked(shard->lock);
+    window = std::min(window, shard->strike_register.GetCurrentValidWindowSecs(
+                                  current_time_external));
+  }
+  return window;
+}
+
+}  // namespace net
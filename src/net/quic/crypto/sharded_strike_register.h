@@ -0,0 +1,65 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_QUIC_CRYPTO_SHARDED_STRIKE_REGISTER_H_
+#define NET_QUIC_CRYPTO_SHARDED_STRIKE_REGISTER_H_
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_vector.h"
+#include "net/base/net_export.h"
+#include "net/quic/crypto/strike_register.h"
+
+namespace net {
+
+// A ShardedStrikeRegister is a set of StrikeRegisters which may be used from
+// many threads at once.  Nonces are partitioned between the shards by a
+// secretly keyed hash of their random bytes, so a nonce always meets the
+// shard that saw any earlier copy of it and each shard's window and horizon
+// keep their replay guarantees, while clients can not choose their shard.
+// Each shard has its own lock, so concurrent inserts only contend when they
+// land in the same shard.  Nonces with the wrong orbit or a timestamp outside
+// the window are rejected before any lock is taken.
+//
+// |max_entries| is divided between the shards, so memory use is that of a
+// single StrikeRegister of the same size.  As each shard evicts on its own,
+// a shard may advance its horizon, and so start rejecting nonces, somewhat
+// before a single register of the same total size would.
+class NET_EXPORT_PRIVATE ShardedStrikeRegister {
+ public:
+  // The arguments other than |num_shards| are as for StrikeRegister.
+  ShardedStrikeRegister(unsigned num_shards,
+                        unsigned max_entries,
+                        uint32 current_time_external,
+                        uint32 window_secs,
+                        const uint8 orbit[8],
+                        StrikeRegister::StartupType startup);
+  ~ShardedStrikeRegister();
+
+  // As StrikeRegister::Insert.  May be called concurrently.
+  InsertStatus Insert(const uint8 nonce[32], uint32 current_time);
+
+  // Returns a pointer to the 8-byte orbit value.  Never changes, so needs no
+  // locking.
+  const uint8* orbit() const { return orbit_; }
+
+  // The time window for which every shard has complete information.
+  uint32 GetCurrentValidWindowSecs(uint32 current_time_external) const;
+
+  size_t num_shards() const { return shards_.size(); }
+
+ private:
+  struct Shard;
+
+  const uint32 window_secs_;
+  uint8 orbit_[8];
+  // Random key of the hash which picks the shard of a nonce.
+  uint64 shard_key_[2];
+  ScopedVector<Shard> shards_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShardedStrikeRegister);
+};
+
+}  // namespace net
+
+#endif  // NET_QUIC_CRYPTO_SHARDED_STRIKE_REGISTER_H_
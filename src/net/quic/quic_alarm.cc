@@ -10,7 +10,9 @@ namespace net {
 
 QuicAlarm::QuicAlarm(Delegate* delegate)
     : delegate_(delegate),
-      deadline_(QuicTime::Zero()) {
+      deadline_(QuicTime::Zero()),
+      scheduled_deadline_(QuicTime::Zero()),
+      in_batch_mode_(false) {
 }
 
 QuicAlarm::~QuicAlarm() {}
@@ -19,12 +21,20 @@ void QuicAlarm::Set(QuicTime deadline) {
   DCHECK(!IsSet());
   DCHECK(deadline.IsInitialized());
   deadline_ = deadline;
+  if (in_batch_mode_) {
+    return;
+  }
   SetImpl();
+  scheduled_deadline_ = deadline_;
 }
 
 void QuicAlarm::Cancel() {
   deadline_ = QuicTime::Zero();
+  if (in_batch_mode_) {
+    return;
+  }
   CancelImpl();
+  scheduled_deadline_ = QuicTime::Zero();
 }
 
 void QuicAlarm::Update(QuicTime deadline, QuicTime::Delta granularity) {
@@ -40,11 +50,39 @@ void QuicAlarm::Update(QuicTime deadline, QuicTime::Delta granularity) {
   Set(deadline);
 }
 
+void QuicAlarm::StartBatchOperations() {
+  DCHECK(!in_batch_mode_);
+  in_batch_mode_ = true;
+}
+
+void QuicAlarm::FinishBatchOperations() {
+  DCHECK(in_batch_mode_);
+  in_batch_mode_ = false;
+  if (deadline_ == scheduled_deadline_) {
+    return;
+  }
+  // SetImpl() and CancelImpl() expect the deadline to be set and cleared
+  // first, as they would be outside of batch mode.
+  const QuicTime deadline = deadline_;
+  if (scheduled_deadline_.IsInitialized()) {
+    deadline_ = QuicTime::Zero();
+    CancelImpl();
+    scheduled_deadline_ = QuicTime::Zero();
+  }
+  deadline_ = deadline;
+  if (deadline_.IsInitialized()) {
+    SetImpl();
+    scheduled_deadline_ = deadline_;
+  }
+}
+
 bool QuicAlarm::IsSet() const {
   return deadline_.IsInitialized();
 }
 
 void QuicAlarm::Fire() {
+  // The underlying scheduling system no longer holds the alarm.
+  scheduled_deadline_ = QuicTime::Zero();
   if (!deadline_.IsInitialized()) {
     return;
   }
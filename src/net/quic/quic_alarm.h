@@ -47,14 +47,23 @@ class NET_EXPORT_PRIVATE QuicAlarm {
   // not initialized, the alarm is cancelled.
   void Update(QuicTime deadline, QuicTime::Delta granularity);
 
+  // While in batch mode, Set(), Cancel() and Update() only change the
+  // deadline, and FinishBatchOperations() then reschedules the alarm once,
+  // for its final deadline, if that differs from the scheduled one.  An alarm
+  // moved many times in a burst of packets thus costs the underlying
+  // scheduling system at most one cancelation and one registration.
+  void StartBatchOperations();
+  void FinishBatchOperations();
+  bool InBatchMode() const { return in_batch_mode_; }
+
   bool IsSet() const;
 
   QuicTime deadline() const { return deadline_; }
 
  protected:
   // Subclasses implement this method to perform the platform-specific
-  // scheduling of the alarm.  Is called from Set() or Fire(), after the
-  // deadline has been updated.
+  // scheduling of the alarm.  Is called from Set(), Fire() or
+  // FinishBatchOperations(), after the deadline has been updated.
   virtual void SetImpl() = 0;
 
   // Subclasses implement this method to perform the platform-specific
@@ -73,6 +82,11 @@ class NET_EXPORT_PRIVATE QuicAlarm {
  private:
   scoped_ptr<Delegate> delegate_;
   QuicTime deadline_;
+  // The deadline the underlying scheduling system holds the alarm for, or
+  // zero if it does not hold it.  Differs from |deadline_| only in batch
+  // mode.
+  QuicTime scheduled_deadline_;
+  bool in_batch_mode_;
 
   DISALLOW_COPY_AND_ASSIGN(QuicAlarm);
 };
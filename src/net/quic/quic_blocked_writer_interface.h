@@ -9,6 +9,7 @@
 #ifndef NET_QUIC_QUIC_BLOCKED_WRITER_INTERFACE_H_
 #define NET_QUIC_QUIC_BLOCKED_WRITER_INTERFACE_H_
 
+#include "base/containers/hash_tables.h"
 #include "net/base/net_export.h"
 
 namespace net {
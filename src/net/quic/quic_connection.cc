@@ -281,8 +281,11 @@ QuicConnection::QuicConnection(QuicConnectionId connection_id,
       ack_queued_(false),
       num_packets_received_since_last_ack_sent_(0),
       stop_waiting_count_(0),
-      delay_setting_retransmission_alarm_(false),
+      batching_alarms_(false),
       pending_retransmission_alarm_(false),
+      pending_ping_alarm_(false),
+      delay_flushing_writer_(false),
+      pending_writer_flush_(false),
       ack_alarm_(helper->CreateAlarm(new AckAlarm(this))),
       retransmission_alarm_(helper->CreateAlarm(new RetransmissionAlarm(this))),
       send_alarm_(helper->CreateAlarm(new SendAlarm(this))),
@@ -302,6 +305,7 @@ QuicConnection::QuicConnection(QuicConnectionId connection_id,
       sent_packet_manager_(
           perspective,
           clock_,
+          random_generator_,
           &stats_,
           FLAGS_quic_use_bbr_congestion_control ? kBBR : kCubic,
           FLAGS_quic_use_time_loss_detection ? kTime : kNack,
@@ -329,6 +333,9 @@ QuicConnection::QuicConnection(QuicConnectionId connection_id,
   if (perspective_ == Perspective::IS_SERVER) {
     set_max_packet_length(kDefaultServerMaxPacketSize);
   }
+  if (FLAGS_quic_connection_trace_events > 0) {
+    EnableTrace(static_cast<size_t>(FLAGS_quic_connection_trace_events));
+  }
 }
 
 QuicConnection::~QuicConnection() {
@@ -732,8 +739,8 @@ bool QuicConnection::OnAckFrame(const QuicAckFrame& incoming_ack) {
     if (incoming_ack.is_truncated) {
       should_last_packet_instigate_acks_ = true;
     }
-    if (!incoming_ack.missing_packets.empty() &&
-        GetLeastUnacked() > *incoming_ack.missing_packets.begin()) {
+    if (!incoming_ack.missing_packets.Empty() &&
+        GetLeastUnacked() > incoming_ack.missing_packets.Min()) {
       ++stop_waiting_count_;
     } else {
       stop_waiting_count_ = 0;
@@ -817,20 +824,20 @@ bool QuicConnection::ValidateAckFrame(const QuicAckFrame& incoming_ack) {
     return false;
   }
 
-  if (!incoming_ack.missing_packets.empty() &&
-      *incoming_ack.missing_packets.rbegin() > incoming_ack.largest_observed) {
+  if (!incoming_ack.missing_packets.Empty() &&
+      incoming_ack.missing_packets.Max() > incoming_ack.largest_observed) {
     DLOG(ERROR) << ENDPOINT << "Peer sent missing packet: "
-                << *incoming_ack.missing_packets.rbegin()
+                << incoming_ack.missing_packets.Max()
                 << " which is greater than largest observed: "
                 << incoming_ack.largest_observed;
     return false;
   }
 
-  if (!incoming_ack.missing_packets.empty() &&
-      *incoming_ack.missing_packets.begin() <
+  if (!incoming_ack.missing_packets.Empty() &&
+      incoming_ack.missing_packets.Min() <
           sent_packet_manager_.least_packet_awaited_by_peer()) {
     DLOG(ERROR) << ENDPOINT << "Peer sent missing packet: "
-                << *incoming_ack.missing_packets.begin()
+                << incoming_ack.missing_packets.Min()
                 << " which is smaller than least_packet_awaited_by_peer_: "
                 << sent_packet_manager_.least_packet_awaited_by_peer();
     return false;
@@ -845,7 +852,7 @@ bool QuicConnection::ValidateAckFrame(const QuicAckFrame& incoming_ack) {
   }
 
   for (QuicPacketSequenceNumber revived_packet : incoming_ack.revived_packets) {
-    if (!ContainsKey(incoming_ack.missing_packets, revived_packet)) {
+    if (!incoming_ack.missing_packets.Contains(revived_packet)) {
       DLOG(ERROR) << ENDPOINT
                   << "Peer specified revived packet which was not missing.";
       return false;
@@ -1176,8 +1183,8 @@ void QuicConnection::UpdateStopWaitingCount() {
 
   // If the peer is still waiting for a packet that we are no longer planning to
   // send, send an ack to raise the high water mark.
-  if (!last_ack_frames_.back().missing_packets.empty() &&
-      GetLeastUnacked() > *last_ack_frames_.back().missing_packets.begin()) {
+  if (!last_ack_frames_.back().missing_packets.Empty() &&
+      GetLeastUnacked() > last_ack_frames_.back().missing_packets.Min()) {
     ++stop_waiting_count_;
   } else {
     stop_waiting_count_ = 0;
@@ -1229,6 +1236,8 @@ void QuicConnection::SendVersionNegotiationPacket() {
   }
 
   pending_version_negotiation_packet_ = false;
+  pending_writer_flush_ = true;
+  MaybeFlushWriter();
 }
 
 QuicConsumedData QuicConnection::SendStreamData(
@@ -1256,7 +1265,7 @@ QuicConsumedData QuicConnection::SendStreamData(
   // right thing: check ack_queued_, and then check undecryptable packets and
   // also if there is possibility of revival. Only bundle an ack if there's no
   // processing left that may cause received_info_ to change.
-  ScopedRetransmissionScheduler alarm_delayer(this);
+  ScopedAlarmBatcher alarm_batcher(this);
   ScopedPacketBundler ack_bundler(this, BUNDLE_PENDING_ACK);
   return packet_generator_.ConsumeData(id, iov, offset, fin, fec_protection,
                                        delegate);
@@ -1353,7 +1362,7 @@ void QuicConnection::ProcessUdpPacket(const IPEndPoint& self_address,
   stats_.bytes_received += packet.length();
   ++stats_.packets_received;
 
-  ScopedRetransmissionScheduler alarm_delayer(this);
+  ScopedAlarmBatcher alarm_batcher(this);
   if (!framer_.ProcessPacket(packet)) {
     // If we are unable to decrypt this packet, it might be
     // because the CHLO or SHLO packet was lost.
@@ -1409,6 +1418,10 @@ void QuicConnection::CheckForAddressMigration(
 void QuicConnection::OnCanWrite() {
   DCHECK(!writer_->IsWriteBlocked());
 
+  // Queued packets, retransmissions and new data all go out in one flush,
+  // and the alarms they move are rescheduled once.
+  ScopedAlarmBatcher alarm_batcher(this);
+  ScopedWriterFlusher flusher(this);
   WriteQueuedPackets();
   WritePendingRetransmissions();
 
@@ -1720,9 +1733,27 @@ bool QuicConnection::WritePacketInner(QueuedPacket* packet) {
     return false;
   }
 
+  pending_writer_flush_ = true;
+  MaybeFlushWriter();
   return true;
 }
 
+void QuicConnection::MaybeFlushWriter() {
+  if (!pending_writer_flush_ || delay_flushing_writer_ ||
+      packet_generator_.InBatchMode()) {
+    return;
+  }
+  pending_writer_flush_ = false;
+  WriteResult result = writer_->Flush();
+  if (result.status == WRITE_STATUS_BLOCKED) {
+    // The writer keeps the unsent packets, so only ask to be told when the
+    // socket is writable again.
+    visitor_->OnWriteBlocked();
+  } else if (result.status == WRITE_STATUS_ERROR && connected_) {
+    OnWriteError(result.error_code);
+  }
+}
+
 bool QuicConnection::ShouldDiscardPacket(const QueuedPacket& packet) {
   if (!connected_) {
     DVLOG(1) << ENDPOINT
@@ -1865,6 +1896,7 @@ void QuicConnection::OnRetransmissionTimeout() {
   if (!sent_packet_manager_.HasUnackedPackets()) {
     return;
   }
+  ScopedAlarmBatcher alarm_batcher(this);
 
   sent_packet_manager_.OnRetransmissionTimeout();
   WriteIfNotBlocked();
@@ -1933,6 +1965,7 @@ const QuicDecrypter* QuicConnection::alternative_decrypter() const {
 void QuicConnection::QueueUndecryptablePacket(
     const QuicEncryptedPacket& packet) {
   DVLOG(1) << ENDPOINT << "Queueing undecryptable packet.";
+  // Packets read into a QuicPacketBuffer are queued without copying.
   undecryptable_packets_.push_back(packet.Clone());
 }
 
@@ -2219,6 +2252,10 @@ void QuicConnection::SetPingAlarm() {
     // Only clients send pings.
     return;
   }
+  if (batching_alarms_) {
+    pending_ping_alarm_ = true;
+    return;
+  }
   if (!visitor_->HasOpenDynamicStreams()) {
     ping_alarm_->Cancel();
     // Don't send a ping unless there are open streams.
@@ -2230,7 +2267,7 @@ void QuicConnection::SetPingAlarm() {
 }
 
 void QuicConnection::SetRetransmissionAlarm() {
-  if (delay_setting_retransmission_alarm_) {
+  if (batching_alarms_) {
     pending_retransmission_alarm_ = true;
     return;
   }
@@ -2302,25 +2339,74 @@ QuicConnection::ScopedPacketBundler::~ScopedPacketBundler() {
   }
   DCHECK_EQ(already_in_batch_mode_,
             connection_->packet_generator_.InBatchMode());
+  connection_->MaybeFlushWriter();
+}
+
+void QuicConnection::SetAlarmsInBatchMode(bool in_batch_mode) {
+  QuicAlarm* const alarms[] = {
+      ack_alarm_.get(),     retransmission_alarm_.get(),
+      send_alarm_.get(),    resume_writes_alarm_.get(),
+      timeout_alarm_.get(), ping_alarm_.get(),
+      mtu_discovery_alarm_.get(), fec_alarm_.get(),
+  };
+  for (QuicAlarm* alarm : alarms) {
+    if (in_batch_mode) {
+      alarm->StartBatchOperations();
+    } else {
+      alarm->FinishBatchOperations();
+    }
+  }
+}
+
+bool QuicConnection::StartAlarmBatch() {
+  if (batching_alarms_) {
+    return false;
+  }
+  batching_alarms_ = true;
+  SetAlarmsInBatchMode(true);
+  return true;
+}
+
+void QuicConnection::FinishAlarmBatch() {
+  DCHECK(batching_alarms_);
+  batching_alarms_ = false;
+  // A connection closed in the batch keeps its alarms cancelled.
+  if (pending_retransmission_alarm_ && connected_) {
+    SetRetransmissionAlarm();
+  }
+  pending_retransmission_alarm_ = false;
+  if (pending_ping_alarm_ && connected_) {
+    SetPingAlarm();
+  }
+  pending_ping_alarm_ = false;
+  SetAlarmsInBatchMode(false);
 }
 
-QuicConnection::ScopedRetransmissionScheduler::ScopedRetransmissionScheduler(
+QuicConnection::ScopedAlarmBatcher::ScopedAlarmBatcher(
     QuicConnection* connection)
     : connection_(connection),
-      already_delayed_(connection_->delay_setting_retransmission_alarm_) {
-  connection_->delay_setting_retransmission_alarm_ = true;
+      started_batch_(connection_->StartAlarmBatch()) {
 }
 
-QuicConnection::ScopedRetransmissionScheduler::
-    ~ScopedRetransmissionScheduler() {
+QuicConnection::ScopedAlarmBatcher::~ScopedAlarmBatcher() {
+  if (started_batch_) {
+    connection_->FinishAlarmBatch();
+  }
+}
+
+QuicConnection::ScopedWriterFlusher::ScopedWriterFlusher(
+    QuicConnection* connection)
+    : connection_(connection),
+      already_delayed_(connection_->delay_flushing_writer_) {
+  connection_->delay_flushing_writer_ = true;
+}
+
+QuicConnection::ScopedWriterFlusher::~ScopedWriterFlusher() {
   if (already_delayed_) {
     return;
   }
-  connection_->delay_setting_retransmission_alarm_ = false;
-  if (connection_->pending_retransmission_alarm_) {
-    connection_->SetRetransmissionAlarm();
-    connection_->pending_retransmission_alarm_ = false;
-  }
+  connection_->delay_flushing_writer_ = false;
+  connection_->MaybeFlushWriter();
 }
 
 HasRetransmittableData QuicConnection::IsRetransmittable(
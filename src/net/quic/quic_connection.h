@@ -551,6 +551,17 @@ class NET_EXPORT_PRIVATE QuicConnection
     return sent_packet_manager_;
   }
 
+  // Records the last |num_events| congestion control events in a trace.
+  void EnableTrace(size_t num_events) {
+    sent_packet_manager_.EnableTrace(num_events);
+  }
+  void DisableTrace() { sent_packet_manager_.DisableTrace(); }
+
+  // The trace of congestion control events, or null if tracing is disabled.
+  const QuicConnectionTrace* trace() const {
+    return sent_packet_manager_.trace();
+  }
+
   bool CanWrite(HasRetransmittableData retransmittable);
 
   // Stores current batch state for connection, puts the connection
@@ -573,18 +584,42 @@ class NET_EXPORT_PRIVATE QuicConnection
     bool already_in_batch_mode_;
   };
 
-  // Delays setting the retransmission alarm until the scope is exited.
-  // When nested, only the outermost scheduler will set the alarm, and inner
-  // ones have no effect.
-  class NET_EXPORT_PRIVATE ScopedRetransmissionScheduler {
+  // Puts the connection's alarms into batch mode until FinishAlarmBatch(),
+  // so that an alarm moved for every packet of a burst is only rescheduled
+  // once, for its final deadline.  The retransmission and ping alarms'
+  // deadlines are also only computed once, at the end.  Callers which
+  // process several packets for the connection in a row, such as a
+  // dispatcher handling the packets of one read, batch across all of them.
+  // Returns false, and does nothing, if the alarms already are in batch mode.
+  bool StartAlarmBatch();
+  void FinishAlarmBatch();
+
+  // Batches the connection's alarms until the scope is exited.  When nested,
+  // only the outermost batcher has any effect.
+  class NET_EXPORT_PRIVATE ScopedAlarmBatcher {
    public:
-    explicit ScopedRetransmissionScheduler(QuicConnection* connection);
-    ~ScopedRetransmissionScheduler();
+    explicit ScopedAlarmBatcher(QuicConnection* connection);
+    ~ScopedAlarmBatcher();
 
    private:
     QuicConnection* connection_;
-    // Set to the connection's delay_setting_retransmission_alarm_ value in the
-    // constructor and when true, causes this class to do nothing.
+    // Whether the constructor started the batch, which the destructor then
+    // finishes.
+    const bool started_batch_;
+  };
+
+  // Delays flushing the writer until the scope is exited, so that a writer
+  // which batches packets can send everything written in the scope at once.
+  // When nested, only the outermost flusher will flush.
+  class NET_EXPORT_PRIVATE ScopedWriterFlusher {
+   public:
+    explicit ScopedWriterFlusher(QuicConnection* connection);
+    ~ScopedWriterFlusher();
+
+   private:
+    QuicConnection* connection_;
+    // Set to the connection's delay_flushing_writer_ value in the constructor
+    // and when true, causes this class to do nothing.
     const bool already_delayed_;
   };
 
@@ -668,6 +703,10 @@ class NET_EXPORT_PRIVATE QuicConnection
   // retransmittable frames upon success.
   bool WritePacketInner(QueuedPacket* packet);
 
+  // Flushes the writer if packets were written since the last flush, unless
+  // a ScopedWriterFlusher or ScopedPacketBundler is in scope.
+  void MaybeFlushWriter();
+
   // Make sure an ack we got from our peer is sane.
   bool ValidateAckFrame(const QuicAckFrame& incoming_ack);
 
@@ -747,6 +786,9 @@ class NET_EXPORT_PRIVATE QuicConnection
   // Sets the MTU discovery alarm if necessary.
   void MaybeSetMtuAlarm();
 
+  // Moves all of the connection's alarms into or out of batch mode.
+  void SetAlarmsInBatchMode(bool in_batch_mode);
+
   // On arrival of a new packet, checks to see if the socket addresses have
   // changed since the last packet we saw on this connection.
   void CheckForAddressMigration(const IPEndPoint& self_address,
@@ -845,11 +887,18 @@ class NET_EXPORT_PRIVATE QuicConnection
   // the peer needs to stop waiting for some packets.
   int stop_waiting_count_;
 
-  // Indicates the retransmit alarm is going to be set by the
-  // ScopedRetransmitAlarmDelayer
-  bool delay_setting_retransmission_alarm_;
+  // Indicates the alarms are in batch mode, and the retransmission and ping
+  // alarms are going to be set by FinishAlarmBatch().
+  bool batching_alarms_;
   // Indicates the retransmission alarm needs to be set.
   bool pending_retransmission_alarm_;
+  // Indicates the ping alarm needs to be set.
+  bool pending_ping_alarm_;
+
+  // Indicates the writer is going to be flushed by the ScopedWriterFlusher.
+  bool delay_flushing_writer_;
+  // Indicates packets were written since the writer was last flushed.
+  bool pending_writer_flush_;
 
   // An alarm that fires when an ACK should be sent to the peer.
   scoped_ptr<QuicAlarm> ack_alarm_;
@@ -0,0 +1,263 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// A hash map from QuicConnectionId, for the tables a server looks up for
+// every packet it receives.  Collisions are resolved by linear probing over
+// an array holding only the connection IDs, eight to a cache line, so a
+// lookup usually costs one cache miss for the probe and one for the entry,
+// instead of one per node of a bucket's chain.  The table is kept at most
+// half full, which keeps probes for absent connection IDs, such as those of
+// new connections, short too.  Erasing shifts the rest of the probe run back,
+// so there are no tombstones and lookups do not slow down as entries come and
+// go.
+//
+// Connection IDs are chosen by clients, so they are hashed by multiplying with
+// a random odd number per map, which keeps clients from aiming for one probe
+// run.
+//
+// It implements the subset of base::hash_map which the server uses.  Inserting
+// may move every entry and erasing may move later ones, so both invalidate
+// all iterators and pointers into the map.
+
+#ifndef NET_QUIC_QUIC_CONNECTION_ID_MAP_H_
+#define NET_QUIC_QUIC_CONNECTION_ID_MAP_H_
+
+#include <stddef.h>
+
+#include <utility>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/logging.h"
+#include "net/quic/crypto/quic_random.h"
+#include "net/quic/quic_protocol.h"
+
+namespace net {
+
+template <typename Value>
+class QuicConnectionIdMap {
+ public:
+  typedef QuicConnectionId key_type;
+  typedef std::pair<QuicConnectionId, Value> value_type;
+
+ private:
+  template <typename Map, typename Entry>
+  class Iterator {
+   public:
+    Iterator(Map* map, size_t index) : map_(map), index_(index) {
+      SkipUnused();
+    }
+
+    Entry& operator*() const { return map_->entries_[index_]; }
+    Entry* operator->() const { return &map_->entries_[index_]; }
+
+    Iterator& operator++() {
+      ++index_;
+      SkipUnused();
+      return *this;
+    }
+
+    bool operator==(const Iterator& other) const {
+      return index_ == other.index_;
+    }
+    bool operator!=(const Iterator& other) const {
+      return index_ != other.index_;
+    }
+
+   private:
+    friend class QuicConnectionIdMap;
+
+    void SkipUnused() {
+      while (index_ < map_->end_index() && !map_->IsUsed(index_)) {
+        ++index_;
+      }
+    }
+
+    Map* map_;
+    size_t index_;
+  };
+
+ public:
+  typedef Iterator<QuicConnectionIdMap, value_type> iterator;
+  typedef Iterator<const QuicConnectionIdMap, const value_type> const_iterator;
+
+  QuicConnectionIdMap()
+      : multiplier_(QuicRandom::GetInstance()->RandUint64() | 1),
+        size_(0),
+        has_zero_(false) {
+    Resize(kMinCapacityBits);
+  }
+
+  iterator begin() { return iterator(this, 0); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  iterator end() { return iterator(this, end_index()); }
+  const_iterator end() const { return const_iterator(this, end_index()); }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  iterator find(QuicConnectionId connection_id) {
+    return iterator(this, Find(connection_id));
+  }
+  const_iterator find(QuicConnectionId connection_id) const {
+    return const_iterator(this, Find(connection_id));
+  }
+
+  // Inserts |entry| unless its connection ID is present.  Returns the entry
+  // with that connection ID, and whether it was inserted.
+  std::pair<iterator, bool> insert(const value_type& entry) {
+    size_t index = Find(entry.first);
+    if (index != end_index()) {
+      return std::make_pair(iterator(this, index), false);
+    }
+    if ((size_ + 1) * 2 > capacity()) {
+      Grow();
+    }
+    index = Insert(entry);
+    return std::make_pair(iterator(this, index), true);
+  }
+
+  void erase(iterator it) {
+    DCHECK(it.map_ == this);
+    DCHECK(IsUsed(it.index_));
+    EraseAt(it.index_);
+  }
+
+  size_t erase(QuicConnectionId connection_id) {
+    const size_t index = Find(connection_id);
+    if (index == end_index()) {
+      return 0;
+    }
+    EraseAt(index);
+    return 1;
+  }
+
+  void clear() {
+    size_ = 0;
+    has_zero_ = false;
+    Resize(kMinCapacityBits);
+  }
+
+ private:
+  static const int kMinCapacityBits = 4;
+
+  // |connection_ids_| marks unused slots with zero, so connection ID zero is
+  // kept in an extra entry at index capacity().
+  static const QuicConnectionId kUnused = 0;
+
+  size_t capacity() const { return connection_ids_.size(); }
+  size_t zero_index() const { return capacity(); }
+  size_t end_index() const { return capacity() + 1; }
+
+  bool IsUsed(size_t index) const {
+    return index < capacity() ? connection_ids_[index] != kUnused : has_zero_;
+  }
+
+  // The slot at which the probe for |connection_id| starts.
+  size_t HomeOf(QuicConnectionId connection_id) const {
+    return static_cast<size_t>((connection_id * multiplier_) >> shift_);
+  }
+
+  size_t Next(size_t index) const { return (index + 1) & (capacity() - 1); }
+
+  // Returns the index of the entry of |connection_id|, or end_index().
+  size_t Find(QuicConnectionId connection_id) const {
+    if (connection_id == kUnused) {
+      return has_zero_ ? zero_index() : end_index();
+    }
+    for (size_t index = HomeOf(connection_id);; index = Next(index)) {
+      const QuicConnectionId slot = connection_ids_[index];
+      if (slot == connection_id) {
+        return index;
+      }
+      if (slot == kUnused) {
+        return end_index();
+      }
+    }
+  }
+
+  // Stores |entry|, whose connection ID must not be present, and returns its
+  // index.
+  size_t Insert(const value_type& entry) {
+    ++size_;
+    if (entry.first == kUnused) {
+      has_zero_ = true;
+      entries_[zero_index()] = entry;
+      return zero_index();
+    }
+    size_t index = HomeOf(entry.first);
+    while (connection_ids_[index] != kUnused) {
+      index = Next(index);
+    }
+    connection_ids_[index] = entry.first;
+    entries_[index] = entry;
+    return index;
+  }
+
+  void Resize(int capacity_bits) {
+    shift_ = 64 - capacity_bits;
+    connection_ids_.assign(static_cast<size_t>(1) << capacity_bits, kUnused);
+    entries_.assign(connection_ids_.size() + 1, value_type());
+  }
+
+  void Grow() {
+    std::vector<QuicConnectionId> old_connection_ids;
+    std::vector<value_type> old_entries;
+    old_connection_ids.swap(connection_ids_);
+    old_entries.swap(entries_);
+    const value_type zero_entry = old_entries.back();
+    Resize(64 - shift_ + 1);
+    size_ = has_zero_ ? 1 : 0;
+    entries_[zero_index()] = zero_entry;
+    for (size_t i = 0; i < old_connection_ids.size(); ++i) {
+      if (old_connection_ids[i] != kUnused) {
+        Insert(old_entries[i]);
+      }
+    }
+  }
+
+  // Empties slot |hole| and moves back any later entry of the probe run that
+  // could no longer be found across the gap.
+  void EraseAt(size_t hole) {
+    --size_;
+    if (hole == zero_index()) {
+      has_zero_ = false;
+      entries_[hole] = value_type();
+      return;
+    }
+    const size_t mask = capacity() - 1;
+    for (size_t index = Next(hole); connection_ids_[index] != kUnused;
+         index = Next(index)) {
+      // The entry can fill the hole if the hole lies between its home slot
+      // and its current one.
+      const size_t home = HomeOf(connection_ids_[index]);
+      if (((index - home) & mask) >= ((index - hole) & mask)) {
+        connection_ids_[hole] = connection_ids_[index];
+        entries_[hole] = entries_[index];
+        hole = index;
+      }
+    }
+    connection_ids_[hole] = kUnused;
+    entries_[hole] = value_type();
+  }
+
+  // Hashes are the top bits of the connection ID times |multiplier_|.
+  const uint64 multiplier_;
+  int shift_;
+  // The connection ID in each slot, or kUnused.  Probes only read these.
+  std::vector<QuicConnectionId> connection_ids_;
+  // The entry in each slot, and that of connection ID zero.
+  std::vector<value_type> entries_;
+  size_t size_;
+  bool has_zero_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicConnectionIdMap);
+};
+
+template <typename Value>
+const QuicConnectionId QuicConnectionIdMap<Value>::kUnused;
+
+}  // namespace net
+
+#endif  // NET_QUIC_QUIC_CONNECTION_ID_MAP_H_
@@ -0,0 +1,109 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_connection_trace.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace net {
+
+namespace {
+
+const uint32 kTraceMagic = 0x43525451;  // "QTRC"
+const uint32 kTraceVersion = 1;
+
+// Returns the smallest power of two which is at least |n|.
+size_t RoundUpToPowerOfTwo(size_t n) {
+  size_t power = 1;
+  while (power < n) {
+    power <<= 1;
+  }
+  return power;
+}
+
+}  // namespace
+
+QuicConnectionTrace::QuicConnectionTrace(size_t capacity)
+    : mask_(RoundUpToPowerOfTwo(std::max<size_t>(capacity, 1)) - 1),
+      events_(new QuicTraceEvent[mask_ + 1]),
+      num_recorded_(0) {
+  // Touch the ring now rather than on the ack path.
+  memset(events_.get(), 0, (mask_ + 1) * sizeof(QuicTraceEvent));
+}
+
+QuicConnectionTrace::~QuicConnectionTrace() {}
+
+size_t QuicConnectionTrace::size() const {
+  return static_cast<size_t>(
+      std::min<uint64>(num_recorded_, static_cast<uint64>(capacity())));
+}
+
+void QuicConnectionTrace::Serialize(QuicConnectionId connection_id,
+                                    Perspective perspective,
+                                    std::string* out) const {
+  QuicTraceHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kTraceMagic;
+  header.version = kTraceVersion;
+  header.event_size = sizeof(QuicTraceEvent);
+  header.perspective = static_cast<uint32>(perspective);
+  header.connection_id = connection_id;
+  header.num_recorded = num_recorded_;
+  header.num_events = size();
+  out->append(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  // The oldest event is the next to be overwritten, once the ring is full.
+  const size_t oldest =
+      num_recorded_ > mask_ ? static_cast<size_t>(num_recorded_ & mask_) : 0;
+  const size_t num_events = size();
+  const size_t first_run = std::min(num_events, capacity() - oldest);
+  out->append(reinterpret_cast<const char*>(&events_[oldest]),
+              first_run * sizeof(QuicTraceEvent));
+  out->append(reinterpret_cast<const char*>(&events_[0]),
+              (num_events - first_run) * sizeof(QuicTraceEvent));
+}
+
+// static
+size_t QuicConnectionTrace::Parse(base::StringPiece data,
+                                  QuicTraceHeader* header,
+                                  std::vector<QuicTraceEvent>* events) {
+  if (data.size() < sizeof(*header)) {
+    return 0;
+  }
+  memcpy(header, data.data(), sizeof(*header));
+  if (header->magic != kTraceMagic || header->version != kTraceVersion ||
+      header->event_size != sizeof(QuicTraceEvent) ||
+      header->num_events > (data.size() - sizeof(*header)) /
+                               sizeof(QuicTraceEvent)) {
+    return 0;
+  }
+  const size_t num_events = static_cast<size_t>(header->num_events);
+  events->resize(num_events);
+  if (num_events > 0) {
+    memcpy(&(*events)[0], data.data() + sizeof(*header),
+           num_events * sizeof(QuicTraceEvent));
+  }
+  return sizeof(*header) + num_events * sizeof(QuicTraceEvent);
+}
+
+// static
+const char* QuicConnectionTrace::EventTypeToString(uint32 type) {
+  switch (type) {
+    case QuicTraceEvent::ACK:
+      return "ack";
+    case QuicTraceEvent::LOSS_TIMEOUT:
+      return "loss_timeout";
+    case QuicTraceEvent::TAIL_LOSS_PROBE:
+      return "tail_loss_probe";
+    case QuicTraceEvent::RETRANSMISSION_TIMEOUT:
+      return "retransmission_timeout";
+  }
+  return "unknown";
+}
+
+}  // namespace net
@@ -0,0 +1,128 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// A fixed-size ring of a connection's congestion control events, such as the
+// congestion window, slow start threshold and RTT after each ack, for
+// plotting how a send algorithm behaved.  Events are fixed-size structs, so
+// recording one is a handful of stores into memory allocated up front, and
+// once the ring is full each event overwrites the oldest.  Connections which
+// do not trace have no ring, and pay one null check per ack.
+//
+// A trace is serialized as a QuicTraceHeader followed by its events, oldest
+// first, both in host byte order; quic_trace_decoder turns files of them into
+// CSV or JSON.
+
+#ifndef NET_QUIC_QUIC_CONNECTION_TRACE_H_
+#define NET_QUIC_QUIC_CONNECTION_TRACE_H_
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_piece.h"
+#include "net/base/net_export.h"
+#include "net/quic/quic_protocol.h"
+
+namespace net {
+
+struct QuicTraceEvent {
+  enum Type {
+    // The send algorithm has processed the packets an ack acked or showed
+    // to be lost.
+    ACK = 1,
+    // The loss detection alarm found packets to be lost.
+    LOSS_TIMEOUT = 2,
+    // The retransmission alarm sent a tail loss probe.
+    TAIL_LOSS_PROBE = 3,
+    // The retransmission alarm fired an RTO.
+    RETRANSMISSION_TIMEOUT = 4,
+  };
+
+  enum Flags {
+    IN_SLOW_START = 1 << 0,
+    IN_RECOVERY = 1 << 1,
+  };
+
+  // The QuicTime of the event, in microseconds.
+  int64 time_us;
+  uint32 type;
+  uint32 flags;
+  // The state of the send algorithm after the event, in bytes.
+  uint64 congestion_window;
+  uint64 slow_start_threshold;
+  uint64 bytes_in_flight;
+  int64 smoothed_rtt_us;
+  int64 min_rtt_us;
+  uint64 pacing_rate_bytes_per_second;
+  uint64 bandwidth_estimate_bytes_per_second;
+  // The number of packets the event acked and declared lost.
+  uint32 packets_acked;
+  uint32 packets_lost;
+};
+
+static_assert(sizeof(QuicTraceEvent) == 80,
+              "QuicTraceEvent is part of the trace file format");
+
+struct QuicTraceHeader {
+  uint32 magic;
+  // Bumped whenever QuicTraceHeader or QuicTraceEvent change.
+  uint32 version;
+  uint32 event_size;
+  // A Perspective.
+  uint32 perspective;
+  QuicConnectionId connection_id;
+  // The number of events ever recorded, including those overwritten.
+  uint64 num_recorded;
+  // The number of events which follow.
+  uint64 num_events;
+};
+
+static_assert(sizeof(QuicTraceHeader) == 40,
+              "QuicTraceHeader is part of the trace file format");
+
+class NET_EXPORT_PRIVATE QuicConnectionTrace {
+ public:
+  // Keeps the last |capacity| events, rounded up to a power of two.
+  explicit QuicConnectionTrace(size_t capacity);
+  ~QuicConnectionTrace();
+
+  // Returns the slot of a new event, for the caller to fill in.
+  QuicTraceEvent* AddEvent() {
+    QuicTraceEvent* event = &events_[num_recorded_ & mask_];
+    ++num_recorded_;
+    return event;
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+  uint64 num_recorded() const { return num_recorded_; }
+  // The number of events held.
+  size_t size() const;
+
+  // Appends the header and events to |out|.
+  void Serialize(QuicConnectionId connection_id,
+                 Perspective perspective,
+                 std::string* out) const;
+
+  // Parses the trace at the start of |data| into |header| and |events|, and
+  // returns its size in bytes, or zero if |data| does not start with a
+  // whole trace.
+  static size_t Parse(base::StringPiece data,
+                      QuicTraceHeader* header,
+                      std::vector<QuicTraceEvent>* events);
+
+  // Returns the name of |type|, or "unknown".
+  static const char* EventTypeToString(uint32 type);
+
+ private:
+  const size_t mask_;
+  scoped_ptr<QuicTraceEvent[]> events_;
+  uint64 num_recorded_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicConnectionTrace);
+};
+
+}  // namespace net
+
+#endif  // NET_QUIC_QUIC_CONNECTION_TRACE_H_
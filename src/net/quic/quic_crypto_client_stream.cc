@@ -158,7 +158,7 @@ void QuicCryptoClientStream::HandleServerConfigUpdateMessage(
       server_config_update,
       session()->connection()->clock()->WallNow(),
       cached,
-      &crypto_negotiated_params_,
+      crypto_negotiated_params_.get(),
       &error_details);
 
   if (error != QUIC_NO_ERROR) {
@@ -275,7 +275,7 @@ void QuicCryptoClientStream::DoSendCHLO(
     crypto_config_->FillInchoateClientHello(
         server_id_,
         session()->connection()->supported_versions().front(),
-        cached, &crypto_negotiated_params_, &out);
+        cached, crypto_negotiated_params_.get(), &out);
     // Pad the inchoate client hello to fill up a packet.
     const QuicByteCount kFramingOverhead = 50;  // A rough estimate.
     const QuicByteCount max_packet_size =
@@ -301,10 +301,10 @@ void QuicCryptoClientStream::DoSendCHLO(
   // If the server nonce is empty, copy over the server nonce from a previous
   // SREJ, if there is one.
   if (FLAGS_enable_quic_stateless_reject_support &&
-      crypto_negotiated_params_.server_nonce.empty() &&
+      crypto_negotiated_params_->server_nonce.empty() &&
       cached->has_server_nonce()) {
-    crypto_negotiated_params_.server_nonce = cached->GetNextServerNonce();
-    DCHECK(!crypto_negotiated_params_.server_nonce.empty());
+    crypto_negotiated_params_->server_nonce = cached->GetNextServerNonce();
+    DCHECK(!crypto_negotiated_params_->server_nonce.empty());
   }
 
   string error_details;
@@ -316,7 +316,7 @@ void QuicCryptoClientStream::DoSendCHLO(
       session()->connection()->clock()->WallNow(),
       session()->connection()->random_generator(),
       channel_id_key_.get(),
-      &crypto_negotiated_params_,
+      crypto_negotiated_params_.get(),
       &out,
       &error_details);
 
@@ -337,13 +337,13 @@ void QuicCryptoClientStream::DoSendCHLO(
   // Be prepared to decrypt with the new server write key.
   session()->connection()->SetAlternativeDecrypter(
       ENCRYPTION_INITIAL,
-      crypto_negotiated_params_.initial_crypters.decrypter.release(),
+      crypto_negotiated_params_->initial_crypters.decrypter.release(),
       true /* latch once used */);
   // Send subsequent packets under encryption on the assumption that the
   // server will accept the handshake.
   session()->connection()->SetEncrypter(
       ENCRYPTION_INITIAL,
-      crypto_negotiated_params_.initial_crypters.encrypter.release());
+      crypto_negotiated_params_->initial_crypters.encrypter.release());
   session()->connection()->SetDefaultEncryptionLevel(
       ENCRYPTION_INITIAL);
   if (!encryption_established_) {
@@ -380,7 +380,7 @@ void QuicCryptoClientStream::DoReceiveREJ(
   string error_details;
   QuicErrorCode error = crypto_config_->ProcessRejection(
       *in, session()->connection()->clock()->WallNow(), cached,
-      server_id_.is_https(), &crypto_negotiated_params_, &error_details);
+      server_id_.is_https(), crypto_negotiated_params_.get(), &error_details);
 
   if (error != QUIC_NO_ERROR) {
     next_state_ = STATE_NONE;
@@ -551,15 +551,19 @@ void QuicCryptoClientStream::DoReceiveSHLO(
   }
 
   string error_details;
+  const string previous_source_address_token = cached->source_address_token();
   QuicErrorCode error = crypto_config_->ProcessServerHello(
       *in, session()->connection()->connection_id(),
       session()->connection()->server_supported_versions(),
-      cached, &crypto_negotiated_params_, &error_details);
+      cached, crypto_negotiated_params_.get(), &error_details);
 
   if (error != QUIC_NO_ERROR) {
     CloseConnectionWithDetails(error, "Server hello invalid: " + error_details);
     return;
   }
+  if (cached->source_address_token() != previous_source_address_token) {
+    crypto_config_->PersistCachedState(server_id_, *cached);
+  }
   error = session()->config()->ProcessPeerHello(*in, SERVER, &error_details);
   if (error != QUIC_NO_ERROR) {
     CloseConnectionWithDetails(error, "Server hello invalid: " + error_details);
@@ -567,7 +571,7 @@ void QuicCryptoClientStream::DoReceiveSHLO(
   }
   session()->OnConfigNegotiated();
 
-  CrypterPair* crypters = &crypto_negotiated_params_.forward_secure_crypters;
+  CrypterPair* crypters = &crypto_negotiated_params_->forward_secure_crypters;
   // TODO(agl): we don't currently latch this decrypter because the idea
   // has been floated that the server shouldn't send packets encrypted
   // with the FORWARD_SECURE key until it receives a FORWARD_SECURE
@@ -607,6 +611,7 @@ void QuicCryptoClientStream::DoInitializeServerConfigUpdate(
 void QuicCryptoClientStream::SetCachedProofValid(
     QuicCryptoClientConfig::CachedState* cached) {
   cached->SetProofValid();
+  crypto_config_->PersistCachedState(server_id_, *cached);
   if (client_session_proof_interface_) {
     client_session_proof_interface_->OnProofValid(*cached);
   }
@@ -33,6 +33,8 @@ QuicCryptoServerStream::QuicCryptoServerStream(
     : QuicCryptoStream(session),
       crypto_config_(crypto_config),
       validate_client_hello_cb_(nullptr),
+      handshake_worker_pool_(nullptr),
+      process_client_hello_cb_(nullptr),
       num_handshake_messages_(0),
       num_handshake_messages_with_server_nonces_(0),
       num_server_config_update_messages_sent_(0),
@@ -50,6 +52,9 @@ void QuicCryptoServerStream::CancelOutstandingCallbacks() {
   if (validate_client_hello_cb_ != nullptr) {
     validate_client_hello_cb_->Cancel();
   }
+  if (process_client_hello_cb_ != nullptr) {
+    process_client_hello_cb_->Cancel();
+  }
 }
 
 void QuicCryptoServerStream::OnHandshakeMessage(
@@ -68,7 +73,8 @@ void QuicCryptoServerStream::OnHandshakeMessage(
     return;
   }
 
-  if (validate_client_hello_cb_ != nullptr) {
+  if (validate_client_hello_cb_ != nullptr ||
+      process_client_hello_cb_ != nullptr) {
     // Already processing some other handshake message.  The protocol
     // does not allow for clients to send multiple handshake messages
     // before the server has a chance to respond.
@@ -93,18 +99,43 @@ void QuicCryptoServerStream::FinishProcessingHandshakeMessage(
     peer_supports_stateless_rejects_ = DoesPeerSupportStatelessRejects(message);
   }
 
+  if (handshake_worker_pool_ != nullptr) {
+    bool use_stateless_rejects;
+    QuicConnectionId server_designated_connection_id;
+    PrepareToProcessClientHello(result, &use_stateless_rejects,
+                                &server_designated_connection_id);
+    QuicConnection* connection = session()->connection();
+    process_client_hello_cb_ = new ProcessClientHelloCallback(this);
+    handshake_worker_pool_->ProcessClientHello(
+        result, connection->connection_id(),
+        connection->self_address().address(), connection->peer_address(),
+        version(), connection->supported_versions(), use_stateless_rejects,
+        server_designated_connection_id, crypto_negotiated_params_.get(),
+        process_client_hello_cb_);
+    return;
+  }
+
   CryptoHandshakeMessage reply;
   string error_details;
   QuicErrorCode error =
       ProcessClientHello(message, result, &reply, &error_details);
+  FinishProcessingHandshakeMessageAfterProcessClientHello(
+      message, error, error_details, &reply);
+}
 
+void QuicCryptoServerStream::
+    FinishProcessingHandshakeMessageAfterProcessClientHello(
+        const CryptoHandshakeMessage& message,
+        QuicErrorCode error,
+        const string& error_details,
+        CryptoHandshakeMessage* reply) {
   if (error != QUIC_NO_ERROR) {
     CloseConnectionWithDetails(error, error_details);
     return;
   }
 
-  if (reply.tag() != kSHLO) {
-    SendHandshakeMessage(reply);
+  if (reply->tag() != kSHLO) {
+    SendHandshakeMessage(*reply);
     return;
   }
 
@@ -113,15 +144,16 @@ void QuicCryptoServerStream::FinishProcessingHandshakeMessage(
   // session config.
   QuicConfig* config = session()->config();
   OverrideQuicConfigDefaults(config);
-  error = config->ProcessPeerHello(message, CLIENT, &error_details);
+  string config_error_details;
+  error = config->ProcessPeerHello(message, CLIENT, &config_error_details);
   if (error != QUIC_NO_ERROR) {
-    CloseConnectionWithDetails(error, error_details);
+    CloseConnectionWithDetails(error, config_error_details);
     return;
   }
 
   session()->OnConfigNegotiated();
 
-  config->ToHandshakeMessage(&reply);
+  config->ToHandshakeMessage(reply);
 
   // Receiving a full CHLO implies the client is prepared to decrypt with
   // the new server write key.  We can start to encrypt with the new server
@@ -130,26 +162,26 @@ void QuicCryptoServerStream::FinishProcessingHandshakeMessage(
   // NOTE: the SHLO will be encrypted with the new server write key.
   session()->connection()->SetEncrypter(
       ENCRYPTION_INITIAL,
-      crypto_negotiated_params_.initial_crypters.encrypter.release());
+      crypto_negotiated_params_->initial_crypters.encrypter.release());
   session()->connection()->SetDefaultEncryptionLevel(ENCRYPTION_INITIAL);
   // Set the decrypter immediately so that we no longer accept unencrypted
   // packets.
   session()->connection()->SetDecrypter(
       ENCRYPTION_INITIAL,
-      crypto_negotiated_params_.initial_crypters.decrypter.release());
+      crypto_negotiated_params_->initial_crypters.decrypter.release());
 
   // We want to be notified when the SHLO is ACKed so that we can disable
   // HANDSHAKE_MODE in the sent packet manager.
   scoped_refptr<ServerHelloNotifier> server_hello_notifier(
       new ServerHelloNotifier(this));
-  SendHandshakeMessage(reply, server_hello_notifier.get());
+  SendHandshakeMessage(*reply, server_hello_notifier.get());
 
   session()->connection()->SetEncrypter(
       ENCRYPTION_FORWARD_SECURE,
-      crypto_negotiated_params_.forward_secure_crypters.encrypter.release());
+      crypto_negotiated_params_->forward_secure_crypters.encrypter.release());
   session()->connection()->SetAlternativeDecrypter(
       ENCRYPTION_FORWARD_SECURE,
-      crypto_negotiated_params_.forward_secure_crypters.decrypter.release(),
+      crypto_negotiated_params_->forward_secure_crypters.decrypter.release(),
       false /* don't latch */);
 
   encryption_established_ = true;
@@ -170,7 +202,7 @@ void QuicCryptoServerStream::SendServerConfigUpdate(
           session()->connection()->peer_address().address(),
           session()->connection()->clock(),
           session()->connection()->random_generator(),
-          crypto_negotiated_params_, cached_network_params,
+          *crypto_negotiated_params_, cached_network_params,
           &server_config_update_message)) {
     DVLOG(1) << "Server: Failed to build server config update (SCUP)!";
     return;
@@ -197,11 +229,11 @@ void QuicCryptoServerStream::set_previous_cached_network_params(
 bool QuicCryptoServerStream::GetBase64SHA256ClientChannelID(
     string* output) const {
   if (!encryption_established_ ||
-      crypto_negotiated_params_.channel_id.empty()) {
+      crypto_negotiated_params_->channel_id.empty()) {
     return false;
   }
 
-  const string& channel_id(crypto_negotiated_params_.channel_id);
+  const string& channel_id(crypto_negotiated_params_->channel_id);
   scoped_ptr<crypto::SecureHash> hash(
       crypto::SecureHash::Create(crypto::SecureHash::SHA256));
   hash->Update(channel_id.data(), channel_id.size());
@@ -229,6 +261,23 @@ QuicErrorCode QuicCryptoServerStream::ProcessClientHello(
     const ValidateClientHelloResultCallback::Result& result,
     CryptoHandshakeMessage* reply,
     string* error_details) {
+  bool use_stateless_rejects_in_crypto_config;
+  QuicConnectionId server_designated_connection_id;
+  PrepareToProcessClientHello(result, &use_stateless_rejects_in_crypto_config,
+                              &server_designated_connection_id);
+  QuicConnection* connection = session()->connection();
+  return crypto_config_->ProcessClientHello(
+      result, connection->connection_id(), connection->self_address().address(),
+      connection->peer_address(), version(), connection->supported_versions(),
+      use_stateless_rejects_in_crypto_config, server_designated_connection_id,
+      connection->clock(), connection->random_generator(),
+      crypto_negotiated_params_.get(), reply, error_details);
+}
+
+void QuicCryptoServerStream::PrepareToProcessClientHello(
+    const ValidateClientHelloResultCallback::Result& result,
+    bool* use_stateless_rejects,
+    QuicConnectionId* server_designated_connection_id) {
   if (!result.info.server_nonce.empty()) {
     ++num_handshake_messages_with_server_nonces_;
   }
@@ -239,21 +288,13 @@ QuicErrorCode QuicCryptoServerStream::ProcessClientHello(
   }
   previous_source_address_tokens_ = result.info.source_address_tokens;
 
-  const bool use_stateless_rejects_in_crypto_config =
-      FLAGS_enable_quic_stateless_reject_support &&
-      use_stateless_rejects_if_peer_supported_ &&
-      peer_supports_stateless_rejects_;
-  QuicConnection* connection = session()->connection();
-  const QuicConnectionId server_designated_connection_id =
-      use_stateless_rejects_in_crypto_config
-          ? GenerateConnectionIdForReject(connection->connection_id())
-          : 0;
-  return crypto_config_->ProcessClientHello(
-      result, connection->connection_id(), connection->self_address().address(),
-      connection->peer_address(), version(), connection->supported_versions(),
-      use_stateless_rejects_in_crypto_config, server_designated_connection_id,
-      connection->clock(), connection->random_generator(),
-      &crypto_negotiated_params_, reply, error_details);
+  *use_stateless_rejects = FLAGS_enable_quic_stateless_reject_support &&
+                           use_stateless_rejects_if_peer_supported_ &&
+                           peer_supports_stateless_rejects_;
+  *server_designated_connection_id =
+      *use_stateless_rejects ? GenerateConnectionIdForReject(
+                                   session()->connection()->connection_id())
+                             : 0;
 }
 
 void QuicCryptoServerStream::OverrideQuicConfigDefaults(QuicConfig* config) {
@@ -278,6 +319,29 @@ void QuicCryptoServerStream::ValidateCallback::RunImpl(
   }
 }
 
+QuicCryptoServerStream::ProcessClientHelloCallback::ProcessClientHelloCallback(
+    QuicCryptoServerStream* parent) : parent_(parent) {
+}
+
+void QuicCryptoServerStream::ProcessClientHelloCallback::Cancel() {
+  parent_ = nullptr;
+}
+
+void QuicCryptoServerStream::ProcessClientHelloCallback::Run(
+    const ValidateClientHelloResultCallback::Result& result,
+    QuicErrorCode error,
+    const string& error_details,
+    CryptoHandshakeMessage* reply) {
+  if (parent_ == nullptr) {
+    return;
+  }
+  // Clear the callback that got us here.
+  DCHECK_EQ(this, parent_->process_client_hello_cb_);
+  parent_->process_client_hello_cb_ = nullptr;
+  parent_->FinishProcessingHandshakeMessageAfterProcessClientHello(
+      result.client_hello, error, error_details, reply);
+}
+
 QuicConnectionId QuicCryptoServerStream::GenerateConnectionIdForReject(
     QuicConnectionId connection_id) {
   return session()->connection()->random_generator()->RandUint64();
@@ -8,6 +8,7 @@
 #include <string>
 
 #include "net/quic/crypto/crypto_handshake.h"
+#include "net/quic/crypto/crypto_handshake_worker_pool.h"
 #include "net/quic/crypto/quic_crypto_server_config.h"
 #include "net/quic/proto/source_address_token.pb.h"
 #include "net/quic/quic_config.h"
@@ -55,7 +56,7 @@ class NET_EXPORT_PRIVATE QuicCryptoServerStream : public QuicCryptoStream {
   ~QuicCryptoServerStream() override;
 
   // Cancel any outstanding callbacks, such as asynchronous validation of client
-  // hello.
+  // hello, or processing of it on a crypto worker thread.
   void CancelOutstandingCallbacks();
 
   // CryptoFramerVisitorInterface implementation
@@ -102,6 +103,13 @@ class NET_EXPORT_PRIVATE QuicCryptoServerStream : public QuicCryptoStream {
         use_stateless_rejects_if_peer_supported;
   }
 
+  // If set, client hellos are processed on |handshake_worker_pool|, which
+  // must outlive the stream, instead of on the network thread.
+  void set_handshake_worker_pool(
+      CryptoHandshakeWorkerPool* handshake_worker_pool) {
+    handshake_worker_pool_ = handshake_worker_pool;
+  }
+
   bool peer_supports_stateless_rejects() const {
     return peer_supports_stateless_rejects_;
   }
@@ -147,13 +155,48 @@ class NET_EXPORT_PRIVATE QuicCryptoServerStream : public QuicCryptoStream {
     DISALLOW_COPY_AND_ASSIGN(ValidateCallback);
   };
 
+  class ProcessClientHelloCallback : public ProcessClientHelloResultCallback {
+   public:
+    explicit ProcessClientHelloCallback(QuicCryptoServerStream* parent);
+    // To allow the parent to detach itself from the callback before deletion.
+    void Cancel();
+
+    // From ProcessClientHelloResultCallback
+    void Run(const ValidateClientHelloResultCallback::Result& result,
+             QuicErrorCode error,
+             const std::string& error_details,
+             CryptoHandshakeMessage* reply) override;
+
+   private:
+    QuicCryptoServerStream* parent_;
+
+    DISALLOW_COPY_AND_ASSIGN(ProcessClientHelloCallback);
+  };
+
   // Invoked by ValidateCallback::RunImpl once initial validation of
-  // the client hello is complete.  Finishes processing of the client
-  // hello message and handles handshake success/failure.
+  // the client hello is complete.  Processes the client hello, on the
+  // handshake worker pool if there is one, and otherwise finishes processing
+  // of the client hello message and handles handshake success/failure.
   void FinishProcessingHandshakeMessage(
       const CryptoHandshakeMessage& message,
       const ValidateClientHelloResultCallback::Result& result);
 
+  // Sends the reply to the client hello |message| and, if it is a SHLO,
+  // completes the handshake.  Invoked with the outcome of ProcessClientHello,
+  // either directly or by ProcessClientHelloCallback::Run.
+  void FinishProcessingHandshakeMessageAfterProcessClientHello(
+      const CryptoHandshakeMessage& message,
+      QuicErrorCode error,
+      const std::string& error_details,
+      CryptoHandshakeMessage* reply);
+
+  // Records what the client sent in |result| and decides whether a rejection
+  // should be stateless, and if so with which connection ID.
+  void PrepareToProcessClientHello(
+      const ValidateClientHelloResultCallback::Result& result,
+      bool* use_stateless_rejects,
+      QuicConnectionId* server_designated_connection_id);
+
   // Checks the options on the handshake-message to see whether the
   // peer supports stateless-rejects.
   static bool DoesPeerSupportStatelessRejects(
@@ -168,6 +211,13 @@ class NET_EXPORT_PRIVATE QuicCryptoServerStream : public QuicCryptoStream {
   // handshake message is being validated.
   ValidateCallback* validate_client_hello_cb_;
 
+  // Processes client hellos off the network thread if not null.  Not owned.
+  CryptoHandshakeWorkerPool* handshake_worker_pool_;
+
+  // The callback receiving the outcome of the client hello being processed
+  // by |handshake_worker_pool_|, or nullptr if there is none.
+  ProcessClientHelloCallback* process_client_hello_cb_;
+
   // Number of handshake messages received by this stream.
   uint8 num_handshake_messages_;
 
@@ -25,7 +25,8 @@ namespace net {
 QuicCryptoStream::QuicCryptoStream(QuicSession* session)
     : ReliableQuicStream(kCryptoStreamId, session),
       encryption_established_(false),
-      handshake_confirmed_(false) {
+      handshake_confirmed_(false),
+      crypto_negotiated_params_(new QuicCryptoNegotiatedParameters) {
   crypto_framer_.set_visitor(this);
   // The crypto stream is exempt from connection level flow control.
   DisableConnectionFlowControlForThisStream();
@@ -88,7 +89,7 @@ bool QuicCryptoStream::ExportKeyingMaterial(
     return false;
   }
   return CryptoUtils::ExportKeyingMaterial(
-      crypto_negotiated_params_.subkey_secret,
+      crypto_negotiated_params_->subkey_secret,
       label,
       context,
       result_len,
@@ -97,7 +98,7 @@ bool QuicCryptoStream::ExportKeyingMaterial(
 
 const QuicCryptoNegotiatedParameters&
 QuicCryptoStream::crypto_negotiated_params() const {
-  return crypto_negotiated_params_;
+  return *crypto_negotiated_params_;
 }
 
 }  // namespace net
@@ -6,7 +6,9 @@
 #define NET_QUIC_QUIC_CRYPTO_STREAM_H_
 
 #include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
 #include "net/quic/crypto/crypto_framer.h"
+#include "net/quic/crypto/crypto_handshake.h"
 #include "net/quic/crypto/crypto_utils.h"
 #include "net/quic/quic_config.h"
 #include "net/quic/quic_protocol.h"
@@ -67,7 +69,7 @@ class NET_EXPORT_PRIVATE QuicCryptoStream
   bool encryption_established_;
   bool handshake_confirmed_;
 
-  QuicCryptoNegotiatedParameters crypto_negotiated_params_;
+  scoped_refptr<QuicCryptoNegotiatedParameters> crypto_negotiated_params_;
 
  private:
   CryptoFramer crypto_framer_;
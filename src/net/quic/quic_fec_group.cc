@@ -9,6 +9,12 @@
 #include "base/basictypes.h"
 #include "base/logging.h"
 #include "base/stl_util.h"
+#include "build/build_config.h"
+
+#if defined(ARCH_CPU_X86_FAMILY) && defined(__GNUC__)
+#include <immintrin.h>
+#define QUIC_FEC_X86_PARITY 1
+#endif
 
 using base::StringPiece;
 using std::numeric_limits;
@@ -16,6 +22,86 @@ using std::set;
 
 namespace net {
 
+namespace {
+
+typedef void (*XorFunction)(char* parity, const char* data, size_t length);
+
+// XORs a 64-bit word at a time.  memcpy keeps unaligned accesses legal and
+// compiles to plain loads and stores.
+void XorWords(char* parity, const char* data, size_t length) {
+  size_t i = 0;
+  for (; i + sizeof(uint64) <= length; i += sizeof(uint64)) {
+    uint64 parity_word;
+    uint64 data_word;
+    memcpy(&parity_word, parity + i, sizeof(parity_word));
+    memcpy(&data_word, data + i, sizeof(data_word));
+    parity_word ^= data_word;
+    memcpy(parity + i, &parity_word, sizeof(parity_word));
+  }
+  for (; i < length; ++i) {
+    parity[i] ^= data[i];
+  }
+}
+
+#if defined(QUIC_FEC_X86_PARITY)
+__attribute__((target("sse2"))) void XorSse2(char* parity,
+                                             const char* data,
+                                             size_t length) {
+  size_t i = 0;
+  for (; i + sizeof(__m128i) <= length; i += sizeof(__m128i)) {
+    __m128i* out = reinterpret_cast<__m128i*>(parity + i);
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    _mm_storeu_si128(out, _mm_xor_si128(_mm_loadu_si128(out), in));
+  }
+  XorWords(parity + i, data + i, length - i);
+}
+
+__attribute__((target("avx2"))) void XorAvx2(char* parity,
+                                             const char* data,
+                                             size_t length) {
+  size_t i = 0;
+  for (; i + sizeof(__m256i) <= length; i += sizeof(__m256i)) {
+    __m256i* out = reinterpret_cast<__m256i*>(parity + i);
+    __m256i in =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+    _mm256_storeu_si256(out, _mm256_xor_si256(_mm256_loadu_si256(out), in));
+  }
+  XorWords(parity + i, data + i, length - i);
+}
+#endif  // QUIC_FEC_X86_PARITY
+
+// Returns the implementation of |kernel|, or null if it is not supported.
+XorFunction GetXorFunction(QuicFecGroup::XorKernel kernel) {
+  switch (kernel) {
+    case QuicFecGroup::XOR_WORDS:
+      return XorWords;
+#if defined(QUIC_FEC_X86_PARITY)
+    case QuicFecGroup::XOR_SSE2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("sse2") ? XorSse2 : nullptr;
+    case QuicFecGroup::XOR_AVX2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2") ? XorAvx2 : nullptr;
+#endif
+    default:
+      return nullptr;
+  }
+}
+
+XorFunction SelectXorFunction() {
+  const QuicFecGroup::XorKernel kKernels[] = {
+      QuicFecGroup::XOR_AVX2, QuicFecGroup::XOR_SSE2, QuicFecGroup::XOR_WORDS};
+  for (QuicFecGroup::XorKernel kernel : kKernels) {
+    XorFunction xor_function = GetXorFunction(kernel);
+    if (xor_function != nullptr) {
+      return xor_function;
+    }
+  }
+  return XorWords;
+}
+
+}  // namespace
+
 QuicFecGroup::QuicFecGroup()
     : min_protected_packet_(kInvalidPacketSequenceNumber),
       max_protected_packet_(kInvalidPacketSequenceNumber),
@@ -111,9 +197,7 @@ size_t QuicFecGroup::Revive(QuicPacketHeader* header,
   if (payload_parity_len_ > decrypted_payload_len) {
     return 0;
   }
-  for (size_t i = 0; i < payload_parity_len_; ++i) {
-    decrypted_payload[i] = payload_parity_[i];
-  }
+  memcpy(decrypted_payload, payload_parity_, payload_parity_len_);
 
   header->packet_sequence_number = missing;
   header->entropy_flag = false;  // Unknown entropy.
@@ -151,11 +235,29 @@ bool QuicFecGroup::UpdateParity(StringPiece payload) {
     }
     return true;
   }
-  // Update the parity by XORing in the data (padding with 0s if necessary).
-  for (size_t i = 0; i < kMaxPacketSize; ++i) {
-    uint8 byte = i < payload.size() ? payload[i] : 0x00;
-    payload_parity_[i] ^= byte;
+  // Update the parity by XORing in the data.  The parity beyond the end of
+  // the payload is XORed with the implicit zero padding, which leaves it
+  // unchanged.
+  XorInto(payload_parity_, payload.data(), payload.size());
+  return true;
+}
+
+// static
+void QuicFecGroup::XorInto(char* parity, const char* data, size_t length) {
+  static const XorFunction xor_function = SelectXorFunction();
+  xor_function(parity, data, length);
+}
+
+// static
+bool QuicFecGroup::XorIntoWithKernel(XorKernel kernel,
+                                     char* parity,
+                                     const char* data,
+                                     size_t length) {
+  XorFunction xor_function = GetXorFunction(kernel);
+  if (xor_function == nullptr) {
+    return false;
   }
+  xor_function(parity, data, length);
   return true;
 }
 
@@ -72,6 +72,24 @@ class NET_EXPORT_PRIVATE QuicFecGroup {
     return effective_encryption_level_;
   }
 
+  // XORs |length| bytes of |data| into |parity|, using the widest vector
+  // instructions the CPU supports.
+  static void XorInto(char* parity, const char* data, size_t length);
+
+  // The implementations XorInto() chooses from.
+  enum XorKernel {
+    XOR_WORDS,  // Portable, 64 bits at a time.
+    XOR_SSE2,
+    XOR_AVX2,
+  };
+
+  // As XorInto(), with |kernel|.  Returns false, doing nothing, if the CPU or
+  // the build does not support it.  For benchmarks.
+  static bool XorIntoWithKernel(XorKernel kernel,
+                                char* parity,
+                                const char* data,
+                                size_t length);
+
  private:
   bool UpdateParity(base::StringPiece payload);
   // Returns the number of missing packets, or QuicPacketCount max
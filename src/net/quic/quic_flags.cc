@@ -40,6 +40,12 @@ int64 FLAGS_quic_time_wait_list_seconds = 200;
 // no configured limit.
 int64 FLAGS_quic_time_wait_list_max_connections = 600000;
 
+// Maximum number of public resets and connection close packets per second sent
+// by a time-wait list in response to packets for its connections, which after
+// a restart may arrive from every client at once.  A non-positive value implies
+// no limit.
+int64 FLAGS_quic_time_wait_list_max_responses_per_second = 20000;
+
 // Enables server-side support for QUIC stateless rejects.
 bool FLAGS_enable_quic_stateless_reject_support = true;
 
@@ -87,3 +93,7 @@ bool FLAGS_quic_limit_pacing_burst = true;
 // disabling 0-rtt handshakes.
 // TODO(rtenneti): Enable this flag after fixing tests.
 bool FLAGS_quic_require_handshake_confirmation = false;
+
+// The number of congestion control events each new connection keeps in its
+// trace.  Zero disables tracing.
+int64 FLAGS_quic_connection_trace_events = 0;
@@ -17,6 +17,8 @@ NET_EXPORT_PRIVATE extern bool FLAGS_quic_allow_bbr;
 NET_EXPORT_PRIVATE extern bool FLAGS_quic_too_many_outstanding_packets;
 NET_EXPORT_PRIVATE extern int64 FLAGS_quic_time_wait_list_seconds;
 NET_EXPORT_PRIVATE extern int64 FLAGS_quic_time_wait_list_max_connections;
+NET_EXPORT_PRIVATE extern int64
+    FLAGS_quic_time_wait_list_max_responses_per_second;
 NET_EXPORT_PRIVATE extern bool FLAGS_enable_quic_stateless_reject_support;
 NET_EXPORT_PRIVATE extern bool FLAGS_quic_auto_tune_receive_window;
 NET_EXPORT_PRIVATE extern bool FLAGS_quic_do_path_mtu_discovery;
@@ -30,5 +32,6 @@ NET_EXPORT_PRIVATE extern bool FLAGS_spdy_strip_invalid_headers;
 NET_EXPORT_PRIVATE extern bool FLAGS_exact_stream_id_delta;
 NET_EXPORT_PRIVATE extern bool FLAGS_quic_limit_pacing_burst;
 NET_EXPORT_PRIVATE extern bool FLAGS_quic_require_handshake_confirmation;
+NET_EXPORT_PRIVATE extern int64 FLAGS_quic_connection_trace_events;
 
 #endif  // NET_QUIC_QUIC_FLAGS_H_
@@ -978,29 +978,31 @@ uint8 QuicFramer::GetSequenceNumberFlags(
 QuicFramer::AckFrameInfo QuicFramer::GetAckFrameInfo(
     const QuicAckFrame& frame) {
   AckFrameInfo ack_info;
-  if (frame.missing_packets.empty()) {
+  if (frame.missing_packets.Empty()) {
     return ack_info;
   }
-  DCHECK_GE(frame.largest_observed, *frame.missing_packets.rbegin());
-  size_t cur_range_length = 0;
-  SequenceNumberSet::const_iterator iter = frame.missing_packets.begin();
-  QuicPacketSequenceNumber last_missing = *iter;
-  ++iter;
-  for (; iter != frame.missing_packets.end(); ++iter) {
-    if (cur_range_length < numeric_limits<uint8>::max() &&
-        *iter == (last_missing + 1)) {
-      ++cur_range_length;
-    } else {
-      ack_info.nack_ranges[last_missing - cur_range_length] =
-          static_cast<uint8>(cur_range_length);
-      cur_range_length = 0;
+  DCHECK_GE(frame.largest_observed, frame.missing_packets.Max());
+  // A nack range covers at most 256 packets, so longer runs of missing
+  // packets are split into adjacent ranges.
+  const QuicPacketSequenceNumber kMaxRangeLength =
+      numeric_limits<uint8>::max() + 1;
+  QuicPacketSequenceNumber last_missing = 0;
+  for (PacketNumberQueue::const_interval_iterator it =
+           frame.missing_packets.begin_intervals();
+       it != frame.missing_packets.end_intervals(); ++it) {
+    if (it != frame.missing_packets.begin_intervals()) {
+      ack_info.max_delta = max(ack_info.max_delta, it->min - last_missing);
     }
-    ack_info.max_delta = max(ack_info.max_delta, *iter - last_missing);
-    last_missing = *iter;
+    if (it->max - it->min > 1) {
+      ack_info.max_delta = max<QuicPacketSequenceNumber>(ack_info.max_delta, 1);
+    }
+    for (QuicPacketSequenceNumber start = it->min; start < it->max;
+         start += kMaxRangeLength) {
+      ack_info.nack_ranges[start] =
+          static_cast<uint8>(min(it->max - start, kMaxRangeLength) - 1);
+    }
+    last_missing = it->max - 1;
   }
-  // Include the last nack range.
-  ack_info.nack_ranges[last_missing - cur_range_length] =
-      static_cast<uint8>(cur_range_length);
   // Include the range to the largest observed.
   ack_info.max_delta =
       max(ack_info.max_delta, frame.largest_observed - last_missing);
@@ -1352,9 +1354,12 @@ bool QuicFramer::ProcessAckFrame(uint8 frame_type, QuicAckFrame* ack_frame) {
       set_detailed_error("Unable to read missing sequence number range.");
       return false;
     }
-    for (size_t j = 0; j <= range_length; ++j) {
-      ack_frame->missing_packets.insert(last_sequence_number - j);
+    if (range_length >= last_sequence_number) {
+      set_detailed_error("Invalid missing sequence number range.");
+      return false;
     }
+    ack_frame->missing_packets.Add(last_sequence_number - range_length,
+                                   last_sequence_number + 1);
     // Subtract an extra 1 to ensure ranges are represented efficiently and
     // can't overlap by 1 sequence number.  This allows a missing_delta of 0
     // to represent an adjacent nack range.
@@ -1655,6 +1660,37 @@ QuicEncryptedPacket* QuicFramer::EncryptPayload(
       encryption_buffer, header_data.length() + output_length, is_new_buffer);
 }
 
+QuicEncryptedPacket* QuicFramer::EncryptPayloadInPlace(
+    EncryptionLevel level,
+    QuicPacketSequenceNumber packet_sequence_number,
+    const QuicPacket& packet,
+    char* buffer,
+    size_t buffer_len) {
+  DCHECK(encrypter_[level].get() != nullptr);
+  DCHECK_EQ(buffer, packet.data());
+
+  const size_t header_len = packet.BeforePlaintext().length();
+  const size_t total_len =
+      header_len +
+      encrypter_[level]->GetCiphertextSize(packet.Plaintext().length());
+  if (total_len > buffer_len) {
+    LOG(DFATAL) << "Buffer of length:" << buffer_len
+                << " is not large enough to encrypt length " << total_len;
+    return nullptr;
+  }
+  // The header stays where it was built, and the plaintext is encrypted over
+  // itself.
+  size_t output_length = 0;
+  if (!encrypter_[level]->EncryptPacket(
+          packet_sequence_number, packet.AssociatedData(), packet.Plaintext(),
+          buffer + header_len, &output_length, buffer_len - header_len)) {
+    RaiseError(QUIC_ENCRYPTION_FAILURE);
+    return nullptr;
+  }
+
+  return new QuicEncryptedPacket(buffer, header_len + output_length, false);
+}
+
 size_t QuicFramer::GetMaxPlaintextSize(size_t ciphertext_size) {
   // In order to keep the code simple, we don't have the current encryption
   // level to hand. Both the NullEncrypter and AES-GCM have a tag length of 12.
@@ -2045,7 +2081,7 @@ bool QuicFramer::AppendAckFrameAndTypeByte(
 
   SequenceNumberSet::const_iterator iter = frame.revived_packets.begin();
   for (int i = 0; i < num_revived_packets; ++i, ++iter) {
-    LOG_IF(DFATAL, !ContainsKey(frame.missing_packets, *iter));
+    LOG_IF(DFATAL, !frame.missing_packets.Contains(*iter));
     if (!AppendPacketSequenceNumber(largest_observed_length,
                                     *iter, writer)) {
       return false;
@@ -342,6 +342,17 @@ class NET_EXPORT_PRIVATE QuicFramer {
                                       char* buffer,
                                       size_t buffer_len);
 
+  // Encrypts |packet|, which must have been built at the start of |buffer|,
+  // in place, and returns a new encrypted packet, owned by the caller and
+  // pointing into |buffer|, or nullptr if |buffer_len| is too short or
+  // encryption fails.  Unlike EncryptPayload(), the header is not copied.
+  QuicEncryptedPacket* EncryptPayloadInPlace(
+      EncryptionLevel level,
+      QuicPacketSequenceNumber sequence_number,
+      const QuicPacket& packet,
+      char* buffer,
+      size_t buffer_len);
+
   // Returns the maximum length of plaintext that can be encrypted
   // to ciphertext no larger than |ciphertext_size|.
   size_t GetMaxPlaintextSize(size_t ciphertext_size);
@@ -0,0 +1,103 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_packet_buffer_pool.h"
+
+#include "base/logging.h"
+
+namespace net {
+
+QuicPacketBuffer::QuicPacketBuffer(size_t capacity)
+    : data_(new char[capacity]), capacity_(capacity), ref_count_(0) {}
+
+QuicPacketBuffer::~QuicPacketBuffer() {}
+
+void QuicPacketBuffer::AddRef() const {
+  base::AtomicRefCountInc(&ref_count_);
+}
+
+void QuicPacketBuffer::Release() const {
+  if (base::AtomicRefCountDec(&ref_count_)) {
+    return;
+  }
+  // Hold on to the pool until the buffer is back in it; the pool may be
+  // destroyed, along with this buffer, when |pool| goes out of scope.
+  scoped_refptr<QuicPacketBufferPool> pool;
+  pool.swap(pool_);
+  DCHECK(pool.get());
+  pool->Recycle(const_cast<QuicPacketBuffer*>(this));
+}
+
+bool QuicPacketBuffer::HasOneRef() const {
+  return base::AtomicRefCountIsOne(&ref_count_);
+}
+
+QuicPacketBufferPool::QuicPacketBufferPool(size_t buffer_size,
+                                           size_t max_free_buffers)
+    : buffer_size_(buffer_size),
+      max_free_buffers_(max_free_buffers),
+      buffers_allocated_(0),
+      buffers_reused_(0),
+      buffers_in_use_(0) {}
+
+QuicPacketBufferPool::~QuicPacketBufferPool() {
+  DCHECK_EQ(0u, buffers_in_use_);
+  for (QuicPacketBuffer* buffer : free_buffers_) {
+    delete buffer;
+  }
+}
+
+scoped_refptr<QuicPacketBuffer> QuicPacketBufferPool::Allocate() {
+  QuicPacketBuffer* buffer = nullptr;
+  {
+    base::AutoLock locked(lock_);
+    ++buffers_in_use_;
+    if (!free_buffers_.empty()) {
+      buffer = free_buffers_.back();
+      free_buffers_.pop_back();
+      ++buffers_reused_;
+    } else {
+      ++buffers_allocated_;
+    }
+  }
+  if (buffer == nullptr) {
+    buffer = new QuicPacketBuffer(buffer_size_);
+  }
+  buffer->pool_ = this;
+  return make_scoped_refptr(buffer);
+}
+
+uint64 QuicPacketBufferPool::buffers_allocated() const {
+  base::AutoLock locked(lock_);
+  return buffers_allocated_;
+}
+
+uint64 QuicPacketBufferPool::buffers_reused() const {
+  base::AutoLock locked(lock_);
+  return buffers_reused_;
+}
+
+size_t QuicPacketBufferPool::buffers_in_use() const {
+  base::AutoLock locked(lock_);
+  return buffers_in_use_;
+}
+
+size_t QuicPacketBufferPool::free_buffers() const {
+  base::AutoLock locked(lock_);
+  return free_buffers_.size();
+}
+
+void QuicPacketBufferPool::Recycle(QuicPacketBuffer* buffer) {
+  {
+    base::AutoLock locked(lock_);
+    --buffers_in_use_;
+    if (free_buffers_.size() < max_free_buffers_) {
+      free_buffers_.push_back(buffer);
+      return;
+    }
+  }
+  delete buffer;
+}
+
+}  // namespace net
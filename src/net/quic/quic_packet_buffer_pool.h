@@ -0,0 +1,106 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// Reference counted buffers for received packets.  A packet reader reads into
+// a QuicPacketBuffer and wraps it in a QuicEncryptedPacket; anything which
+// needs the packet after it has been processed, such as a connection queueing
+// a packet it cannot decrypt yet, takes another reference with
+// QuicEncryptedPacket::Clone() instead of copying the bytes.  When the last
+// reference goes away the buffer returns to the pool it came from.
+
+#ifndef NET_QUIC_QUIC_PACKET_BUFFER_POOL_H_
+#define NET_QUIC_QUIC_PACKET_BUFFER_POOL_H_
+
+#include <vector>
+
+#include "base/atomic_ref_count.h"
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/synchronization/lock.h"
+#include "net/base/net_export.h"
+
+namespace net {
+
+class QuicPacketBufferPool;
+
+class NET_EXPORT_PRIVATE QuicPacketBuffer {
+ public:
+  char* data() { return data_.get(); }
+  const char* data() const { return data_.get(); }
+  size_t capacity() const { return capacity_; }
+
+  // Buffers may be released on any thread.
+  void AddRef() const;
+  void Release() const;
+
+  // True if the caller holds the only reference, so the buffer may be
+  // overwritten.
+  bool HasOneRef() const;
+
+ private:
+  friend class QuicPacketBufferPool;
+
+  explicit QuicPacketBuffer(size_t capacity);
+  ~QuicPacketBuffer();
+
+  scoped_ptr<char[]> data_;
+  const size_t capacity_;
+  mutable base::AtomicRefCount ref_count_;
+  // The pool the buffer returns to.  Only set while the buffer is in use, so
+  // that a pool is destroyed once it and all of its buffers are released.
+  mutable scoped_refptr<QuicPacketBufferPool> pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicPacketBuffer);
+};
+
+// Hands out buffers of a fixed size and keeps up to |max_free_buffers|
+// released buffers for reuse, so that a reader in steady state does not
+// allocate.  Thread safe.
+class NET_EXPORT_PRIVATE QuicPacketBufferPool
+    : public base::RefCountedThreadSafe<QuicPacketBufferPool> {
+ public:
+  QuicPacketBufferPool(size_t buffer_size, size_t max_free_buffers);
+
+  // Returns a buffer, reusing a released one if there is one.
+  scoped_refptr<QuicPacketBuffer> Allocate();
+
+  size_t buffer_size() const { return buffer_size_; }
+
+  // Number of buffers allocated from the heap.
+  uint64 buffers_allocated() const;
+
+  // Number of times Allocate() handed out a released buffer.
+  uint64 buffers_reused() const;
+
+  // Number of buffers handed out and not yet released.
+  size_t buffers_in_use() const;
+
+  // Number of released buffers waiting to be reused.
+  size_t free_buffers() const;
+
+ private:
+  friend class base::RefCountedThreadSafe<QuicPacketBufferPool>;
+  friend class QuicPacketBuffer;
+
+  ~QuicPacketBufferPool();
+
+  // Called when the last reference to |buffer| is released.
+  void Recycle(QuicPacketBuffer* buffer);
+
+  const size_t buffer_size_;
+  const size_t max_free_buffers_;
+
+  mutable base::Lock lock_;
+  std::vector<QuicPacketBuffer*> free_buffers_;
+  uint64 buffers_allocated_;
+  uint64 buffers_reused_;
+  size_t buffers_in_use_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicPacketBufferPool);
+};
+
+}  // namespace net
+
+#endif  // NET_QUIC_QUIC_PACKET_BUFFER_POOL_H_
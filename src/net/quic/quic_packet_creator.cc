@@ -260,17 +260,18 @@ size_t QuicPacketCreator::StreamFramePacketOverhead(
       QuicFramer::GetMinStreamFrameSize(1u, offset, true, is_in_fec_group);
 }
 
-size_t QuicPacketCreator::CreateStreamFrame(QuicStreamId id,
-                                            const QuicIOVector& iov,
-                                            size_t iov_offset,
-                                            QuicStreamOffset offset,
-                                            bool fin,
-                                            QuicFrame* frame,
-                                            scoped_ptr<char[]>* buffer) {
+size_t QuicPacketCreator::CreateStreamFrame(
+    QuicStreamId id,
+    const QuicIOVector& iov,
+    size_t iov_offset,
+    QuicStreamOffset offset,
+    bool fin,
+    QuicFrame* frame,
+    scoped_refptr<QuicSendBufferSlice>* data) {
   DCHECK_GT(max_packet_length_, StreamFramePacketOverhead(
                 connection_id_length_, kIncludeVersion,
                 PACKET_6BYTE_SEQUENCE_NUMBER, offset, IN_FEC_GROUP));
-  DCHECK(buffer);
+  DCHECK(data);
 
   InFecGroup is_in_fec_group = MaybeUpdateLengthsAndStartFec();
 
@@ -293,10 +294,19 @@ size_t QuicPacketCreator::CreateStreamFrame(QuicStreamId id,
   size_t bytes_consumed = min<size_t>(BytesFree() - min_frame_size, data_size);
 
   bool set_fin = fin && bytes_consumed == data_size;  // Last frame.
-  buffer->reset(new char[bytes_consumed]);
-  CopyToBuffer(iov, iov_offset, bytes_consumed, buffer->get());
+  const char* frame_data;
+  if (iov.slice != nullptr) {
+    DCHECK_EQ(1, iov.iov_count);
+    *data = iov.slice;
+    frame_data = static_cast<const char*>(iov.iov[0].iov_base) + iov_offset;
+  } else {
+    scoped_ptr<char[]> buffer(new char[bytes_consumed]);
+    CopyToBuffer(iov, iov_offset, bytes_consumed, buffer.get());
+    frame_data = buffer.get();
+    *data = new QuicSendBufferSlice(buffer.Pass(), bytes_consumed);
+  }
   *frame = QuicFrame(new QuicStreamFrame(
-      id, set_fin, offset, StringPiece(buffer->get(), bytes_consumed)));
+      id, set_fin, offset, StringPiece(frame_data, bytes_consumed)));
   return bytes_consumed;
 }
 
@@ -417,17 +427,18 @@ bool QuicPacketCreator::AddSavedFrame(const QuicFrame& frame) {
                   /*needs_padding=*/false, nullptr);
 }
 
-bool QuicPacketCreator::AddSavedFrame(const QuicFrame& frame, char* buffer) {
+bool QuicPacketCreator::AddSavedFrame(const QuicFrame& frame,
+                                      QuicSendBufferSlice* data) {
   return AddFrame(frame,
                   /*save_retransmittable_frames=*/true,
-                  /*needs_padding=*/false, buffer);
+                  /*needs_padding=*/false, data);
 }
 
 bool QuicPacketCreator::AddPaddedSavedFrame(const QuicFrame& frame,
-                                            char* buffer) {
+                                            QuicSendBufferSlice* data) {
   return AddFrame(frame,
                   /*save_retransmittable_frames=*/true,
-                  /*needs_padding=*/true, buffer);
+                  /*needs_padding=*/true, data);
 }
 
 SerializedPacket QuicPacketCreator::SerializePacket(
@@ -450,19 +461,20 @@ SerializedPacket QuicPacketCreator::SerializePacket(
   bool possibly_truncated_by_length = packet_size_ == max_plaintext_size_ &&
                                       queued_frames_.size() == 1 &&
                                       queued_frames_.back().type == ACK_FRAME;
-  char buffer[kMaxPacketSize];
-  scoped_ptr<QuicPacket> packet;
+  // A buffer which holds any packet of max_packet_length_ gets the packet
+  // built and encrypted in place, without a plaintext copy.  Smaller buffers,
+  // which only tests pass, get it through a temporary plaintext buffer.
+  const bool encrypt_in_place = max_packet_length_ <= encrypted_buffer_len;
+  scoped_ptr<char[]> plaintext_buffer;
+  char* buffer = encrypted_buffer;
+  if (!encrypt_in_place) {
+    plaintext_buffer.reset(new char[packet_size_]);
+    buffer = plaintext_buffer.get();
+  }
   // Use the packet_size_ instead of the buffer size to ensure smaller
   // packet sizes are properly used.
-  scoped_ptr<char[]> large_buffer;
-  if (packet_size_ <= kMaxPacketSize) {
-    packet.reset(
-        framer_->BuildDataPacket(header, queued_frames_, buffer, packet_size_));
-  } else {
-    large_buffer.reset(new char[packet_size_]);
-    packet.reset(framer_->BuildDataPacket(header, queued_frames_,
-                                          large_buffer.get(), packet_size_));
-  }
+  scoped_ptr<QuicPacket> packet(
+      framer_->BuildDataPacket(header, queued_frames_, buffer, packet_size_));
   if (packet == nullptr) {
     LOG(DFATAL) << "Failed to serialize " << queued_frames_.size()
                 << " frames.";
@@ -479,8 +491,13 @@ SerializedPacket QuicPacketCreator::SerializePacket(
   // Immediately encrypt the packet, to ensure we don't encrypt the same packet
   // sequence number multiple times.
   QuicEncryptedPacket* encrypted =
-      framer_->EncryptPayload(encryption_level_, sequence_number_, *packet,
-                              encrypted_buffer, encrypted_buffer_len);
+      encrypt_in_place
+          ? framer_->EncryptPayloadInPlace(encryption_level_, sequence_number_,
+                                           *packet, encrypted_buffer,
+                                           encrypted_buffer_len)
+          : framer_->EncryptPayload(encryption_level_, sequence_number_,
+                                    *packet, encrypted_buffer,
+                                    encrypted_buffer_len);
   if (encrypted == nullptr) {
     LOG(DFATAL) << "Failed to encrypt packet number " << sequence_number_;
     return NoPacket();
@@ -588,7 +605,7 @@ bool QuicPacketCreator::ShouldRetransmit(const QuicFrame& frame) {
 bool QuicPacketCreator::AddFrame(const QuicFrame& frame,
                                  bool save_retransmittable_frames,
                                  bool needs_padding,
-                                 char* buffer) {
+                                 QuicSendBufferSlice* data) {
   DVLOG(1) << "Adding frame: " << frame;
   InFecGroup is_in_fec_group = MaybeUpdateLengthsAndStartFec();
 
@@ -607,7 +624,7 @@ bool QuicPacketCreator::AddFrame(const QuicFrame& frame,
           new RetransmittableFrames(encryption_level_));
     }
     queued_frames_.push_back(
-        queued_retransmittable_frames_->AddFrame(frame, buffer));
+        queued_retransmittable_frames_->AddFrame(frame, data));
   } else {
     queued_frames_.push_back(frame);
   }
@@ -13,11 +13,13 @@
 #include <utility>
 #include <vector>
 
+#include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/strings/string_piece.h"
 #include "net/quic/quic_fec_group.h"
 #include "net/quic/quic_framer.h"
 #include "net/quic/quic_protocol.h"
+#include "net/quic/quic_send_buffer_slice.h"
 
 namespace net {
 namespace test {
@@ -82,15 +84,16 @@ class NET_EXPORT_PRIVATE QuicPacketCreator {
   // packet.  The payload begins at |iov_offset| into the |iov|.
   // Returns the number of bytes consumed from data.
   // If data is empty and fin is true, the expected behavior is to consume the
-  // fin but return 0.  If any data is consumed, it will be copied into a
-  // new buffer that |frame| will point to and will be stored in |buffer|.
+  // fin but return 0.  If any data is consumed, |frame| points into
+  // |iov.slice|, or, if there is none, into a new slice holding a copy of the
+  // data.  Either way the slice is stored in |data|.
   size_t CreateStreamFrame(QuicStreamId id,
                            const QuicIOVector& iov,
                            size_t iov_offset,
                            QuicStreamOffset offset,
                            bool fin,
                            QuicFrame* frame,
-                           scoped_ptr<char[]>* buffer);
+                           scoped_refptr<QuicSendBufferSlice>* data);
 
   // Serializes all frames into a single packet. All frames must fit into a
   // single packet. Also, sets the entropy hash of the serialized packet to a
@@ -153,13 +156,13 @@ class NET_EXPORT_PRIVATE QuicPacketCreator {
   // Returns false if the frame doesn't fit into the current packet.
   bool AddSavedFrame(const QuicFrame& frame);
 
-  // Identical to AddSavedFrame, but takes ownership of the buffer if it returns
-  // true.
-  bool AddSavedFrame(const QuicFrame& frame, char* buffer);
+  // Identical to AddSavedFrame, but takes a reference to |data|, which holds
+  // the bytes of a stream frame, if it returns true.
+  bool AddSavedFrame(const QuicFrame& frame, QuicSendBufferSlice* data);
 
-  // Identical to AddSavedFrame, but takes ownership of the buffer if it returns
+  // Identical to AddSavedFrame, but takes a reference to |data| if it returns
   // true, and allows to cause the packet to be padded.
-  bool AddPaddedSavedFrame(const QuicFrame& frame, char* buffer);
+  bool AddPaddedSavedFrame(const QuicFrame& frame, QuicSendBufferSlice* data);
 
   // Serializes all frames which have been added and adds any which should be
   // retransmitted to |retransmittable_frames| if it's not nullptr. All frames
@@ -268,7 +271,7 @@ class NET_EXPORT_PRIVATE QuicPacketCreator {
   bool AddFrame(const QuicFrame& frame,
                 bool save_retransmittable_frames,
                 bool needs_padding,
-                char* buffer);
+                QuicSendBufferSlice* data);
 
   // Adds a padding frame to the current packet only if the current packet
   // contains a handshake message, and there is sufficient room to fit a
@@ -168,10 +168,10 @@ QuicConsumedData QuicPacketGenerator::ConsumeData(
   while (delegate_->ShouldGeneratePacket(
       HAS_RETRANSMITTABLE_DATA, has_handshake ? IS_HANDSHAKE : NOT_HANDSHAKE)) {
     QuicFrame frame;
-    scoped_ptr<char[]> buffer;
+    scoped_refptr<QuicSendBufferSlice> data;
     size_t bytes_consumed = packet_creator_.CreateStreamFrame(
         id, iov, total_bytes_consumed, offset + total_bytes_consumed, fin,
-        &frame, &buffer);
+        &frame, &data);
     ++frames_created;
 
     // We want to track which packet this stream frame ends up in.
@@ -179,7 +179,7 @@ QuicConsumedData QuicPacketGenerator::ConsumeData(
       ack_notifiers_.push_back(notifier);
     }
 
-    if (!AddFrame(frame, buffer.get(), has_handshake)) {
+    if (!AddFrame(frame, data.get(), has_handshake)) {
       LOG(DFATAL) << "Failed to add stream frame.";
       // Inability to add a STREAM frame creates an unrecoverable hole in a
       // the stream, so it's best to close the connection.
@@ -187,9 +187,6 @@ QuicConsumedData QuicPacketGenerator::ConsumeData(
       delete notifier;
       return QuicConsumedData(0, false);
     }
-    // When AddFrame succeeds, it takes ownership of the buffer.
-    ignore_result(buffer.release());
-
     total_bytes_consumed += bytes_consumed;
     fin_consumed = fin && total_bytes_consumed == iov.total_length;
     DCHECK(total_bytes_consumed == iov.total_length ||
@@ -442,11 +439,11 @@ bool QuicPacketGenerator::AddNextPendingFrame() {
 }
 
 bool QuicPacketGenerator::AddFrame(const QuicFrame& frame,
-                                   char* buffer,
+                                   QuicSendBufferSlice* data,
                                    bool needs_padding) {
   bool success = needs_padding
-                     ? packet_creator_.AddPaddedSavedFrame(frame, buffer)
-                     : packet_creator_.AddSavedFrame(frame, buffer);
+                     ? packet_creator_.AddPaddedSavedFrame(frame, data)
+                     : packet_creator_.AddSavedFrame(frame, data);
   if (success && debug_delegate_) {
     debug_delegate_->OnFrameAddedToPacket(frame);
   }
@@ -254,7 +254,9 @@ class NET_EXPORT_PRIVATE QuicPacketGenerator {
   bool AddNextPendingFrame();
   // Adds a frame and takes ownership of the underlying buffer if the addition
   // was successful.
-  bool AddFrame(const QuicFrame& frame, char* buffer, bool needs_padding);
+  bool AddFrame(const QuicFrame& frame,
+                QuicSendBufferSlice* data,
+                bool needs_padding);
 
   void SerializeAndSendPacket();
 
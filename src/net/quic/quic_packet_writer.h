@@ -38,6 +38,12 @@ class NET_EXPORT_PRIVATE QuicPacketWriter {
   // Records that the socket has become writable, for example when an EPOLLOUT
   // is received or an asynchronous write completes.
   virtual void SetWritable() = 0;
+
+  // Sends any packets which WritePacket reported as written but held back in
+  // order to send several at once.  Writers which send each packet from
+  // WritePacket return WRITE_STATUS_OK.  If the socket becomes write blocked,
+  // the unsent packets stay buffered and WRITE_STATUS_BLOCKED is returned.
+  virtual WriteResult Flush() = 0;
 };
 
 }  // namespace net
@@ -4,7 +4,11 @@
 
 #include "net/quic/quic_protocol.h"
 
+#include <algorithm>
+
 #include "base/stl_util.h"
+#include "net/quic/quic_packet_buffer_pool.h"
+#include "net/quic/quic_send_buffer_slice.h"
 #include "net/quic/quic_utils.h"
 
 using base::StringPiece;
@@ -219,18 +223,178 @@ ostream& operator<<(ostream& os, const QuicPacketHeader& header) {
   return os;
 }
 
+namespace {
+
+// Orders |sequence_number| before the intervals which end after it.
+bool EndsAfter(QuicPacketSequenceNumber sequence_number,
+               const PacketNumberQueue::Interval& interval) {
+  return sequence_number < interval.max;
+}
+
+// Orders |sequence_number| before the intervals which start after it.
+bool StartsAfter(QuicPacketSequenceNumber sequence_number,
+                 const PacketNumberQueue::Interval& interval) {
+  return sequence_number < interval.min;
+}
+
+}  // namespace
+
+PacketNumberQueue::const_iterator::const_iterator(
+    const_interval_iterator interval,
+    const_interval_iterator end)
+    : interval_(interval),
+      end_(end),
+      current_(interval == end ? 0 : interval->min) {
+}
+
+PacketNumberQueue::const_iterator&
+PacketNumberQueue::const_iterator::operator++() {
+  ++current_;
+  if (current_ == interval_->max) {
+    ++interval_;
+    current_ = interval_ == end_ ? 0 : interval_->min;
+  }
+  return *this;
+}
+
+PacketNumberQueue::PacketNumberQueue() {}
+
+PacketNumberQueue::~PacketNumberQueue() {}
+
+void PacketNumberQueue::Add(QuicPacketSequenceNumber sequence_number) {
+  Add(sequence_number, sequence_number + 1);
+}
+
+void PacketNumberQueue::Add(QuicPacketSequenceNumber lower,
+                            QuicPacketSequenceNumber higher) {
+  if (lower >= higher) {
+    return;
+  }
+  // A receiver adds missing packets above the largest one, and the framer
+  // adds them in decreasing order, so check both ends first.
+  if (intervals_.empty() || lower > intervals_.back().max) {
+    intervals_.push_back(Interval(lower, higher));
+    return;
+  }
+  if (lower == intervals_.back().max) {
+    intervals_.back().max = higher;
+    return;
+  }
+  if (higher < intervals_.front().min) {
+    intervals_.push_front(Interval(lower, higher));
+    return;
+  }
+  if (higher == intervals_.front().min) {
+    intervals_.front().min = lower;
+    return;
+  }
+
+  // Merge with every interval which overlaps or touches [lower, higher).
+  std::deque<Interval>::iterator first =
+      std::upper_bound(intervals_.begin(), intervals_.end(), lower, EndsAfter);
+  if (first != intervals_.begin() && (first - 1)->max == lower) {
+    --first;
+  }
+  std::deque<Interval>::iterator last =
+      std::upper_bound(first, intervals_.end(), higher, StartsAfter);
+  if (first == last) {
+    intervals_.insert(first, Interval(lower, higher));
+    return;
+  }
+  first->min = std::min(first->min, lower);
+  first->max = std::max((last - 1)->max, higher);
+  intervals_.erase(first + 1, last);
+}
+
+bool PacketNumberQueue::Remove(QuicPacketSequenceNumber sequence_number) {
+  std::deque<Interval>::iterator it = std::upper_bound(
+      intervals_.begin(), intervals_.end(), sequence_number, EndsAfter);
+  if (it == intervals_.end() || it->min > sequence_number) {
+    return false;
+  }
+  if (it->min == sequence_number) {
+    ++it->min;
+    if (it->min == it->max) {
+      intervals_.erase(it);
+    }
+  } else if (it->max == sequence_number + 1) {
+    --it->max;
+  } else {
+    // Split the interval around |sequence_number|.
+    QuicPacketSequenceNumber max = it->max;
+    it->max = sequence_number;
+    intervals_.insert(it + 1, Interval(sequence_number + 1, max));
+  }
+  return true;
+}
+
+bool PacketNumberQueue::RemoveUpTo(QuicPacketSequenceNumber higher) {
+  bool removed = false;
+  while (!intervals_.empty() && intervals_.front().min < higher) {
+    removed = true;
+    if (intervals_.front().max > higher) {
+      intervals_.front().min = higher;
+      break;
+    }
+    intervals_.pop_front();
+  }
+  return removed;
+}
+
+bool PacketNumberQueue::Contains(
+    QuicPacketSequenceNumber sequence_number) const {
+  const_interval_iterator it = std::upper_bound(
+      intervals_.begin(), intervals_.end(), sequence_number, EndsAfter);
+  return it != intervals_.end() && it->min <= sequence_number;
+}
+
+QuicPacketSequenceNumber PacketNumberQueue::Min() const {
+  DCHECK(!Empty());
+  return intervals_.front().min;
+}
+
+QuicPacketSequenceNumber PacketNumberQueue::Max() const {
+  DCHECK(!Empty());
+  return intervals_.back().max - 1;
+}
+
+size_t PacketNumberQueue::NumPackets() const {
+  size_t num_packets = 0;
+  for (const Interval& interval : intervals_) {
+    num_packets += interval.max - interval.min;
+  }
+  return num_packets;
+}
+
+PacketNumberQueue::const_iterator PacketNumberQueue::begin() const {
+  return const_iterator(intervals_.begin(), intervals_.end());
+}
+
+PacketNumberQueue::const_iterator PacketNumberQueue::end() const {
+  return const_iterator(intervals_.end(), intervals_.end());
+}
+
+ostream& operator<<(ostream& os, const PacketNumberQueue& q) {
+  for (const PacketNumberQueue::Interval& interval : q.intervals_) {
+    if (interval.max - interval.min == 1) {
+      os << interval.min << " ";
+    } else {
+      os << interval.min << "..." << interval.max - 1 << " ";
+    }
+  }
+  return os;
+}
+
 bool IsAwaitingPacket(const QuicAckFrame& ack_frame,
                       QuicPacketSequenceNumber sequence_number) {
   return sequence_number > ack_frame.largest_observed ||
-      ContainsKey(ack_frame.missing_packets, sequence_number);
+      ack_frame.missing_packets.Contains(sequence_number);
 }
 
 void InsertMissingPacketsBetween(QuicAckFrame* ack_frame,
                                  QuicPacketSequenceNumber lower,
                                  QuicPacketSequenceNumber higher) {
-  for (QuicPacketSequenceNumber i = lower; i < higher; ++i) {
-    ack_frame->missing_packets.insert(i);
-  }
+  ack_frame->missing_packets.Add(lower, higher);
 }
 
 QuicStopWaitingFrame::QuicStopWaitingFrame()
@@ -339,12 +503,8 @@ ostream& operator<<(ostream& os, const QuicAckFrame& ack_frame) {
      << " largest_observed: " << ack_frame.largest_observed
      << " delta_time_largest_observed: "
      << ack_frame.delta_time_largest_observed.ToMicroseconds()
-     << " missing_packets: [ ";
-  for (SequenceNumberSet::const_iterator it = ack_frame.missing_packets.begin();
-       it != ack_frame.missing_packets.end(); ++it) {
-    os << *it << " ";
-  }
-  os << " ] is_truncated: " << ack_frame.is_truncated;
+     << " missing_packets: [ " << ack_frame.missing_packets
+     << " ] is_truncated: " << ack_frame.is_truncated;
   os << " revived_packets: [ ";
   for (SequenceNumberSet::const_iterator it = ack_frame.revived_packets.begin();
        it != ack_frame.revived_packets.end(); ++it) {
@@ -524,6 +684,15 @@ QuicEncryptedPacket::QuicEncryptedPacket(char* buffer,
       : QuicData(buffer, length, owns_buffer) {
 }
 
+QuicEncryptedPacket::QuicEncryptedPacket(QuicPacketBuffer* packet_buffer,
+                                         size_t length)
+    : QuicData(packet_buffer->data(), length),
+      packet_buffer_(packet_buffer) {
+  DCHECK_LE(length, packet_buffer->capacity());
+}
+
+QuicEncryptedPacket::~QuicEncryptedPacket() {}
+
 StringPiece QuicPacket::FecProtectedData() const {
   const size_t start_of_fec = GetStartOfFecProtectedData(
       connection_id_length_, includes_version_, sequence_number_length_);
@@ -598,9 +767,6 @@ RetransmittableFrames::~RetransmittableFrames() {
         DCHECK(false) << "Cannot delete type: " << it->type;
     }
   }
-  for (const char* buffer : stream_data_) {
-    delete[] buffer;
-  }
 }
 
 const QuicFrame& RetransmittableFrames::AddFrame(const QuicFrame& frame) {
@@ -608,13 +774,15 @@ const QuicFrame& RetransmittableFrames::AddFrame(const QuicFrame& frame) {
 }
 
 const QuicFrame& RetransmittableFrames::AddFrame(const QuicFrame& frame,
-                                                 char* buffer) {
+                                                 QuicSendBufferSlice* data) {
   if (frame.type == STREAM_FRAME &&
       frame.stream_frame->stream_id == kCryptoStreamId) {
     has_crypto_handshake_ = IS_HANDSHAKE;
   }
-  if (buffer != nullptr) {
-    stream_data_.push_back(buffer);
+  // Consecutive frames usually come from the same slice.
+  if (data != nullptr &&
+      (stream_data_.empty() || stream_data_.back().get() != data)) {
+    stream_data_.push_back(data);
   }
   frames_.push_back(frame);
   return frames_.back();
@@ -649,6 +817,9 @@ SerializedPacket::SerializedPacket(
 SerializedPacket::~SerializedPacket() {}
 
 QuicEncryptedPacket* QuicEncryptedPacket::Clone() const {
+  if (packet_buffer_.get() != nullptr) {
+    return new QuicEncryptedPacket(packet_buffer_.get(), this->length());
+  }
   char* buffer = new char[this->length()];
   memcpy(buffer, this->data(), this->length());
   return new QuicEncryptedPacket(buffer, this->length(), true);
@@ -7,6 +7,8 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <deque>
+#include <iterator>
 #include <limits>
 #include <list>
 #include <map>
@@ -19,6 +21,7 @@
 #include "base/basictypes.h"
 #include "base/containers/hash_tables.h"
 #include "base/logging.h"
+#include "base/memory/ref_counted.h"
 #include "base/strings/string_piece.h"
 #include "net/base/int128.h"
 #include "net/base/iovec.h"
@@ -32,6 +35,8 @@ namespace net {
 
 class QuicAckNotifier;
 class QuicPacket;
+class QuicPacketBuffer;
+class QuicSendBufferSlice;
 struct QuicPacketHeader;
 
 typedef uint64 QuicConnectionId;
@@ -707,6 +712,90 @@ struct NET_EXPORT_PRIVATE QuicStreamFrame {
 typedef std::set<QuicPacketSequenceNumber> SequenceNumberSet;
 typedef std::list<QuicPacketSequenceNumber> SequenceNumberList;
 
+// A sorted set of packet sequence numbers, stored as disjoint ranges.  Packets
+// go missing in runs and are removed mostly from the low end, so under heavy
+// loss this is far smaller and cheaper to update than a SequenceNumberSet.
+class NET_EXPORT_PRIVATE PacketNumberQueue {
+ public:
+  // The sequence numbers in [min, max).
+  struct Interval {
+    Interval(QuicPacketSequenceNumber min, QuicPacketSequenceNumber max)
+        : min(min), max(max) {}
+
+    QuicPacketSequenceNumber min;
+    QuicPacketSequenceNumber max;
+  };
+  typedef std::deque<Interval>::const_iterator const_interval_iterator;
+
+  // Iterates over the individual sequence numbers in increasing order.
+  class NET_EXPORT_PRIVATE const_iterator
+      : public std::iterator<std::forward_iterator_tag,
+                             QuicPacketSequenceNumber> {
+   public:
+    const_iterator(const_interval_iterator interval,
+                   const_interval_iterator end);
+
+    QuicPacketSequenceNumber operator*() const { return current_; }
+    const_iterator& operator++();
+    bool operator==(const const_iterator& other) const {
+      return interval_ == other.interval_ && current_ == other.current_;
+    }
+    bool operator!=(const const_iterator& other) const {
+      return !(*this == other);
+    }
+
+   private:
+    const_interval_iterator interval_;
+    const_interval_iterator end_;
+    QuicPacketSequenceNumber current_;
+  };
+
+  PacketNumberQueue();
+  ~PacketNumberQueue();
+
+  // Adds |sequence_number|.
+  void Add(QuicPacketSequenceNumber sequence_number);
+
+  // Adds the sequence numbers in [lower, higher).
+  void Add(QuicPacketSequenceNumber lower, QuicPacketSequenceNumber higher);
+
+  // Removes |sequence_number|.  Returns false if it was not in the queue.
+  bool Remove(QuicPacketSequenceNumber sequence_number);
+
+  // Removes all sequence numbers less than |higher|.  Returns true if any
+  // were removed.
+  bool RemoveUpTo(QuicPacketSequenceNumber higher);
+
+  bool Contains(QuicPacketSequenceNumber sequence_number) const;
+
+  bool Empty() const { return intervals_.empty(); }
+
+  // The smallest and largest sequence numbers.  The queue must not be empty.
+  QuicPacketSequenceNumber Min() const;
+  QuicPacketSequenceNumber Max() const;
+
+  // The number of sequence numbers, which takes time linear in the number of
+  // intervals.
+  size_t NumPackets() const;
+
+  size_t NumIntervals() const { return intervals_.size(); }
+
+  const_iterator begin() const;
+  const_iterator end() const;
+
+  const_interval_iterator begin_intervals() const {
+    return intervals_.begin();
+  }
+  const_interval_iterator end_intervals() const { return intervals_.end(); }
+
+  NET_EXPORT_PRIVATE friend std::ostream& operator<<(
+      std::ostream& os, const PacketNumberQueue& q);
+
+ private:
+  // Sorted, and neither overlapping nor adjacent.
+  std::deque<Interval> intervals_;
+};
+
 typedef std::list<
     std::pair<QuicPacketSequenceNumber, QuicTime> > PacketTimeList;
 
@@ -748,10 +837,8 @@ struct NET_EXPORT_PRIVATE QuicAckFrame {
   // sent.
   QuicTime::Delta delta_time_largest_observed;
 
-  // TODO(satyamshekhar): Can be optimized using an interval set like data
-  // structure.
   // The set of packets which we're expecting and have not received.
-  SequenceNumberSet missing_packets;
+  PacketNumberQueue missing_packets;
 
   // Whether the ack had to be truncated when sent.
   bool is_truncated;
@@ -987,10 +1074,19 @@ class NET_EXPORT_PRIVATE QuicEncryptedPacket : public QuicData {
  public:
   QuicEncryptedPacket(const char* buffer, size_t length);
   QuicEncryptedPacket(char* buffer, size_t length, bool owns_buffer);
-
-  // Clones the packet into a new packet which owns the buffer.
+  // The packet is the first |length| bytes of |packet_buffer|, and holds a
+  // reference to it.
+  QuicEncryptedPacket(QuicPacketBuffer* packet_buffer, size_t length);
+  ~QuicEncryptedPacket() override;
+
+  // Clones the packet into a new packet which owns the buffer.  If the packet
+  // is in a QuicPacketBuffer, the clone shares the buffer instead of copying
+  // it.
   QuicEncryptedPacket* Clone() const;
 
+  // The buffer holding the packet, or null if it is not reference counted.
+  QuicPacketBuffer* packet_buffer() const { return packet_buffer_.get(); }
+
   // By default, gtest prints the raw bytes of an object. The bool data
   // member (in the base class QuicData) causes this object to have padding
   // bytes, which causes the default gtest object printer to read
@@ -999,6 +1095,8 @@ class NET_EXPORT_PRIVATE QuicEncryptedPacket : public QuicData {
       std::ostream& os, const QuicEncryptedPacket& s);
 
  private:
+  scoped_refptr<QuicPacketBuffer> packet_buffer_;
+
   DISALLOW_COPY_AND_ASSIGN(QuicEncryptedPacket);
 };
 
@@ -1009,8 +1107,9 @@ class NET_EXPORT_PRIVATE RetransmittableFrames {
 
   // Takes ownership of the frame inside |frame|.
   const QuicFrame& AddFrame(const QuicFrame& frame);
-  // Takes ownership of the frame inside |frame| and |buffer|.
-  const QuicFrame& AddFrame(const QuicFrame& frame, char* buffer);
+  // Takes ownership of the frame inside |frame|, and a reference to |data|,
+  // which holds the bytes of a stream frame.
+  const QuicFrame& AddFrame(const QuicFrame& frame, QuicSendBufferSlice* data);
   // Removes all stream frames associated with |stream_id|.
   void RemoveFramesForStream(QuicStreamId stream_id);
 
@@ -1034,7 +1133,7 @@ class NET_EXPORT_PRIVATE RetransmittableFrames {
   IsHandshake has_crypto_handshake_;
   bool needs_padding_;
   // Data referenced by the StringPiece of a QuicStreamFrame.
-  std::vector<const char*> stream_data_;
+  std::vector<scoped_refptr<QuicSendBufferSlice>> stream_data_;
 
   DISALLOW_COPY_AND_ASSIGN(RetransmittableFrames);
 };
@@ -1093,11 +1192,21 @@ struct NET_EXPORT_PRIVATE TransmissionInfo {
 // be less than or equal to the actual total length of the iovecs.
 struct NET_EXPORT_PRIVATE QuicIOVector {
   QuicIOVector(const struct iovec* iov, int iov_count, size_t total_length)
-      : iov(iov), iov_count(iov_count), total_length(total_length) {}
+      : iov(iov), iov_count(iov_count), total_length(total_length),
+        slice(nullptr) {}
+
+  // |iov| is a single iovec pointing into |slice|, which stream frames may
+  // reference instead of copying.
+  QuicIOVector(const struct iovec* iov,
+               size_t total_length,
+               QuicSendBufferSlice* slice)
+      : iov(iov), iov_count(1), total_length(total_length), slice(slice) {}
 
   const struct iovec* iov;
   const int iov_count;
   const size_t total_length;
+  // Owner of the data, or null if it must be copied.
+  QuicSendBufferSlice* const slice;
 };
 
 }  // namespace net
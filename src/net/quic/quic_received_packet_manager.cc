@@ -157,7 +157,7 @@ void QuicReceivedPacketManager::RecordPacketReceived(
     // We've gotten one of the out of order packets - remove it from our
     // "missing packets" list.
     DVLOG(1) << "Removing " << sequence_number << " from missing list";
-    ack_frame_.missing_packets.erase(sequence_number);
+    ack_frame_.missing_packets.Remove(sequence_number);
 
     // Record how out of order stats.
     ++stats_->packets_reordered;
@@ -190,7 +190,7 @@ void QuicReceivedPacketManager::RecordPacketRevived(
 
 bool QuicReceivedPacketManager::IsMissing(
     QuicPacketSequenceNumber sequence_number) {
-  return ContainsKey(ack_frame_.missing_packets, sequence_number);
+  return ack_frame_.missing_packets.Contains(sequence_number);
 }
 
 bool QuicReceivedPacketManager::IsAwaitingPacket(
@@ -246,11 +246,7 @@ bool QuicReceivedPacketManager::DontWaitForPacketsBefore(
   ack_frame_.revived_packets.erase(
       ack_frame_.revived_packets.begin(),
       ack_frame_.revived_packets.lower_bound(least_unacked));
-  size_t missing_packets_count = ack_frame_.missing_packets.size();
-  ack_frame_.missing_packets.erase(
-      ack_frame_.missing_packets.begin(),
-      ack_frame_.missing_packets.lower_bound(least_unacked));
-  return missing_packets_count != ack_frame_.missing_packets.size();
+  return ack_frame_.missing_packets.RemoveUpTo(least_unacked);
 }
 
 void QuicReceivedPacketManager::UpdatePacketInformationSentByPeer(
@@ -268,15 +264,15 @@ void QuicReceivedPacketManager::UpdatePacketInformationSentByPeer(
     }
     peer_least_packet_awaiting_ack_ = stop_waiting.least_unacked;
   }
-  DCHECK(ack_frame_.missing_packets.empty() ||
-         *ack_frame_.missing_packets.begin() >=
+  DCHECK(ack_frame_.missing_packets.Empty() ||
+         ack_frame_.missing_packets.Min() >=
              peer_least_packet_awaiting_ack_);
 }
 
 bool QuicReceivedPacketManager::HasNewMissingPackets() const {
-  return !ack_frame_.missing_packets.empty() &&
+  return !ack_frame_.missing_packets.Empty() &&
       (ack_frame_.largest_observed -
-       *ack_frame_.missing_packets.rbegin()) <= kMaxPacketsAfterNewMissing;
+       ack_frame_.missing_packets.Max()) <= kMaxPacketsAfterNewMissing;
 }
 
 size_t QuicReceivedPacketManager::NumTrackedPackets() const {
@@ -0,0 +1,27 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_send_buffer_slice.h"
+
+#include <string.h>
+
+namespace net {
+
+QuicSendBufferSlice::QuicSendBufferSlice(base::StringPiece data)
+    : buffer_(new char[data.size()]),
+      data_(buffer_.get()),
+      length_(data.size()) {
+  memcpy(buffer_.get(), data.data(), data.size());
+}
+
+QuicSendBufferSlice::QuicSendBufferSlice(scoped_ptr<char[]> buffer,
+                                         size_t length)
+    : buffer_(buffer.Pass()), data_(buffer_.get()), length_(length) {}
+
+QuicSendBufferSlice::QuicSendBufferSlice(const char* data, size_t length)
+    : data_(data), length_(length) {}
+
+QuicSendBufferSlice::~QuicSendBufferSlice() {}
+
+}  // namespace net
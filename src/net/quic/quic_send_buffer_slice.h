@@ -0,0 +1,64 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// A QuicSendBufferSlice holds bytes a stream has written, from the time the
+// stream queues them until the peer has acked every packet carrying them.
+// The stream frames built from a slice, and the retransmissions of those
+// frames, point into it rather than copying it, so the bytes are stored once
+// however often they are sent.  Each RetransmittableFrames holding such a
+// frame holds a reference, so the slice is released once all of them have
+// been acked or discarded.  A single packet left unacked therefore holds its
+// whole slice, so streams cut what they write into slices of at most
+// kMaxSendBufferSliceSize bytes.
+
+#ifndef NET_QUIC_QUIC_SEND_BUFFER_SLICE_H_
+#define NET_QUIC_QUIC_SEND_BUFFER_SLICE_H_
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_piece.h"
+#include "net/base/net_export.h"
+
+namespace net {
+
+// The most bytes a stream puts in one slice.  A multiple of the page size, so
+// that a mapped file can be cut into slices which each unmap their own pages.
+const size_t kMaxSendBufferSliceSize = 64 * 1024;
+
+class NET_EXPORT_PRIVATE QuicSendBufferSlice
+    : public base::RefCounted<QuicSendBufferSlice> {
+ public:
+  // Copies |data|.
+  explicit QuicSendBufferSlice(base::StringPiece data);
+
+  // Takes ownership of the |length| bytes in |buffer|.
+  QuicSendBufferSlice(scoped_ptr<char[]> buffer, size_t length);
+
+  const char* data() const { return data_; }
+  size_t length() const { return length_; }
+
+ protected:
+  friend class base::RefCounted<QuicSendBufferSlice>;
+
+  // For subclasses which keep |data| alive some other way, such as a mapped
+  // file, until they are destroyed.
+  QuicSendBufferSlice(const char* data, size_t length);
+  virtual ~QuicSendBufferSlice();
+
+ private:
+  scoped_ptr<char[]> buffer_;
+  const char* data_;
+  const size_t length_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicSendBufferSlice);
+};
+
+typedef std::vector<scoped_refptr<QuicSendBufferSlice>> QuicSendBufferSlices;
+
+}  // namespace net
+
+#endif  // NET_QUIC_QUIC_SEND_BUFFER_SLICE_H_
@@ -66,15 +66,15 @@ QuicPacketEntropyHash QuicSentEntropyManager::GetCumulativeEntropy(
 
 bool QuicSentEntropyManager::IsValidEntropy(
     QuicPacketSequenceNumber largest_observed,
-    const SequenceNumberSet& missing_packets,
+    const PacketNumberQueue& missing_packets,
     QuicPacketEntropyHash entropy_hash) {
   DCHECK_GE(largest_observed, last_valid_entropy_.sequence_number);
   // Ensure the largest and smallest sequence numbers are in range.
   if (largest_observed > GetLargestPacketWithEntropy()) {
     return false;
   }
-  if (!missing_packets.empty() &&
-      *missing_packets.begin() < GetSmallestPacketWithEntropy()) {
+  if (!missing_packets.Empty() &&
+      missing_packets.Min() < GetSmallestPacketWithEntropy()) {
     return false;
   }
   // First the entropy for largest_observed sequence number should be updated.
@@ -82,9 +82,8 @@ bool QuicSentEntropyManager::IsValidEntropy(
 
   // Now XOR out all the missing entropies.
   QuicPacketEntropyHash expected_entropy_hash = last_valid_entropy_.entropy;
-  for (SequenceNumberSet::const_iterator it = missing_packets.begin();
-       it != missing_packets.end(); ++it) {
-    expected_entropy_hash ^= GetPacketEntropy(*it);
+  for (QuicPacketSequenceNumber sequence_number : missing_packets) {
+    expected_entropy_hash ^= GetPacketEntropy(sequence_number);
   }
   DLOG_IF(WARNING, entropy_hash != expected_entropy_hash)
       << "Invalid entropy hash: " << static_cast<int>(entropy_hash)
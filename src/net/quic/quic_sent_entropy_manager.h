@@ -42,7 +42,7 @@ class NET_EXPORT_PRIVATE QuicSentEntropyManager {
   // up to |largest_observed| removing sequence numbers from |missing_packets|.
   // Must always be called with a monotonically increasing |largest_observed|.
   bool IsValidEntropy(QuicPacketSequenceNumber largest_observed,
-                      const SequenceNumberSet& missing_packets,
+                      const PacketNumberQueue& missing_packets,
                       QuicPacketEntropyHash entropy_hash);
 
   // Removes unnecessary entries before |sequence_number|.
@@ -66,6 +66,7 @@ bool HasCryptoHandshake(const TransmissionInfo& transmission_info) {
 QuicSentPacketManager::QuicSentPacketManager(
     Perspective perspective,
     const QuicClock* clock,
+    QuicRandom* random,
     QuicConnectionStats* stats,
     CongestionControlType congestion_control_type,
     LossDetectionType loss_type,
@@ -73,6 +74,7 @@ QuicSentPacketManager::QuicSentPacketManager(
     : unacked_packets_(&ack_notifier_manager_),
       perspective_(perspective),
       clock_(clock),
+      random_(random),
       stats_(stats),
       debug_delegate_(nullptr),
       network_change_visitor_(nullptr),
@@ -82,6 +84,7 @@ QuicSentPacketManager::QuicSentPacketManager(
           SendAlgorithmInterface::Create(clock,
                                          &rtt_stats_,
                                          congestion_control_type,
+                                         random,
                                          stats,
                                          initial_congestion_window_)),
       loss_algorithm_(LossDetectionInterface::Create(loss_type)),
@@ -129,21 +132,25 @@ void QuicSentPacketManager::SetFromConfig(const QuicConfig& config) {
           QuicTime::Delta::FromSeconds(FLAGS_quic_recent_min_rtt_window_s));
     }
     send_algorithm_.reset(SendAlgorithmInterface::Create(
-        clock_, &rtt_stats_, kBBR, stats_, initial_congestion_window_));
+        clock_, &rtt_stats_, kBBR, random_, stats_,
+        initial_congestion_window_));
   }
   if (config.HasReceivedConnectionOptions() &&
       ContainsQuicTag(config.ReceivedConnectionOptions(), kRENO)) {
     if (ContainsQuicTag(config.ReceivedConnectionOptions(), kBYTE)) {
       send_algorithm_.reset(SendAlgorithmInterface::Create(
-          clock_, &rtt_stats_, kRenoBytes, stats_, initial_congestion_window_));
+          clock_, &rtt_stats_, kRenoBytes, random_, stats_,
+          initial_congestion_window_));
     } else {
       send_algorithm_.reset(SendAlgorithmInterface::Create(
-          clock_, &rtt_stats_, kReno, stats_, initial_congestion_window_));
+          clock_, &rtt_stats_, kReno, random_, stats_,
+          initial_congestion_window_));
     }
   } else if (config.HasReceivedConnectionOptions() &&
              ContainsQuicTag(config.ReceivedConnectionOptions(), kBYTE)) {
     send_algorithm_.reset(SendAlgorithmInterface::Create(
-        clock_, &rtt_stats_, kCubicBytes, stats_, initial_congestion_window_));
+        clock_, &rtt_stats_, kCubicBytes, random_, stats_,
+        initial_congestion_window_));
   }
   //jkhoury -- to disable pacing comment line below
   EnablePacing();
@@ -222,7 +229,8 @@ void QuicSentPacketManager::OnIncomingAck(const QuicAckFrame& ack_frame,
   if (consecutive_rto_count_ > 0 && !use_new_rto_) {
     packets_lost_.clear();
   }
-  MaybeInvokeCongestionEvent(rtt_updated, bytes_in_flight);
+  MaybeInvokeCongestionEvent(QuicTraceEvent::ACK, ack_receive_time,
+                             rtt_updated, bytes_in_flight);
   unacked_packets_.RemoveObsoletePackets();
 
   sustained_bandwidth_recorder_.RecordEstimate(
@@ -232,9 +240,6 @@ void QuicSentPacketManager::OnIncomingAck(const QuicAckFrame& ack_frame,
       ack_receive_time,
       clock_->WallNow(),
       rtt_stats_.smoothed_rtt());
-    
-   // ----------- added by jkhoury --------
-  send_algorithm_->PrintMyStats(ack_receive_time);
 
   // If we have received a truncated ack, then we need to clear out some
   // previous transmissions to allow the peer to actually ACK new packets.
@@ -273,20 +278,27 @@ void QuicSentPacketManager::OnIncomingAck(const QuicAckFrame& ack_frame,
 
 void QuicSentPacketManager::UpdatePacketInformationReceivedByPeer(
     const QuicAckFrame& ack_frame) {
-  if (ack_frame.missing_packets.empty()) {
+  if (ack_frame.missing_packets.Empty()) {
     least_packet_awaited_by_peer_ = ack_frame.largest_observed + 1;
   } else {
-    least_packet_awaited_by_peer_ = *(ack_frame.missing_packets.begin());
+    least_packet_awaited_by_peer_ = ack_frame.missing_packets.Min();
   }
 }
 
 void QuicSentPacketManager::MaybeInvokeCongestionEvent(
-    bool rtt_updated, QuicByteCount bytes_in_flight) {
+    QuicTraceEvent::Type cause,
+    QuicTime event_time,
+    bool rtt_updated,
+    QuicByteCount bytes_in_flight) {
   if (!rtt_updated && packets_acked_.empty() && packets_lost_.empty()) {
     return;
   }
   send_algorithm_->OnCongestionEvent(rtt_updated, bytes_in_flight,
                                      packets_acked_, packets_lost_);
+  if (trace_ != nullptr) {
+    RecordTraceEvent(cause, event_time, packets_acked_.size(),
+                     packets_lost_.size());
+  }
   packets_acked_.clear();
   packets_lost_.clear();
   if (network_change_visitor_ != nullptr) {
@@ -301,6 +313,9 @@ void QuicSentPacketManager::HandleAckForSentPackets(
   QuicTime::Delta delta_largest_observed =
       ack_frame.delta_time_largest_observed;
   QuicPacketSequenceNumber sequence_number = unacked_packets_.GetLeastUnacked();
+  // Walk the missing ranges alongside the unacked packets.
+  PacketNumberQueue::const_interval_iterator missing_it =
+      ack_frame.missing_packets.begin_intervals();
   for (QuicUnackedPacketMap::const_iterator it = unacked_packets_.begin();
        it != unacked_packets_.end(); ++it, ++sequence_number) {
     if (sequence_number > ack_frame.largest_observed) {
@@ -308,7 +323,12 @@ void QuicSentPacketManager::HandleAckForSentPackets(
       break;
     }
 
-    if (ContainsKey(ack_frame.missing_packets, sequence_number)) {
+    while (missing_it != ack_frame.missing_packets.end_intervals() &&
+           missing_it->max <= sequence_number) {
+      ++missing_it;
+    }
+    if (missing_it != ack_frame.missing_packets.end_intervals() &&
+        missing_it->min <= sequence_number) {
       // Don't continue to increase the nack count for packets not in flight.
       if (!it->in_flight) {
         continue;
@@ -603,8 +623,10 @@ void QuicSentPacketManager::OnRetransmissionTimeout() {
     case LOSS_MODE: {
       ++stats_->loss_timeout_count;
       QuicByteCount bytes_in_flight = unacked_packets_.bytes_in_flight();
-      InvokeLossDetection(clock_->Now());
-      MaybeInvokeCongestionEvent(false, bytes_in_flight);
+      const QuicTime now = clock_->Now();
+      InvokeLossDetection(now);
+      MaybeInvokeCongestionEvent(QuicTraceEvent::LOSS_TIMEOUT, now, false,
+                                 bytes_in_flight);
       return;
     }
     case TLP_MODE:
@@ -613,12 +635,20 @@ void QuicSentPacketManager::OnRetransmissionTimeout() {
       ++stats_->tlp_count;
       ++consecutive_tlp_count_;
       pending_timer_transmission_count_ = 1;
+      if (trace_ != nullptr) {
+        RecordTraceEvent(QuicTraceEvent::TAIL_LOSS_PROBE,
+                         clock_->ApproximateNow(), 0, 0);
+      }
       // TLPs prefer sending new data instead of retransmitting data, so
       // give the connection a chance to write before completing the TLP.
       return;
     case RTO_MODE:
       ++stats_->rto_count;
       RetransmitRtoPackets();
+      if (trace_ != nullptr) {
+        RecordTraceEvent(QuicTraceEvent::RETRANSMISSION_TIMEOUT,
+                         clock_->ApproximateNow(), 0, 0);
+      }
       return;
   }
 }
@@ -954,4 +984,39 @@ void QuicSentPacketManager::EnablePacing() {
                        kInitialUnpacedBurst));
 }
 
+void QuicSentPacketManager::EnableTrace(size_t num_events) {
+  trace_.reset(new QuicConnectionTrace(num_events));
+}
+
+void QuicSentPacketManager::DisableTrace() {
+  trace_.reset();
+}
+
+void QuicSentPacketManager::RecordTraceEvent(QuicTraceEvent::Type type,
+                                             QuicTime event_time,
+                                             size_t packets_acked,
+                                             size_t packets_lost) {
+  QuicTraceEvent* event = trace_->AddEvent();
+  event->time_us = event_time.ToDebuggingValue();
+  event->type = type;
+  event->flags = 0;
+  if (send_algorithm_->InSlowStart()) {
+    event->flags |= QuicTraceEvent::IN_SLOW_START;
+  }
+  if (send_algorithm_->InRecovery()) {
+    event->flags |= QuicTraceEvent::IN_RECOVERY;
+  }
+  event->congestion_window = send_algorithm_->GetCongestionWindow();
+  event->slow_start_threshold = send_algorithm_->GetSlowStartThreshold();
+  event->bytes_in_flight = unacked_packets_.bytes_in_flight();
+  event->smoothed_rtt_us = rtt_stats_.smoothed_rtt().ToMicroseconds();
+  event->min_rtt_us = rtt_stats_.min_rtt().ToMicroseconds();
+  event->pacing_rate_bytes_per_second =
+      send_algorithm_->PacingRate().ToBytesPerSecond();
+  event->bandwidth_estimate_bytes_per_second =
+      send_algorithm_->BandwidthEstimate().ToBytesPerSecond();
+  event->packets_acked = static_cast<uint32>(packets_acked);
+  event->packets_lost = static_cast<uint32>(packets_lost);
+}
+
 }  // namespace net
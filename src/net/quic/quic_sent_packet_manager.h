@@ -17,6 +17,7 @@
 #include "net/quic/congestion_control/rtt_stats.h"
 #include "net/quic/congestion_control/send_algorithm_interface.h"
 #include "net/quic/quic_ack_notifier_manager.h"
+#include "net/quic/quic_connection_trace.h"
 #include "net/quic/quic_protocol.h"
 #include "net/quic/quic_sustained_bandwidth_recorder.h"
 #include "net/quic/quic_unacked_packet_map.h"
@@ -30,6 +31,7 @@ class QuicSentPacketManagerPeer;
 
 class QuicClock;
 class QuicConfig;
+class QuicRandom;
 struct QuicConnectionStats;
 
 // Class which tracks the set of packets sent on a QUIC connection and contains
@@ -94,6 +96,7 @@ class NET_EXPORT_PRIVATE QuicSentPacketManager {
 
   QuicSentPacketManager(Perspective perspective,
                         const QuicClock* clock,
+                        QuicRandom* random,
                         QuicConnectionStats* stats,
                         CongestionControlType congestion_control_type,
                         LossDetectionType loss_type,
@@ -223,6 +226,14 @@ class NET_EXPORT_PRIVATE QuicSentPacketManager {
     debug_delegate_ = debug_delegate;
   }
 
+  // Records the last |num_events| congestion control events in a trace,
+  // replacing any trace kept so far.
+  void EnableTrace(size_t num_events);
+  void DisableTrace();
+
+  // The trace of congestion control events, or null if tracing is disabled.
+  const QuicConnectionTrace* trace() const { return trace_.get(); }
+
   QuicPacketSequenceNumber largest_observed() const {
     return unacked_packets_.largest_observed();
   }
@@ -305,10 +316,19 @@ class NET_EXPORT_PRIVATE QuicSentPacketManager {
   // Invokes OnCongestionEvent if |rtt_updated| is true, there are pending acks,
   // or pending losses.  Clears pending acks and pending losses afterwards.
   // |bytes_in_flight| is the number of bytes in flight before the losses or
-  // acks.
-  void MaybeInvokeCongestionEvent(bool rtt_updated,
+  // acks.  |cause| and |event_time| describe the event to the trace.
+  void MaybeInvokeCongestionEvent(QuicTraceEvent::Type cause,
+                                  QuicTime event_time,
+                                  bool rtt_updated,
                                   QuicByteCount bytes_in_flight);
 
+  // Records the state of the send algorithm after an event in the trace,
+  // which must be enabled.
+  void RecordTraceEvent(QuicTraceEvent::Type type,
+                        QuicTime event_time,
+                        size_t packets_acked,
+                        size_t packets_lost);
+
   // Marks |sequence_number| as having been revived by the peer, but not
   // received, so the packet remains pending if it is and the congestion control
   // does not consider the packet acked.
@@ -355,6 +375,7 @@ class NET_EXPORT_PRIVATE QuicSentPacketManager {
   AckNotifierManager ack_notifier_manager_;
 
   const QuicClock* clock_;
+  QuicRandom* random_;
   QuicConnectionStats* stats_;
   DebugDelegate* debug_delegate_;
   NetworkChangeVisitor* network_change_visitor_;
@@ -362,6 +383,7 @@ class NET_EXPORT_PRIVATE QuicSentPacketManager {
   RttStats rtt_stats_;
   scoped_ptr<SendAlgorithmInterface> send_algorithm_;
   scoped_ptr<LossDetectionInterface> loss_algorithm_;
+  scoped_ptr<QuicConnectionTrace> trace_;
   bool n_connection_simulation_;
 
   // Receiver side buffer in bytes.
@@ -5,12 +5,10 @@
 #ifndef NET_QUIC_QUIC_STREAM_SEQUENCER_H_
 #define NET_QUIC_QUIC_STREAM_SEQUENCER_H_
 
-#include <map>
-#include <string>
-
 #include "base/basictypes.h"
 #include "net/base/iovec.h"
 #include "net/quic/quic_protocol.h"
+#include "net/quic/quic_stream_sequencer_buffer.h"
 
 namespace net {
 
@@ -25,19 +23,6 @@ class ReliableQuicStream;
 // up to the next layer.
 class NET_EXPORT_PRIVATE QuicStreamSequencer {
  public:
-  // A contiguous segment received by a QUIC stream.
-  struct FrameData {
-    FrameData(QuicStreamOffset offset, std::string segment);
-
-    const QuicStreamOffset offset;
-    std::string segment;
-  };
-
-  // TODO(alyssar) use something better than strings.
-  // Maybe write new frames into a ring buffer, and keep track of consumed
-  // bytes, and gaps.
-  typedef std::list<FrameData> FrameList;
-
   explicit QuicStreamSequencer(ReliableQuicStream* quic_stream);
   virtual ~QuicStreamSequencer();
 
@@ -79,8 +64,12 @@ class NET_EXPORT_PRIVATE QuicStreamSequencer {
   // Blocks processing of frames until |SetUnblocked| is called.
   void SetBlockedUntilFlush();
 
-  size_t num_bytes_buffered() const { return num_bytes_buffered_; }
-  QuicStreamOffset num_bytes_consumed() const { return num_bytes_consumed_; }
+  size_t num_bytes_buffered() const {
+    return buffered_frames_.BytesBuffered();
+  }
+  QuicStreamOffset num_bytes_consumed() const {
+    return buffered_frames_.BytesConsumed();
+  }
 
   int num_frames_received() const { return num_frames_received_; }
 
@@ -93,39 +82,22 @@ class NET_EXPORT_PRIVATE QuicStreamSequencer {
  private:
   friend class test::QuicStreamSequencerPeer;
 
-  // Finds the place the frame should be inserted.  If an identical frame is
-  // present, stops on the identical frame.
-  FrameList::iterator FindInsertionPoint(const QuicStreamFrame& frame);
-
-  // Returns true if |frame| contains data which overlaps buffered data
-  // (indicating an invalid stream frame has been received).
-  bool FrameOverlapsBufferedData(
-      const QuicStreamFrame& frame,
-      FrameList::const_iterator insertion_point) const;
-
-  // Returns true if the sequencer has received this frame before.
-  bool IsDuplicate(const QuicStreamFrame& frame,
-                   FrameList::const_iterator insertion_point) const;
-
   // Wait until we've seen 'offset' bytes, and then terminate the stream.
   void CloseStreamAtOffset(QuicStreamOffset offset);
 
+  // Handles the FIN, if |fin|, of a frame ending at |offset| whose data was
+  // all received before.
+  void OnDuplicateFin(bool fin, QuicStreamOffset offset);
+
   // If we've received a FIN and have processed all remaining data, then inform
   // the stream of FIN, and clear buffers.
   bool MaybeCloseStream();
 
-  // Called whenever bytes are consumed by the stream. Updates
-  // num_bytes_consumed_ and num_bytes_buffered_.
-  void RecordBytesConsumed(size_t bytes_consumed);
-
   // The stream which owns this sequencer.
   ReliableQuicStream* stream_;
 
-  // The last data consumed by the stream.
-  QuicStreamOffset num_bytes_consumed_;
-
-  // Stores buffered frames in offset order.
-  FrameList buffered_frames_;
+  // Stores received data until the stream consumes it.
+  QuicStreamSequencerBuffer buffered_frames_;
 
   // The offset, if any, we got a stream termination for.  When this many bytes
   // have been processed, the sequencer will be closed.
@@ -135,9 +107,6 @@ class NET_EXPORT_PRIVATE QuicStreamSequencer {
   // buffer all new incoming data until FlushBufferedFrames is called.
   bool blocked_;
 
-  // Tracks how many bytes the sequencer has buffered.
-  size_t num_bytes_buffered_;
-
   // Count of the number of frames received.
   int num_frames_received_;
 
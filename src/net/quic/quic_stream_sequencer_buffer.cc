@@ -0,0 +1,220 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/quic/quic_stream_sequencer_buffer.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "base/logging.h"
+
+using base::StringPiece;
+using std::min;
+using std::numeric_limits;
+using std::string;
+
+namespace net {
+
+QuicStreamSequencerBuffer::Gap::Gap(QuicStreamOffset begin_offset,
+                                    QuicStreamOffset end_offset)
+    : begin_offset(begin_offset), end_offset(end_offset) {}
+
+QuicStreamSequencerBuffer::QuicStreamSequencerBuffer()
+    : first_block_number_(0), total_bytes_consumed_(0), num_bytes_buffered_(0) {
+  gaps_.push_back(Gap(0, numeric_limits<QuicStreamOffset>::max()));
+}
+
+QuicStreamSequencerBuffer::~QuicStreamSequencerBuffer() {
+  Clear();
+}
+
+void QuicStreamSequencerBuffer::Clear() {
+  for (BufferBlock* block : blocks_) {
+    delete block;
+  }
+  blocks_.clear();
+  first_block_number_ = total_bytes_consumed_ / kBlockSizeBytes;
+  gaps_.clear();
+  gaps_.push_back(
+      Gap(total_bytes_consumed_, numeric_limits<QuicStreamOffset>::max()));
+  num_bytes_buffered_ = 0;
+}
+
+QuicErrorCode QuicStreamSequencerBuffer::OnStreamData(
+    QuicStreamOffset offset,
+    StringPiece data,
+    size_t* bytes_buffered,
+    string* error_details) {
+  *bytes_buffered = 0;
+  const QuicStreamOffset end_offset = offset + data.size();
+  if (data.empty()) {
+    return QUIC_NO_ERROR;
+  }
+  if (end_offset < offset) {
+    *error_details = "Stream frame offset overflows.";
+    return QUIC_INVALID_STREAM_FRAME;
+  }
+
+  // Find the last gap starting at or before |offset|.  In-order data lands in
+  // the last gap, so this usually stops straight away.
+  std::list<Gap>::iterator gap = gaps_.end();
+  while (gap != gaps_.begin()) {
+    --gap;
+    if (gap->begin_offset <= offset) {
+      break;
+    }
+  }
+
+  if (gap->begin_offset > offset || gap->end_offset <= offset) {
+    // |offset| was received before.  The data is a duplicate if it all falls
+    // before the next gap.
+    std::list<Gap>::const_iterator next_gap = gap;
+    if (gap->begin_offset <= offset) {
+      ++next_gap;
+    }
+    if (next_gap == gaps_.end() || end_offset <= next_gap->begin_offset) {
+      return QUIC_NO_ERROR;
+    }
+    *error_details = "Stream frame overlaps with buffered data.";
+    return QUIC_INVALID_STREAM_FRAME;
+  }
+  if (end_offset > gap->end_offset) {
+    *error_details = "Stream frame overlaps with buffered data.";
+    return QUIC_INVALID_STREAM_FRAME;
+  }
+
+  CopyIntoBlocks(offset, data);
+
+  // Shrink, split or remove the gap the data filled.
+  if (offset == gap->begin_offset && end_offset == gap->end_offset) {
+    gaps_.erase(gap);
+  } else if (offset == gap->begin_offset) {
+    gap->begin_offset = end_offset;
+  } else if (end_offset == gap->end_offset) {
+    gap->end_offset = offset;
+  } else {
+    gaps_.insert(gap, Gap(gap->begin_offset, offset));
+    gap->begin_offset = end_offset;
+  }
+
+  num_bytes_buffered_ += data.size();
+  *bytes_buffered = data.size();
+  return QUIC_NO_ERROR;
+}
+
+int QuicStreamSequencerBuffer::GetReadableRegions(iovec* iov,
+                                                  size_t iov_len) const {
+  QuicStreamOffset offset = total_bytes_consumed_;
+  const QuicStreamOffset end_offset = offset + ReadableBytes();
+  size_t index = 0;
+  while (offset < end_offset && index < iov_len) {
+    const size_t block_offset = offset % kBlockSizeBytes;
+    const size_t region_len =
+        min<QuicStreamOffset>(kBlockSizeBytes - block_offset,
+                              end_offset - offset);
+    BufferBlock* block = GetBlock(offset);
+    DCHECK(block);
+    iov[index].iov_base = block->buffer + block_offset;
+    iov[index].iov_len = region_len;
+    offset += region_len;
+    ++index;
+  }
+  return static_cast<int>(index);
+}
+
+size_t QuicStreamSequencerBuffer::Readv(const iovec* iov, size_t iov_len) {
+  QuicStreamOffset offset = total_bytes_consumed_;
+  const QuicStreamOffset end_offset = offset + ReadableBytes();
+  for (size_t i = 0; i < iov_len && offset < end_offset; ++i) {
+    char* dest = static_cast<char*>(iov[i].iov_base);
+    size_t dest_remaining = iov[i].iov_len;
+    while (dest_remaining > 0 && offset < end_offset) {
+      const size_t block_offset = offset % kBlockSizeBytes;
+      const size_t bytes_to_copy = min<QuicStreamOffset>(
+          min(dest_remaining, kBlockSizeBytes - block_offset),
+          end_offset - offset);
+      memcpy(dest, GetBlock(offset)->buffer + block_offset, bytes_to_copy);
+      dest += bytes_to_copy;
+      dest_remaining -= bytes_to_copy;
+      offset += bytes_to_copy;
+    }
+  }
+  const size_t bytes_read = offset - total_bytes_consumed_;
+  MarkConsumed(bytes_read);
+  return bytes_read;
+}
+
+bool QuicStreamSequencerBuffer::MarkConsumed(size_t bytes_consumed) {
+  if (bytes_consumed > ReadableBytes()) {
+    return false;
+  }
+  total_bytes_consumed_ += bytes_consumed;
+  num_bytes_buffered_ -= bytes_consumed;
+  RetireConsumedBlocks();
+  return true;
+}
+
+bool QuicStreamSequencerBuffer::HasBytesToRead() const {
+  return ReadableBytes() > 0;
+}
+
+bool QuicStreamSequencerBuffer::Empty() const {
+  return num_bytes_buffered_ == 0;
+}
+
+size_t QuicStreamSequencerBuffer::ReadableBytes() const {
+  return gaps_.front().begin_offset - total_bytes_consumed_;
+}
+
+QuicStreamSequencerBuffer::BufferBlock* QuicStreamSequencerBuffer::GetBlock(
+    QuicStreamOffset offset) const {
+  const QuicStreamOffset index =
+      offset / kBlockSizeBytes - first_block_number_;
+  if (index >= blocks_.size()) {
+    return nullptr;
+  }
+  return blocks_[index];
+}
+
+QuicStreamSequencerBuffer::BufferBlock*
+QuicStreamSequencerBuffer::GetOrCreateBlock(QuicStreamOffset offset) {
+  DCHECK_GE(offset / kBlockSizeBytes, first_block_number_);
+  const QuicStreamOffset index =
+      offset / kBlockSizeBytes - first_block_number_;
+  while (blocks_.size() <= index) {
+    blocks_.push_back(nullptr);
+  }
+  if (blocks_[index] == nullptr) {
+    blocks_[index] = new BufferBlock;
+  }
+  return blocks_[index];
+}
+
+void QuicStreamSequencerBuffer::CopyIntoBlocks(QuicStreamOffset offset,
+                                               StringPiece data) {
+  while (!data.empty()) {
+    const size_t block_offset = offset % kBlockSizeBytes;
+    const size_t bytes_to_copy =
+        min(data.size(), kBlockSizeBytes - block_offset);
+    memcpy(GetOrCreateBlock(offset)->buffer + block_offset, data.data(),
+           bytes_to_copy);
+    data.remove_prefix(bytes_to_copy);
+    offset += bytes_to_copy;
+  }
+}
+
+void QuicStreamSequencerBuffer::RetireConsumedBlocks() {
+  const QuicStreamOffset consumed_block_number =
+      total_bytes_consumed_ / kBlockSizeBytes;
+  while (first_block_number_ < consumed_block_number && !blocks_.empty()) {
+    delete blocks_.front();
+    blocks_.pop_front();
+    ++first_block_number_;
+  }
+  if (blocks_.empty()) {
+    first_block_number_ = consumed_block_number;
+  }
+}
+
+}  // namespace net
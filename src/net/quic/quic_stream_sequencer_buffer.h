@@ -0,0 +1,128 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_QUIC_QUIC_STREAM_SEQUENCER_BUFFER_H_
+#define NET_QUIC_QUIC_STREAM_SEQUENCER_BUFFER_H_
+
+// QuicStreamSequencerBuffer holds the received, unconsumed bytes of a stream
+// in fixed size blocks, each block holding the bytes of one aligned range of
+// stream offsets.  Blocks are allocated when data first lands in them and
+// freed once the stream has consumed them, so the memory used is bounded by
+// the span between the consumed offset and the highest received offset,
+// which flow control limits to the receive window.
+//
+// Which bytes have arrived is tracked as a list of gaps, ranges of offsets
+// not yet received.  The last gap is open ended.  In-order data always lands
+// at the start of the last gap, so appending it is O(1); data arriving out of
+// order walks back from the last gap, which only matters when there are many
+// holes.
+//
+// Readable data is the contiguous run from the consumed offset up to the
+// first gap.  GetReadableRegions() returns it in place, one region per block,
+// so readers can consume it without another copy.
+
+#include <deque>
+#include <list>
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/strings/string_piece.h"
+#include "net/base/iovec.h"
+#include "net/base/net_export.h"
+#include "net/quic/quic_protocol.h"
+
+namespace net {
+
+class NET_EXPORT_PRIVATE QuicStreamSequencerBuffer {
+ public:
+  // Size of the blocks the buffer allocates.
+  static const size_t kBlockSizeBytes = 8 * 1024;
+
+  QuicStreamSequencerBuffer();
+  ~QuicStreamSequencerBuffer();
+
+  // Frees all blocks and discards all buffered data.  The consumed offset is
+  // kept.
+  void Clear();
+
+  // Copies |data| received at |offset| into the buffer.  Sets
+  // |bytes_buffered| to the number of new bytes, which is zero if all of
+  // |data| was received before.  Returns QUIC_INVALID_STREAM_FRAME and sets
+  // |error_details| if |data| partially overlaps data received before.
+  QuicErrorCode OnStreamData(QuicStreamOffset offset,
+                             base::StringPiece data,
+                             size_t* bytes_buffered,
+                             std::string* error_details);
+
+  // Fills in up to |iov_len| iovecs with the readable regions, in order, and
+  // returns the number used.
+  int GetReadableRegions(iovec* iov, size_t iov_len) const;
+
+  // Copies readable data into |iov| and consumes it.  Returns the number of
+  // bytes copied.
+  size_t Readv(const iovec* iov, size_t iov_len);
+
+  // Consumes |bytes_consumed| readable bytes.  Returns false, consuming
+  // nothing, if fewer bytes are readable.
+  bool MarkConsumed(size_t bytes_consumed);
+
+  // Returns true if there is data to read at the consumed offset.
+  bool HasBytesToRead() const;
+
+  // Returns true if no data is buffered.
+  bool Empty() const;
+
+  // The number of bytes consumed from the start of the stream.
+  QuicStreamOffset BytesConsumed() const { return total_bytes_consumed_; }
+
+  // The number of bytes received and not yet consumed.
+  size_t BytesBuffered() const { return num_bytes_buffered_; }
+
+ private:
+  // A range of offsets which has not been received.
+  struct Gap {
+    Gap(QuicStreamOffset begin_offset, QuicStreamOffset end_offset);
+
+    QuicStreamOffset begin_offset;
+    QuicStreamOffset end_offset;
+  };
+
+  struct BufferBlock {
+    char buffer[kBlockSizeBytes];
+  };
+
+  // Returns the number of bytes readable from the consumed offset.
+  size_t ReadableBytes() const;
+
+  // Returns the block holding |offset|, or null if it has not been allocated.
+  BufferBlock* GetBlock(QuicStreamOffset offset) const;
+
+  // Returns the block holding |offset|, allocating it if needed.
+  BufferBlock* GetOrCreateBlock(QuicStreamOffset offset);
+
+  // Copies |data| into the blocks starting at |offset|.
+  void CopyIntoBlocks(QuicStreamOffset offset, base::StringPiece data);
+
+  // Frees the blocks wholly below the consumed offset.
+  void RetireConsumedBlocks();
+
+  // Gaps in offset order.  Never empty; the last gap runs to the maximum
+  // offset.
+  std::list<Gap> gaps_;
+
+  // Blocks from the one holding |total_bytes_consumed_| onwards.  Blocks with
+  // no data yet are null.
+  std::deque<BufferBlock*> blocks_;
+  // The block number, offset divided by kBlockSizeBytes, of |blocks_[0]|.
+  QuicStreamOffset first_block_number_;
+
+  QuicStreamOffset total_bytes_consumed_;
+  size_t num_bytes_buffered_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicStreamSequencerBuffer);
+};
+
+}  // namespace net
+
+#endif  // NET_QUIC_QUIC_STREAM_SEQUENCER_BUFFER_H_
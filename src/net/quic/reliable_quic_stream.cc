@@ -104,9 +104,11 @@ class ReliableQuicStream::ProxyAckNotifierDelegate
 };
 
 ReliableQuicStream::PendingData::PendingData(
-    string data_in,
-    scoped_refptr<ProxyAckNotifierDelegate> delegate_in)
-    : data(data_in), offset(0), delegate(delegate_in) {
+    QuicSendBufferSlice* data_in,
+    size_t offset_in,
+    scoped_refptr<ProxyAckNotifierDelegate> delegate_in,
+    bool last_in)
+    : data(data_in), offset(offset_in), delegate(delegate_in), last(last_in) {
 }
 
 ReliableQuicStream::PendingData::~PendingData() {
@@ -254,7 +256,24 @@ void ReliableQuicStream::WriteOrBufferData(
     StringPiece data,
     bool fin,
     QuicAckNotifier::DelegateInterface* ack_notifier_delegate) {
-  if (data.empty() && !fin) {
+  QuicSendBufferSlices slices;
+  for (size_t offset = 0; offset < data.size();
+       offset += kMaxSendBufferSliceSize) {
+    slices.push_back(make_scoped_refptr(new QuicSendBufferSlice(
+        data.substr(offset, kMaxSendBufferSliceSize))));
+  }
+  WriteOrBufferSlices(slices, fin, ack_notifier_delegate);
+}
+
+void ReliableQuicStream::WriteOrBufferSlices(
+    const QuicSendBufferSlices& data,
+    bool fin,
+    QuicAckNotifier::DelegateInterface* ack_notifier_delegate) {
+  size_t data_length = 0;
+  for (const scoped_refptr<QuicSendBufferSlice>& slice : data) {
+    data_length += slice->length();
+  }
+  if (data_length == 0 && !fin) {
     LOG(DFATAL) << "data.empty() && !fin";
     return;
   }
@@ -273,29 +292,55 @@ void ReliableQuicStream::WriteOrBufferData(
     proxy_delegate = new ProxyAckNotifierDelegate(ack_notifier_delegate);
   }
 
-  QuicConsumedData consumed_data(0, false);
   fin_buffered_ = fin;
 
+  // Index of the first slice not completely written, and the bytes of it
+  // which were.
+  size_t next_slice = 0;
+  size_t slice_offset = 0;
+  bool write_completed = false;
   if (queued_data_.empty()) {
-    struct iovec iov(MakeIovec(data));
-    consumed_data = WritevData(&iov, 1, fin, proxy_delegate.get());
-    DCHECK_LE(consumed_data.bytes_consumed, data.length());
-  }
-
-  bool write_completed;
-  // If there's unconsumed data or an unconsumed fin, queue it.
-  if (consumed_data.bytes_consumed < data.length() ||
-      (fin && !consumed_data.fin_consumed)) {
-    StringPiece remainder(data.substr(consumed_data.bytes_consumed));
-    queued_data_.push_back(PendingData(remainder.as_string(), proxy_delegate));
-    write_completed = false;
-  } else {
-    write_completed = true;
+    // Fill packets across slice boundaries rather than flushing a short
+    // packet at the end of each slice.
+    QuicConnection::ScopedPacketBundler bundler(session()->connection(),
+                                                QuicConnection::NO_ACK);
+    do {
+      const bool last_slice = next_slice + 1 >= data.size();
+      QuicSendBufferSlice* slice =
+          data.empty() ? nullptr : data[next_slice].get();
+      const size_t slice_length = slice != nullptr ? slice->length() : 0;
+      QuicConsumedData consumed_data =
+          WriteSlice(slice, 0, fin && last_slice, proxy_delegate.get());
+      DCHECK_LE(consumed_data.bytes_consumed, slice_length);
+      const bool slice_completed =
+          consumed_data.bytes_consumed == slice_length &&
+          (!(fin && last_slice) || consumed_data.fin_consumed);
+      write_completed = slice_completed && last_slice;
+      if ((proxy_delegate.get() != nullptr) &&
+          (consumed_data.bytes_consumed > 0 || consumed_data.fin_consumed)) {
+        proxy_delegate->WroteData(write_completed);
+      }
+      if (!slice_completed) {
+        slice_offset = consumed_data.bytes_consumed;
+        break;
+      }
+      ++next_slice;
+    } while (next_slice < data.size());
   }
 
-  if ((proxy_delegate.get() != nullptr) &&
-      (consumed_data.bytes_consumed > 0 || consumed_data.fin_consumed)) {
-    proxy_delegate->WroteData(write_completed);
+  // Queue the unwritten slices, or the unconsumed fin.  The queue shares the
+  // slices rather than copying what is left of them.
+  if (write_completed) {
+    return;
+  }
+  if (data.empty()) {
+    queued_data_.push_back(PendingData(nullptr, 0, proxy_delegate, true));
+    return;
+  }
+  for (size_t i = next_slice; i < data.size(); ++i) {
+    queued_data_.push_back(PendingData(data[i].get(),
+                                       i == next_slice ? slice_offset : 0,
+                                       proxy_delegate, i + 1 == data.size()));
   }
 }
 
@@ -308,24 +353,23 @@ void ReliableQuicStream::OnCanWrite() {
       fin = true;
     }
     if (pending_data->offset > 0 &&
-        pending_data->offset >= pending_data->data.size()) {
+        pending_data->offset >= pending_data->length()) {
       // This should be impossible because offset tracks the amount of
       // pending_data written thus far.
       LOG(DFATAL) << "Pending offset is beyond available data. offset: "
                   << pending_data->offset
-                  << " vs: " << pending_data->data.size();
+                  << " vs: " << pending_data->length();
       return;
     }
-    size_t remaining_len = pending_data->data.size() - pending_data->offset;
-    struct iovec iov = {
-        const_cast<char*>(pending_data->data.data()) + pending_data->offset,
-        remaining_len};
-    QuicConsumedData consumed_data = WritevData(&iov, 1, fin, delegate);
+    size_t remaining_len = pending_data->length() - pending_data->offset;
+    QuicConsumedData consumed_data = WriteSlice(
+        pending_data->data.get(), pending_data->offset, fin, delegate);
     if (consumed_data.bytes_consumed == remaining_len &&
         fin == consumed_data.fin_consumed) {
+      const bool last = pending_data->last;
       queued_data_.pop_front();
       if (delegate != nullptr) {
-        delegate->WroteData(true);
+        delegate->WroteData(last);
       }
     } else {
       if (consumed_data.bytes_consumed > 0) {
@@ -360,6 +404,30 @@ QuicConsumedData ReliableQuicStream::WritevData(
     int iov_count,
     bool fin,
     QuicAckNotifier::DelegateInterface* ack_notifier_delegate) {
+  return WritevDataInternal(iov, iov_count, nullptr, fin,
+                            ack_notifier_delegate);
+}
+
+QuicConsumedData ReliableQuicStream::WriteSlice(
+    QuicSendBufferSlice* data,
+    size_t data_offset,
+    bool fin,
+    QuicAckNotifier::DelegateInterface* ack_notifier_delegate) {
+  if (data == nullptr) {
+    return WritevDataInternal(nullptr, 0, nullptr, fin, ack_notifier_delegate);
+  }
+  DCHECK_LE(data_offset, data->length());
+  struct iovec iov(
+      MakeIovec(StringPiece(data->data(), data->length()).substr(data_offset)));
+  return WritevDataInternal(&iov, 1, data, fin, ack_notifier_delegate);
+}
+
+QuicConsumedData ReliableQuicStream::WritevDataInternal(
+    const struct iovec* iov,
+    int iov_count,
+    QuicSendBufferSlice* slice,
+    bool fin,
+    QuicAckNotifier::DelegateInterface* ack_notifier_delegate) {
   if (write_side_closed_) {
     DLOG(ERROR) << ENDPOINT << "Attempt to write when the write side is closed";
     return QuicConsumedData(0, false);
@@ -393,8 +461,10 @@ QuicConsumedData ReliableQuicStream::WritevData(
   }
 
   QuicConsumedData consumed_data = session()->WritevData(
-      id(), QuicIOVector(iov, iov_count, write_length), stream_bytes_written_,
-      fin, GetFecProtection(), ack_notifier_delegate);
+      id(),
+      slice != nullptr ? QuicIOVector(iov, write_length, slice)
+                       : QuicIOVector(iov, iov_count, write_length),
+      stream_bytes_written_, fin, GetFecProtection(), ack_notifier_delegate);
   stream_bytes_written_ += consumed_data.bytes_consumed;
 
   AddBytesSent(consumed_data.bytes_consumed);
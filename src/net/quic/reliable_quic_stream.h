@@ -30,6 +30,7 @@
 #include "net/quic/quic_ack_notifier.h"
 #include "net/quic/quic_flow_controller.h"
 #include "net/quic/quic_protocol.h"
+#include "net/quic/quic_send_buffer_slice.h"
 #include "net/quic/quic_stream_sequencer.h"
 #include "net/quic/quic_types.h"
 
@@ -160,11 +161,24 @@ class NET_EXPORT_PRIVATE ReliableQuicStream {
   // and then buffers any remaining data in queued_data_.
   // If fin is true: if it is immediately passed on to the session,
   // write_side_closed() becomes true, otherwise fin_buffered_ becomes true.
+  // |data| is copied once into QuicSendBufferSlices of at most
+  // kMaxSendBufferSliceSize bytes, which the stream frames carrying it then
+  // reference.
   void WriteOrBufferData(
       base::StringPiece data,
       bool fin,
       QuicAckNotifier::DelegateInterface* ack_notifier_delegate);
 
+  // Identical to WriteOrBufferData, but sends the bytes of |data|, in order,
+  // without copying them.  Each slice is released once the packets carrying
+  // its own bytes are acked, so callers should keep slices to at most
+  // kMaxSendBufferSliceSize bytes.  |data| may be empty if only a fin is
+  // written.
+  void WriteOrBufferSlices(
+      const QuicSendBufferSlices& data,
+      bool fin,
+      QuicAckNotifier::DelegateInterface* ack_notifier_delegate);
+
   // Sends as many bytes in the first |count| buffers of |iov| to the connection
   // as the connection will consume.
   // If |ack_notifier_delegate| is provided, then it will be notified once all
@@ -207,19 +221,42 @@ class NET_EXPORT_PRIVATE ReliableQuicStream {
   class ProxyAckNotifierDelegate;
 
   struct PendingData {
-    PendingData(std::string data_in,
-                scoped_refptr<ProxyAckNotifierDelegate> delegate_in);
+    PendingData(QuicSendBufferSlice* data_in,
+                size_t offset_in,
+                scoped_refptr<ProxyAckNotifierDelegate> delegate_in,
+                bool last_in);
     ~PendingData();
 
-    // Pending data to be written.
-    std::string data;
+    size_t length() const { return data.get() ? data->length() : 0; }
+
+    // Pending data to be written.  Null for a fin without data.
+    scoped_refptr<QuicSendBufferSlice> data;
     // Index of the first byte in data still to be written.
     size_t offset;
     // Delegate that should be notified when the pending data is acked.
     // Can be nullptr.
     scoped_refptr<ProxyAckNotifierDelegate> delegate;
+    // True if this is the last slice of its write, so that writing it all
+    // completes the write for |delegate|.
+    bool last;
   };
 
+  // Sends the bytes of |data| from |data_offset| on, as for WritevData.  |data|
+  // may be null to send only a fin.
+  QuicConsumedData WriteSlice(
+      QuicSendBufferSlice* data,
+      size_t data_offset,
+      bool fin,
+      QuicAckNotifier::DelegateInterface* ack_notifier_delegate);
+
+  // Writes |iov|, which points into |slice| if it is not null.
+  QuicConsumedData WritevDataInternal(
+      const struct iovec* iov,
+      int iov_count,
+      QuicSendBufferSlice* slice,
+      bool fin,
+      QuicAckNotifier::DelegateInterface* ack_notifier_delegate);
+
   // Calls MaybeSendBlocked on the stream's flow controller and the connection
   // level flow controller.  If the stream is flow control blocked by the
   // connection-level flow controller but not by the stream-level flow
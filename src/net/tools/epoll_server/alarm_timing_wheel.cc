@@ -0,0 +1,306 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/epoll_server/alarm_timing_wheel.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace net {
+
+namespace {
+
+// The largest distance, in ticks, an alarm is placed from the current tick;
+// about 49 days.  Later alarms are parked in the last slot of the top level
+// and placed again when it is cascaded.
+const int64 kMaxTicksAhead = INT64_C(1) << 32;
+
+}  // namespace
+
+AlarmTimingWheel::AlarmList::AlarmList() {
+  head_.prev = &head_;
+  head_.next = &head_;
+  head_.slot = kNotInWheel;
+}
+
+AlarmTimingWheel::AlarmList::~AlarmList() {
+  DCHECK(empty());
+}
+
+AlarmTimingWheel::AlarmTimingWheel()
+    : current_tick_(0), initialized_(false), size_(0), free_nodes_(nullptr) {
+  for (int i = 0; i < kLevels * kSlotsPerLevel; ++i) {
+    slots_[i].prev = &slots_[i];
+    slots_[i].next = &slots_[i];
+    slots_[i].slot = i;
+  }
+  memset(occupied_, 0, sizeof(occupied_));
+}
+
+AlarmTimingWheel::~AlarmTimingWheel() {
+  for (int i = 0; i < kLevels * kSlotsPerLevel; ++i) {
+    while (slots_[i].next != &slots_[i]) {
+      Node* node = slots_[i].next;
+      Unlink(node);
+      delete node;
+    }
+  }
+  while (free_nodes_ != nullptr) {
+    Node* node = free_nodes_;
+    free_nodes_ = node->next;
+    delete node;
+  }
+}
+
+AlarmTimingWheel::Node* AlarmTimingWheel::Add(int64 deadline_in_us,
+                                              AlarmCB* cb) {
+  if (!initialized_) {
+    current_tick_ = TickOf(deadline_in_us);
+    initialized_ = true;
+  }
+  Node* node = NewNode();
+  node->deadline_in_us = deadline_in_us;
+  node->cb = cb;
+  Place(node);
+  return node;
+}
+
+void AlarmTimingWheel::Remove(Node* node) {
+  Unlink(node);
+  FreeNode(node);
+}
+
+void AlarmTimingWheel::Advance(int64 now_in_us, AlarmList* expired) {
+  const int64 now_tick = TickOf(now_in_us);
+  if (size_ == 0) {
+    current_tick_ = now_tick;
+    initialized_ = true;
+    return;
+  }
+  if (now_tick < current_tick_) {
+    // The wheel started at the first alarm's deadline, or the clock went
+    // back.  Place everything again relative to now.
+    AlarmList all;
+    RemoveAll(&all);
+    current_tick_ = now_tick;
+    while (!all.empty()) {
+      Node* node = all.head_.next;
+      Unlink(node);
+      Place(node);
+    }
+  }
+
+  while (true) {
+    Expire(current_tick_ & kSlotMask, now_in_us, expired);
+    if (current_tick_ >= now_tick) {
+      break;
+    }
+    if (size_ == 0) {
+      current_tick_ = now_tick;
+      break;
+    }
+    // Skip straight to the next tick with an occupied level 0 slot or a
+    // non-empty slot to cascade.
+    int64 next_tick = NextCascadeTick();
+    const int index = current_tick_ & kSlotMask;
+    const int next = NextOccupiedSlot(0, (index + 1) & kSlotMask);
+    if (next >= 0) {
+      const int distance = (next - index) & kSlotMask;
+      next_tick = std::min(
+          next_tick, current_tick_ + (distance == 0 ? kSlotsPerLevel : distance));
+    }
+    current_tick_ = std::min(next_tick, now_tick);
+    if ((current_tick_ & kSlotMask) == 0) {
+      for (int level = 1; level < kLevels; ++level) {
+        const int level_index =
+            (current_tick_ >> (level * kSlotBits)) & kSlotMask;
+        Cascade(level << kSlotBits | level_index);
+        if (level_index != 0) {
+          break;
+        }
+      }
+    }
+  }
+}
+
+void AlarmTimingWheel::RemoveAll(AlarmList* list) {
+  for (int i = 0; i < kLevels * kSlotsPerLevel; ++i) {
+    while (slots_[i].next != &slots_[i]) {
+      Node* node = slots_[i].next;
+      Unlink(node);
+      LinkBefore(&list->head_, node);
+    }
+  }
+}
+
+AlarmTimingWheel::AlarmCB* AlarmTimingWheel::PopFront(AlarmList* list) {
+  DCHECK(!list->empty());
+  Node* node = list->head_.next;
+  AlarmCB* cb = node->cb;
+  Remove(node);
+  return cb;
+}
+
+int64 AlarmTimingWheel::NextEventTimeInUsec() const {
+  DCHECK(!empty());
+  int64 next_event_in_us = kint64max;
+  const int64 cascade_tick = NextCascadeTick();
+  if (cascade_tick != kint64max) {
+    next_event_in_us = cascade_tick * kTickInUsec;
+  }
+  const int next = NextOccupiedSlot(0, current_tick_ & kSlotMask);
+  if (next >= 0) {
+    // Level 0 only holds alarms less than a turn ahead, so the first occupied
+    // slot from the current one holds the earliest of them.
+    const Node* head = &slots_[next];
+    for (const Node* node = head->next; node != head; node = node->next) {
+      next_event_in_us = std::min(next_event_in_us, node->deadline_in_us);
+    }
+  }
+  return next_event_in_us;
+}
+
+void AlarmTimingWheel::GetAlarms(
+    std::vector<std::pair<int64, AlarmCB*>>* alarms) const {
+  for (int i = 0; i < kLevels * kSlotsPerLevel; ++i) {
+    const Node* head = &slots_[i];
+    for (const Node* node = head->next; node != head; node = node->next) {
+      alarms->push_back(std::make_pair(node->deadline_in_us, node->cb));
+    }
+  }
+}
+
+int64 AlarmTimingWheel::NextCascadeTick() const {
+  int64 next_tick = kint64max;
+  for (int level = 1; level < kLevels; ++level) {
+    const int shift = level * kSlotBits;
+    const int index = (current_tick_ >> shift) & kSlotMask;
+    const int next = NextOccupiedSlot(level, (index + 1) & kSlotMask);
+    if (next < 0) {
+      continue;
+    }
+    // A slot is cascaded when the wheel reaches its first tick.  The current
+    // slot of a level can only hold alarms a whole turn ahead.
+    const int distance = (next - index) & kSlotMask;
+    next_tick = std::min(
+        next_tick,
+        ((current_tick_ >> shift) + (distance == 0 ? kSlotsPerLevel : distance))
+            << shift);
+  }
+  return next_tick;
+}
+
+void AlarmTimingWheel::Place(Node* node) {
+  int64 tick = std::max(TickOf(node->deadline_in_us), current_tick_);
+  if (tick - current_tick_ >= kMaxTicksAhead) {
+    tick = current_tick_ + kMaxTicksAhead - 1;
+  }
+  const int64 delta = tick - current_tick_;
+  int level = 0;
+  while (level + 1 < kLevels &&
+         delta >= (INT64_C(1) << ((level + 1) * kSlotBits))) {
+    ++level;
+  }
+  const int index = (tick >> (level * kSlotBits)) & kSlotMask;
+  LinkBefore(&slots_[level << kSlotBits | index], node);
+}
+
+void AlarmTimingWheel::Cascade(int slot) {
+  Node* head = &slots_[slot];
+  if (head->next == head) {
+    return;
+  }
+  // Take the whole list first: nodes may be placed back into |slot| itself.
+  AlarmList cascading;
+  while (head->next != head) {
+    Node* node = head->next;
+    Unlink(node);
+    LinkBefore(&cascading.head_, node);
+  }
+  while (!cascading.empty()) {
+    Node* node = cascading.head_.next;
+    Unlink(node);
+    Place(node);
+  }
+}
+
+void AlarmTimingWheel::Expire(int slot, int64 now_in_us, AlarmList* expired) {
+  Node* head = &slots_[slot];
+  Node* node = head->next;
+  while (node != head) {
+    Node* next = node->next;
+    if (node->deadline_in_us <= now_in_us) {
+      Unlink(node);
+      LinkBefore(&expired->head_, node);
+    }
+    node = next;
+  }
+}
+
+int AlarmTimingWheel::NextOccupiedSlot(int level, int start) const {
+  const uint64* words = occupied_[level];
+  const int start_word = start >> 6;
+  for (int i = 0; i <= kWordsPerLevel; ++i) {
+    const int word = (start_word + i) % kWordsPerLevel;
+    uint64 bits = words[word];
+    if (i == 0) {
+      bits &= ~UINT64_C(0) << (start & 63);
+    } else if (i == kWordsPerLevel) {
+      bits &= (UINT64_C(1) << (start & 63)) - 1;
+    }
+    if (bits != 0) {
+      return word * 64 + __builtin_ctzll(bits);
+    }
+  }
+  return -1;
+}
+
+void AlarmTimingWheel::LinkBefore(Node* position, Node* node) {
+  node->prev = position->prev;
+  node->next = position;
+  position->prev->next = node;
+  position->prev = node;
+  node->slot = position->slot;
+  if (node->slot != kNotInWheel) {
+    occupied_[node->slot >> kSlotBits][(node->slot & kSlotMask) >> 6] |=
+        UINT64_C(1) << (node->slot & 63);
+    ++size_;
+  }
+}
+
+void AlarmTimingWheel::Unlink(Node* node) {
+  node->prev->next = node->next;
+  node->next->prev = node->prev;
+  if (node->slot != kNotInWheel) {
+    const Node* head = &slots_[node->slot];
+    if (head->next == head) {
+      occupied_[node->slot >> kSlotBits][(node->slot & kSlotMask) >> 6] &=
+          ~(UINT64_C(1) << (node->slot & 63));
+    }
+    --size_;
+  }
+  node->prev = nullptr;
+  node->next = nullptr;
+  node->slot = kNotInWheel;
+}
+
+AlarmTimingWheel::Node* AlarmTimingWheel::NewNode() {
+  if (free_nodes_ == nullptr) {
+    return new Node;
+  }
+  Node* node = free_nodes_;
+  free_nodes_ = node->next;
+  return node;
+}
+
+void AlarmTimingWheel::FreeNode(Node* node) {
+  node->cb = nullptr;
+  node->next = free_nodes_;
+  free_nodes_ = node;
+}
+
+}  // namespace net
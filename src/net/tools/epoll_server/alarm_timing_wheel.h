@@ -0,0 +1,146 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_EPOLL_SERVER_ALARM_TIMING_WHEEL_H_
+#define NET_TOOLS_EPOLL_SERVER_ALARM_TIMING_WHEEL_H_
+
+// AlarmTimingWheel holds the EpollServer's alarms in a hierarchical timing
+// wheel.  Level 0 has one slot per tick; each slot of a higher level covers a
+// whole turn of the level below it.  An alarm is placed in the lowest level
+// whose range reaches its deadline, and is moved down a level ("cascaded")
+// when the wheel reaches the start of its slot.  Alarms live on intrusive
+// doubly linked lists, so adding and removing one is O(1) however many are
+// registered, and each alarm is cascaded at most once per level.
+//
+// The tick is one millisecond, the granularity QuicAlarm::Update() already
+// ignores, but alarms keep their exact deadlines: Advance() only expires an
+// alarm once its deadline has passed, and NextEventTimeInUsec() reports the
+// exact deadline of the earliest alarm in level 0.
+
+#include <utility>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace net {
+
+class EpollAlarmCallbackInterface;
+
+class AlarmTimingWheel {
+ public:
+  typedef EpollAlarmCallbackInterface AlarmCB;
+
+  // An alarm in the wheel.  A Node* is the token handed to the alarm on
+  // registration; it stays valid until the alarm is removed or popped.
+  struct Node {
+    int64 deadline_in_us;
+    AlarmCB* cb;
+    Node* prev;
+    Node* next;
+    // The slot holding the node, or kNotInWheel if it is on an AlarmList.
+    int slot;
+  };
+
+  // Alarms taken out of the wheel, in the order they were taken out.  Alarms
+  // on a list can still be removed with Remove().
+  class AlarmList {
+   public:
+    AlarmList();
+    ~AlarmList();
+
+    bool empty() const { return head_.next == &head_; }
+
+   private:
+    friend class AlarmTimingWheel;
+
+    Node head_;
+
+    DISALLOW_COPY_AND_ASSIGN(AlarmList);
+  };
+
+  static const int64 kTickInUsec = 1000;
+  static const int kNotInWheel = -1;
+
+  AlarmTimingWheel();
+  ~AlarmTimingWheel();
+
+  // Adds |cb| to go off at |deadline_in_us| and returns its node.
+  Node* Add(int64 deadline_in_us, AlarmCB* cb);
+
+  // Removes |node| from the wheel or the list it is on and frees it.
+  void Remove(Node* node);
+
+  // Moves the alarms whose deadline is at or before |now_in_us| to |expired|.
+  void Advance(int64 now_in_us, AlarmList* expired);
+
+  // Moves all alarms to |list|.
+  void RemoveAll(AlarmList* list);
+
+  // Removes and frees the first node of |list|, which must not be empty, and
+  // returns its alarm.
+  AlarmCB* PopFront(AlarmList* list);
+
+  // Returns the time by which Advance() must next be called: the earliest
+  // deadline in level 0, or the time an earlier slot of a higher level is
+  // cascaded, if that is sooner.  Must not be called when the wheel is empty.
+  int64 NextEventTimeInUsec() const;
+
+  // Appends the deadline and alarm of every alarm in the wheel to |alarms|,
+  // in no particular order.
+  void GetAlarms(std::vector<std::pair<int64, AlarmCB*>>* alarms) const;
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+
+ private:
+  static const int kLevels = 4;
+  static const int kSlotBits = 8;
+  static const int kSlotsPerLevel = 1 << kSlotBits;
+  static const int kSlotMask = kSlotsPerLevel - 1;
+  static const int kWordsPerLevel = kSlotsPerLevel / 64;
+
+  static int64 TickOf(int64 time_in_us) { return time_in_us / kTickInUsec; }
+
+  // Returns the first tick after the current one at which a non-empty slot
+  // of a higher level is cascaded, or kint64max if there is none.
+  int64 NextCascadeTick() const;
+  // Links |node| into the slot its deadline falls in.
+  void Place(Node* node);
+  // Moves the nodes of |slot| back through Place().
+  void Cascade(int slot);
+  // Moves the nodes of |slot| due by |now_in_us| to |expired|.
+  void Expire(int slot, int64 now_in_us, AlarmList* expired);
+
+  // Returns the first occupied slot of |level| at or after |start|, wrapping
+  // around, or -1 if the level is empty.
+  int NextOccupiedSlot(int level, int start) const;
+
+  void LinkBefore(Node* position, Node* node);
+  void Unlink(Node* node);
+
+  Node* NewNode();
+  void FreeNode(Node* node);
+
+  // Sentinels of the slot lists; slot s of level l is |slots_[l << 8 | s]|.
+  Node slots_[kLevels * kSlotsPerLevel];
+  // One bit per non-empty slot.
+  uint64 occupied_[kLevels][kWordsPerLevel];
+
+  // Every tick before |current_tick_| has been expired.  Only meaningful once
+  // |initialized_| is set.
+  int64 current_tick_;
+  bool initialized_;
+
+  // Number of nodes in the wheel, excluding those on AlarmLists.
+  size_t size_;
+
+  // Freed nodes, chained through |next|, for reuse.
+  Node* free_nodes_;
+
+  DISALLOW_COPY_AND_ASSIGN(AlarmTimingWheel);
+};
+
+}  // namespace net
+
+#endif  // NET_TOOLS_EPOLL_SERVER_ALARM_TIMING_WHEEL_H_
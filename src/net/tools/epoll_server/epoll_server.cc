@@ -12,7 +12,7 @@
 #include <vector>
 
 #include "base/logging.h"
-#include "base/time/time.h"
+#include "net/tools/epoll_server/monotonic_clock.h"
 
 // Design notes: An efficient implementation of ready list has the following
 // desirable properties:
@@ -125,21 +125,13 @@ void EpollServer::CleanupFDToCBMap() {
   }
 }
 
-void EpollServer::CleanupTimeToAlarmCBMap() {
-  TimeToAlarmCBMap::iterator erase_it;
-
-  // Call OnShutdown() on alarms. Note that the structure of the loop
-  // is similar to the structure of loop in the function HandleAlarms()
-  for (TimeToAlarmCBMap::iterator i = alarm_map_.begin();
-       i != alarm_map_.end();
-      ) {
-    // Note that OnShutdown() can call UnregisterAlarm() on
-    // other iterators. OnShutdown() should not call UnregisterAlarm()
-    // on self because by definition the iterator is not valid any more.
-    i->second->OnShutdown(this);
-    erase_it = i;
-    ++i;
-    alarm_map_.erase(erase_it);
+void EpollServer::CleanupAlarms() {
+  // Call OnShutdown() on alarms.  Note that OnShutdown() can call
+  // UnregisterAlarm() on other alarms, which removes them from |alarms|.
+  AlarmTimingWheel::AlarmList alarms;
+  alarm_wheel_.RemoveAll(&alarms);
+  while (!alarms.empty()) {
+    alarm_wheel_.PopFront(&alarms)->OnShutdown(this);
   }
 }
 
@@ -155,7 +147,7 @@ EpollServer::~EpollServer() {
   LIST_INIT(&ready_list_);
   LIST_INIT(&tmp_list_);
 
-  CleanupTimeToAlarmCBMap();
+  CleanupAlarms();
 
   close(read_fd_);
   close(write_fd_);
@@ -363,7 +355,7 @@ void EpollServer::WaitForEventsAndExecuteCallbacks() {
     return;  // COV_NF_LINE
   }
   TrueFalseGuard recursion_guard(&in_wait_for_events_and_execute_callbacks_);
-  if (alarm_map_.empty()) {
+  if (alarm_wheel_.empty()) {
     // no alarms, this is business as usual.
     WaitForEventsAndCallHandleEvents(timeout_in_us_,
                                      events_,
@@ -379,9 +371,9 @@ void EpollServer::WaitForEventsAndExecuteCallbacks() {
   // a more reasonable amount of work is done here.
   int64 now_in_us  = NowInUsec();
 
-  // Get the first timeout from the alarm_map where it is
+  // Get the first timeout from the alarm wheel where it is
   // stored in absolute time.
-  int64 next_alarm_time_in_us =  alarm_map_.begin()->first;
+  int64 next_alarm_time_in_us = alarm_wheel_.NextEventTimeInUsec();
   VLOG(4) << "next_alarm_time = " << next_alarm_time_in_us
           << " now             = " << now_in_us
           << " timeout_in_us = " << timeout_in_us_;
@@ -463,19 +455,18 @@ void EpollServer::RegisterAlarm(int64 timeout_time_in_us, AlarmCB* ac) {
   }
   VLOG(4) << "RegisteringAlarm at : " << timeout_time_in_us;
 
-  TimeToAlarmCBMap::iterator alarm_iter =
-      alarm_map_.insert(std::make_pair(timeout_time_in_us, ac));
+  AlarmRegToken token = alarm_wheel_.Add(timeout_time_in_us, ac);
 
   all_alarms_.insert(ac);
-  // Pass the iterator to the EpollAlarmCallbackInterface.
-  ac->OnRegistration(alarm_iter, this);
+  // Pass the token to the EpollAlarmCallbackInterface.
+  ac->OnRegistration(token, this);
 }
 
 // Unregister a specific alarm callback: iterator_token must be a
-//  valid iterator. The caller must ensure the validity of the iterator.
+//  valid token. The caller must ensure the validity of the token.
 void EpollServer::UnregisterAlarm(const AlarmRegToken& iterator_token) {
-  AlarmCB* cb = iterator_token->second;
-  alarm_map_.erase(iterator_token);
+  AlarmCB* cb = iterator_token->cb;
+  alarm_wheel_.Remove(iterator_token);
   all_alarms_.erase(cb);
   cb->OnUnregistration();
 }
@@ -493,7 +484,7 @@ void EpollServer::Wake() {
 }
 
 int64 EpollServer::NowInUsec() const {
-  return base::Time::Now().ToInternalValue();
+  return MonotonicClock::NowInUsec();
 }
 
 int64 EpollServer::ApproximateNowInUsec() const {
@@ -526,15 +517,12 @@ void EpollServer::LogStateOnCrash() {
   LOG(ERROR) << "timeout_in_us_: " << timeout_in_us_;
 
   // Log sessions with alarms.
-  LOG(ERROR) << alarm_map_.size() << " alarms registered.";
-  for (TimeToAlarmCBMap::iterator it = alarm_map_.begin();
-       it != alarm_map_.end();
-       ++it) {
-    const bool skipped =
-        alarms_reregistered_and_should_be_skipped_.find(it->second)
-        != alarms_reregistered_and_should_be_skipped_.end();
-    LOG(ERROR) << "Alarm " << it->second << " registered at time " << it->first
-               << " and should be skipped = " << skipped;
+  std::vector<std::pair<int64, AlarmCB*>> alarms;
+  alarm_wheel_.GetAlarms(&alarms);
+  LOG(ERROR) << alarms.size() << " alarms registered.";
+  for (size_t i = 0; i < alarms.size(); ++i) {
+    LOG(ERROR) << "Alarm " << alarms[i].second << " registered at time "
+               << alarms[i].first;
   }
 
   LOG(ERROR) << cb_map_.size() << " fd callbacks registered.";
@@ -735,48 +723,28 @@ void EpollServer::CallAndReregisterAlarmEvents() {
   int64 now_in_us = recorded_now_in_us_;
   DCHECK_NE(0, recorded_now_in_us_);
 
-  TimeToAlarmCBMap::iterator erase_it;
+  // Take the due alarms out of the wheel before running any of them.  Alarms
+  // registered while they run, even for a time <= now_in_us, go into the
+  // wheel and are not run until the next call, so OnAlarm() returning a time
+  // in the past can not loop forever.  OnAlarm() may unregister alarms which
+  // are still on |expired|.
+  AlarmTimingWheel::AlarmList expired;
+  alarm_wheel_.Advance(now_in_us, &expired);
 
   // execute alarms.
-  for (TimeToAlarmCBMap::iterator i = alarm_map_.begin();
-       i != alarm_map_.end();
-      ) {
-    if (i->first > now_in_us) {
-      break;
-    }
-    AlarmCB* cb = i->second;
-    // Execute the OnAlarm() only if we did not register
-    // it in this loop itself.
-    const bool added_in_this_round =
-        alarms_reregistered_and_should_be_skipped_.find(cb)
-        != alarms_reregistered_and_should_be_skipped_.end();
-    if (added_in_this_round) {
-      ++i;
-      continue;
-    }
+  while (!expired.empty()) {
+    AlarmCB* cb = alarm_wheel_.PopFront(&expired);
     all_alarms_.erase(cb);
     const int64 new_timeout_time_in_us = cb->OnAlarm();
 
-    erase_it = i;
-    ++i;
-    alarm_map_.erase(erase_it);
-
     if (new_timeout_time_in_us > 0) {
-      // We add to hash_set only if the new timeout is <= now_in_us.
-      // if timeout is > now_in_us then we have no fear that this alarm
-      // can be reexecuted in this loop, and hence we do not need to
-      // worry about a recursive loop.
       DVLOG(3) << "Reregistering alarm "
                << " " << cb
                << " " << new_timeout_time_in_us
                << " " << now_in_us;
-      if (new_timeout_time_in_us <= now_in_us) {
-        alarms_reregistered_and_should_be_skipped_.insert(cb);
-      }
       RegisterAlarm(new_timeout_time_in_us, cb);
     }
   }
-  alarms_reregistered_and_should_be_skipped_.clear();
 }
 
 EpollAlarm::EpollAlarm() : eps_(NULL), registered_(false) {
@@ -36,6 +36,7 @@
 #include "base/compiler_specific.h"
 #include "base/containers/hash_tables.h"
 #include "base/memory/scoped_ptr.h"
+#include "net/tools/epoll_server/alarm_timing_wheel.h"
 #include <sys/epoll.h>
 
 namespace net {
@@ -122,8 +123,7 @@ class EpollServer {
   typedef EpollAlarmCallbackInterface AlarmCB;
   typedef EpollCallbackInterface CB;
 
-  typedef std::multimap<int64, AlarmCB*> TimeToAlarmCBMap;
-  typedef TimeToAlarmCBMap::iterator AlarmRegToken;
+  typedef AlarmTimingWheel::Node* AlarmRegToken;
 
   // Summary:
   //   Constructor:
@@ -394,7 +394,7 @@ class EpollServer {
   //   be warned that a token may have become already invalid when OnAlarm()
   //   is called, was unregistered, or OnShutdown was called on that alarm.
   // Args:
-  //    iterator_token - iterator to the alarm callback to unregister.
+  //    iterator_token - the token of the alarm callback to unregister.
   virtual void UnregisterAlarm(
       const EpollServer::AlarmRegToken& iterator_token);
 
@@ -411,11 +411,12 @@ class EpollServer {
   virtual void Wake();
 
   // Summary:
-  //   Wrapper around WallTimer's NowInUsec.  We do this so that we can test
-  //   EpollServer without using the system clock (and can avoid the flakiness
-  //   that would ensue)
+  //   Wrapper around MonotonicClock::NowInUsec.  We do this so that we can
+  //   test EpollServer without using the system clock (and can avoid the
+  //   flakiness that would ensue)
   // Returns:
-  //   the current time as number of microseconds since the Unix epoch.
+  //   the current monotonic time in microseconds, which is unaffected by
+  //   steps of the wall clock and has an arbitrary epoch.
   virtual int64 NowInUsec() const;
 
   // Summary:
@@ -437,8 +438,7 @@ class EpollServer {
   //
   //   Users should be encouraged to use this function.
   // Returns:
-  //   the "approximate" current time as number of microseconds since the Unix
-  //   epoch.
+  //   the "approximate" current monotonic time in microseconds.
   virtual int64 ApproximateNowInUsec() const;
 
   static std::string EventMaskToString(int event_mask);
@@ -677,7 +677,9 @@ class EpollServer {
   typedef base::hash_set<AlarmCB*, AlarmCBHash> AlarmCBMap;
   AlarmCBMap all_alarms_;
 
-  TimeToAlarmCBMap alarm_map_;
+  // Registered alarms, by time.  Registering, unregistering and firing an
+  // alarm are O(1).
+  AlarmTimingWheel alarm_wheel_;
 
   // The amount of time in microseconds that we'll wait before returning
   // from the WaitForEventsAndExecuteCallbacks() function.
@@ -693,15 +695,6 @@ class EpollServer {
   // ApproximateNowInUs() function. See that function for more details.
   int64 recorded_now_in_us_;
 
-  // This is used to implement CallAndReregisterAlarmEvents. This stores
-  // all alarms that were reregistered because OnAlarm() returned a
-  // value > 0 and the time at which they should be executed is less that
-  // the current time.  By storing such alarms in this map we ensure
-  // that while calling CallAndReregisterAlarmEvents we do not call
-  // OnAlarm on any alarm in this set. This ensures that we do not
-  // go in an infinite loop.
-  AlarmCBMap alarms_reregistered_and_should_be_skipped_;
-
   LIST_HEAD(ReadyList, CBAndEventMask) ready_list_;
   LIST_HEAD(TmpList, CBAndEventMask) tmp_list_;
   int ready_list_size_;
@@ -945,7 +938,7 @@ class EpollServer {
  private:
   // Helper functions used in the destructor.
   void CleanupFDToCBMap();
-  void CleanupTimeToAlarmCBMap();
+  void CleanupAlarms();
 
   // The callback registered to the fds below.  As the purpose of their
   // registration is to wake the epoll server it just clears the pipe and
@@ -984,7 +977,7 @@ class EpollAlarmCallbackInterface {
   // Summary:
   //   Called when the an alarm is registered. Invalidates an AlarmRegToken.
   // Args:
-  //   token: the iterator to the the alarm registered in the alarm map.
+  //   token: the token of the alarm registered in the alarm wheel.
   //   WARNING: this token becomes invalid when the alarm fires, is
   //   unregistered, or OnShutdown is called on that alarm.
   //   eps: the epoll server the alarm is registered with.
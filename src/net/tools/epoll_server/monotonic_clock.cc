@@ -0,0 +1,101 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/epoll_server/monotonic_clock.h"
+
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define MONOTONIC_CLOCK_HAS_TSC 1
+#endif
+
+#include "base/logging.h"
+
+namespace net {
+
+namespace {
+
+const int64 kCalibrationUs = 20 * 1000;
+
+// Written once by EnableTsc(), before other threads start.
+bool g_tsc_enabled = false;
+uint64 g_base_tsc = 0;
+int64 g_base_us = 0;
+double g_us_per_tick = 0;
+
+#if defined(MONOTONIC_CLOCK_HAS_TSC)
+// Whether the TSC ticks at a constant rate in every P-, C- and T-state, as
+// reported by CPUID.80000007H:EDX[8].
+bool HasInvariantTsc() {
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 ||
+      eax < 0x80000007) {
+    return false;
+  }
+  if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0) {
+    return false;
+  }
+  return (edx & (1u << 8)) != 0;
+}
+#endif
+
+}  // namespace
+
+// static
+int64 MonotonicClock::NowInUsec() {
+#if defined(MONOTONIC_CLOCK_HAS_TSC)
+  if (g_tsc_enabled) {
+    return g_base_us +
+           static_cast<int64>((__rdtsc() - g_base_tsc) * g_us_per_tick);
+  }
+#endif
+  return SystemNowInUsec();
+}
+
+// static
+int64 MonotonicClock::SystemNowInUsec() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64>(now.tv_sec) * 1000 * 1000 + now.tv_nsec / 1000;
+}
+
+// static
+bool MonotonicClock::EnableTsc() {
+#if defined(MONOTONIC_CLOCK_HAS_TSC)
+  if (g_tsc_enabled) {
+    return true;
+  }
+  if (!HasInvariantTsc()) {
+    return false;
+  }
+  const int64 start_us = SystemNowInUsec();
+  const uint64 start_tsc = __rdtsc();
+  int64 end_us;
+  do {
+    end_us = SystemNowInUsec();
+  } while (end_us - start_us < kCalibrationUs);
+  const uint64 end_tsc = __rdtsc();
+  if (end_tsc <= start_tsc) {
+    return false;
+  }
+  g_us_per_tick =
+      static_cast<double>(end_us - start_us) / (end_tsc - start_tsc);
+  g_base_tsc = end_tsc;
+  g_base_us = end_us;
+  g_tsc_enabled = true;
+  DVLOG(1) << "TSC runs at " << 1 / g_us_per_tick << " ticks per us";
+  return true;
+#else
+  return false;
+#endif
+}
+
+// static
+bool MonotonicClock::tsc_enabled() {
+  return g_tsc_enabled;
+}
+
+}  // namespace net
@@ -0,0 +1,44 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_EPOLL_SERVER_MONOTONIC_CLOCK_H_
+#define NET_TOOLS_EPOLL_SERVER_MONOTONIC_CLOCK_H_
+
+#include "base/basictypes.h"
+
+namespace net {
+
+// MonotonicClock is the timebase of the EpollServer, and thus of every
+// QuicTime and alarm in the tools.  It reads CLOCK_MONOTONIC, which unlike
+// the wall clock never jumps when NTP or an administrator steps the system
+// time, so RTT samples, pacing and alarm deadlines stay meaningful across
+// clock adjustments.  Its values count microseconds from an arbitrary point
+// (usually boot) and must not be mixed with wall times.
+//
+// On x86 CPUs with an invariant TSC, EnableTsc() switches it to reading the
+// time stamp counter, calibrated against CLOCK_MONOTONIC, which avoids the
+// vDSO call and its seqlock retries.
+class MonotonicClock {
+ public:
+  // Returns the current monotonic time in microseconds.
+  static int64 NowInUsec();
+
+  // Returns CLOCK_MONOTONIC in microseconds, whether or not the TSC is
+  // enabled.
+  static int64 SystemNowInUsec();
+
+  // Calibrates the TSC for about 20 ms and makes NowInUsec() use it.  Returns
+  // false, leaving CLOCK_MONOTONIC in use, if the CPU has no invariant TSC.
+  // Must be called before any other thread reads the clock.
+  static bool EnableTsc();
+
+  static bool tsc_enabled();
+
+ private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(MonotonicClock);
+};
+
+}  // namespace net
+
+#endif  // NET_TOOLS_EPOLL_SERVER_MONOTONIC_CLOCK_H_
@@ -0,0 +1,151 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/file_cached_state_store.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "base/logging.h"
+#include "base/pickle.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/strings/string_number_conversions.h"
+#include "net/quic/quic_server_id.h"
+
+using std::string;
+
+namespace net {
+namespace tools {
+
+namespace {
+
+// Bumped whenever the file format changes; files of other versions are
+// ignored.
+const uint32 kFileVersion = 1;
+
+// Larger files are not ours.
+const off_t kMaxFileSize = 256 * 1024;
+
+bool ReadFileToString(const string& path, string* contents) {
+  int fd = HANDLE_EINTR(open(path.c_str(), O_RDONLY));
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  bool ok = fstat(fd, &st) == 0 && st.st_size <= kMaxFileSize;
+  if (ok) {
+    contents->resize(st.st_size);
+    size_t done = 0;
+    while (done < contents->size()) {
+      ssize_t rv = HANDLE_EINTR(
+          read(fd, &(*contents)[done], contents->size() - done));
+      if (rv <= 0) {
+        ok = false;
+        break;
+      }
+      done += rv;
+    }
+  }
+  IGNORE_EINTR(close(fd));
+  return ok;
+}
+
+bool WriteAll(int fd, const char* data, size_t length) {
+  while (length > 0) {
+    ssize_t rv = HANDLE_EINTR(write(fd, data, length));
+    if (rv < 0) {
+      return false;
+    }
+    data += rv;
+    length -= rv;
+  }
+  return true;
+}
+
+}  // namespace
+
+FileCachedStateStore::FileCachedStateStore(const string& directory)
+    : directory_(directory) {
+}
+
+FileCachedStateStore::~FileCachedStateStore() {
+}
+
+bool FileCachedStateStore::Load(const QuicServerId& server_id, State* state) {
+  string contents;
+  if (!ReadFileToString(PathFor(server_id), &contents)) {
+    return false;
+  }
+
+  base::Pickle pickle(contents.data(), contents.size());
+  base::PickleIterator iter(pickle);
+  uint32 version;
+  uint32 num_certs;
+  if (!iter.ReadUInt32(&version) || version != kFileVersion ||
+      !iter.ReadString(&state->server_config) ||
+      !iter.ReadString(&state->source_address_token) ||
+      !iter.ReadString(&state->server_config_sig) ||
+      !iter.ReadUInt32(&num_certs)) {
+    DVLOG(1) << "Ignoring unreadable state for " << server_id.ToString();
+    return false;
+  }
+  state->certs.clear();
+  for (uint32 i = 0; i < num_certs; ++i) {
+    string cert;
+    if (!iter.ReadString(&cert)) {
+      DVLOG(1) << "Ignoring unreadable state for " << server_id.ToString();
+      return false;
+    }
+    state->certs.push_back(cert);
+  }
+  return true;
+}
+
+void FileCachedStateStore::Save(const QuicServerId& server_id,
+                                const State& state) {
+  base::Pickle pickle;
+  pickle.WriteUInt32(kFileVersion);
+  pickle.WriteString(state.server_config);
+  pickle.WriteString(state.source_address_token);
+  pickle.WriteString(state.server_config_sig);
+  pickle.WriteUInt32(state.certs.size());
+  for (const string& cert : state.certs) {
+    pickle.WriteString(cert);
+  }
+
+  const string path = PathFor(server_id);
+  const string temp_path = path + ".tmp" + base::IntToString(getpid());
+  int fd = HANDLE_EINTR(
+      open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600));
+  if (fd < 0) {
+    LOG(WARNING) << "Failed to create " << temp_path << ": "
+                 << strerror(errno);
+    return;
+  }
+  bool ok = WriteAll(fd, static_cast<const char*>(pickle.data()),
+                     pickle.size());
+  ok = IGNORE_EINTR(close(fd)) == 0 && ok;
+  if (!ok || rename(temp_path.c_str(), path.c_str()) != 0) {
+    LOG(WARNING) << "Failed to write " << path << ": " << strerror(errno);
+    unlink(temp_path.c_str());
+  }
+}
+
+string FileCachedStateStore::PathFor(const QuicServerId& server_id) const {
+  // "https://example.com:443" is stored in "https___example.com_443".
+  string name = server_id.ToString();
+  for (char& c : name) {
+    if (!isalnum(static_cast<unsigned char>(c)) && c != '.' && c != '-') {
+      c = '_';
+    }
+  }
+  return directory_ + "/" + name;
+}
+
+}  // namespace tools
+}  // namespace net
@@ -0,0 +1,44 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// A CachedStateStore that keeps one file per server in a directory, so that
+// a restarted quic_client can reach 0-RTT with a server it has talked to.
+
+#ifndef NET_TOOLS_QUIC_FILE_CACHED_STATE_STORE_H_
+#define NET_TOOLS_QUIC_FILE_CACHED_STATE_STORE_H_
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "net/quic/crypto/cached_state_store.h"
+
+namespace net {
+namespace tools {
+
+class FileCachedStateStore : public CachedStateStore {
+ public:
+  // |directory| must exist.  Files are only read when a server is first
+  // looked up.
+  explicit FileCachedStateStore(const std::string& directory);
+  ~FileCachedStateStore() override;
+
+  // CachedStateStore implementation.
+  bool Load(const QuicServerId& server_id, State* state) override;
+  // Writes to a temporary file which is then renamed over the old one, so a
+  // reader never sees a partly written state.
+  void Save(const QuicServerId& server_id, const State& state) override;
+
+ private:
+  // Returns the path of the file holding the state of |server_id|.
+  std::string PathFor(const QuicServerId& server_id) const;
+
+  const std::string directory_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileCachedStateStore);
+};
+
+}  // namespace tools
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_FILE_CACHED_STATE_STORE_H_
@@ -8,6 +8,8 @@
 #include <unistd.h>
 #include <sys/mman.h>
 
+#include <algorithm>
+
 #include "net/tools/quic/file_downloader_server_stream.h"
 
 #include "net/tools/quic/quic_server_session.h"
@@ -23,19 +25,34 @@ using std::string;
 namespace net {
 namespace tools {
 
+namespace {
+
+// Part of a file mapped into memory, which is unmapped once the stream and
+// every packet carrying its bytes are done with it.  |address| must be page
+// aligned.
+class MappedFileSlice : public QuicSendBufferSlice {
+ public:
+  MappedFileSlice(char* address, size_t size)
+      : QuicSendBufferSlice(address, size), address_(address) {}
+
+ private:
+  ~MappedFileSlice() override { munmap(address_, length()); }
+
+  char* const address_;
+
+  DISALLOW_COPY_AND_ASSIGN(MappedFileSlice);
+};
+
+}  // namespace
+
 std::string FileDownloaderServerStream::HomeDir = "./";
 
 FileDownloaderServerStream::FileDownloaderServerStream(QuicStreamId id,
                                            QuicServerSession* session)
-    : ReliableQuicStream(id, session),
-      fd_(-1), file_mmap_address_(NULL), file_size_(0), sent_bytes_(0) {
+    : ReliableQuicStream(id, session) {
 }
 
 FileDownloaderServerStream::~FileDownloaderServerStream() {
-  if (fd_ != -1) {
-    munmap(file_mmap_address_, file_size_);
-    close(fd_);
-  }
 }
 
 void FileDownloaderServerStream::OnDataAvailable() {
@@ -70,70 +87,56 @@ void FileDownloaderServerStream::OnDataAvailable() {
 void FileDownloaderServerStream::StartFileDownload() {
   DVLOG(1) << "Sending file (" << request_ << ") on stream " << id();
 
-  if (!MapFileIntoMemory()) {
+  QuicSendBufferSlices file;
+  if (!MapFileIntoMemory(&file)) {
     // Just close the stream.
     WriteOrBufferData("", true, nullptr);
     return;
   }
 
-//  std::string data(200000, 0);
-//  WriteOrBufferData(data, true, nullptr);
-
-  SendNextFileBlock();
-}
-
-void FileDownloaderServerStream::SendNextFileBlock() {
-  struct iovec iov = {
-    static_cast<uint8_t*>(file_mmap_address_) + sent_bytes_,
-    file_size_ - sent_bytes_
-  };
-
+  // The stream sends the file as flow control allows, and the packets point
+  // straight into the mapping.
   // TODO(dimm): do we need to be notified when all data has been sent?
-  QuicConsumedData consumed_data = WritevData(&iov, 1, true, nullptr);
-  sent_bytes_ += consumed_data.bytes_consumed;
-  DVLOG(1) << "===> Sent " << sent_bytes_ << " bytes";
-
-  if (sent_bytes_ == file_size_) {
-    DVLOG(1) << "=====> Done!";
-    // TODO(dimm): perhaps unmap/close the file here. Currently it will be done
-    // when the stream closes.
-  }
-}
-
-void FileDownloaderServerStream::OnCanWrite() {
-  DVLOG(1) << "@@@@@ OnCanWrite";
-  if (sent_bytes_ < file_size_) {
-    SendNextFileBlock();
-  }
+  WriteOrBufferSlices(file, true, nullptr);
 }
 
 // TODO(dimm): We map a complete file into memory. This may be problematic on
 // 32bit systems and big files. If this proves to be a problem, we can map
 // a big file in chunks (one after another) or use another interface
 // (e.g. read() at the cost of extra copying).
-bool FileDownloaderServerStream::MapFileIntoMemory() {
-  fd_ = open(request_.c_str(), O_RDONLY);
-  if (fd_ == -1) {
+bool FileDownloaderServerStream::MapFileIntoMemory(
+    QuicSendBufferSlices* slices) {
+  int fd = open(request_.c_str(), O_RDONLY);
+  if (fd == -1) {
     DLOG(ERROR) << "Failed to open() " << request_;
     return false;
   }
 
   struct stat file_stats;
-  if (fstat(fd_, &file_stats) == -1) {
+  if (fstat(fd, &file_stats) == -1) {
     DLOG(ERROR) << "Failed to stat() " << request_;
-    close(fd_);
-    fd_ = -1;
+    close(fd);
     return false;
   }
-  file_size_ = file_stats.st_size;
+  size_t file_size = file_stats.st_size;
 
-  file_mmap_address_ = mmap(NULL, file_size_, PROT_READ, MAP_PRIVATE, fd_, 0);
-  if (file_mmap_address_ == MAP_FAILED) {
+  void* address = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping outlives the descriptor.
+  close(fd);
+  if (address == MAP_FAILED) {
     DLOG(ERROR) << "Failed to mmap() " << request_;
-    close(fd_);
-    fd_ = -1;
     return false;
   }
+  // munmap() takes whole pages, so the slices split the mapping on page
+  // boundaries.
+  DCHECK_EQ(0u, kMaxSendBufferSliceSize % getpagesize());
+  char* const data = static_cast<char*>(address);
+  for (size_t offset = 0; offset < file_size;
+       offset += kMaxSendBufferSliceSize) {
+    slices->push_back(make_scoped_refptr(new MappedFileSlice(
+        data + offset,
+        std::min(kMaxSendBufferSliceSize, file_size - offset))));
+  }
   return true;
 }
 
@@ -8,8 +8,10 @@
 #include <string>
 
 #include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
 #include "net/quic/reliable_quic_stream.h"
 #include "net/quic/quic_protocol.h"
+#include "net/quic/quic_send_buffer_slice.h"
 
 namespace net {
 
@@ -26,7 +28,6 @@ class FileDownloaderServerStream : public ReliableQuicStream {
   // ReliableQuicStream implementation called by the session when there's
   // data for us.
   void OnDataAvailable() override;
-  void OnCanWrite() override;
   QuicPriority EffectivePriority() const override { return kDefaultPriority; }
 
   static void SetHomeDir(const std::string& home_dir) {
@@ -34,21 +35,17 @@ class FileDownloaderServerStream : public ReliableQuicStream {
   }
 
  protected:
-  bool MapFileIntoMemory();
+  // Maps the requested file into memory as |slices| of at most
+  // kMaxSendBufferSliceSize bytes, each unmapping its own pages once it is
+  // released.  Returns false on failure.
+  bool MapFileIntoMemory(QuicSendBufferSlices* slices);
   void StartFileDownload();
-  void SendNextFileBlock();
 
  private:
   static std::string HomeDir;
 
   std::string request_;
 
-  // TODO(dimm): Consider using Chromium's base/files/memory_mapped_file.h.
-  int fd_;
-  void* file_mmap_address_;
-  size_t file_size_;
-  size_t sent_bytes_;
-
   DISALLOW_COPY_AND_ASSIGN(FileDownloaderServerStream);
 };
 
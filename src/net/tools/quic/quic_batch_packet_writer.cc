@@ -0,0 +1,169 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_batch_packet_writer.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/stl_util.h"
+#include "net/tools/quic/quic_socket_utils.h"
+
+namespace net {
+namespace tools {
+
+QuicBatchPacketWriter::QuicBatchPacketWriter(int fd)
+    : QuicDefaultPacketWriter(fd),
+      packets_sent_(0),
+      packets_dropped_(0),
+      write_calls_(0) {
+  memset(mmsg_hdr_, 0, sizeof(mmsg_hdr_));
+}
+
+QuicBatchPacketWriter::~QuicBatchPacketWriter() {
+  STLDeleteElements(&buffered_packets_);
+  STLDeleteElements(&free_packets_);
+}
+
+WriteResult QuicBatchPacketWriter::WritePacket(
+    const char* buffer,
+    size_t buf_len,
+    const IPAddressNumber& self_address,
+    const IPEndPoint& peer_address) {
+  DCHECK(!IsWriteBlocked());
+  DCHECK_LE(buf_len, kMaxPacketSize);
+  WriteResult flush_result(WRITE_STATUS_OK, 0);
+  if (buffered_packets_.size() >=
+      static_cast<size_t>(kMaxPacketsPerWriteMmsgCall)) {
+    flush_result = Flush();
+  }
+
+  BufferedPacket* packet;
+  if (free_packets_.empty()) {
+    packet = new BufferedPacket;
+  } else {
+    packet = free_packets_.back();
+    free_packets_.pop_back();
+  }
+  memcpy(packet->buffer, buffer, buf_len);
+  packet->length = buf_len;
+  packet->self_address = self_address;
+  packet->peer_address = peer_address;
+  buffered_packets_.push_back(packet);
+  if (flush_result.status == WRITE_STATUS_BLOCKED) {
+    // The packet is buffered, but the caller must not write more until
+    // SetWritable() is called, and must learn that it is blocked.
+    return flush_result;
+  }
+  return WriteResult(WRITE_STATUS_OK, buf_len);
+}
+
+bool QuicBatchPacketWriter::IsWriteBlockedDataBuffered() const {
+  return true;
+}
+
+WriteResult QuicBatchPacketWriter::Flush() {
+  size_t bytes_written = 0;
+  while (!buffered_packets_.empty()) {
+    WriteResult result = WriteBufferedPackets(std::min<int>(
+        buffered_packets_.size(), kMaxPacketsPerWriteMmsgCall));
+    if (result.status != WRITE_STATUS_OK) {
+      return result;
+    }
+    bytes_written += result.bytes_written;
+  }
+  return WriteResult(WRITE_STATUS_OK, bytes_written);
+}
+
+WriteResult QuicBatchPacketWriter::WriteBufferedPackets(int num_packets) {
+  DCHECK_LE(num_packets, kMaxPacketsPerWriteMmsgCall);
+  DCHECK_LE(static_cast<size_t>(num_packets), buffered_packets_.size());
+  for (int i = 0; i < num_packets; ++i) {
+    SetMsgHdr(i, buffered_packets_[i]);
+  }
+
+  int rc = sendmmsg(fd(), mmsg_hdr_, num_packets, 0);
+  if (rc < 0) {
+    OnWriteCallFailed();
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      set_write_blocked(true);
+      return WriteResult(WRITE_STATUS_BLOCKED, errno);
+    }
+    // The first packet cannot be sent.  It may belong to any connection
+    // sharing the writer, so rather than failing the caller's connection it
+    // is dropped, like a packet lost in the network, and the flush goes on.
+    DropFirstBufferedPacket(errno);
+    return WriteResult(WRITE_STATUS_OK, 0);
+  }
+
+  // A short count means the next packet would have failed; the following
+  // sendmmsg call reports why.
+  size_t bytes_written = 0;
+  for (int i = 0; i < rc; ++i) {
+    bytes_written += mmsg_hdr_[i].msg_len;
+  }
+  OnBufferedPacketsSent(rc);
+  return WriteResult(WRITE_STATUS_OK, bytes_written);
+}
+
+void QuicBatchPacketWriter::OnBufferedPacketsSent(int num_packets) {
+  for (int i = 0; i < num_packets; ++i) {
+    free_packets_.push_back(buffered_packets_.front());
+    buffered_packets_.pop_front();
+  }
+  packets_sent_ += num_packets;
+  ++write_calls_;
+}
+
+void QuicBatchPacketWriter::DropFirstBufferedPacket(int error) {
+  // Logs the first of every thousand drops.
+  LOG_IF(WARNING, packets_dropped_ % 1000 == 0)
+      << "Dropping a packet to "
+      << buffered_packets_.front()->peer_address.ToString()
+      << " after a write error: " << strerror(error) << " ("
+      << packets_dropped_ + 1 << " dropped so far)";
+  ++packets_dropped_;
+  free_packets_.push_back(buffered_packets_.front());
+  buffered_packets_.pop_front();
+}
+
+// static
+void QuicBatchPacketWriter::SetIpInfo(const IPAddressNumber& self_address,
+                                      char* cbuf,
+                                      size_t cbuf_len,
+                                      msghdr* hdr) {
+  if (self_address.empty()) {
+    hdr->msg_control = nullptr;
+    hdr->msg_controllen = 0;
+    return;
+  }
+  hdr->msg_control = cbuf;
+  hdr->msg_controllen = cbuf_len;
+  cmsghdr* cmsg = CMSG_FIRSTHDR(hdr);
+  QuicSocketUtils::SetIpInfoInCmsg(self_address, cmsg);
+  hdr->msg_controllen = cmsg->cmsg_len;
+}
+
+void QuicBatchPacketWriter::SetMsgHdr(int index, BufferedPacket* packet) {
+  socklen_t address_len = sizeof(raw_address_[index]);
+  CHECK(packet->peer_address.ToSockAddr(
+      reinterpret_cast<sockaddr*>(&raw_address_[index]), &address_len));
+  iov_[index].iov_base = packet->buffer;
+  iov_[index].iov_len = packet->length;
+
+  msghdr* hdr = &mmsg_hdr_[index].msg_hdr;
+  hdr->msg_name = &raw_address_[index];
+  hdr->msg_namelen = address_len;
+  hdr->msg_iov = &iov_[index];
+  hdr->msg_iovlen = 1;
+  hdr->msg_flags = 0;
+  mmsg_hdr_[index].msg_len = 0;
+  SetIpInfo(packet->self_address, cbuf_[index], sizeof(cbuf_[index]), hdr);
+}
+
+}  // namespace tools
+}  // namespace net
@@ -0,0 +1,130 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_QUIC_QUIC_BATCH_PACKET_WRITER_H_
+#define NET_TOOLS_QUIC_QUIC_BATCH_PACKET_WRITER_H_
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <deque>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "net/base/ip_endpoint.h"
+#include "net/quic/quic_protocol.h"
+#include "net/tools/quic/quic_default_packet_writer.h"
+
+namespace net {
+namespace tools {
+
+// The most packets handed to the kernel by one sendmmsg call.
+const int kMaxPacketsPerWriteMmsgCall = 32;
+
+// A packet writer which copies packets into its own buffers and sends them
+// with a single sendmmsg call when Flush() is called.  WritePacket always
+// buffers the packet, and returns WRITE_STATUS_BLOCKED if flushing a full
+// batch blocked.  If the socket blocks part-way through a flush, the unsent
+// packets stay buffered and are sent by a later flush, so
+// IsWriteBlockedDataBuffered() is true.
+//
+// One writer is shared by all the connections of a dispatcher, so a packet
+// the kernel rejects is dropped and counted rather than reported as an error
+// to whichever connection happened to flush.
+class QuicBatchPacketWriter : public QuicDefaultPacketWriter {
+ public:
+  explicit QuicBatchPacketWriter(int fd);
+  ~QuicBatchPacketWriter() override;
+
+  // QuicPacketWriter
+  WriteResult WritePacket(const char* buffer,
+                          size_t buf_len,
+                          const IPAddressNumber& self_address,
+                          const IPEndPoint& peer_address) override;
+  bool IsWriteBlockedDataBuffered() const override;
+  WriteResult Flush() override;
+
+  // Number of packets waiting for a flush.
+  size_t buffered_packets() const { return buffered_packets_.size(); }
+
+  // Number of packets the kernel accepted.
+  uint64 packets_sent() const { return packets_sent_; }
+
+  // Number of packets dropped because the kernel rejected them.
+  uint64 packets_dropped() const { return packets_dropped_; }
+
+  // Number of send system calls made, including ones which failed.
+  uint64 write_calls() const { return write_calls_; }
+
+  // Average number of packets sent per send system call.
+  double packets_per_write_call() const {
+    return write_calls_ == 0 ? 0 : static_cast<double>(packets_sent_) /
+                                       write_calls_;
+  }
+
+ protected:
+  struct BufferedPacket {
+    char buffer[kMaxPacketSize];
+    size_t length;
+    IPAddressNumber self_address;
+    IPEndPoint peer_address;
+  };
+
+  // Sends the first |num_packets| buffered packets with one sendmmsg call and
+  // releases the ones the kernel accepted.  On WRITE_STATUS_OK,
+  // |bytes_written| is the number of bytes sent, which may cover fewer than
+  // |num_packets| packets.  Returns WRITE_STATUS_BLOCKED if the socket is
+  // blocked, and drops the first packet if the kernel rejects it.
+  WriteResult WriteBufferedPackets(int num_packets);
+
+  // Recycles the first |num_packets| buffered packets after they were sent
+  // and counts them, and the system call which sent them.
+  void OnBufferedPacketsSent(int num_packets);
+
+  // Drops and counts the first buffered packet after write error |error|.
+  void DropFirstBufferedPacket(int error);
+
+  // Records a send system call which failed.
+  void OnWriteCallFailed() { ++write_calls_; }
+
+  // Packets waiting to be sent, in the order they were written.
+  const std::deque<BufferedPacket*>& buffered_packet_queue() const {
+    return buffered_packets_;
+  }
+
+  // Fills in the control message carrying |self_address| for |hdr|, using
+  // |cbuf| of |cbuf_len| bytes.
+  static void SetIpInfo(const IPAddressNumber& self_address,
+                        char* cbuf,
+                        size_t cbuf_len,
+                        msghdr* hdr);
+
+ private:
+  // Fills in the |index|th message header for |packet|.
+  void SetMsgHdr(int index, BufferedPacket* packet);
+
+  // Packets waiting to be sent, in the order they were written.
+  std::deque<BufferedPacket*> buffered_packets_;
+  // Sent packets kept around for reuse, so that steady state writes do not
+  // allocate.
+  std::vector<BufferedPacket*> free_packets_;
+
+  uint64 packets_sent_;
+  uint64 packets_dropped_;
+  uint64 write_calls_;
+
+  // Storage for the sendmmsg call.
+  mmsghdr mmsg_hdr_[kMaxPacketsPerWriteMmsgCall];
+  iovec iov_[kMaxPacketsPerWriteMmsgCall];
+  sockaddr_storage raw_address_[kMaxPacketsPerWriteMmsgCall];
+  // cbuf_ holds the IP_PKTINFO or IPV6_PKTINFO control message of each packet.
+  char cbuf_[kMaxPacketsPerWriteMmsgCall][CMSG_SPACE(sizeof(in6_pktinfo))];
+
+  DISALLOW_COPY_AND_ASSIGN(QuicBatchPacketWriter);
+};
+
+}  // namespace tools
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_BATCH_PACKET_WRITER_H_
@@ -0,0 +1,1372 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// A benchmark which runs a QuicServer and a QuicClient in one process and
+// downloads a file over loopback with the FileDownloader streams, optionally
+// through a simulated link with --delay_ms, --bandwidth_kbps, --loss_percent
+// and --queue_bytes in each direction.  Every result is printed as one line of
+// JSON,
+//
+//   {"benchmark":"transfer","params":{...},"results":{...}}
+//
+// so that runs of different builds can be collected and compared.  The
+// transfer benchmark reports goodput, CPU time per byte and operator new
+// calls per packet; the handshake benchmark reports connection latency with
+// and without a cached server config; the storm benchmark reports the rate of
+// concurrent new handshakes and the request latency of a connection
+// established before them, and the workers benchmark the same rate against 1
+// to 8 workers sharing the port; the clock benchmark reports the cost
+// of reading each time source; the seal benchmark reports packets encrypted
+// per second of CPU time, into a separate buffer and in place.  The
+// microbenchmarks of quic_microbenchmarks.h run under their own names.
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+#include "base/command_line.h"
+#include "base/compiler_specific.h"
+#include "base/json/json_writer.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+#include "base/values.h"
+#include "net/base/ip_endpoint.h"
+#include "net/quic/crypto/crypto_protocol.h"
+#include "net/quic/crypto/file_proof_source.h"
+#include "net/quic/crypto/quic_encrypter.h"
+#include "net/quic/crypto/quic_random.h"
+#include "net/quic/quic_bandwidth.h"
+#include "net/quic/quic_clock.h"
+#include "net/quic/quic_connection.h"
+#include "net/quic/quic_flags.h"
+#include "net/quic/quic_framer.h"
+#include "net/quic/quic_protocol.h"
+#include "net/quic/quic_server_id.h"
+#include "net/quic/quic_utils.h"
+#include "net/tools/epoll_server/epoll_server.h"
+#include "net/tools/epoll_server/monotonic_clock.h"
+#include "net/tools/quic/file_cached_state_store.h"
+#include "net/tools/quic/quic_client.h"
+#include "net/tools/quic/quic_client_session.h"
+#include "net/tools/quic/quic_epoll_clock.h"
+#include "net/tools/quic/quic_link_packet_writer.h"
+#include "net/tools/quic/quic_microbenchmarks.h"
+#include "net/tools/quic/quic_server.h"
+#include "net/tools/quic/quic_server_worker_pool.h"
+
+using std::string;
+
+// Comma separated benchmarks to run: transfer, handshake, storm, clock, seal,
+// strike_register, ack, xor, sequencer, alarms, certs, dispatch, workers,
+// gso.
+string FLAGS_benchmarks = "transfer,handshake";
+// The size of the downloaded file.
+int32 FLAGS_file_bytes = 16 * 1024 * 1024;
+// The number of downloads, each on a new connection.
+int32 FLAGS_transfers = 3;
+// The number of connections made by each handshake benchmark.
+int32 FLAGS_handshakes = 20;
+// The number of threads making new connections in the storm and workers
+// benchmarks.
+int32 FLAGS_storm_threads = 4;
+// The number of connections made by the storm benchmark, and by each step of
+// the workers benchmark, across their threads.
+int32 FLAGS_storm_handshakes = 400;
+// The number of times the clock benchmark reads each time source.
+int32 FLAGS_clock_calls = 10 * 1000 * 1000;
+// The number of packets the seal benchmark encrypts per algorithm and mode.
+int32 FLAGS_seal_packets = 320 * 1000;
+// The number of nonces the strike_register benchmark checks per run.
+int32 FLAGS_strike_register_nonces = 1000 * 1000;
+// The number of packets the ack benchmark receives per loss rate.
+int32 FLAGS_ack_packets = 1000 * 1000;
+// The number of payloads the xor benchmark XORs per kernel.
+int32 FLAGS_xor_payloads = 1000 * 1000;
+// The number of frames the sequencer benchmark buffers per arrival order.
+int32 FLAGS_sequencer_frames = 1000 * 1000;
+// The number of alarms the alarms benchmark reschedules per alarm count.
+int32 FLAGS_alarm_reschedules = 1000 * 1000;
+// The number of client hellos the certs benchmark answers per flood.
+int32 FLAGS_cert_hellos = 20 * 1000;
+// The number of packets the dispatch benchmark dispatches per session count.
+int32 FLAGS_dispatch_packets = 10 * 1000 * 1000;
+// The number of packets the gso benchmark sends with each writer.
+int32 FLAGS_gso_packets = 1000 * 1000;
+// If true, the epoll servers read the time from the calibrated TSC.
+bool FLAGS_tsc_clock = false;
+// cubic, reno or bbr.
+string FLAGS_congestion_control = "cubic";
+// One-way delay of the simulated link.
+int32 FLAGS_delay_ms = 0;
+// Bottleneck bandwidth of the simulated link.  Zero is unlimited.
+int32 FLAGS_bandwidth_kbps = 0;
+// Random loss of the simulated link.
+double FLAGS_loss_percent = 0;
+// Drop-tail queue of the simulated link.  Zero is unlimited.
+int32 FLAGS_queue_bytes = 0;
+// Seeds the choice of lost packets.
+int32 FLAGS_seed = 1;
+// Server options, as for quic_server.
+bool FLAGS_sendmmsg = false;
+bool FLAGS_gso = false;
+int32 FLAGS_packets_per_read = 1;
+int32 FLAGS_crypto_threads = 0;
+string FLAGS_certificate_chains = "";
+// The existing directory the resumed handshake benchmark persists client state
+// in.  Empty uses a temporary directory which is removed afterwards.
+string FLAGS_state_dir = "";
+// Copied into the params of every result, e.g. to name the build.
+string FLAGS_label = "";
+// The file results are appended to.  Empty prints them.
+string FLAGS_output = "";
+
+namespace {
+
+// The name of the downloaded file in the working directory.  The client
+// stores it with a leading underscore.
+const char kFileName[] = "benchmark_file";
+const char kDownloadedFileName[] = "_benchmark_file";
+// The small file requested over the established connection of the storm
+// benchmark.
+const char kProbeFileName[] = "benchmark_probe";
+const char kDownloadedProbeFileName[] = "_benchmark_probe";
+const int32 kProbeFileBytes = 1000;
+
+// The number of server config signatures the proof source caches.
+const size_t kMaxCachedSignatures = 64;
+
+// The number of calls to operator new, from any thread.
+base::subtle::AtomicWord g_allocations = 0;
+
+int64 GetAllocations() {
+  return base::subtle::NoBarrier_Load(&g_allocations);
+}
+
+// Returns the CPU time used by all threads of the process.
+int64 GetProcessCpuUs() {
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000LL +
+         usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+// Returns the CPU time used by the calling thread.
+int64 GetThreadCpuUs() {
+  struct timespec now;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) != 0) {
+    return 0;
+  }
+  return static_cast<int64>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+// Where the clock benchmark stores the sum of its readings.
+volatile int64 g_clock_sink = 0;
+
+// Returns the nanoseconds per call of reading |clock| FLAGS_clock_calls
+// times.  The readings are summed into |sink| so that they are not optimized
+// away.
+template <typename Clock>
+double MeasureClock(const Clock& clock, int64* sink) {
+  const base::TimeTicks start = base::TimeTicks::Now();
+  for (int32 i = 0; i < FLAGS_clock_calls; ++i) {
+    *sink += clock();
+  }
+  const base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+  return elapsed.InMicroseconds() * 1000.0 / std::max(FLAGS_clock_calls, 1);
+}
+
+struct WallClock {
+  int64 operator()() const { return base::Time::Now().ToInternalValue(); }
+};
+
+struct SystemMonotonicClock {
+  int64 operator()() const { return net::MonotonicClock::SystemNowInUsec(); }
+};
+
+struct TscClock {
+  int64 operator()() const { return net::MonotonicClock::NowInUsec(); }
+};
+
+struct DefaultQuicClock {
+  int64 operator()() const { return clock.Now().ToDebuggingValue(); }
+  net::QuicClock clock;
+};
+
+struct EpollClockNow {
+  explicit EpollClockNow(net::EpollServer* epoll_server)
+      : clock(epoll_server) {}
+  int64 operator()() const { return clock.Now().ToDebuggingValue(); }
+  net::tools::QuicEpollClock clock;
+};
+
+struct EpollClockApproximateNow {
+  explicit EpollClockApproximateNow(net::EpollServer* epoll_server)
+      : clock(epoll_server) {}
+  int64 operator()() const { return clock.ApproximateNow().ToDebuggingValue(); }
+  net::tools::QuicEpollClock clock;
+};
+
+// Measures QuicEpollClock::ApproximateNow() from an alarm, where it returns
+// the time cached by the event loop as it does for connections.
+class ApproximateNowAlarm : public net::EpollAlarm {
+ public:
+  ApproximateNowAlarm(net::EpollServer* epoll_server, int64* sink)
+      : clock_(epoll_server), sink_(sink), ns_per_call_(0) {}
+
+  int64 OnAlarm() override {
+    ns_per_call_ = MeasureClock(clock_, sink_);
+    return EpollAlarm::OnAlarm();
+  }
+
+  double ns_per_call() const { return ns_per_call_; }
+
+ private:
+  EpollClockApproximateNow clock_;
+  int64* sink_;
+  double ns_per_call_;
+
+  DISALLOW_COPY_AND_ASSIGN(ApproximateNowAlarm);
+};
+
+// Removes |directory| and the files in it.
+void RemoveDirectory(const string& directory) {
+  DIR* dir = opendir(directory.c_str());
+  if (dir == nullptr) {
+    PLOG(WARNING) << "Unable to open " << directory;
+    return;
+  }
+  while (const dirent* entry = readdir(dir)) {
+    const string name = entry->d_name;
+    if (name != "." && name != ".." &&
+        unlink((directory + "/" + name).c_str()) != 0) {
+      PLOG(WARNING) << "Unable to remove " << name << " from " << directory;
+    }
+  }
+  closedir(dir);
+  if (rmdir(directory.c_str()) != 0) {
+    PLOG(WARNING) << "Unable to remove " << directory;
+  }
+}
+
+// Returns a proof source serving FLAGS_certificate_chains, or null if a chain
+// can not be loaded.
+net::ProofSource* CreateProofSource() {
+  scoped_ptr<net::FileProofSource> proof_source(
+      new net::FileProofSource(kMaxCachedSignatures));
+  for (const string& entry : base::SplitString(
+           FLAGS_certificate_chains, ",", base::TRIM_WHITESPACE,
+           base::SPLIT_WANT_NONEMPTY)) {
+    std::vector<string> parts = base::SplitString(
+        entry, ":", base::TRIM_WHITESPACE, base::SPLIT_WANT_ALL);
+    if (parts.size() != 3 ||
+        !proof_source->AddCertificateChain(parts[0], parts[1], parts[2])) {
+      LOG(ERROR) << "Bad --certificate_chains entry: " << entry;
+      return nullptr;
+    }
+  }
+  return proof_source.release();
+}
+
+net::tools::QuicLinkParameters GetLinkParameters(uint64 seed) {
+  net::tools::QuicLinkParameters link;
+  link.bandwidth = net::QuicBandwidth::FromKBitsPerSecond(FLAGS_bandwidth_kbps);
+  link.delay = net::QuicTime::Delta::FromMilliseconds(FLAGS_delay_ms);
+  link.loss_rate = FLAGS_loss_percent / 100;
+  link.queue_bytes = FLAGS_queue_bytes;
+  link.seed = seed;
+  return link;
+}
+
+// A server whose packets cross the simulated link.
+class BenchmarkServer : public net::tools::QuicServer {
+ public:
+  BenchmarkServer(const net::QuicConfig& config,
+                  const net::QuicVersionVector& supported_versions)
+      : QuicServer(config, supported_versions), writer_(nullptr) {}
+
+  // Valid after Listen().
+  net::tools::QuicLinkPacketWriter* writer() { return writer_; }
+
+ protected:
+  net::QuicPacketWriter* CreateWriter(int fd) override {
+    writer_ = new net::tools::QuicLinkPacketWriter(
+        QuicServer::CreateWriter(fd), epoll_server(),
+        GetLinkParameters(FLAGS_seed));
+    return writer_;
+  }
+
+ private:
+  net::tools::QuicLinkPacketWriter* writer_;  // Owned by the dispatcher.
+
+  DISALLOW_COPY_AND_ASSIGN(BenchmarkServer);
+};
+
+// A client whose packets cross the simulated link.
+class BenchmarkClient : public net::tools::QuicClient {
+ public:
+  BenchmarkClient(net::IPEndPoint server_address,
+                  const net::QuicServerId& server_id,
+                  const net::QuicConfig& config,
+                  net::EpollServer* epoll_server)
+      : QuicClient(server_address, server_id, net::QuicSupportedVersions(),
+                   config, epoll_server),
+        writer_(nullptr) {}
+
+  // The writer of the latest connection.
+  net::tools::QuicLinkPacketWriter* writer() { return writer_; }
+
+ protected:
+  net::QuicPacketWriter* CreateQuicPacketWriter() override {
+    writer_ = new net::tools::QuicLinkPacketWriter(
+        QuicClient::CreateQuicPacketWriter(), epoll_server(),
+        GetLinkParameters(FLAGS_seed + 1));
+    return writer_;
+  }
+
+ private:
+  net::tools::QuicLinkPacketWriter* writer_;  // Owned by QuicClient.
+
+  DISALLOW_COPY_AND_ASSIGN(BenchmarkClient);
+};
+
+// Runs the server's event loop while started.  Stopping it lets the main
+// thread read the server's counters.
+class ServerThread : public base::PlatformThread::Delegate {
+ public:
+  explicit ServerThread(net::tools::QuicServer* server)
+      : server_(server), stopping_(0) {}
+  ~ServerThread() override {}
+
+  bool Start() {
+    base::subtle::NoBarrier_Store(&stopping_, 0);
+    return base::PlatformThread::Create(0, this, &handle_);
+  }
+
+  void Stop() {
+    base::subtle::Release_Store(&stopping_, 1);
+    base::PlatformThread::Join(handle_);
+  }
+
+  // base::PlatformThread::Delegate implementation.
+  void ThreadMain() override {
+    base::PlatformThread::SetName("QuicBenchmarkServer");
+    while (base::subtle::Acquire_Load(&stopping_) == 0) {
+      server_->WaitForEvents();
+    }
+  }
+
+ private:
+  net::tools::QuicServer* server_;  // Not owned.
+  base::subtle::Atomic32 stopping_;
+  base::PlatformThreadHandle handle_;
+
+  DISALLOW_COPY_AND_ASSIGN(ServerThread);
+};
+
+class Benchmark {
+ public:
+  Benchmark(BenchmarkServer* server, std::ostream* out)
+      : server_(server),
+        server_thread_(server),
+        out_(out) {
+    net::IPAddressNumber loopback;
+    CHECK(net::ParseIPLiteralToNumber("127.0.0.1", &loopback));
+    server_address_ = net::IPEndPoint(loopback, server->port());
+
+    net::QuicTagVector copt;
+    if (FLAGS_congestion_control == "reno") {
+      copt.push_back(net::kRENO);
+    } else if (FLAGS_congestion_control == "bbr") {
+      copt.push_back(net::kTBBR);
+    }
+    config_.SetConnectionOptionsToSend(copt);
+  }
+
+  // Downloads the file FLAGS_transfers times.
+  bool RunTransfers() {
+    for (int run = 0; run < FLAGS_transfers; ++run) {
+      scoped_ptr<base::DictionaryValue> results(new base::DictionaryValue);
+      if (!RunTransfer(results.get())) {
+        return false;
+      }
+      results->SetInteger("run", run);
+      Print("transfer", results.Pass());
+    }
+    return true;
+  }
+
+  // Connects FLAGS_handshakes times, with a new client each time.  Unless
+  // |resume|, every client starts without state and needs a full handshake.
+  // If |resume|, every client loads the server config and source address token
+  // which a first, unmeasured connection persisted in FLAGS_state_dir, as a
+  // restarted client would, and can complete the handshake in 0-RTT.
+  bool RunHandshakes(bool resume) {
+    string state_dir = FLAGS_state_dir;
+    if (resume && state_dir.empty()) {
+      char temp_dir[] = "/tmp/quic_benchmark_state.XXXXXX";
+      if (mkdtemp(temp_dir) == nullptr) {
+        PLOG(ERROR) << "Unable to create a state directory";
+        return false;
+      }
+      state_dir = temp_dir;
+    }
+
+    std::vector<int64> established_us;
+    std::vector<int64> confirmed_us;
+    int client_hellos = 0;
+    int zero_rtt_connections = 0;
+    int failures = 0;
+
+    net::EpollServer epoll_server;
+    scoped_ptr<BenchmarkClient> client;
+    if (!server_thread_.Start()) {
+      LOG(ERROR) << "Unable to start the server thread";
+      return false;
+    }
+    for (int i = resume ? -1 : 0; i < FLAGS_handshakes; ++i) {
+      client.reset(NewClient(&epoll_server));
+      if (resume) {
+        client->SetCachedStateStore(
+            new net::tools::FileCachedStateStore(state_dir));
+      }
+      if (!client->Initialize()) {
+        LOG(ERROR) << "Failed to initialize the client";
+        break;
+      }
+      const base::TimeTicks start = base::TimeTicks::Now();
+      const bool connected = client->Connect();
+      const base::TimeTicks established = base::TimeTicks::Now();
+      if (connected) {
+        client->WaitForCryptoHandshakeConfirmed();
+      }
+      if (!client->connected()) {
+        ++failures;
+      } else if (i >= 0) {
+        established_us.push_back((established - start).InMicroseconds());
+        confirmed_us.push_back(
+            (base::TimeTicks::Now() - start).InMicroseconds());
+        const int hellos = client->session()->GetNumSentClientHellos();
+        client_hellos += hellos;
+        // A full handshake is rejected once before the server config is
+        // known.
+        if (hellos == 1) {
+          ++zero_rtt_connections;
+        }
+      }
+      client->Disconnect();
+    }
+    client.reset();
+    server_thread_.Stop();
+    if (resume && FLAGS_state_dir.empty()) {
+      RemoveDirectory(state_dir);
+    }
+
+    if (established_us.empty()) {
+      LOG(ERROR) << "No connection was established";
+      return false;
+    }
+    scoped_ptr<base::DictionaryValue> results(new base::DictionaryValue);
+    results->SetBoolean("resume", resume);
+    results->SetInteger("connections", established_us.size());
+    results->SetInteger("failures", failures);
+    results->SetInteger("zero_rtt_connections", zero_rtt_connections);
+    results->SetDouble("client_hellos_per_connection",
+                       static_cast<double>(client_hellos) /
+                           established_us.size());
+    SetLatencies("encryption_established", &established_us, results.get());
+    SetLatencies("handshake_confirmed", &confirmed_us, results.get());
+    Print("handshake", results.Pass());
+    return true;
+  }
+
+  // Connects FLAGS_storm_handshakes times from FLAGS_storm_threads threads at
+  // once, each connection with a new client, while a connection established
+  // before the storm repeatedly requests kProbeFileName.  Reports the
+  // handshake rate and the probe latency before and during the storm.
+  bool RunStorm() {
+    if (!server_thread_.Start()) {
+      LOG(ERROR) << "Unable to start the server thread";
+      return false;
+    }
+    net::EpollServer epoll_server;
+    scoped_ptr<BenchmarkClient> probe(NewClient(&epoll_server));
+    if (!probe->Initialize() || !probe->Connect()) {
+      LOG(ERROR) << "Failed to connect the probe to "
+                 << server_address_.ToString();
+      probe.reset();
+      server_thread_.Stop();
+      return false;
+    }
+    probe->WaitForCryptoHandshakeConfirmed();
+
+    const int kIdleProbes = 100;
+    std::vector<int64> idle_probe_us;
+    for (int i = 0; i < kIdleProbes && Probe(probe.get(), &idle_probe_us);
+         ++i) {
+    }
+
+    ScopedVector<StormThread> threads;
+    base::subtle::Atomic32 running = 0;
+    const base::TimeTicks start = base::TimeTicks::Now();
+    StartStorm(server_address_, &running, &threads);
+    std::vector<int64> storm_probe_us;
+    while (base::subtle::Acquire_Load(&running) > 0 &&
+           Probe(probe.get(), &storm_probe_us)) {
+    }
+    std::vector<int64> confirmed_us;
+    int failures = 0;
+    JoinStorm(&threads, &confirmed_us, &failures);
+    const base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+    const bool probe_connected = probe->connected();
+    probe->Disconnect();
+    probe.reset();
+    server_thread_.Stop();
+    unlink(kDownloadedProbeFileName);
+
+    if (confirmed_us.empty() || idle_probe_us.empty() ||
+        storm_probe_us.empty()) {
+      LOG(ERROR) << "The storm made no connection or the probe failed";
+      return false;
+    }
+    scoped_ptr<base::DictionaryValue> results(new base::DictionaryValue);
+    results->SetInteger("threads", threads.size());
+    results->SetInteger("connections", confirmed_us.size());
+    results->SetInteger("failures", failures);
+    results->SetDouble("handshakes_per_second",
+                       confirmed_us.size() /
+                           std::max(elapsed.InSecondsF(), 1e-6));
+    results->SetBoolean("probe_connected", probe_connected);
+    results->SetInteger("idle_probes", idle_probe_us.size());
+    results->SetInteger("storm_probes", storm_probe_us.size());
+    SetLatencies("handshake_confirmed", &confirmed_us, results.get());
+    SetLatencies("idle_probe", &idle_probe_us, results.get());
+    SetLatencies("storm_probe", &storm_probe_us, results.get());
+    Print("storm", results.Pass());
+    return true;
+  }
+
+  // Runs the storm of RunStorm(), without the probe, against a
+  // QuicServerWorkerPool of 1, 2, 4 and 8 workers, and reports the handshake
+  // rate of each.
+  bool RunWorkerSweep() {
+    const uint32 kWorkerCounts[] = {1, 2, 4, 8};
+    for (uint32 num_workers : kWorkerCounts) {
+      net::tools::QuicServerWorkerPool pool(
+          config_, net::QuicSupportedVersions(), num_workers,
+          net::QuicCryptoServerConfig::ConfigOptions());
+      pool.SetStrikeRegisterNoStartupPeriod();
+      pool.set_use_sendmmsg(FLAGS_sendmmsg);
+      pool.set_use_gso(FLAGS_gso);
+      pool.set_packets_per_read(FLAGS_packets_per_read);
+      pool.set_crypto_worker_threads(FLAGS_crypto_threads);
+      if (!FLAGS_certificate_chains.empty()) {
+        for (uint32 i = 0; i < pool.num_workers(); ++i) {
+          net::ProofSource* proof_source = CreateProofSource();
+          if (proof_source == nullptr) {
+            return false;
+          }
+          pool.shard(i)->SetProofSource(proof_source);
+        }
+      }
+      if (!pool.Listen(net::IPEndPoint(server_address_.address(), 0)) ||
+          !pool.Start()) {
+        LOG(ERROR) << "Unable to start " << num_workers << " workers";
+        return false;
+      }
+
+      ScopedVector<StormThread> threads;
+      base::subtle::Atomic32 running = 0;
+      const base::TimeTicks start = base::TimeTicks::Now();
+      StartStorm(net::IPEndPoint(server_address_.address(), pool.port()),
+                 &running, &threads);
+      std::vector<int64> confirmed_us;
+      int failures = 0;
+      JoinStorm(&threads, &confirmed_us, &failures);
+      const base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+      pool.Shutdown();
+
+      if (confirmed_us.empty()) {
+        LOG(ERROR) << "No connection was made to " << num_workers
+                   << " workers";
+        return false;
+      }
+      uint64 packets_forwarded = 0;
+      for (uint32 i = 0; i < pool.num_workers(); ++i) {
+        packets_forwarded += pool.shard(i)->packets_forwarded();
+      }
+      scoped_ptr<base::DictionaryValue> results(new base::DictionaryValue);
+      results->SetInteger("workers", num_workers);
+      results->SetBoolean("kernel_steering", pool.kernel_steering());
+      results->SetInteger("threads", threads.size());
+      results->SetInteger("connections", confirmed_us.size());
+      results->SetInteger("failures", failures);
+      results->SetDouble("handshakes_per_second",
+                         confirmed_us.size() /
+                             std::max(elapsed.InSecondsF(), 1e-6));
+      results->SetDouble("packets_forwarded",
+                         static_cast<double>(packets_forwarded));
+      SetLatencies("handshake_confirmed", &confirmed_us, results.get());
+      Print("workers", results.Pass());
+    }
+    return true;
+  }
+
+  // Reads each time source FLAGS_clock_calls times.
+  void RunClocks() {
+    int64 sink = 0;
+    net::EpollServer epoll_server;
+    scoped_ptr<base::DictionaryValue> results(new base::DictionaryValue);
+    results->SetInteger("calls", FLAGS_clock_calls);
+    results->SetDouble("wall_ns_per_call", MeasureClock(WallClock(), &sink));
+    results->SetDouble("clock_monotonic_ns_per_call",
+                       MeasureClock(SystemMonotonicClock(), &sink));
+    if (net::MonotonicClock::tsc_enabled()) {
+      results->SetDouble("tsc_ns_per_call", MeasureClock(TscClock(), &sink));
+    }
+    results->SetDouble("quic_clock_now_ns_per_call",
+                       MeasureClock(DefaultQuicClock(), &sink));
+    results->SetDouble("epoll_clock_now_ns_per_call",
+                       MeasureClock(EpollClockNow(&epoll_server), &sink));
+    ApproximateNowAlarm alarm(&epoll_server, &sink);
+    epoll_server.RegisterAlarmApproximateDelta(0, &alarm);
+    while (alarm.registered()) {
+      epoll_server.WaitForEventsAndExecuteCallbacks();
+    }
+    results->SetDouble("epoll_clock_approximate_now_ns_per_call",
+                       alarm.ns_per_call());
+    g_clock_sink = sink;
+    Print("clock", results.Pass());
+  }
+
+  // Prints every result of the microbenchmark |benchmark|.
+  void PrintAll(const string& benchmark,
+                net::tools::BenchmarkResults* results) {
+    for (base::DictionaryValue* result : *results) {
+      Print(benchmark, make_scoped_ptr(result));
+    }
+    results->weak_clear();
+  }
+
+  // Encrypts FLAGS_seal_packets full-sized packets with each AEAD, once with
+  // QuicFramer::EncryptPayload() into a separate buffer and once with
+  // QuicFramer::EncryptPayloadInPlace() as the packet creator does.
+  bool RunSeals() {
+    const net::QuicTag kAlgorithms[] = {net::kAESG, net::kCC12};
+    for (net::QuicTag algorithm : kAlgorithms) {
+      for (bool in_place : {false, true}) {
+        scoped_ptr<base::DictionaryValue> results(new base::DictionaryValue);
+        if (!RunSeal(algorithm, in_place, results.get())) {
+          return false;
+        }
+        Print("seal", results.Pass());
+      }
+    }
+    return true;
+  }
+
+ private:
+  // Makes new connections to |address| for RunStorm(), one after the other,
+  // on its own event loop.
+  class StormThread : public base::PlatformThread::Delegate {
+   public:
+    StormThread(Benchmark* benchmark,
+                const net::IPEndPoint& address,
+                int handshakes,
+                base::subtle::Atomic32* running)
+        : benchmark_(benchmark),
+          address_(address),
+          handshakes_(handshakes),
+          running_(running),
+          failures_(0) {}
+    ~StormThread() override {}
+
+    bool Start() { return base::PlatformThread::Create(0, this, &handle_); }
+
+    void Join() { base::PlatformThread::Join(handle_); }
+
+    // base::PlatformThread::Delegate implementation.
+    void ThreadMain() override {
+      base::PlatformThread::SetName("QuicBenchmarkStorm");
+      net::EpollServer epoll_server;
+      for (int i = 0; i < handshakes_; ++i) {
+        scoped_ptr<BenchmarkClient> client(
+            benchmark_->NewClient(address_, &epoll_server));
+        const base::TimeTicks start = base::TimeTicks::Now();
+        if (!client->Initialize() || !client->Connect()) {
+          ++failures_;
+          continue;
+        }
+        client->WaitForCryptoHandshakeConfirmed();
+        if (!client->connected()) {
+          ++failures_;
+          continue;
+        }
+        confirmed_us_.push_back(
+            (base::TimeTicks::Now() - start).InMicroseconds());
+        client->Disconnect();
+      }
+      base::subtle::Barrier_AtomicIncrement(running_, -1);
+    }
+
+    const std::vector<int64>& confirmed_us() const { return confirmed_us_; }
+    int failures() const { return failures_; }
+
+   private:
+    Benchmark* benchmark_;  // Not owned.
+    const net::IPEndPoint address_;
+    const int handshakes_;
+    base::subtle::Atomic32* running_;  // Not owned.
+    std::vector<int64> confirmed_us_;
+    int failures_;
+    base::PlatformThreadHandle handle_;
+
+    DISALLOW_COPY_AND_ASSIGN(StormThread);
+  };
+
+  // Starts FLAGS_storm_threads StormThreads which make FLAGS_storm_handshakes
+  // connections to |address| between them.  Sets |running| to the number of
+  // threads, each of which decrements it when done.
+  void StartStorm(const net::IPEndPoint& address,
+                  base::subtle::Atomic32* running,
+                  ScopedVector<StormThread>* threads) {
+    const int num_threads = std::max(FLAGS_storm_threads, 1);
+    base::subtle::NoBarrier_Store(running, num_threads);
+    for (int i = 0; i < num_threads; ++i) {
+      const int handshakes = FLAGS_storm_handshakes / num_threads +
+                             (i < FLAGS_storm_handshakes % num_threads);
+      threads->push_back(new StormThread(this, address, handshakes, running));
+      CHECK(threads->back()->Start());
+    }
+  }
+
+  // Joins |threads| and collects their handshake latencies and failures.
+  static void JoinStorm(ScopedVector<StormThread>* threads,
+                        std::vector<int64>* confirmed_us,
+                        int* failures) {
+    for (StormThread* thread : *threads) {
+      thread->Join();
+      confirmed_us->insert(confirmed_us->end(), thread->confirmed_us().begin(),
+                           thread->confirmed_us().end());
+      *failures += thread->failures();
+    }
+  }
+
+  // Requests kProbeFileName over the connection of |client|, and appends how
+  // long that took to |latencies_us|.  Returns false if the connection is
+  // gone.
+  static bool Probe(BenchmarkClient* client, std::vector<int64>* latencies_us) {
+    const base::TimeTicks start = base::TimeTicks::Now();
+    if (!client->SendRequest(kProbeFileName, true)) {
+      return false;
+    }
+    while (client->connected() && client->WaitForEvents()) {
+    }
+    if (!client->connected()) {
+      return false;
+    }
+    latencies_us->push_back((base::TimeTicks::Now() - start).InMicroseconds());
+    return true;
+  }
+
+  BenchmarkClient* NewClient(net::EpollServer* epoll_server) {
+    return NewClient(server_address_, epoll_server);
+  }
+
+  BenchmarkClient* NewClient(const net::IPEndPoint& address,
+                             net::EpollServer* epoll_server) {
+    return new BenchmarkClient(
+        address,
+        net::QuicServerId("127.0.0.1", address.port(), false /*is_https*/,
+                          net::PRIVACY_MODE_DISABLED),
+        config_, epoll_server);
+  }
+
+  // Encrypts FLAGS_seal_packets packets with |algorithm|, in place if
+  // |in_place|, and sets |results|.
+  bool RunSeal(net::QuicTag algorithm,
+               bool in_place,
+               base::DictionaryValue* results) {
+    net::QuicEncrypter* encrypter = net::QuicEncrypter::Create(algorithm);
+    string key(encrypter->GetKeySize(), '\0');
+    string nonce_prefix(encrypter->GetNoncePrefixSize(), '\0');
+    net::QuicRandom::GetInstance()->RandBytes(&key[0], key.size());
+    net::QuicRandom::GetInstance()->RandBytes(&nonce_prefix[0],
+                                              nonce_prefix.size());
+    if (!encrypter->SetKey(key) || !encrypter->SetNoncePrefix(nonce_prefix)) {
+      LOG(ERROR) << "Unable to key the encrypter";
+      delete encrypter;
+      return false;
+    }
+    net::QuicFramer framer(net::QuicSupportedVersions(),
+                           net::QuicTime::Zero(),
+                           net::Perspective::IS_SERVER);
+    framer.SetEncrypter(net::ENCRYPTION_FORWARD_SECURE, encrypter);
+
+    // Every packet has the same header and payload, but its own sequence
+    // number.  In place, the packet is built in the output buffer, and each
+    // packet encrypts the ciphertext of the one before, which costs the same.
+    char plaintext[net::kMaxPacketSize];
+    char buffer[net::kMaxPacketSize];
+    const size_t plaintext_length =
+        encrypter->GetMaxPlaintextSize(net::kDefaultMaxPacketSize);
+    net::QuicRandom::GetInstance()->RandBytes(plaintext, plaintext_length);
+    memcpy(buffer, plaintext, plaintext_length);
+    const net::QuicPacket packet(in_place ? buffer : plaintext,
+                                 plaintext_length, false,
+                                 net::PACKET_8BYTE_CONNECTION_ID, false,
+                                 net::PACKET_6BYTE_SEQUENCE_NUMBER);
+
+    const int64 packets = std::max<int64>(FLAGS_seal_packets, 1);
+    net::QuicPacketSequenceNumber sequence_number = 0;
+    const int64 start_cpu_us = GetThreadCpuUs();
+    while (sequence_number < static_cast<uint64>(packets)) {
+      ++sequence_number;
+      scoped_ptr<net::QuicEncryptedPacket> encrypted(
+          in_place ? framer.EncryptPayloadInPlace(
+                         net::ENCRYPTION_FORWARD_SECURE, sequence_number,
+                         packet, buffer, sizeof(buffer))
+                   : framer.EncryptPayload(net::ENCRYPTION_FORWARD_SECURE,
+                                           sequence_number, packet, buffer,
+                                           sizeof(buffer)));
+      if (encrypted.get() == nullptr) {
+        LOG(ERROR) << "Failed to encrypt packet " << sequence_number;
+        return false;
+      }
+    }
+    const int64 cpu_us = std::max<int64>(GetThreadCpuUs() - start_cpu_us, 1);
+
+    results->SetString("algorithm", net::QuicUtils::TagToString(algorithm));
+    results->SetBoolean("in_place", in_place);
+    results->SetDouble("packets", static_cast<double>(sequence_number));
+    results->SetInteger("packet_bytes", net::kDefaultMaxPacketSize);
+    results->SetDouble("packets_per_cpu_second",
+                       sequence_number * 1e6 / cpu_us);
+    results->SetDouble("cpu_ns_per_packet",
+                       cpu_us * 1000.0 / sequence_number);
+    return true;
+  }
+
+  // Downloads the file on a new connection and sets |results|.
+  bool RunTransfer(base::DictionaryValue* results) {
+    net::EpollServer epoll_server;
+    scoped_ptr<BenchmarkClient> client(NewClient(&epoll_server));
+    net::tools::QuicLinkPacketWriter* server_writer = server_->writer();
+    const uint64 server_packets = server_writer->packets_written();
+    const uint64 server_lost = server_writer->packets_lost();
+    const uint64 server_dropped = server_writer->packets_dropped();
+
+    if (!client->Initialize()) {
+      LOG(ERROR) << "Failed to initialize the client";
+      return false;
+    }
+    if (!server_thread_.Start()) {
+      LOG(ERROR) << "Unable to start the server thread";
+      return false;
+    }
+    base::TimeTicks start = base::TimeTicks::Now();
+    if (!client->Connect()) {
+      LOG(ERROR) << "Failed to connect to " << server_address_.ToString();
+      client.reset();
+      server_thread_.Stop();
+      return false;
+    }
+    results->SetInteger("handshake_us",
+                        (base::TimeTicks::Now() - start).InMicroseconds());
+
+    // Only the download is measured.
+    net::QuicConnection* connection = client->session()->connection();
+    const net::QuicConnectionStats before = connection->GetStats();
+    const int64 allocations = GetAllocations();
+    const int64 process_cpu_us = GetProcessCpuUs();
+    const base::ThreadTicks client_cpu = base::ThreadTicks::Now();
+    start = base::TimeTicks::Now();
+
+    client->SendRequest(kFileName, true);
+    while (client->connected() && client->WaitForEvents()) {
+    }
+
+    const int64 transfer_us = (base::TimeTicks::Now() - start).InMicroseconds();
+    const int64 client_cpu_us =
+        (base::ThreadTicks::Now() - client_cpu).InMicroseconds();
+    const int64 total_cpu_us = GetProcessCpuUs() - process_cpu_us;
+    const int64 num_allocations = GetAllocations() - allocations;
+    const bool connected = client->connected();
+    const net::QuicConnectionStats after = connection->GetStats();
+    const net::tools::QuicLinkPacketWriter* client_writer = client->writer();
+    const uint64 client_lost = client_writer->packets_lost();
+    const uint64 client_dropped = client_writer->packets_dropped();
+    client->Disconnect();
+    client.reset();
+    server_thread_.Stop();
+
+    struct stat download;
+    const bool complete = connected &&
+                          stat(kDownloadedFileName, &download) == 0 &&
+                          download.st_size == FLAGS_file_bytes;
+    unlink(kDownloadedFileName);
+
+    const double bytes = FLAGS_file_bytes;
+    // Packets both ways, as seen by the client.
+    const double packets = (after.packets_sent - before.packets_sent) +
+                           (after.packets_received - before.packets_received);
+    results->SetBoolean("complete", complete);
+    results->SetDouble("transfer_us", transfer_us);
+    results->SetDouble("goodput_mbps",
+                       transfer_us > 0 ? bytes * 8 / transfer_us : 0);
+    results->SetDouble("cpu_ns_per_byte", total_cpu_us * 1000 / bytes);
+    results->SetDouble("client_cpu_ns_per_byte", client_cpu_us * 1000 / bytes);
+    results->SetDouble("server_cpu_ns_per_byte",
+                       (total_cpu_us - client_cpu_us) * 1000 / bytes);
+    results->SetDouble("allocations", num_allocations);
+    results->SetDouble("allocations_per_packet",
+                       packets > 0 ? num_allocations / packets : 0);
+    results->SetDouble("client_packets_sent",
+                       after.packets_sent - before.packets_sent);
+    results->SetDouble("client_packets_received",
+                       after.packets_received - before.packets_received);
+    results->SetDouble("min_rtt_us", after.min_rtt_us);
+    results->SetDouble("srtt_us", after.srtt_us);
+    results->SetDouble("server_packets_sent",
+                       server_writer->packets_written() - server_packets);
+    results->SetDouble("server_packets_lost",
+                       server_writer->packets_lost() - server_lost);
+    results->SetDouble("server_packets_dropped",
+                       server_writer->packets_dropped() - server_dropped);
+    results->SetDouble("client_packets_lost", client_lost);
+    results->SetDouble("client_packets_dropped", client_dropped);
+    return true;
+  }
+
+  // Sets the mean, minimum, median, 99th percentile and maximum of
+  // |latencies_us|.
+  static void SetLatencies(const string& name,
+                           std::vector<int64>* latencies_us,
+                           base::DictionaryValue* results) {
+    std::sort(latencies_us->begin(), latencies_us->end());
+    double sum = 0;
+    for (int64 latency_us : *latencies_us) {
+      sum += latency_us;
+    }
+    results->SetDouble(name + "_mean_us", sum / latencies_us->size());
+    results->SetDouble(name + "_min_us", latencies_us->front());
+    results->SetDouble(name + "_median_us",
+                       (*latencies_us)[latencies_us->size() / 2]);
+    results->SetDouble(name + "_p99_us",
+                       (*latencies_us)[latencies_us->size() * 99 / 100]);
+    results->SetDouble(name + "_max_us", latencies_us->back());
+  }
+
+  void Print(const string& benchmark,
+             scoped_ptr<base::DictionaryValue> results) {
+    base::DictionaryValue line;
+    line.SetString("benchmark", benchmark);
+    line.Set("params", GetParams().Pass());
+    line.Set("results", results.Pass());
+    string json;
+    base::JSONWriter::Write(line, &json);
+    *out_ << json << std::endl;
+  }
+
+  static scoped_ptr<base::DictionaryValue> GetParams() {
+    scoped_ptr<base::DictionaryValue> params(new base::DictionaryValue);
+    params->SetString("label", FLAGS_label);
+    params->SetInteger("file_bytes", FLAGS_file_bytes);
+    params->SetString("congestion_control", FLAGS_congestion_control);
+    params->SetInteger("delay_ms", FLAGS_delay_ms);
+    params->SetInteger("bandwidth_kbps", FLAGS_bandwidth_kbps);
+    params->SetDouble("loss_percent", FLAGS_loss_percent);
+    params->SetInteger("queue_bytes", FLAGS_queue_bytes);
+    params->SetInteger("seed", FLAGS_seed);
+    params->SetBoolean("sendmmsg", FLAGS_sendmmsg);
+    params->SetBoolean("gso", FLAGS_gso);
+    params->SetInteger("packets_per_read", FLAGS_packets_per_read);
+    params->SetInteger("crypto_threads", FLAGS_crypto_threads);
+    params->SetBoolean("tsc_clock", net::MonotonicClock::tsc_enabled());
+    params->SetBoolean("certificate_chains", !FLAGS_certificate_chains.empty());
+    return params.Pass();
+  }
+
+  BenchmarkServer* server_;  // Not owned.
+  ServerThread server_thread_;
+  std::ostream* out_;  // Not owned.
+  net::IPEndPoint server_address_;
+  net::QuicConfig config_;
+
+  DISALLOW_COPY_AND_ASSIGN(Benchmark);
+};
+
+// Writes |bytes| of random data to |name|.
+bool WriteBenchmarkFile(const char* name, int32 bytes) {
+  std::ofstream file(name, std::ios::binary | std::ios::trunc);
+  char buffer[64 * 1024];
+  for (int32 left = bytes; left > 0;) {
+    const int32 length = std::min<int32>(left, sizeof(buffer));
+    net::QuicRandom::GetInstance()->RandBytes(buffer, length);
+    file.write(buffer, length);
+    left -= length;
+  }
+  file.close();
+  return !file.fail();
+}
+
+// Starts the server and runs the benchmarks.  Returns the exit code.
+int RunBenchmarks(std::ostream* out) {
+  if (!WriteBenchmarkFile(kFileName, FLAGS_file_bytes) ||
+      !WriteBenchmarkFile(kProbeFileName, kProbeFileBytes)) {
+    LOG(ERROR) << "Unable to write the benchmark files";
+    return 1;
+  }
+
+  net::QuicConfig config;
+  BenchmarkServer server(config, net::QuicSupportedVersions());
+  server.SetStrikeRegisterNoStartupPeriod();
+  server.set_use_sendmmsg(FLAGS_sendmmsg);
+  server.set_use_gso(FLAGS_gso);
+  server.set_packets_per_read(FLAGS_packets_per_read);
+  server.set_crypto_worker_threads(FLAGS_crypto_threads);
+  if (!FLAGS_certificate_chains.empty()) {
+    net::ProofSource* proof_source = CreateProofSource();
+    if (proof_source == nullptr) {
+      return 1;
+    }
+    server.SetProofSource(proof_source);
+  }
+  net::IPAddressNumber loopback;
+  CHECK(net::ParseIPLiteralToNumber("127.0.0.1", &loopback));
+  if (!server.Listen(net::IPEndPoint(loopback, 0))) {
+    return 1;
+  }
+
+  Benchmark benchmark(&server, out);
+  for (const string& name : base::SplitString(
+           FLAGS_benchmarks, ",", base::TRIM_WHITESPACE,
+           base::SPLIT_WANT_NONEMPTY)) {
+    bool ok;
+    if (name == "transfer") {
+      ok = benchmark.RunTransfers();
+    } else if (name == "handshake") {
+      ok = benchmark.RunHandshakes(false) && benchmark.RunHandshakes(true);
+    } else if (name == "storm") {
+      ok = benchmark.RunStorm();
+    } else if (name == "workers") {
+      ok = benchmark.RunWorkerSweep();
+    } else if (name == "clock") {
+      benchmark.RunClocks();
+      ok = true;
+    } else if (name == "seal") {
+      ok = benchmark.RunSeals();
+    } else if (name == "strike_register") {
+      net::tools::BenchmarkResults results;
+      net::tools::RunStrikeRegisterBenchmark(FLAGS_strike_register_nonces,
+                                             &results);
+      benchmark.PrintAll(name, &results);
+      ok = true;
+    } else if (name == "ack") {
+      net::tools::BenchmarkResults results;
+      net::tools::RunAckBenchmark(FLAGS_ack_packets, &results);
+      benchmark.PrintAll(name, &results);
+      ok = true;
+    } else if (name == "xor") {
+      net::tools::BenchmarkResults results;
+      net::tools::RunXorBenchmark(FLAGS_xor_payloads, &results);
+      benchmark.PrintAll(name, &results);
+      ok = true;
+    } else if (name == "sequencer") {
+      net::tools::BenchmarkResults results;
+      net::tools::RunSequencerBufferBenchmark(FLAGS_sequencer_frames,
+                                              &results);
+      benchmark.PrintAll(name, &results);
+      ok = true;
+    } else if (name == "alarms") {
+      net::tools::BenchmarkResults results;
+      net::tools::RunTimingWheelBenchmark(FLAGS_alarm_reschedules, &results);
+      benchmark.PrintAll(name, &results);
+      ok = true;
+    } else if (name == "certs") {
+      net::tools::BenchmarkResults results;
+      ok = net::tools::RunCertCompressionBenchmark(FLAGS_cert_hellos,
+                                                   &results);
+      benchmark.PrintAll(name, &results);
+    } else if (name == "dispatch") {
+      net::tools::BenchmarkResults results;
+      net::tools::RunDispatchBenchmark(FLAGS_dispatch_packets, &results);
+      benchmark.PrintAll(name, &results);
+      ok = true;
+    } else if (name == "gso") {
+      net::tools::BenchmarkResults results;
+      ok = net::tools::RunGsoBenchmark(FLAGS_gso_packets, &results);
+      benchmark.PrintAll(name, &results);
+    } else {
+      LOG(ERROR) << "Unknown benchmark: " << name;
+      ok = false;
+    }
+    if (!ok) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+bool ParseNonNegativeInt(const base::CommandLine* line,
+                         const string& name,
+                         int32* value) {
+  if (!line->HasSwitch(name)) {
+    return true;
+  }
+  if (!base::StringToInt(line->GetSwitchValueASCII(name), value) ||
+      *value < 0) {
+    LOG(ERROR) << "--" << name << " must be a non-negative integer\n";
+    return false;
+  }
+  return true;
+}
+
+// Counts an allocation and makes it with malloc(), which every replacement
+// operator delete below matches with free().  Returns null on failure.
+void* CountedMalloc(size_t size) {
+  base::subtle::NoBarrier_AtomicIncrement(&g_allocations, 1);
+  return malloc(size != 0 ? size : 1);
+}
+
+}  // namespace
+
+// Counts allocations, so that their number per packet can be reported.  Every
+// replaceable form of operator new and delete is defined, so that whichever
+// form a caller uses, memory from malloc() is released with free().  They are
+// not inlined, so the compiler never pairs a new-expression with free().
+NOINLINE void* operator new(size_t size) {
+  void* p = CountedMalloc(size);
+  if (p == nullptr) {
+    abort();
+  }
+  return p;
+}
+
+NOINLINE void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+NOINLINE void* operator new(size_t size, const std::nothrow_t&) throw() {
+  return CountedMalloc(size);
+}
+
+NOINLINE void* operator new[](size_t size, const std::nothrow_t&) throw() {
+  return CountedMalloc(size);
+}
+
+NOINLINE void operator delete(void* p) throw() {
+  free(p);
+}
+
+NOINLINE void operator delete[](void* p) throw() {
+  free(p);
+}
+
+NOINLINE void operator delete(void* p, const std::nothrow_t&) throw() {
+  free(p);
+}
+
+NOINLINE void operator delete[](void* p, const std::nothrow_t&) throw() {
+  free(p);
+}
+
+#if defined(__cpp_sized_deallocation)
+NOINLINE void operator delete(void* p, size_t size) throw() {
+  free(p);
+}
+
+NOINLINE void operator delete[](void* p, size_t size) throw() {
+  free(p);
+}
+#endif
+
+int main(int argc, char *argv[]) {
+  base::AtExitManager exit_manager;
+
+  base::CommandLine::Init(argc, argv);
+  base::CommandLine* line = base::CommandLine::ForCurrentProcess();
+
+  logging::LoggingSettings settings;
+  settings.logging_dest = logging::LOG_TO_SYSTEM_DEBUG_LOG;
+  CHECK(logging::InitLogging(settings));
+
+  if (line->HasSwitch("h") || line->HasSwitch("help")) {
+    const char* help_str =
+        "Usage: quic_benchmark [options]\n"
+        "\n"
+        "Options:\n"
+        "-h, --help          show this help message and exit\n"
+        "--benchmarks=<list> comma separated: transfer, handshake, storm,\n"
+        "                    clock, seal, strike_register, ack, xor,\n"
+        "                    sequencer, alarms, certs, dispatch, workers,\n"
+        "                    gso\n"
+        "--file_bytes=<n>    size of the downloaded file\n"
+        "--transfers=<n>     number of downloads\n"
+        "--handshakes=<n>    number of connections per handshake benchmark\n"
+        "--storm_threads=<n> number of threads connecting during the storm\n"
+        "                    and the workers sweep\n"
+        "--storm_handshakes=<n> number of connections made by the storm and\n"
+        "                    per workers sweep step\n"
+        "--clock_calls=<n>   number of reads of each clock\n"
+        "--seal_packets=<n>  number of packets encrypted per seal benchmark\n"
+        "--strike_register_nonces=<n> nonces checked per strike_register run\n"
+        "--ack_packets=<n>   packets received per ack benchmark loss rate\n"
+        "--xor_payloads=<n>  payloads XORed per xor benchmark kernel\n"
+        "--sequencer_frames=<n> frames buffered per sequencer arrival order\n"
+        "--alarm_reschedules=<n> alarms rescheduled per alarms benchmark run\n"
+        "--cert_hellos=<n>   client hellos per certs benchmark flood\n"
+        "--dispatch_packets=<n> packets per dispatch benchmark session count\n"
+        "--gso_packets=<n>   packets sent per gso benchmark writer\n"
+        "--tsc_clock         read the time from the TSC if it is invariant\n"
+        "--congestion_control=<cubic|reno|bbr>\n"
+        "--delay_ms=<n>      one-way delay of the simulated link\n"
+        "--bandwidth_kbps=<n> bandwidth of the simulated link\n"
+        "--loss_percent=<x>  random loss of the simulated link\n"
+        "--queue_bytes=<n>   drop-tail queue of the simulated link\n"
+        "--seed=<n>          seed for the choice of lost packets\n"
+        "--sendmmsg          batch server packets with sendmmsg\n"
+        "--gso               send server packet runs with UDP_SEGMENT\n"
+        "--packets_per_read=<n> server reads up to n packets per recvmmsg\n"
+        "--crypto_threads=<n> server processes client hellos on n threads\n"
+        "--certificate_chains=<host>:<chain.pem>:<key.pem>[,...]\n"
+        "                    serve these PEM certificate chains\n"
+        "--state_dir=<dir>   persist client state here for resumed handshakes\n"
+        "--label=<string>    copied into the params of every result\n"
+        "--output=<file>     append results to file instead of printing\n";
+    std::cout << help_str;
+    exit(0);
+  }
+
+  if (line->HasSwitch("benchmarks")) {
+    FLAGS_benchmarks = line->GetSwitchValueASCII("benchmarks");
+  }
+  if (!ParseNonNegativeInt(line, "file_bytes", &FLAGS_file_bytes) ||
+      !ParseNonNegativeInt(line, "transfers", &FLAGS_transfers) ||
+      !ParseNonNegativeInt(line, "handshakes", &FLAGS_handshakes) ||
+      !ParseNonNegativeInt(line, "clock_calls", &FLAGS_clock_calls) ||
+      !ParseNonNegativeInt(line, "storm_threads", &FLAGS_storm_threads) ||
+      !ParseNonNegativeInt(line, "storm_handshakes",
+                           &FLAGS_storm_handshakes) ||
+      !ParseNonNegativeInt(line, "seal_packets", &FLAGS_seal_packets) ||
+      !ParseNonNegativeInt(line, "strike_register_nonces",
+                           &FLAGS_strike_register_nonces) ||
+      !ParseNonNegativeInt(line, "ack_packets", &FLAGS_ack_packets) ||
+      !ParseNonNegativeInt(line, "xor_payloads", &FLAGS_xor_payloads) ||
+      !ParseNonNegativeInt(line, "sequencer_frames",
+                           &FLAGS_sequencer_frames) ||
+      !ParseNonNegativeInt(line, "alarm_reschedules",
+                           &FLAGS_alarm_reschedules) ||
+      !ParseNonNegativeInt(line, "cert_hellos", &FLAGS_cert_hellos) ||
+      !ParseNonNegativeInt(line, "dispatch_packets",
+                           &FLAGS_dispatch_packets) ||
+      !ParseNonNegativeInt(line, "gso_packets", &FLAGS_gso_packets) ||
+      !ParseNonNegativeInt(line, "delay_ms", &FLAGS_delay_ms) ||
+      !ParseNonNegativeInt(line, "bandwidth_kbps", &FLAGS_bandwidth_kbps) ||
+      !ParseNonNegativeInt(line, "queue_bytes", &FLAGS_queue_bytes) ||
+      !ParseNonNegativeInt(line, "seed", &FLAGS_seed) ||
+      !ParseNonNegativeInt(line, "crypto_threads", &FLAGS_crypto_threads)) {
+    return 1;
+  }
+  if (line->HasSwitch("congestion_control")) {
+    FLAGS_congestion_control = line->GetSwitchValueASCII("congestion_control");
+    if (FLAGS_congestion_control != "cubic" &&
+        FLAGS_congestion_control != "reno" &&
+        FLAGS_congestion_control != "bbr") {
+      LOG(ERROR) << "--congestion_control must be cubic, reno or bbr\n";
+      return 1;
+    }
+  }
+  if (line->HasSwitch("loss_percent")) {
+    if (!base::StringToDouble(line->GetSwitchValueASCII("loss_percent"),
+                              &FLAGS_loss_percent) ||
+        FLAGS_loss_percent < 0 || FLAGS_loss_percent >= 100) {
+      LOG(ERROR) << "--loss_percent must be at least 0 and below 100\n";
+      return 1;
+    }
+  }
+  if (line->HasSwitch("sendmmsg")) {
+    FLAGS_sendmmsg = true;
+  }
+  if (line->HasSwitch("gso")) {
+    FLAGS_gso = true;
+  }
+  if (line->HasSwitch("tsc_clock")) {
+    FLAGS_tsc_clock = true;
+  }
+  if (line->HasSwitch("packets_per_read")) {
+    if (!base::StringToInt(line->GetSwitchValueASCII("packets_per_read"),
+                           &FLAGS_packets_per_read) ||
+        FLAGS_packets_per_read < 1) {
+      LOG(ERROR) << "--packets_per_read must be a positive integer\n";
+      return 1;
+    }
+  }
+  if (line->HasSwitch("certificate_chains")) {
+    FLAGS_certificate_chains = line->GetSwitchValueASCII("certificate_chains");
+  }
+  if (line->HasSwitch("state_dir")) {
+    FLAGS_state_dir = line->GetSwitchValueASCII("state_dir");
+  }
+  if (line->HasSwitch("label")) {
+    FLAGS_label = line->GetSwitchValueASCII("label");
+  }
+  if (line->HasSwitch("output")) {
+    FLAGS_output = line->GetSwitchValueASCII("output");
+  }
+
+  // The clock must be switched before the server thread reads it.
+  if (FLAGS_tsc_clock && !net::MonotonicClock::EnableTsc()) {
+    LOG(WARNING) << "No invariant TSC, using CLOCK_MONOTONIC";
+  }
+
+  // The server only uses BBR when allowed to.
+  if (FLAGS_congestion_control == "bbr") {
+    FLAGS_quic_allow_bbr = true;
+  }
+
+  std::ofstream output;
+  if (!FLAGS_output.empty()) {
+    output.open(FLAGS_output.c_str(), std::ios::app);
+    if (!output.is_open()) {
+      LOG(ERROR) << "Unable to open " << FLAGS_output;
+      return 1;
+    }
+  }
+
+  // The server serves files from, and the client stores them in, the working
+  // directory, so both use a fresh one.
+  char dir[] = "/tmp/quic_benchmark.XXXXXX";
+  if (mkdtemp(dir) == nullptr || chdir(dir) != 0) {
+    LOG(ERROR) << "Unable to create a working directory";
+    return 1;
+  }
+  const int rc = RunBenchmarks(output.is_open() ? &output : &std::cout);
+  unlink(kFileName);
+  unlink(kDownloadedFileName);
+  unlink(kProbeFileName);
+  if (chdir("/") != 0 || rmdir(dir) != 0) {
+    LOG(WARNING) << "Unable to remove " << dir;
+  }
+  return rc;
+}
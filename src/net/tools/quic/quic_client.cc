@@ -308,7 +308,9 @@ bool QuicClient::WaitForEvents() {
 void QuicClient::OnEvent(int fd, EpollEvent* event) {
   DCHECK_EQ(fd, fd_);
 
-  if (event->in_events & EPOLLIN) {
+  if ((event->in_events & EPOLLIN) && connected()) {
+    // The connection's alarms are rescheduled once for everything read.
+    QuicConnection::ScopedAlarmBatcher alarm_batcher(session_->connection());
     while (connected() && ReadAndProcessPacket()) {
     }
   }
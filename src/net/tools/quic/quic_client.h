@@ -25,6 +25,7 @@
 
 namespace net {
 
+class CachedStateStore;
 class ProofVerifier;
 class QuicServerId;
 
@@ -162,6 +163,12 @@ class QuicClient : public EpollCallbackInterface,
     crypto_config_.SetChannelIDSource(source);
   }
 
+  // SetCachedStateStore sets the CachedStateStore that server configs are
+  // loaded from and saved to, and takes ownership of |store|.
+  void SetCachedStateStore(CachedStateStore* store) {
+    crypto_config_.SetCachedStateStore(store);
+  }
+
   void SetSupportedVersions(const QuicVersionVector& versions) {
     supported_versions_ = versions;
   }
@@ -27,6 +27,7 @@
 #include "net/quic/quic_utils.h"
 #include "net/quic/quic_config.h"
 #include "net/tools/epoll_server/epoll_server.h"
+#include "net/tools/quic/file_cached_state_store.h"
 #include "net/tools/quic/quic_client.h"
 //#include "net/tools/quic/spdy_balsa_utils.h"
 //#include "net/tools/quic/synchronous_host_resolver.h"
@@ -49,6 +50,8 @@ string FLAGS_host = "127.0.0.1";
 int32 FLAGS_port = 6121;
 // The local port to connect from.
 int32 FLAGS_local_port = 0;
+// Directory in which server configs are kept between runs, if set.
+string FLAGS_state_dir = "";
 // Set to true for a quieter output experience.
 bool FLAGS_quiet = false;
 // QUIC version to speak, e.g. 21. If not set, then all available versions are
@@ -93,6 +96,8 @@ int main(int argc, char *argv[]) {
         "connect to\n"
         "--port=<port>               specify the port to connect to\n"
         "--local-port=<port>         specify the local-port to connect from\n"
+        "--state-dir=<dir>           keep server configs in <dir> between runs "
+        "for 0-RTT\n"
         "--mtcp                      enable mTCP like behavior for congestion control\n"
         "--fec                       enable FEC\n"
         "--emulated-connections=<N>  congestion control with N emulated connections (4,8,16,32,64)\n"
@@ -123,6 +128,9 @@ int main(int argc, char *argv[]) {
       return 1;
     }
   }
+  if (line->HasSwitch("state-dir")) {
+    FLAGS_state_dir = line->GetSwitchValueASCII("state-dir");
+  }
   if (line->HasSwitch("requests")) {
     if (!base::StringToInt(line->GetSwitchValueASCII("requests"), &FLAGS_requests)) {
       std::cerr << "--requests must be an integer\n";
@@ -246,6 +254,10 @@ int main(int argc, char *argv[]) {
   net::tools::QuicClient client(net::IPEndPoint(ip_addr, FLAGS_port), server_id,
                                 versions, config, &epoll_server);
   client.set_local_port(FLAGS_local_port);
+  if (!FLAGS_state_dir.empty()) {
+    client.SetCachedStateStore(
+        new net::tools::FileCachedStateStore(FLAGS_state_dir));
+  }
 
   if (!client.Initialize()) {
     cerr << "Failed to initialize client." << endl;
@@ -263,7 +275,9 @@ int main(int argc, char *argv[]) {
          << ". Error: " << net::QuicUtils::ErrorToString(error) << endl;
     return 1;
   }
-  cout << "Connected to " << host_port << endl;
+  cout << "Connected to " << host_port << " after "
+       << client.session()->GetNumSentClientHellos() << " client hello(s)"
+       << endl;
 
   // Make sure to store the response, for later output.
   client.set_store_response(true);
@@ -41,5 +41,9 @@ void QuicDefaultPacketWriter::SetWritable() {
   write_blocked_ = false;
 }
 
+WriteResult QuicDefaultPacketWriter::Flush() {
+  return WriteResult(WRITE_STATUS_OK, 0);
+}
+
 }  // namespace tools
 }  // namespace net
@@ -5,14 +5,17 @@
 #include "net/tools/quic/quic_dispatcher.h"
 
 #include <utility>
+#include <vector>
 
 #include "base/debug/stack_trace.h"
 #include "base/logging.h"
 #include "base/stl_util.h"
+#include "base/strings/string_number_conversions.h"
 #include "net/quic/quic_flags.h"
 #include "net/quic/quic_utils.h"
 #include "net/tools/quic/quic_per_connection_packet_writer.h"
 #include "net/tools/quic/quic_time_wait_list_manager.h"
+#include "net/tools/quic/quic_trace_writer.h"
 
 namespace net {
 
@@ -29,6 +32,10 @@ int32 FLAGS_quic_session_map_threshold_for_stateless_rejects = -1;
 
 namespace {
 
+// The most trace bytes waiting for the disk.  Traces of connections which
+// close while the writer is this far behind are dropped.
+const size_t kMaxQueuedTraceBytes = 64 * 1024 * 1024;
+
 // An alarm that informs the QuicDispatcher to delete old sessions.
 class DeleteSessionsAlarm : public QuicAlarm::Delegate {
  public:
@@ -175,6 +182,8 @@ QuicDispatcher::QuicDispatcher(const QuicConfig& config,
                                QuicConnectionHelperInterface* helper)
     : config_(config),
       crypto_config_(crypto_config),
+      handshake_worker_pool_(nullptr),
+      in_packet_batch_(false),
       helper_(helper),
       delete_sessions_alarm_(
           helper_->CreateAlarm(new DeleteSessionsAlarm(this))),
@@ -195,6 +204,15 @@ QuicDispatcher::~QuicDispatcher() {
   STLDeleteElements(&closed_session_list_);
 }
 
+void QuicDispatcher::set_trace_directory(const std::string& directory) {
+  trace_directory_ = directory;
+  if (trace_directory_.empty()) {
+    trace_writer_.reset();
+  } else if (trace_writer_.get() == nullptr) {
+    trace_writer_.reset(new QuicTraceWriter(kMaxQueuedTraceBytes));
+  }
+}
+
 void QuicDispatcher::InitializeWithWriter(QuicPacketWriter* writer) {
   DCHECK(writer_ == nullptr);
   writer_.reset(writer);
@@ -215,6 +233,20 @@ void QuicDispatcher::ProcessPacket(const IPEndPoint& server_address,
   //                and log somehow.  Maybe expose as a varz.
 }
 
+void QuicDispatcher::StartPacketBatch() {
+  DCHECK(!in_packet_batch_);
+  in_packet_batch_ = true;
+}
+
+void QuicDispatcher::FinishPacketBatch() {
+  DCHECK(in_packet_batch_);
+  in_packet_batch_ = false;
+  for (QuicConnection* connection : batched_connections_) {
+    connection->FinishAlarmBatch();
+  }
+  batched_connections_.clear();
+}
+
 bool QuicDispatcher::OnUnauthenticatedPublicHeader(
     const QuicPacketPublicHeader& header) {
   // Port zero is only allowed for unidirectional UDP, so is disallowed by QUIC.
@@ -237,6 +269,7 @@ bool QuicDispatcher::OnUnauthenticatedPublicHeader(
   QuicConnectionId connection_id = header.connection_id;
   SessionMap::iterator it = session_map_.find(connection_id);
   if (it != session_map_.end()) {
+    MaybeBatchAlarms(it->second->connection());
     it->second->connection()->ProcessUdpPacket(
         current_server_address_, current_client_address_, *current_packet_);
     return false;
@@ -300,6 +333,7 @@ void QuicDispatcher::OnUnauthenticatedHeader(const QuicPacketHeader& header) {
           connection_id, current_server_address_, current_client_address_);
       DVLOG(1) << "Created new session for " << connection_id;
       session_map_.insert(make_pair(connection_id, session));
+      MaybeBatchAlarms(session->connection());
       session->connection()->ProcessUdpPacket(
           current_server_address_, current_client_address_, *current_packet_);
 
@@ -387,6 +421,9 @@ void QuicDispatcher::DeleteSessions() {
 void QuicDispatcher::OnCanWrite() {
   // The socket is now writable.
   writer_->SetWritable();
+  // Packets the writer buffered before it blocked go out first, even if the
+  // connections which wrote them are gone.
+  writer_->Flush();
 
   // Give all the blocked writers one chance to write, until we're blocked again
   // or there's no work left.
@@ -403,12 +440,17 @@ bool QuicDispatcher::HasPendingWrites() const {
 }
 
 void QuicDispatcher::Shutdown() {
-  while (!session_map_.empty()) {
-    QuicServerSession* session = session_map_.begin()->second;
+  // Each session removes itself from the session map on close, which moves
+  // the other entries, so close them from a copy.
+  std::vector<QuicServerSession*> sessions;
+  sessions.reserve(session_map_.size());
+  for (const SessionMap::value_type& entry : session_map_) {
+    sessions.push_back(entry.second);
+  }
+  for (QuicServerSession* session : sessions) {
     session->connection()->SendConnectionClose(QUIC_PEER_GOING_AWAY);
-    // Validate that the session removes itself from the session map on close.
-    DCHECK(session_map_.empty() || session_map_.begin()->second != session);
   }
+  DCHECK(session_map_.empty());
   DeleteSessions();
 }
 
@@ -432,6 +474,9 @@ void QuicDispatcher::OnConnectionClosed(QuicConnectionId connection_id,
     delete_sessions_alarm_->Cancel();
     delete_sessions_alarm_->Set(helper()->GetClock()->ApproximateNow());
   }
+  if (trace_writer_.get() != nullptr) {
+    WriteTrace(*it->second->connection());
+  }
   closed_session_list_.push_back(it->second);
   const bool should_close_statelessly =
       (error == QUIC_CRYPTO_HANDSHAKE_STATELESS_REJECT);
@@ -473,6 +518,9 @@ QuicServerSession* QuicDispatcher::CreateQuicSession(
   QuicServerSession* session =
       new QuicServerSession(config_, connection, this, crypto_config_);
   session->Initialize();
+  if (handshake_worker_pool_ != nullptr) {
+    session->set_handshake_worker_pool(handshake_worker_pool_);
+  }
   if (FLAGS_quic_session_map_threshold_for_stateless_rejects != -1 &&
       session_map_.size() >=
           static_cast<size_t>(
@@ -508,6 +556,28 @@ bool QuicDispatcher::HandlePacketForTimeWait(
   return true;
 }
 
+void QuicDispatcher::MaybeBatchAlarms(QuicConnection* connection) {
+  if (in_packet_batch_ && connection->StartAlarmBatch()) {
+    batched_connections_.push_back(connection);
+  }
+}
+
+void QuicDispatcher::WriteTrace(const QuicConnection& connection) {
+  const QuicConnectionTrace* trace = connection.trace();
+  if (trace == nullptr || trace->num_recorded() == 0) {
+    return;
+  }
+  // Serializing copies the ring into memory; only the file write is left to
+  // the writer thread.
+  std::string data;
+  trace->Serialize(connection.connection_id(), connection.perspective(),
+                   &data);
+  trace_writer_->Write(trace_directory_ + "/" +
+                           base::Uint64ToString(connection.connection_id()) +
+                           ".qtr",
+                       &data);
+}
+
 void QuicDispatcher::SetLastError(QuicErrorCode error) {
   last_error_ = error;
 }
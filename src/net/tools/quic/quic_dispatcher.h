@@ -8,19 +8,23 @@
 #ifndef NET_TOOLS_QUIC_QUIC_DISPATCHER_H_
 #define NET_TOOLS_QUIC_QUIC_DISPATCHER_H_
 
+#include <string>
+#include <vector>
+
 #include "base/basictypes.h"
-#include "base/containers/hash_tables.h"
 #include "base/memory/scoped_ptr.h"
 #include "net/base/ip_endpoint.h"
 #include "net/base/linked_hash_map.h"
 #include "net/quic/quic_blocked_writer_interface.h"
 #include "net/quic/quic_connection.h"
+#include "net/quic/quic_connection_id_map.h"
 #include "net/quic/quic_protocol.h"
 #include "net/tools/quic/quic_server_session.h"
 #include "net/tools/quic/quic_time_wait_list_manager.h"
 
 namespace net {
 
+class CryptoHandshakeWorkerPool;
 class QuicConfig;
 class QuicCryptoServerConfig;
 class QuicServerSession;
@@ -31,6 +35,8 @@ namespace test {
 class QuicDispatcherPeer;
 }  // namespace test
 
+class QuicTraceWriter;
+
 class ProcessPacketInterface {
  public:
   virtual ~ProcessPacketInterface() {}
@@ -89,6 +95,12 @@ class QuicDispatcher : public QuicServerSessionVisitor,
                      const IPEndPoint& client_address,
                      const QuicEncryptedPacket& packet) override;
 
+  // Between these calls, the alarms of the connections packets are processed
+  // for are batched, and rescheduled once at the end, rather than for every
+  // packet.  A server calls them around each read of its socket.
+  void StartPacketBatch();
+  void FinishPacketBatch();
+
   // Called when the socket becomes writable to allow queued writes to happen.
   void OnCanWrite() override;
 
@@ -98,6 +110,18 @@ class QuicDispatcher : public QuicServerSessionVisitor,
   // Sends ConnectionClose frames to all connected clients.
   void Shutdown();
 
+  // If set, the crypto streams of new sessions process client hellos on
+  // |pool|.  Does not take ownership of |pool|, which must outlive the
+  // dispatcher.
+  void set_handshake_worker_pool(CryptoHandshakeWorkerPool* pool) {
+    handshake_worker_pool_ = pool;
+  }
+
+  // If set, the congestion control trace of each closed connection which
+  // kept one is written to |directory|/<connection id>.qtr, on a thread of its
+  // own.
+  void set_trace_directory(const std::string& directory);
+
   // QuicServerSessionVisitor interface implementation:
   // Ensure that the closed connection is cleaned up asynchronously.
   void OnConnectionClosed(QuicConnectionId connection_id,
@@ -115,7 +139,7 @@ class QuicDispatcher : public QuicServerSessionVisitor,
   void OnConnectionRemovedFromTimeWaitList(
       QuicConnectionId connection_id) override;
 
-  typedef base::hash_map<QuicConnectionId, QuicServerSession*> SessionMap;
+  typedef QuicConnectionIdMap<QuicServerSession*> SessionMap;
 
   const SessionMap& session_map() const { return session_map_; }
 
@@ -235,13 +259,34 @@ class QuicDispatcher : public QuicServerSessionVisitor,
 
   bool HandlePacketForTimeWait(const QuicPacketPublicHeader& header);
 
+  // Batches the alarms of |connection| until FinishPacketBatch(), if in a
+  // packet batch.
+  void MaybeBatchAlarms(QuicConnection* connection);
+
+  // Queues the trace of |connection|, if it kept one, for |trace_writer_|.
+  void WriteTrace(const QuicConnection& connection);
+
   const QuicConfig& config_;
 
   const QuicCryptoServerConfig* crypto_config_;
 
+  // Not owned.  May be null, in which case handshakes are processed inline.
+  CryptoHandshakeWorkerPool* handshake_worker_pool_;
+
+  // Where traces of closed connections are written; empty for nowhere.
+  std::string trace_directory_;
+  // Writes the traces.  Null if |trace_directory_| is empty.
+  scoped_ptr<QuicTraceWriter> trace_writer_;
+
   // The list of connections waiting to write.
   WriteBlockedList write_blocked_list_;
 
+  // Whether in a packet batch, and the connections whose alarms it batches.
+  // Sessions are only deleted by |delete_sessions_alarm_|, so the
+  // connections outlive the batch.
+  bool in_packet_batch_;
+  std::vector<QuicConnection*> batched_connections_;
+
   SessionMap session_map_;
 
   // Entity that manages connection_ids in time wait state.
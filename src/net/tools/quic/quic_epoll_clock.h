@@ -17,7 +17,10 @@ class EpollServer;
 namespace tools {
 
 // Clock to efficiently retrieve an approximately accurate time from an
-// EpollServer.
+// EpollServer.  Now() and ApproximateNow() are monotonic, so RTTs and pacing
+// are unaffected by steps of the system time; ApproximateNow() is read once
+// per event loop iteration.  WallNow() still reads the system time, for
+// server config expiry and the like.
 class QuicEpollClock : public QuicClock {
  public:
   explicit QuicEpollClock(EpollServer* epoll_server);
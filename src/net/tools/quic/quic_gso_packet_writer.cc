@@ -0,0 +1,169 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_gso_packet_writer.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "net/tools/quic/quic_socket_utils.h"
+
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+namespace net {
+namespace tools {
+
+namespace {
+
+// The largest UDP payload which fits in one IPv4 or IPv6 datagram.
+const size_t kMaxGsoPayloadSize = 65535 - 40 - 8;
+
+// Returns true if |error| means the kernel or device cannot do UDP_SEGMENT,
+// as opposed to a failure of the packet itself.
+bool IsGsoUnsupportedError(int error) {
+  return error == EINVAL || error == EIO || error == ENOPROTOOPT ||
+         error == EOPNOTSUPP;
+}
+
+}  // namespace
+
+QuicGsoPacketWriter::QuicGsoPacketWriter(int fd)
+    : QuicBatchPacketWriter(fd),
+      gso_supported_(true),
+      packets_sent_with_gso_(0) {}
+
+QuicGsoPacketWriter::~QuicGsoPacketWriter() {}
+
+WriteResult QuicGsoPacketWriter::Flush() {
+  const std::deque<BufferedPacket*>& queue = buffered_packet_queue();
+  size_t bytes_written = 0;
+  while (gso_supported_ && !queue.empty()) {
+    WriteResult result(WRITE_STATUS_OK, 0);
+    int num_segments = CountSegments();
+    if (num_segments > 1) {
+      result = WriteSegments(num_segments);
+      if (result.status == WRITE_STATUS_ERROR &&
+          IsGsoUnsupportedError(result.error_code)) {
+        LOG(WARNING) << "UDP_SEGMENT rejected, falling back to sendmmsg: "
+                     << strerror(result.error_code);
+        gso_supported_ = false;
+        break;
+      }
+    } else {
+      // Send everything up to the next run which can be segmented.
+      int num_packets = 1;
+      while (num_packets < kMaxPacketsPerWriteMmsgCall &&
+             static_cast<size_t>(num_packets) < queue.size() &&
+             queue[num_packets]->length != queue[num_packets - 1]->length) {
+        ++num_packets;
+      }
+      result = WriteBufferedPackets(num_packets);
+    }
+    if (result.status != WRITE_STATUS_OK) {
+      return result;
+    }
+    bytes_written += result.bytes_written;
+  }
+
+  WriteResult result = QuicBatchPacketWriter::Flush();
+  if (result.status == WRITE_STATUS_OK) {
+    result.bytes_written += bytes_written;
+  }
+  return result;
+}
+
+int QuicGsoPacketWriter::CountSegments() const {
+  const std::deque<BufferedPacket*>& queue = buffered_packet_queue();
+  const BufferedPacket* first = queue.front();
+  size_t total_length = first->length;
+  int num_segments = 1;
+  while (num_segments < kMaxGsoSegments &&
+         static_cast<size_t>(num_segments) < queue.size()) {
+    const BufferedPacket* packet = queue[num_segments];
+    if (packet->length > first->length ||
+        total_length + packet->length > kMaxGsoPayloadSize ||
+        !(packet->peer_address == first->peer_address) ||
+        packet->self_address != first->self_address) {
+      break;
+    }
+    total_length += packet->length;
+    ++num_segments;
+    // Only the last segment may be shorter than the segment size.
+    if (packet->length < first->length) {
+      break;
+    }
+  }
+  return num_segments;
+}
+
+WriteResult QuicGsoPacketWriter::WriteSegments(int num_segments) {
+  const std::deque<BufferedPacket*>& queue = buffered_packet_queue();
+  const BufferedPacket* first = queue.front();
+
+  sockaddr_storage raw_address;
+  socklen_t address_len = sizeof(raw_address);
+  CHECK(first->peer_address.ToSockAddr(
+      reinterpret_cast<sockaddr*>(&raw_address), &address_len));
+  for (int i = 0; i < num_segments; ++i) {
+    iov_[i].iov_base = queue[i]->buffer;
+    iov_[i].iov_len = queue[i]->length;
+  }
+
+  msghdr hdr;
+  hdr.msg_name = &raw_address;
+  hdr.msg_namelen = address_len;
+  hdr.msg_iov = iov_;
+  hdr.msg_iovlen = num_segments;
+  hdr.msg_flags = 0;
+  memset(cbuf_, 0, sizeof(cbuf_));
+  hdr.msg_control = cbuf_;
+  hdr.msg_controllen = sizeof(cbuf_);
+
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+  size_t control_length = 0;
+  if (!first->self_address.empty()) {
+    control_length +=
+        CMSG_SPACE(QuicSocketUtils::SetIpInfoInCmsg(first->self_address, cmsg));
+    cmsg = CMSG_NXTHDR(&hdr, cmsg);
+  }
+  cmsg->cmsg_level = SOL_UDP;
+  cmsg->cmsg_type = UDP_SEGMENT;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(uint16));
+  uint16 segment_size = first->length;
+  memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+  control_length += CMSG_SPACE(sizeof(uint16));
+  hdr.msg_controllen = control_length;
+
+  int rc = sendmsg(fd(), &hdr, 0);
+  if (rc < 0) {
+    OnWriteCallFailed();
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      set_write_blocked(true);
+      return WriteResult(WRITE_STATUS_BLOCKED, errno);
+    }
+    int error = errno;
+    if (IsGsoUnsupportedError(error)) {
+      // Flush() falls back to sendmmsg.
+      return WriteResult(WRITE_STATUS_ERROR, error);
+    }
+    DropFirstBufferedPacket(error);
+    return WriteResult(WRITE_STATUS_OK, 0);
+  }
+  // A UDP_SEGMENT send is all or nothing.
+  OnBufferedPacketsSent(num_segments);
+  packets_sent_with_gso_ += num_segments;
+  return WriteResult(WRITE_STATUS_OK, rc);
+}
+
+}  // namespace tools
+}  // namespace net
@@ -0,0 +1,62 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_QUIC_QUIC_GSO_PACKET_WRITER_H_
+#define NET_TOOLS_QUIC_QUIC_GSO_PACKET_WRITER_H_
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "base/basictypes.h"
+#include "net/tools/quic/quic_batch_packet_writer.h"
+
+namespace net {
+namespace tools {
+
+// The most segments the kernel accepts in one UDP_SEGMENT send.
+const int kMaxGsoSegments = 64;
+
+// A batching packet writer which uses UDP generic segmentation offload.  On
+// Flush(), each run of consecutive packets to the same peer from the same
+// address, all of one size except perhaps a shorter last one, goes to the
+// kernel as a single buffer with a UDP_SEGMENT control message, and the kernel
+// or NIC cuts it back into packets.  Packets which cannot be combined are sent
+// with sendmmsg.  If the kernel rejects UDP_SEGMENT, the writer stops using it
+// and behaves like QuicBatchPacketWriter.
+class QuicGsoPacketWriter : public QuicBatchPacketWriter {
+ public:
+  explicit QuicGsoPacketWriter(int fd);
+  ~QuicGsoPacketWriter() override;
+
+  // QuicPacketWriter
+  WriteResult Flush() override;
+
+  // False once the kernel has rejected UDP_SEGMENT.
+  bool gso_supported() const { return gso_supported_; }
+
+  // Number of packets sent as segments of a UDP_SEGMENT send.
+  uint64 packets_sent_with_gso() const { return packets_sent_with_gso_; }
+
+ private:
+  // Returns the number of packets at the front of the queue which can be
+  // sent in one UDP_SEGMENT send.
+  int CountSegments() const;
+
+  // Sends the first |num_segments| buffered packets as one UDP_SEGMENT send.
+  WriteResult WriteSegments(int num_segments);
+
+  bool gso_supported_;
+  uint64 packets_sent_with_gso_;
+
+  iovec iov_[kMaxGsoSegments];
+  // Holds the IP_PKTINFO or IPV6_PKTINFO control message and the segment size.
+  char cbuf_[CMSG_SPACE(sizeof(in6_pktinfo)) + CMSG_SPACE(sizeof(uint16))];
+
+  DISALLOW_COPY_AND_ASSIGN(QuicGsoPacketWriter);
+};
+
+}  // namespace tools
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_GSO_PACKET_WRITER_H_
@@ -0,0 +1,182 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_link_packet_writer.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/stl_util.h"
+
+namespace net {
+namespace tools {
+
+QuicLinkParameters::QuicLinkParameters()
+    : bandwidth(QuicBandwidth::Zero()),
+      delay(QuicTime::Delta::Zero()),
+      loss_rate(0),
+      queue_bytes(0),
+      seed(1) {
+}
+
+class QuicLinkPacketWriter::DeliveryAlarm : public EpollAlarm {
+ public:
+  explicit DeliveryAlarm(QuicLinkPacketWriter* writer) : writer_(writer) {}
+
+  int64 OnAlarm() override {
+    EpollAlarm::OnAlarm();
+    return writer_->OnDeliveryAlarm();
+  }
+
+ private:
+  QuicLinkPacketWriter* writer_;
+
+  DISALLOW_COPY_AND_ASSIGN(DeliveryAlarm);
+};
+
+QuicLinkPacketWriter::QuicLinkPacketWriter(QuicPacketWriter* writer,
+                                           EpollServer* epoll_server,
+                                           const QuicLinkParameters& link)
+    : writer_(writer),
+      epoll_server_(epoll_server),
+      link_(link),
+      // xorshift gets stuck at zero.
+      random_state_(link.seed != 0 ? link.seed : 1),
+      link_free_us_(0),
+      delivery_alarm_(new DeliveryAlarm(this)),
+      packets_written_(0),
+      bytes_written_(0),
+      packets_lost_(0),
+      packets_dropped_(0) {
+}
+
+QuicLinkPacketWriter::~QuicLinkPacketWriter() {
+  delivery_alarm_.reset();
+  STLDeleteElements(&in_flight_);
+  STLDeleteElements(&free_packets_);
+}
+
+WriteResult QuicLinkPacketWriter::WritePacket(
+    const char* buffer,
+    size_t buf_len,
+    const IPAddressNumber& self_address,
+    const IPEndPoint& peer_address) {
+  ++packets_written_;
+  bytes_written_ += buf_len;
+  if (!shaped()) {
+    return writer_->WritePacket(buffer, buf_len, self_address, peer_address);
+  }
+  if (buf_len > kMaxPacketSize) {
+    LOG(DFATAL) << "Packet of " << buf_len << " bytes is too large";
+    return WriteResult(WRITE_STATUS_ERROR, EMSGSIZE);
+  }
+  if (NextPacketLost()) {
+    ++packets_lost_;
+    return WriteResult(WRITE_STATUS_OK, buf_len);
+  }
+
+  const int64 now_us = epoll_server_->ApproximateNowInUsec();
+  if (!link_.bandwidth.IsZero()) {
+    if (link_.queue_bytes > 0 && link_free_us_ > now_us) {
+      const QuicByteCount queued = link_.bandwidth.ToBytesPerPeriod(
+          QuicTime::Delta::FromMicroseconds(link_free_us_ - now_us));
+      if (queued + buf_len > link_.queue_bytes) {
+        ++packets_dropped_;
+        return WriteResult(WRITE_STATUS_OK, buf_len);
+      }
+    }
+    link_free_us_ = std::max(link_free_us_, now_us) +
+                    link_.bandwidth.TransferTime(buf_len).ToMicroseconds();
+  } else {
+    link_free_us_ = now_us;
+  }
+
+  Packet* packet;
+  if (free_packets_.empty()) {
+    packet = new Packet;
+  } else {
+    packet = free_packets_.back();
+    free_packets_.pop_back();
+  }
+  memcpy(packet->buffer, buffer, buf_len);
+  packet->length = buf_len;
+  packet->self_address = self_address;
+  packet->peer_address = peer_address;
+  // The delay is the same for every packet, so packets are delivered in the
+  // order they were accepted.
+  packet->delivery_time_us = link_free_us_ + link_.delay.ToMicroseconds();
+  in_flight_.push_back(packet);
+  if (!delivery_alarm_->registered()) {
+    epoll_server_->RegisterAlarm(packet->delivery_time_us,
+                                 delivery_alarm_.get());
+  }
+  return WriteResult(WRITE_STATUS_OK, buf_len);
+}
+
+bool QuicLinkPacketWriter::IsWriteBlockedDataBuffered() const {
+  return shaped() ? false : writer_->IsWriteBlockedDataBuffered();
+}
+
+bool QuicLinkPacketWriter::IsWriteBlocked() const {
+  return shaped() ? false : writer_->IsWriteBlocked();
+}
+
+void QuicLinkPacketWriter::SetWritable() {
+  writer_->SetWritable();
+}
+
+WriteResult QuicLinkPacketWriter::Flush() {
+  if (!shaped()) {
+    return writer_->Flush();
+  }
+  // Packets leave the link from the delivery alarm, which flushes them.
+  return WriteResult(WRITE_STATUS_OK, 0);
+}
+
+bool QuicLinkPacketWriter::shaped() const {
+  return !link_.bandwidth.IsZero() || !link_.delay.IsZero() ||
+         link_.loss_rate > 0;
+}
+
+bool QuicLinkPacketWriter::NextPacketLost() {
+  if (link_.loss_rate <= 0) {
+    return false;
+  }
+  // xorshift64*, which is plenty for picking lost packets.
+  random_state_ ^= random_state_ >> 12;
+  random_state_ ^= random_state_ << 25;
+  random_state_ ^= random_state_ >> 27;
+  const uint64 random = random_state_ * 2685821657736338717ULL;
+  return (random >> 11) * (1.0 / (1ULL << 53)) < link_.loss_rate;
+}
+
+int64 QuicLinkPacketWriter::OnDeliveryAlarm() {
+  const int64 now_us = epoll_server_->NowInUsec();
+  bool delivered = false;
+  while (!in_flight_.empty() &&
+         in_flight_.front()->delivery_time_us <= now_us) {
+    Packet* packet = in_flight_.front();
+    in_flight_.pop_front();
+    WriteResult result = writer_->WritePacket(
+        packet->buffer, packet->length, packet->self_address,
+        packet->peer_address);
+    if (result.status != WRITE_STATUS_OK &&
+        !(result.status == WRITE_STATUS_BLOCKED &&
+          writer_->IsWriteBlockedDataBuffered())) {
+      ++packets_dropped_;
+    }
+    free_packets_.push_back(packet);
+    delivered = true;
+  }
+  if (delivered) {
+    writer_->Flush();
+  }
+  return in_flight_.empty() ? 0 : in_flight_.front()->delivery_time_us;
+}
+
+}  // namespace tools
+}  // namespace net
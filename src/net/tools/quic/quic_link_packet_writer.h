@@ -0,0 +1,125 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_QUIC_QUIC_LINK_PACKET_WRITER_H_
+#define NET_TOOLS_QUIC_QUIC_LINK_PACKET_WRITER_H_
+
+#include <deque>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "net/base/ip_endpoint.h"
+#include "net/quic/quic_bandwidth.h"
+#include "net/quic/quic_packet_writer.h"
+#include "net/quic/quic_protocol.h"
+#include "net/quic/quic_time.h"
+#include "net/tools/epoll_server/epoll_server.h"
+
+namespace net {
+namespace tools {
+
+// The properties of a simulated one-way link.
+struct QuicLinkParameters {
+  QuicLinkParameters();
+
+  // The bottleneck bandwidth.  Zero is unlimited.
+  QuicBandwidth bandwidth;
+  // The propagation delay added to every packet.
+  QuicTime::Delta delay;
+  // The fraction of packets lost at random, before they reach the queue.
+  double loss_rate;
+  // The number of bytes which may wait for the bottleneck.  Packets which
+  // would exceed it are dropped.  Zero is unlimited.
+  QuicByteCount queue_bytes;
+  // Seeds the choice of lost packets, so that runs can be repeated.
+  uint64 seed;
+};
+
+// A packet writer which passes packets to another writer once they have
+// crossed a simulated link, so that in-process benchmarks can measure a
+// connection over a path slower than loopback.  Each packet first waits for
+// the bottleneck to finish serializing the ones before it, then for the
+// propagation delay, and is then written by an alarm on the epoll server, so
+// timing has the epoll server's resolution of about a millisecond.  Packets
+// are copied into buffers which are reused, so once the link has filled, it
+// does not allocate.
+//
+// A link without bandwidth limit, delay or loss writes packets straight
+// through.  Otherwise the link accepts every packet and never reports being
+// write blocked; packets which the wrapped writer blocks on are dropped.
+// All methods must be called on the thread of the epoll server.
+class QuicLinkPacketWriter : public QuicPacketWriter {
+ public:
+  // Takes ownership of |writer| but not of |epoll_server|.
+  QuicLinkPacketWriter(QuicPacketWriter* writer,
+                       EpollServer* epoll_server,
+                       const QuicLinkParameters& link);
+  ~QuicLinkPacketWriter() override;
+
+  // QuicPacketWriter
+  WriteResult WritePacket(const char* buffer,
+                          size_t buf_len,
+                          const IPAddressNumber& self_address,
+                          const IPEndPoint& peer_address) override;
+  bool IsWriteBlockedDataBuffered() const override;
+  bool IsWriteBlocked() const override;
+  void SetWritable() override;
+  WriteResult Flush() override;
+
+  // The number of packets and bytes handed to the link.
+  uint64 packets_written() const { return packets_written_; }
+  uint64 bytes_written() const { return bytes_written_; }
+  // The number of packets lost at random.
+  uint64 packets_lost() const { return packets_lost_; }
+  // The number of packets dropped by the full queue or the wrapped writer.
+  uint64 packets_dropped() const { return packets_dropped_; }
+
+ private:
+  class DeliveryAlarm;
+
+  struct Packet {
+    char buffer[kMaxPacketSize];
+    size_t length;
+    IPAddressNumber self_address;
+    IPEndPoint peer_address;
+    int64 delivery_time_us;
+  };
+
+  // Returns true if packets are delayed or lost at all.
+  bool shaped() const;
+
+  // Returns true if the next packet is to be lost.
+  bool NextPacketLost();
+
+  // Writes the packets which are due.  Returns the time at which the next one
+  // is, or zero.
+  int64 OnDeliveryAlarm();
+
+  scoped_ptr<QuicPacketWriter> writer_;
+  EpollServer* epoll_server_;  // Not owned.
+  const QuicLinkParameters link_;
+  uint64 random_state_;
+
+  // The time at which the bottleneck will have serialized the packets which
+  // were accepted so far.
+  int64 link_free_us_;
+  // Packets on the link, in order of delivery.
+  std::deque<Packet*> in_flight_;
+  // Buffers of delivered packets, for reuse.
+  std::vector<Packet*> free_packets_;
+  scoped_ptr<DeliveryAlarm> delivery_alarm_;
+
+  uint64 packets_written_;
+  uint64 bytes_written_;
+  uint64 packets_lost_;
+  uint64 packets_dropped_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicLinkPacketWriter);
+};
+
+}  // namespace tools
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_LINK_PACKET_WRITER_H_
@@ -0,0 +1,944 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_microbenchmarks.h"
+
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/obj_mac.h>
+#include <openssl/x509.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/containers/hash_tables.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+#include "crypto/scoped_openssl_types.h"
+#include "net/base/ip_endpoint.h"
+#include "net/quic/crypto/cert_compressor.h"
+#include "net/quic/crypto/common_cert_set.h"
+#include "net/quic/crypto/quic_compressed_certs_cache.h"
+#include "net/quic/crypto/quic_random.h"
+#include "net/quic/crypto/sharded_strike_register.h"
+#include "net/quic/quic_connection_id_map.h"
+#include "net/quic/quic_fec_group.h"
+#include "net/quic/quic_protocol.h"
+#include "net/quic/quic_stream_sequencer_buffer.h"
+#include "net/quic/quic_utils.h"
+#include "net/tools/epoll_server/alarm_timing_wheel.h"
+#include "net/tools/quic/quic_batch_packet_writer.h"
+#include "net/tools/quic/quic_default_packet_writer.h"
+#include "net/tools/quic/quic_gso_packet_writer.h"
+
+namespace net {
+namespace tools {
+
+namespace {
+
+// Inserts its share of the nonces into a strike register shared by all
+// threads of a run.
+class NonceInserter : public base::PlatformThread::Delegate {
+ public:
+  NonceInserter(ShardedStrikeRegister* strike_register,
+                const uint8* nonces,
+                size_t num_nonces,
+                uint32 now)
+      : strike_register_(strike_register),
+        nonces_(nonces),
+        num_nonces_(num_nonces),
+        now_(now),
+        failures_(0) {}
+  ~NonceInserter() override {}
+
+  bool Start() { return base::PlatformThread::Create(0, this, &handle_); }
+
+  void Join() { base::PlatformThread::Join(handle_); }
+
+  // base::PlatformThread::Delegate implementation.
+  void ThreadMain() override {
+    for (size_t i = 0; i < num_nonces_; ++i) {
+      if (strike_register_->Insert(nonces_ + i * 32, now_) != NONCE_OK) {
+        ++failures_;
+      }
+    }
+  }
+
+  size_t failures() const { return failures_; }
+
+ private:
+  ShardedStrikeRegister* strike_register_;  // Not owned.
+  const uint8* nonces_;  // Not owned.
+  const size_t num_nonces_;
+  const uint32 now_;
+  size_t failures_;
+  base::PlatformThreadHandle handle_;
+
+  DISALLOW_COPY_AND_ASSIGN(NonceInserter);
+};
+
+// Returns a deterministic pseudo-random number in [0, 1).
+double NextRandom(uint64* state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return (*state >> 11) * (1.0 / (UINT64_C(1) << 53));
+}
+
+// The operations of a receiver on the missing packets of its ack frame, for
+// PacketNumberQueue and for the std::set it replaced.
+void AddMissing(QuicPacketSequenceNumber lower,
+                QuicPacketSequenceNumber higher,
+                PacketNumberQueue* missing) {
+  missing->Add(lower, higher);
+}
+
+void AddMissing(QuicPacketSequenceNumber lower,
+                QuicPacketSequenceNumber higher,
+                SequenceNumberSet* missing) {
+  for (QuicPacketSequenceNumber i = lower; i < higher; ++i) {
+    missing->insert(missing->end(), i);
+  }
+}
+
+void RemoveMissing(QuicPacketSequenceNumber sequence_number,
+                   PacketNumberQueue* missing) {
+  missing->Remove(sequence_number);
+}
+
+void RemoveMissing(QuicPacketSequenceNumber sequence_number,
+                   SequenceNumberSet* missing) {
+  missing->erase(sequence_number);
+}
+
+void RemoveMissingUpTo(QuicPacketSequenceNumber higher,
+                       PacketNumberQueue* missing) {
+  missing->RemoveUpTo(higher);
+}
+
+void RemoveMissingUpTo(QuicPacketSequenceNumber higher,
+                       SequenceNumberSet* missing) {
+  missing->erase(missing->begin(), missing->lower_bound(higher));
+}
+
+// Returns the number of nack ranges the framer would write, walking the
+// missing packets from the largest down as it does.
+size_t CountNackRanges(const PacketNumberQueue& missing) {
+  size_t ranges = 0;
+  for (PacketNumberQueue::const_interval_iterator it =
+           missing.end_intervals();
+       it != missing.begin_intervals();) {
+    --it;
+    ++ranges;
+  }
+  return ranges;
+}
+
+size_t CountNackRanges(const SequenceNumberSet& missing) {
+  size_t ranges = 0;
+  QuicPacketSequenceNumber previous = 0;
+  for (SequenceNumberSet::const_reverse_iterator it = missing.rbegin();
+       it != missing.rend(); ++it) {
+    if (ranges == 0 || *it + 1 != previous) {
+      ++ranges;
+    }
+    previous = *it;
+  }
+  return ranges;
+}
+
+// Receives |arrivals| in order into |missing|, acking every second packet
+// and moving the stop waiting point every twentieth.  Returns the average
+// number of nack ranges per ack.
+template <typename MissingPackets>
+double ReceivePackets(const std::vector<QuicPacketSequenceNumber>& arrivals,
+                      MissingPackets* missing) {
+  // The stop waiting point trails the largest received packet by this much.
+  const QuicPacketSequenceNumber kStopWaitingLag = 200;
+  QuicPacketSequenceNumber largest = 0;
+  size_t acks = 0;
+  size_t ranges = 0;
+  for (size_t i = 0; i < arrivals.size(); ++i) {
+    const QuicPacketSequenceNumber sequence_number = arrivals[i];
+    if (sequence_number > largest) {
+      AddMissing(largest + 1, sequence_number, missing);
+      largest = sequence_number;
+    } else {
+      RemoveMissing(sequence_number, missing);
+    }
+    if (i % 2 == 1) {
+      ++acks;
+      ranges += CountNackRanges(*missing);
+    }
+    if (i % 20 == 19 && largest > kStopWaitingLag) {
+      RemoveMissingUpTo(largest - kStopWaitingLag, missing);
+    }
+  }
+  return acks > 0 ? static_cast<double>(ranges) / acks : 0;
+}
+
+// The XORs compared by RunXorBenchmark().  Each returns false if the CPU
+// does not support it.
+typedef bool (*XorFunction)(char* parity, const char* data, size_t length);
+
+// XORs a byte at a time, as QuicFecGroup::UpdateParity() did.
+bool XorBytes(char* parity, const char* data, size_t length) {
+  for (size_t i = 0; i < length; ++i) {
+    parity[i] ^= data[i];
+  }
+  return true;
+}
+
+template <QuicFecGroup::XorKernel kKernel>
+bool XorWithKernel(char* parity, const char* data, size_t length) {
+  return QuicFecGroup::XorIntoWithKernel(kKernel, parity, data, length);
+}
+
+bool XorWithBestKernel(char* parity, const char* data, size_t length) {
+  QuicFecGroup::XorInto(parity, data, length);
+  return true;
+}
+
+// The alarm containers compared by RunTimingWheelBenchmark(): the
+// AlarmTimingWheel of EpollServer and the std::multimap it replaced.
+class WheelAlarms {
+ public:
+  typedef AlarmTimingWheel::AlarmCB AlarmCB;
+  typedef AlarmTimingWheel::Node* Token;
+
+  Token Add(int64 deadline_in_us, AlarmCB* cb) {
+    return wheel_.Add(deadline_in_us, cb);
+  }
+
+  void Remove(Token token) { wheel_.Remove(token); }
+
+  // Takes out the alarms due at |now_in_us| and appends them to |expired|.
+  void Advance(int64 now_in_us, std::vector<AlarmCB*>* expired) {
+    AlarmTimingWheel::AlarmList list;
+    wheel_.Advance(now_in_us, &list);
+    while (!list.empty()) {
+      expired->push_back(wheel_.PopFront(&list));
+    }
+  }
+
+ private:
+  AlarmTimingWheel wheel_;
+};
+
+class MultimapAlarms {
+ public:
+  typedef AlarmTimingWheel::AlarmCB AlarmCB;
+  typedef std::multimap<int64, AlarmCB*>::iterator Token;
+
+  Token Add(int64 deadline_in_us, AlarmCB* cb) {
+    return alarms_.insert(std::make_pair(deadline_in_us, cb));
+  }
+
+  void Remove(Token token) { alarms_.erase(token); }
+
+  void Advance(int64 now_in_us, std::vector<AlarmCB*>* expired) {
+    while (!alarms_.empty() && alarms_.begin()->first <= now_in_us) {
+      expired->push_back(alarms_.begin()->second);
+      alarms_.erase(alarms_.begin());
+    }
+  }
+
+ private:
+  std::multimap<int64, AlarmCB*> alarms_;
+};
+
+// Registers |num_alarms| alarms due within a second, then advances the time
+// a millisecond at a time, rescheduling 1% of the alarms and re-registering
+// the expired ones each millisecond, until |num_reschedules| alarms were
+// rescheduled.  Returns the nanoseconds per rescheduled or expired alarm and
+// sets |expirations|.
+template <typename Alarms>
+double ChurnAlarms(int num_alarms, int num_reschedules, int64* expirations) {
+  const int64 kMaxDelayUs = 1000 * 1000;
+  const int64 kStepUs = 1000;
+  // The alarms are never run, so they are only told apart by address.
+  std::vector<char> callbacks(num_alarms);
+  typedef typename Alarms::AlarmCB AlarmCB;
+  Alarms alarms;
+  std::vector<typename Alarms::Token> tokens(num_alarms);
+  uint64 random_state = UINT64_C(0x9e3779b97f4a7c15);
+  int64 now_us = 0;
+  for (int i = 0; i < num_alarms; ++i) {
+    tokens[i] = alarms.Add(
+        now_us + 1 + static_cast<int64>(NextRandom(&random_state) *
+                                        kMaxDelayUs),
+        reinterpret_cast<AlarmCB*>(&callbacks[i]));
+  }
+
+  const int per_step = std::max(num_alarms / 100, 1);
+  std::vector<AlarmCB*> expired;
+  *expirations = 0;
+  const base::TimeTicks start = base::TimeTicks::Now();
+  for (int rescheduled = 0; rescheduled < num_reschedules;
+       rescheduled += per_step) {
+    now_us += kStepUs;
+    for (int j = 0; j < per_step; ++j) {
+      const size_t i =
+          static_cast<size_t>(NextRandom(&random_state) * num_alarms);
+      alarms.Remove(tokens[i]);
+      tokens[i] = alarms.Add(
+          now_us + 1 + static_cast<int64>(NextRandom(&random_state) *
+                                          kMaxDelayUs),
+          reinterpret_cast<AlarmCB*>(&callbacks[i]));
+    }
+    expired.clear();
+    alarms.Advance(now_us, &expired);
+    for (AlarmCB* cb : expired) {
+      const size_t i = reinterpret_cast<char*>(cb) - &callbacks[0];
+      tokens[i] = alarms.Add(
+          now_us + 1 + static_cast<int64>(NextRandom(&random_state) *
+                                          kMaxDelayUs),
+          cb);
+    }
+    *expirations += expired.size();
+  }
+  const base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+  const int64 operations =
+      std::max<int64>(num_reschedules + *expirations, 1);
+  return elapsed.InMicroseconds() * 1000.0 / operations;
+}
+
+// The per-session state the dispatch benchmark touches for each packet: one
+// cache line, as reading a QuicServerSession's connection pointer would.
+struct DispatchedSession {
+  uint64 packets;
+  char padding[56];
+};
+
+template <typename Value>
+using HashMap = base::hash_map<QuicConnectionId, Value>;
+
+// Dispatches packets to |connection_ids| as QuicDispatcher::ProcessPacket()
+// does: a packet goes to its session, or else to the time-wait list, or else
+// starts a new connection.  Returns the nanoseconds per packet and sets
+// |new_connections|.
+template <template <typename> class Map>
+double DispatchPackets(
+    const std::vector<QuicConnectionId>& session_ids,
+    const std::vector<QuicConnectionId>& time_wait_ids,
+    const std::vector<QuicConnectionId>& packets,
+    std::vector<DispatchedSession>* sessions,
+    int64* new_connections) {
+  Map<DispatchedSession*> session_map;
+  for (size_t i = 0; i < session_ids.size(); ++i) {
+    session_map.insert(std::make_pair(session_ids[i], &(*sessions)[i]));
+  }
+  Map<int> time_wait_map;
+  for (QuicConnectionId connection_id : time_wait_ids) {
+    time_wait_map.insert(std::make_pair(connection_id, 0));
+  }
+
+  *new_connections = 0;
+  const base::TimeTicks start = base::TimeTicks::Now();
+  for (QuicConnectionId connection_id : packets) {
+    typename Map<DispatchedSession*>::iterator it =
+        session_map.find(connection_id);
+    if (it != session_map.end()) {
+      ++it->second->packets;
+      continue;
+    }
+    typename Map<int>::iterator time_wait = time_wait_map.find(connection_id);
+    if (time_wait != time_wait_map.end()) {
+      ++time_wait->second;
+      continue;
+    }
+    ++*new_connections;
+  }
+  const base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+  return elapsed.InMicroseconds() * 1000.0 /
+         std::max<size_t>(packets.size(), 1);
+}
+
+typedef crypto::ScopedOpenSSL<X509, X509_free> ScopedX509;
+
+// Returns a new P-256 key, or null.
+EVP_PKEY* NewKey() {
+  crypto::ScopedEC_KEY ec_key(
+      EC_KEY_new_by_curve_name(NID_X9_62_prime256v1));
+  crypto::ScopedEVP_PKEY key(EVP_PKEY_new());
+  if (!ec_key || !key || !EC_KEY_generate_key(ec_key.get()) ||
+      !EVP_PKEY_set1_EC_KEY(key.get(), ec_key.get())) {
+    return nullptr;
+  }
+  return key.release();
+}
+
+// Returns the DER certificate of |key| for |name|, signed by |issuer_key| for
+// |issuer|, or an empty string.
+std::string MakeCertificate(const char* name,
+                            EVP_PKEY* key,
+                            const char* issuer,
+                            EVP_PKEY* issuer_key) {
+  ScopedX509 cert(X509_new());
+  if (!cert || !X509_set_version(cert.get(), 2) ||
+      !ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1) ||
+      !X509_gmtime_adj(X509_get_notBefore(cert.get()), 0) ||
+      !X509_gmtime_adj(X509_get_notAfter(cert.get()), 86400) ||
+      !X509_NAME_add_entry_by_txt(
+          X509_get_subject_name(cert.get()), "CN", MBSTRING_ASC,
+          reinterpret_cast<const uint8*>(name), -1, -1, 0) ||
+      !X509_NAME_add_entry_by_txt(
+          X509_get_issuer_name(cert.get()), "CN", MBSTRING_ASC,
+          reinterpret_cast<const uint8*>(issuer), -1, -1, 0) ||
+      !X509_set_pubkey(cert.get(), key) ||
+      !X509_sign(cert.get(), issuer_key, EVP_sha256())) {
+    return std::string();
+  }
+  uint8_t* der = nullptr;
+  const int der_len = i2d_X509(cert.get(), &der);
+  if (der_len <= 0) {
+    return std::string();
+  }
+  crypto::ScopedOpenSSLBytes free_der(der);
+  return std::string(reinterpret_cast<char*>(der), der_len);
+}
+
+// Where the XOR benchmark stores a byte of each parity, so that computing it
+// is not optimized away.
+volatile char g_parity_sink = 0;
+
+// Returns a UDP socket bound to an ephemeral loopback port, and sets |address|
+// to that port, or returns -1.
+int BindLoopbackSocket(IPEndPoint* address) {
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  sockaddr_in raw_address;
+  memset(&raw_address, 0, sizeof(raw_address));
+  raw_address.sin_family = AF_INET;
+  raw_address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t address_len = sizeof(raw_address);
+  if (bind(fd, reinterpret_cast<sockaddr*>(&raw_address), address_len) != 0 ||
+      getsockname(fd, reinterpret_cast<sockaddr*>(&raw_address),
+                  &address_len) != 0 ||
+      !address->FromSockAddr(reinterpret_cast<sockaddr*>(&raw_address),
+                             address_len)) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Writes |num_packets| packets of |packet_length| bytes to |peer_address|
+// with |writer|, flushing after every kMaxGsoSegments as the dispatcher does
+// after each burst, and sets |cpu_us| and |wall_us| to the time taken.
+// Returns false if a write fails.
+bool WritePackets(QuicPacketWriter* writer,
+                  const IPEndPoint& peer_address,
+                  int num_packets,
+                  size_t packet_length,
+                  int64* cpu_us,
+                  int64* wall_us) {
+  std::vector<char> packet(packet_length, 'q');
+  const IPAddressNumber self_address;
+  const base::ThreadTicks start_cpu = base::ThreadTicks::Now();
+  const base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; i < num_packets; ++i) {
+    WriteResult result =
+        writer->WritePacket(&packet[0], packet.size(), self_address,
+                            peer_address);
+    if (result.status == WRITE_STATUS_OK &&
+        ((i + 1) % kMaxGsoSegments == 0 || i + 1 == num_packets)) {
+      result = writer->Flush();
+    }
+    if (result.status != WRITE_STATUS_OK) {
+      LOG(ERROR) << "Write failed: " << strerror(result.error_code);
+      return false;
+    }
+  }
+  *cpu_us = std::max<int64>(
+      (base::ThreadTicks::Now() - start_cpu).InMicroseconds(), 1);
+  *wall_us =
+      std::max<int64>((base::TimeTicks::Now() - start).InMicroseconds(), 1);
+  return true;
+}
+
+}  // namespace
+
+void RunAckBenchmark(int num_packets, BenchmarkResults* results) {
+  const double kLossRates[] = {0.01, 0.1, 0.3};
+  for (double loss_rate : kLossRates) {
+    // Half of the packets which miss their turn arrive ten packets late,
+    // and the others never do.
+    const QuicPacketSequenceNumber kReorderDistance = 10;
+    std::vector<QuicPacketSequenceNumber> arrivals;
+    arrivals.reserve(num_packets);
+    // Late packets and the sequence number after which they arrive.
+    std::deque<std::pair<QuicPacketSequenceNumber, QuicPacketSequenceNumber>>
+        late;
+    uint64 random_state = UINT64_C(0x9e3779b97f4a7c15);
+    for (QuicPacketSequenceNumber i = 1;
+         arrivals.size() < static_cast<size_t>(num_packets); ++i) {
+      if (!late.empty() && late.front().first < i) {
+        arrivals.push_back(late.front().second);
+        late.pop_front();
+      }
+      if (NextRandom(&random_state) >= loss_rate) {
+        arrivals.push_back(i);
+      } else if (NextRandom(&random_state) < 0.5) {
+        late.push_back(std::make_pair(i + kReorderDistance, i));
+      }
+    }
+    arrivals.resize(num_packets);
+
+    base::DictionaryValue* result = new base::DictionaryValue;
+    result->SetDouble("loss_percent", loss_rate * 100);
+    result->SetInteger("packets", num_packets);
+    {
+      PacketNumberQueue missing;
+      const base::TimeTicks start = base::TimeTicks::Now();
+      const double ranges = ReceivePackets(arrivals, &missing);
+      const base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+      result->SetDouble("nack_ranges_per_ack", ranges);
+      result->SetDouble("queue_ns_per_packet",
+                        elapsed.InMicroseconds() * 1000.0 /
+                            std::max(num_packets, 1));
+    }
+    {
+      SequenceNumberSet missing;
+      const base::TimeTicks start = base::TimeTicks::Now();
+      ReceivePackets(arrivals, &missing);
+      const base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+      result->SetDouble("set_ns_per_packet",
+                        elapsed.InMicroseconds() * 1000.0 /
+                            std::max(num_packets, 1));
+    }
+    results->push_back(result);
+  }
+}
+
+void RunXorBenchmark(int num_payloads, BenchmarkResults* results) {
+  // XORing cycles through this many random payloads, which stay in the cache.
+  const size_t kPayloads = 32;
+  const size_t kLength = kMaxPacketSize;
+  std::vector<char> payloads(kPayloads * kLength);
+  QuicRandom::GetInstance()->RandBytes(&payloads[0], payloads.size());
+  char parity[kMaxPacketSize];
+
+  const struct {
+    const char* name;
+    XorFunction function;
+  } kKernels[] = {
+      {"bytes", XorBytes},
+      {"words", XorWithKernel<QuicFecGroup::XOR_WORDS>},
+      {"sse2", XorWithKernel<QuicFecGroup::XOR_SSE2>},
+      {"avx2", XorWithKernel<QuicFecGroup::XOR_AVX2>},
+      {"xor_into", XorWithBestKernel},
+  };
+  for (const auto& kernel : kKernels) {
+    memset(parity, 0, sizeof(parity));
+    if (!kernel.function(parity, &payloads[0], kLength)) {
+      continue;
+    }
+    const base::TimeTicks start = base::TimeTicks::Now();
+    for (int i = 0; i < num_payloads; ++i) {
+      kernel.function(parity, &payloads[(i % kPayloads) * kLength], kLength);
+    }
+    const base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+    g_parity_sink = parity[0];
+
+    const double ns = std::max<double>(elapsed.InMicroseconds() * 1000.0, 1);
+    base::DictionaryValue* result = new base::DictionaryValue;
+    result->SetString("kernel", kernel.name);
+    result->SetInteger("payloads", num_payloads);
+    result->SetInteger("payload_bytes", kLength);
+    result->SetDouble("ns_per_payload", ns / std::max(num_payloads, 1));
+    result->SetDouble("gbytes_per_second",
+                      static_cast<double>(num_payloads) * kLength / ns);
+    results->push_back(result);
+  }
+}
+
+void RunSequencerBufferBenchmark(int num_frames, BenchmarkResults* results) {
+  const size_t kFrameBytes = 1350;
+  std::string payload(kFrameBytes, '\0');
+  QuicRandom::GetInstance()->RandBytes(&payload[0], payload.size());
+
+  const char* const kOrders[] = {"in_order", "late", "shuffled"};
+  for (const char* order : kOrders) {
+    // The order frames arrive in: as sent, with 10% of them 20 frames late,
+    // or permuted within every 32 frames.
+    std::vector<size_t> frames(num_frames);
+    for (size_t i = 0; i < frames.size(); ++i) {
+      frames[i] = i;
+    }
+    uint64 random_state = UINT64_C(0x9e3779b97f4a7c15);
+    if (strcmp(order, "late") == 0) {
+      const size_t kLateFrames = 20;
+      for (size_t i = 0; i + kLateFrames < frames.size(); ++i) {
+        if (NextRandom(&random_state) < 0.1) {
+          const size_t late = frames[i];
+          std::copy(frames.begin() + i + 1,
+                    frames.begin() + i + kLateFrames + 1, frames.begin() + i);
+          frames[i + kLateFrames] = late;
+        }
+      }
+    } else if (strcmp(order, "shuffled") == 0) {
+      const size_t kWindow = 32;
+      for (size_t start = 0; start < frames.size(); start += kWindow) {
+        const size_t end = std::min(start + kWindow, frames.size());
+        for (size_t i = end - 1; i > start; --i) {
+          const size_t j =
+              start + static_cast<size_t>(NextRandom(&random_state) *
+                                          (i - start + 1));
+          std::swap(frames[i], frames[j]);
+        }
+      }
+    }
+
+    QuicStreamSequencerBuffer buffer;
+    size_t max_buffered = 0;
+    std::string error_details;
+    const base::TimeTicks start = base::TimeTicks::Now();
+    for (size_t frame : frames) {
+      size_t bytes_buffered = 0;
+      if (buffer.OnStreamData(frame * kFrameBytes, payload, &bytes_buffered,
+                              &error_details) != QUIC_NO_ERROR) {
+        LOG(ERROR) << "Unable to buffer frame " << frame << ": "
+                   << error_details;
+        break;
+      }
+      max_buffered = std::max(max_buffered, buffer.BytesBuffered());
+      // Consume everything readable in place, as a stream reading its data
+      // without copying does.
+      iovec iov[8];
+      while (buffer.HasBytesToRead()) {
+        const int num_regions = buffer.GetReadableRegions(iov, arraysize(iov));
+        size_t readable = 0;
+        for (int i = 0; i < num_regions; ++i) {
+          readable += iov[i].iov_len;
+        }
+        buffer.MarkConsumed(readable);
+      }
+    }
+    const base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+    const double ns = std::max<double>(elapsed.InMicroseconds() * 1000.0, 1);
+    base::DictionaryValue* result = new base::DictionaryValue;
+    result->SetString("order", order);
+    result->SetInteger("frames", num_frames);
+    result->SetInteger("frame_bytes", kFrameBytes);
+    result->SetBoolean("complete",
+                       buffer.BytesConsumed() == frames.size() * kFrameBytes);
+    result->SetDouble("max_buffered_bytes", static_cast<double>(max_buffered));
+    result->SetDouble("ns_per_frame", ns / std::max(num_frames, 1));
+    result->SetDouble("gbits_per_second",
+                      static_cast<double>(num_frames) * kFrameBytes * 8 / ns);
+    results->push_back(result);
+  }
+}
+
+void RunTimingWheelBenchmark(int num_reschedules, BenchmarkResults* results) {
+  const int kAlarmCounts[] = {10 * 1000, 100 * 1000, 1000 * 1000};
+  for (int num_alarms : kAlarmCounts) {
+    int64 expirations = 0;
+    base::DictionaryValue* result = new base::DictionaryValue;
+    result->SetInteger("alarms", num_alarms);
+    result->SetInteger("reschedules", num_reschedules);
+    result->SetDouble(
+        "wheel_ns_per_operation",
+        ChurnAlarms<WheelAlarms>(num_alarms, num_reschedules, &expirations));
+    result->SetDouble("expirations", static_cast<double>(expirations));
+    result->SetDouble(
+        "multimap_ns_per_operation",
+        ChurnAlarms<MultimapAlarms>(num_alarms, num_reschedules,
+                                    &expirations));
+    results->push_back(result);
+  }
+}
+
+bool RunCertCompressionBenchmark(int num_hellos, BenchmarkResults* results) {
+  // A leaf and an intermediate certificate, as a server sends.
+  crypto::ScopedEVP_PKEY root_key(NewKey());
+  crypto::ScopedEVP_PKEY intermediate_key(NewKey());
+  crypto::ScopedEVP_PKEY leaf_key(NewKey());
+  if (!root_key || !intermediate_key || !leaf_key) {
+    LOG(ERROR) << "Unable to generate the certificate keys";
+    return false;
+  }
+  std::vector<std::string> chain;
+  chain.push_back(MakeCertificate("benchmark.example.org", leaf_key.get(),
+                                  "Benchmark Intermediate CA",
+                                  intermediate_key.get()));
+  chain.push_back(MakeCertificate("Benchmark Intermediate CA",
+                                  intermediate_key.get(), "Benchmark Root CA",
+                                  root_key.get()));
+  if (chain[0].empty() || chain[1].empty()) {
+    LOG(ERROR) << "Unable to make the certificate chain";
+    return false;
+  }
+
+  const CommonCertSets* common_sets = CommonCertSets::GetInstanceQUIC();
+  const std::string common_set_hashes =
+      common_sets->GetCommonHashes().as_string();
+  // What a client which cached the chain on an earlier connection sends.
+  std::string cached_cert_hashes;
+  for (const std::string& cert : chain) {
+    const uint64 hash = QuicUtils::FNV1a_64_Hash(cert.data(), cert.size());
+    cached_cert_hashes.append(reinterpret_cast<const char*>(&hash),
+                              sizeof(hash));
+  }
+
+  // The client hellos of the flood: all from new clients, half from clients
+  // which cached the chain, or each with its own cached certificate hash, as
+  // a flood crafted to miss the cache would be.
+  const char* const kFloods[] = {"new_clients", "half_returning",
+                                 "distinct_hashes"};
+  for (const char* flood : kFloods) {
+    std::vector<std::string> client_cached_hashes(num_hellos);
+    for (int i = 0; i < num_hellos; ++i) {
+      if (strcmp(flood, "half_returning") == 0 && i % 2 == 1) {
+        client_cached_hashes[i] = cached_cert_hashes;
+      } else if (strcmp(flood, "distinct_hashes") == 0) {
+        const uint64 hash = i;
+        client_cached_hashes[i].assign(reinterpret_cast<const char*>(&hash),
+                                       sizeof(hash));
+      }
+    }
+
+    base::DictionaryValue* result = new base::DictionaryValue;
+    result->SetString("flood", flood);
+    result->SetInteger("hellos", num_hellos);
+    result->SetInteger("chain_bytes", chain[0].size() + chain[1].size());
+    result->SetInteger(
+        "compressed_bytes",
+        CertCompressor::CompressChain(chain, common_set_hashes, "",
+                                      common_sets).size());
+
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (int i = 0; i < num_hellos; ++i) {
+      CertCompressor::CompressChain(chain, common_set_hashes,
+                                    client_cached_hashes[i], common_sets);
+    }
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+    result->SetDouble("uncached_us_per_hello",
+                      elapsed.InMicroseconds() /
+                          static_cast<double>(std::max(num_hellos, 1)));
+
+    // As many entries as QuicCryptoServerConfig's cache.
+    QuicCompressedCertsCache cache(64);
+    start = base::TimeTicks::Now();
+    for (int i = 0; i < num_hellos; ++i) {
+      cache.CompressChain(chain, common_set_hashes, client_cached_hashes[i],
+                          common_sets);
+    }
+    elapsed = base::TimeTicks::Now() - start;
+    result->SetDouble("cached_us_per_hello",
+                      elapsed.InMicroseconds() /
+                          static_cast<double>(std::max(num_hellos, 1)));
+    result->SetDouble("cache_hits", static_cast<double>(cache.num_hits()));
+    result->SetDouble("cache_misses", static_cast<double>(cache.num_misses()));
+    results->push_back(result);
+  }
+  return true;
+}
+
+void RunDispatchBenchmark(int num_packets, BenchmarkResults* results) {
+  const int kSessionCounts[] = {10 * 1000, 100 * 1000, 1000 * 1000};
+  for (int num_sessions : kSessionCounts) {
+    // Connection IDs are random, as clients choose them.  A tenth as many
+    // connections are in time wait as are open.
+    std::vector<QuicConnectionId> session_ids(num_sessions);
+    std::vector<QuicConnectionId> time_wait_ids(num_sessions / 10);
+    QuicRandom* random = QuicRandom::GetInstance();
+    for (QuicConnectionId& connection_id : session_ids) {
+      connection_id = random->RandUint64();
+    }
+    for (QuicConnectionId& connection_id : time_wait_ids) {
+      connection_id = random->RandUint64();
+    }
+    // 90% of the packets are for open sessions, picked at random, 5% for
+    // connections in time wait and 5% start new connections.
+    std::vector<QuicConnectionId> packets(num_packets);
+    uint64 random_state = UINT64_C(0x9e3779b97f4a7c15);
+    for (QuicConnectionId& connection_id : packets) {
+      const double kind = NextRandom(&random_state);
+      const double pick = NextRandom(&random_state);
+      if (kind < 0.9) {
+        connection_id = session_ids[static_cast<size_t>(pick * num_sessions)];
+      } else if (kind < 0.95 && !time_wait_ids.empty()) {
+        connection_id =
+            time_wait_ids[static_cast<size_t>(pick * time_wait_ids.size())];
+      } else {
+        connection_id = random->RandUint64();
+      }
+    }
+    std::vector<DispatchedSession> sessions(num_sessions);
+
+    int64 new_connections = 0;
+    base::DictionaryValue* result = new base::DictionaryValue;
+    result->SetInteger("sessions", num_sessions);
+    result->SetInteger("time_wait_connections", time_wait_ids.size());
+    result->SetInteger("packets", num_packets);
+    result->SetDouble(
+        "flat_map_ns_per_packet",
+        DispatchPackets<QuicConnectionIdMap>(session_ids, time_wait_ids,
+                                             packets, &sessions,
+                                             &new_connections));
+    result->SetDouble("new_connections",
+                      static_cast<double>(new_connections));
+    result->SetDouble(
+        "hash_map_ns_per_packet",
+        DispatchPackets<HashMap>(session_ids, time_wait_ids, packets,
+                                 &sessions, &new_connections));
+    results->push_back(result);
+  }
+}
+
+bool RunGsoBenchmark(int num_packets, BenchmarkResults* results) {
+  const int total = std::max(num_packets, 1);
+  IPEndPoint sink_address;
+  int sink_fd = BindLoopbackSocket(&sink_address);
+  if (sink_fd < 0) {
+    LOG(ERROR) << "Unable to bind the sink socket: " << strerror(errno);
+    return false;
+  }
+  // The sink never reads; the kernel drops what does not fit its buffer,
+  // after the sender has paid for the send.
+  const char* const kWriters[] = {"default", "sendmmsg", "gso"};
+  bool ok = true;
+  for (const char* name : kWriters) {
+    IPEndPoint self_address;
+    int fd = BindLoopbackSocket(&self_address);
+    if (fd < 0) {
+      LOG(ERROR) << "Unable to bind the sending socket: " << strerror(errno);
+      ok = false;
+      break;
+    }
+    scoped_ptr<QuicDefaultPacketWriter> writer;
+    QuicBatchPacketWriter* batch_writer = nullptr;
+    QuicGsoPacketWriter* gso_writer = nullptr;
+    if (strcmp(name, "gso") == 0) {
+      gso_writer = new QuicGsoPacketWriter(fd);
+      batch_writer = gso_writer;
+      writer.reset(gso_writer);
+    } else if (strcmp(name, "sendmmsg") == 0) {
+      batch_writer = new QuicBatchPacketWriter(fd);
+      writer.reset(batch_writer);
+    } else {
+      writer.reset(new QuicDefaultPacketWriter(fd));
+    }
+
+    int64 cpu_us = 0;
+    int64 wall_us = 0;
+    const bool written =
+        WritePackets(writer.get(), sink_address, total,
+                     kDefaultMaxPacketSize, &cpu_us, &wall_us);
+    const double bits = 8.0 * kDefaultMaxPacketSize * total;
+
+    base::DictionaryValue* result = new base::DictionaryValue;
+    result->SetString("writer", name);
+    result->SetInteger("packets", total);
+    result->SetInteger("packet_bytes", kDefaultMaxPacketSize);
+    result->SetBoolean("complete", written);
+    // Sender CPU time, which on loopback includes the kernel's work for the
+    // receiving socket too.
+    result->SetDouble("gbits_per_cpu_second", bits / (cpu_us * 1000.0));
+    result->SetDouble("gbits_per_second", bits / (wall_us * 1000.0));
+    result->SetDouble("cpu_ns_per_packet", cpu_us * 1000.0 / total);
+    if (batch_writer != nullptr) {
+      result->SetDouble("packets_per_write_call",
+                        batch_writer->packets_per_write_call());
+      result->SetDouble("packets_dropped",
+                        static_cast<double>(batch_writer->packets_dropped()));
+    }
+    if (gso_writer != nullptr) {
+      result->SetBoolean("gso_supported", gso_writer->gso_supported());
+      result->SetDouble(
+          "gso_packets",
+          static_cast<double>(gso_writer->packets_sent_with_gso()));
+    }
+    results->push_back(result);
+    writer.reset();
+    close(fd);
+    if (!written) {
+      ok = false;
+      break;
+    }
+  }
+  close(sink_fd);
+  return ok;
+}
+
+void RunStrikeRegisterBenchmark(int num_nonces, BenchmarkResults* results) {
+  const uint32 kNow = 1000000;
+  const uint32 kWindowSecs = 600;
+  uint8 orbit[8];
+  QuicRandom::GetInstance()->RandBytes(orbit, sizeof(orbit));
+
+  // Valid nonces: the time, big endian, the orbit and 20 random bytes.
+  const size_t total = std::max(num_nonces, 1);
+  std::vector<uint8> nonces(total * 32);
+  QuicRandom::GetInstance()->RandBytes(&nonces[0], nonces.size());
+  for (size_t i = 0; i < total; ++i) {
+    uint8* nonce = &nonces[i * 32];
+    nonce[0] = static_cast<uint8>(kNow >> 24);
+    nonce[1] = static_cast<uint8>(kNow >> 16);
+    nonce[2] = static_cast<uint8>(kNow >> 8);
+    nonce[3] = static_cast<uint8>(kNow);
+    memcpy(nonce + 4, orbit, sizeof(orbit));
+  }
+
+  const int kThreadCounts[] = {1, 2, 4, 8, 16, 32};
+  for (int num_threads : kThreadCounts) {
+    std::vector<int> shard_counts(1, 1);
+    if (num_threads > 1) {
+      shard_counts.push_back(num_threads);
+    }
+    for (int num_shards : shard_counts) {
+      // Twice the entries needed, so that no shard fills up and evicts.
+      ShardedStrikeRegister strike_register(
+          num_shards, 2 * total, kNow, kWindowSecs, orbit,
+          StrikeRegister::NO_STARTUP_PERIOD_NEEDED);
+      ScopedVector<NonceInserter> inserters;
+      const size_t per_thread = total / num_threads;
+      const base::TimeTicks start = base::TimeTicks::Now();
+      for (int i = 0; i < num_threads; ++i) {
+        inserters.push_back(new NonceInserter(
+            &strike_register, &nonces[i * per_thread * 32], per_thread, kNow));
+        CHECK(inserters.back()->Start());
+      }
+      size_t failures = 0;
+      for (NonceInserter* inserter : inserters) {
+        inserter->Join();
+        failures += inserter->failures();
+      }
+      const base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+      base::DictionaryValue* result = new base::DictionaryValue;
+      result->SetInteger("threads", num_threads);
+      result->SetInteger("shards", num_shards);
+      result->SetDouble("nonces",
+                        static_cast<double>(per_thread * num_threads));
+      result->SetDouble("failures", static_cast<double>(failures));
+      result->SetDouble("nonces_per_second",
+                        per_thread * num_threads /
+                            std::max(elapsed.InSecondsF(), 1e-6));
+      results->push_back(result);
+    }
+  }
+}
+
+}  // namespace tools
+}  // namespace net
@@ -0,0 +1,69 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// Microbenchmarks of the data structures on QUIC's hot paths, run by
+// quic_benchmark.  Each benchmark appends one result per configuration to
+// |results|, for quic_benchmark to print as a line of JSON.
+
+#ifndef NET_TOOLS_QUIC_QUIC_MICROBENCHMARKS_H_
+#define NET_TOOLS_QUIC_QUIC_MICROBENCHMARKS_H_
+
+#include "base/memory/scoped_vector.h"
+#include "base/values.h"
+
+namespace net {
+namespace tools {
+
+typedef ScopedVector<base::DictionaryValue> BenchmarkResults;
+
+// Receives |num_packets| at 1%, 10% and 30% loss, some of the lost packets
+// arriving late, and tracks the missing ones as an ack frame does.  Reports
+// the time per packet with PacketNumberQueue and with a std::set.
+void RunAckBenchmark(int num_packets, BenchmarkResults* results);
+
+// XORs |num_payloads| packet-sized payloads into an FEC parity with each
+// kernel of QuicFecGroup::XorInto() the CPU supports, with the byte loop it
+// replaced, and through XorInto() itself, and reports the time per payload.
+void RunXorBenchmark(int num_payloads, BenchmarkResults* results);
+
+// Feeds |num_frames| stream frames to a QuicStreamSequencerBuffer in order,
+// with some frames late, and permuted, consuming the readable data in place
+// after each, and reports the time per frame.
+void RunSequencerBufferBenchmark(int num_frames, BenchmarkResults* results);
+
+// Keeps 10k, 100k and 1M alarms due within a second, rescheduling 1% of
+// them and re-registering the expired ones every millisecond, until
+// |num_reschedules| were rescheduled.  Reports the time per rescheduled or
+// expired alarm with AlarmTimingWheel and with the std::multimap it replaced.
+void RunTimingWheelBenchmark(int num_reschedules, BenchmarkResults* results);
+
+// Compresses a generated two-certificate chain for |num_hellos| client hellos
+// with CertCompressor and with a QuicCompressedCertsCache, for floods of new
+// clients, of half returning clients, and of clients each sending its own
+// cached certificate hash.  Reports the time per hello.  Returns false if the
+// chain can not be generated.
+bool RunCertCompressionBenchmark(int num_hellos, BenchmarkResults* results);
+
+// Dispatches |num_packets| to 10k, 100k and 1M sessions, with a tenth as many
+// connections in time wait, as QuicDispatcher does: by connection ID to a
+// session, else to the time-wait list, else to a new connection.  Reports the
+// time per packet with QuicConnectionIdMap and with base::hash_map.
+void RunDispatchBenchmark(int num_packets, BenchmarkResults* results);
+
+// Writes |num_packets| full-sized packets over loopback to a socket which
+// never reads them, with QuicDefaultPacketWriter, QuicBatchPacketWriter and
+// QuicGsoPacketWriter, flushing every kMaxGsoSegments packets.  Reports the
+// Gbit/s each sends per core of sender CPU, and the packets per system call.
+// Returns false if a socket can not be bound or a write fails.
+bool RunGsoBenchmark(int num_packets, BenchmarkResults* results);
+
+// Inserts |num_nonces| fresh nonces into a ShardedStrikeRegister from 1, 2,
+// 4, 8, 16 and 32 threads at once, with a single shard and with a shard per
+// thread, and reports the nonces checked per second.
+void RunStrikeRegisterBenchmark(int num_nonces, BenchmarkResults* results);
+
+}  // namespace tools
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_MICROBENCHMARKS_H_
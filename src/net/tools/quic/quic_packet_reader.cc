@@ -17,7 +17,13 @@
 #include "net/tools/quic/quic_dispatcher.h"
 #include "net/tools/quic/quic_socket_utils.h"
 
+// recvmmsg is available from glibc 2.12.
+#if defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 12))
+#define MMSG_MORE 1
+#else
 #define MMSG_MORE 0
+#endif
 
 #ifndef SO_RXQ_OVFL
 #define SO_RXQ_OVFL 40
@@ -27,20 +33,53 @@ namespace net {
 
 namespace tools {
 
-QuicPacketReader::QuicPacketReader() {
+namespace {
+
+// Allocate some extra space so we can send an error if the packet is larger
+// than kMaxPacketSize.
+const size_t kPacketBufferSize = 2 * kMaxPacketSize;
+
+// Number of released buffers the pool keeps for every packet the reader reads
+// per call.  Packets are only retained briefly, for example while a connection
+// waits for the keys to decrypt them, so a few spare buffers cover them.
+const size_t kFreeBuffersPerPacketRead = 2;
+
+}  // namespace
+
+QuicPacketReader::QuicPacketReader()
+    : packets_per_read_(kNumPacketsPerReadMmsgCall),
+      pool_(new QuicPacketBufferPool(
+          kPacketBufferSize,
+          kFreeBuffersPerPacketRead * kNumPacketsPerReadMmsgCall)),
+      packets_retained_(0) {
+  Initialize();
+}
+
+QuicPacketReader::QuicPacketReader(int packets_per_read)
+    : packets_per_read_(packets_per_read),
+      pool_(new QuicPacketBufferPool(
+          kPacketBufferSize,
+          kFreeBuffersPerPacketRead * packets_per_read)),
+      packets_retained_(0) {
+  DCHECK_GT(packets_per_read, 0);
   Initialize();
 }
 
 void QuicPacketReader::Initialize() {
   // Zero initialize uninitialized memory.
-  memset(cbuf_, 0, arraysize(cbuf_));
-  memset(buf_, 0, arraysize(buf_));
-  memset(raw_address_, 0, sizeof(raw_address_));
-  memset(mmsg_hdr_, 0, sizeof(mmsg_hdr_));
+  cbuf_.assign(kSpaceForOverflowAndIp * packets_per_read_, 0);
+  raw_address_.resize(packets_per_read_);
+  memset(&raw_address_[0], 0, sizeof(sockaddr_storage) * packets_per_read_);
+  iov_.resize(packets_per_read_);
+  mmsg_hdr_.resize(packets_per_read_);
+  memset(&mmsg_hdr_[0], 0, sizeof(mmsghdr) * packets_per_read_);
+
+  buffers_.resize(packets_per_read_);
+  for (int i = 0; i < packets_per_read_; ++i) {
+    buffers_[i] = pool_->Allocate();
 
-  for (int i = 0; i < kNumPacketsPerReadMmsgCall; ++i) {
-    iov_[i].iov_base = buf_ + (2 * kMaxPacketSize * i);
-    iov_[i].iov_len = 2 * kMaxPacketSize;
+    iov_[i].iov_base = buffers_[i]->data();
+    iov_[i].iov_len = kPacketBufferSize;
 
     msghdr* hdr = &mmsg_hdr_[i].msg_hdr;
     hdr->msg_name = &raw_address_[i];
@@ -48,7 +87,7 @@ void QuicPacketReader::Initialize() {
     hdr->msg_iov = &iov_[i];
     hdr->msg_iovlen = 1;
 
-    hdr->msg_control = cbuf_ + kSpaceForOverflowAndIp * i;
+    hdr->msg_control = &cbuf_[kSpaceForOverflowAndIp * i];
     hdr->msg_controllen = kSpaceForOverflowAndIp;
   }
 }
@@ -56,15 +95,23 @@ void QuicPacketReader::Initialize() {
 QuicPacketReader::~QuicPacketReader() {
 }
 
+// static
+bool QuicPacketReader::BatchReadsSupported() {
+  return MMSG_MORE;
+}
+
 bool QuicPacketReader::ReadAndDispatchPackets(
     int fd,
     int port,
     ProcessPacketInterface* processor,
     QuicPacketCount* packets_dropped) {
+  if (packets_per_read_ == 1 || !BatchReadsSupported()) {
+    return ReadAndDispatchPooledPacket(fd, port, processor, packets_dropped);
+  }
 #if MMSG_MORE
   // Re-set the length fields in case recvmmsg has changed them.
-  for (int i = 0; i < kNumPacketsPerReadMmsgCall; ++i) {
-    iov_[i].iov_len = 2 * kMaxPacketSize;
+  for (int i = 0; i < packets_per_read_; ++i) {
+    iov_[i].iov_len = kPacketBufferSize;
     mmsg_hdr_[i].msg_len = 0;
     msghdr* hdr = &mmsg_hdr_[i].msg_hdr;
     hdr->msg_namelen = sizeof(sockaddr_storage);
@@ -73,7 +120,7 @@ bool QuicPacketReader::ReadAndDispatchPackets(
   }
 
   int packets_read =
-      recvmmsg(fd, mmsg_hdr_, kNumPacketsPerReadMmsgCall, 0, nullptr);
+      recvmmsg(fd, &mmsg_hdr_[0], packets_per_read_, 0, nullptr);
 
   if (packets_read <= 0) {
     return false;  // recvmmsg failed.
@@ -84,18 +131,23 @@ bool QuicPacketReader::ReadAndDispatchPackets(
       continue;
     }
 
-    IPEndPoint client_address = IPEndPoint(raw_address_[i]);
+    IPEndPoint client_address;
+    if (!client_address.FromSockAddr(
+            reinterpret_cast<const sockaddr*>(&raw_address_[i]),
+            mmsg_hdr_[i].msg_hdr.msg_namelen)) {
+      LOG(DFATAL) << "Unable to get client address.";
+      continue;
+    }
     IPAddressNumber server_ip =
         QuicSocketUtils::GetAddressFromMsghdr(&mmsg_hdr_[i].msg_hdr);
-    if (!IsInitializedAddress(server_ip)) {
+    if (server_ip.empty()) {
       LOG(DFATAL) << "Unable to get server address.";
       continue;
     }
 
-    QuicEncryptedPacket packet(reinterpret_cast<char*>(iov_[i].iov_base),
-                               mmsg_hdr_[i].msg_len, false);
     IPEndPoint server_address(server_ip, port);
-    processor->ProcessPacket(server_address, client_address, packet);
+    DispatchPacket(i, mmsg_hdr_[i].msg_len, server_address, client_address,
+                   processor);
   }
 
   if (packets_dropped != nullptr) {
@@ -110,6 +162,47 @@ bool QuicPacketReader::ReadAndDispatchPackets(
 #endif
 }
 
+bool QuicPacketReader::ReadAndDispatchPooledPacket(
+    int fd,
+    int port,
+    ProcessPacketInterface* processor,
+    QuicPacketCount* packets_dropped) {
+  IPEndPoint client_address;
+  IPAddressNumber server_ip;
+  int bytes_read = QuicSocketUtils::ReadPacket(
+      fd, buffers_[0]->data(), kPacketBufferSize, packets_dropped, &server_ip,
+      &client_address);
+
+  if (bytes_read < 0) {
+    return false;  // ReadPacket failed.
+  }
+
+  IPEndPoint server_address(server_ip, port);
+  DispatchPacket(0, bytes_read, server_address, client_address, processor);
+
+  // The socket read was successful, so return true even if packet dispatch
+  // failed.
+  return true;
+}
+
+void QuicPacketReader::DispatchPacket(int index,
+                                      size_t length,
+                                      const IPEndPoint& server_address,
+                                      const IPEndPoint& client_address,
+                                      ProcessPacketInterface* processor) {
+  {
+    QuicEncryptedPacket packet(buffers_[index].get(), length);
+    processor->ProcessPacket(server_address, client_address, packet);
+  }
+  if (buffers_[index]->HasOneRef()) {
+    return;
+  }
+  // Something kept the packet; leave the buffer to it.
+  ++packets_retained_;
+  buffers_[index] = pool_->Allocate();
+  iov_[index].iov_base = buffers_[index]->data();
+}
+
 /* static */
 bool QuicPacketReader::ReadAndDispatchSinglePacket(
     int fd,
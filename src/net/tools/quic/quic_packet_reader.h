@@ -10,7 +10,11 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 
+#include <vector>
+
 #include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "net/quic/quic_packet_buffer_pool.h"
 #include "net/quic/quic_protocol.h"
 
 namespace net {
@@ -30,12 +34,23 @@ class QuicServerPeer;
 class ProcessPacketInterface;
 class QuicDispatcher;
 
+// Reads packets into reference counted buffers from a QuicPacketBufferPool.
+// A buffer is reused for the next read unless something kept a reference to
+// the packet, in which case a new one is taken from the pool, so packets which
+// outlive ProcessPacket() are never copied.
 class QuicPacketReader {
  public:
   QuicPacketReader();
 
+  // Reads up to |packets_per_read| packets per system call.  recvmmsg is used
+  // if |packets_per_read| is more than one and the platform supports it.
+  explicit QuicPacketReader(int packets_per_read);
+
   virtual ~QuicPacketReader();
 
+  // True if ReadAndDispatchPackets can read more than one packet per call.
+  static bool BatchReadsSupported();
+
   // Reads a number of packets from the given fd, and then passes them off to
   // the PacketProcessInterface.  Returns true if at least 1 packet is read,
   // false otherwise.
@@ -52,22 +67,50 @@ class QuicPacketReader {
                                           ProcessPacketInterface* processor,
                                           QuicPacketCount* packets_dropped);
 
+  int packets_per_read() const { return packets_per_read_; }
+
+  const QuicPacketBufferPool* buffer_pool() const { return pool_.get(); }
+
+  // Number of packets whose buffer was still referenced after ProcessPacket()
+  // returned, and so had to be replaced with a buffer from the pool.
+  uint64 packets_retained() const { return packets_retained_; }
+
  private:
   // Initialize the internal state of the reader.
   void Initialize();
 
+  // Reads one packet with recvmsg into the first buffer.
+  bool ReadAndDispatchPooledPacket(int fd,
+                                   int port,
+                                   ProcessPacketInterface* processor,
+                                   QuicPacketCount* packets_dropped);
+
+  // Hands the |length| bytes read into the |index|th buffer to |processor|,
+  // and replaces the buffer if the packet was kept.
+  void DispatchPacket(int index,
+                      size_t length,
+                      const IPEndPoint& server_address,
+                      const IPEndPoint& client_address,
+                      ProcessPacketInterface* processor);
+
+  const int packets_per_read_;
+  scoped_refptr<QuicPacketBufferPool> pool_;
+  uint64 packets_retained_;
+
+  // buffers_ holds the data read from the kernel, one packet per buffer.
+  std::vector<scoped_refptr<QuicPacketBuffer>> buffers_;
+
   // Storage only used when recvmmsg is available.
 
   // cbuf_ is used for ancillary data from the kernel on recvmmsg.
-  char cbuf_[kSpaceForOverflowAndIp * kNumPacketsPerReadMmsgCall];
-  // buf_ is used for the data read from the kernel on recvmmsg.
-  char buf_[2 * kMaxPacketSize * kNumPacketsPerReadMmsgCall];
-  // iov_ and mmsg_hdr_ are used to supply cbuf and buf to the recvmmsg call.
-  iovec iov_[kNumPacketsPerReadMmsgCall];
-  mmsghdr mmsg_hdr_[kNumPacketsPerReadMmsgCall];
+  std::vector<char> cbuf_;
+  // iov_ and mmsg_hdr_ are used to supply cbuf and buffers_ to the recvmmsg
+  // call.
+  std::vector<iovec> iov_;
+  std::vector<mmsghdr> mmsg_hdr_;
   // raw_address_ is used for address information provided by the recvmmsg
   // call on the packets.
-  struct sockaddr_storage raw_address_[kNumPacketsPerReadMmsgCall];
+  std::vector<sockaddr_storage> raw_address_;
 
   DISALLOW_COPY_AND_ASSIGN(QuicPacketReader);
 };
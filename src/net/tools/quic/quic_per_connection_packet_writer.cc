@@ -41,6 +41,10 @@ void QuicPerConnectionPacketWriter::SetWritable() {
   shared_writer_->SetWritable();
 }
 
+WriteResult QuicPerConnectionPacketWriter::Flush() {
+  return shared_writer_->Flush();
+}
+
 }  // namespace tools
 
 }  // namespace net
@@ -33,6 +33,7 @@ class QuicPerConnectionPacketWriter : public QuicPacketWriter {
   bool IsWriteBlockedDataBuffered() const override;
   bool IsWriteBlocked() const override;
   void SetWritable() override;
+  WriteResult Flush() override;
 
  private:
   QuicPacketWriter* shared_writer_;  // Not owned.
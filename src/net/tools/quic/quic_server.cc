@@ -13,22 +13,24 @@
 
 #include "net/base/ip_endpoint.h"
 #include "net/quic/crypto/crypto_handshake.h"
+#include "net/quic/crypto/crypto_server_config_protobuf.h"
 #include "net/quic/crypto/quic_random.h"
 #include "net/quic/quic_clock.h"
 #include "net/quic/quic_crypto_stream.h"
 #include "net/quic/quic_data_reader.h"
 #include "net/quic/quic_protocol.h"
+#include "net/tools/quic/quic_batch_packet_writer.h"
 #include "net/tools/quic/quic_dispatcher.h"
 #include "net/tools/quic/quic_epoll_clock.h"
 #include "net/tools/quic/quic_epoll_connection_helper.h"
+#include "net/tools/quic/quic_gso_packet_writer.h"
 #include "net/tools/quic/quic_packet_reader.h"
 #include "net/tools/quic/quic_socket_utils.h"
+#include "net/tools/quic/remote_strike_register_client.h"
+#include "net/tools/quic/strike_register_protocol.h"
 
 #include "net/tools/quic/net_util.h"
 
-// TODO(rtenneti): Add support for MMSG_MORE.
-#define MMSG_MORE 0
-
 #ifndef SO_RXQ_OVFL
 #define SO_RXQ_OVFL 40
 #endif
@@ -56,11 +58,14 @@ QuicServer::QuicServer()
       fd_(-1),
       packets_dropped_(0),
       overflow_supported_(false),
-      use_recvmmsg_(false),
+      reuse_port_(false),
+      use_sendmmsg_(false),
+      use_gso_(false),
+      crypto_worker_threads_(0),
       crypto_config_(kSourceAddressTokenSecret, QuicRandom::GetInstance()),
       supported_versions_(QuicSupportedVersions()),
-      packet_reader_(new QuicPacketReader()) {
-  Initialize();
+      packet_reader_(new QuicPacketReader(1)) {
+  Initialize(nullptr);
 }
 
 QuicServer::QuicServer(const QuicConfig& config,
@@ -69,19 +74,36 @@ QuicServer::QuicServer(const QuicConfig& config,
       fd_(-1),
       packets_dropped_(0),
       overflow_supported_(false),
-      use_recvmmsg_(false),
+      reuse_port_(false),
+      use_sendmmsg_(false),
+      use_gso_(false),
+      crypto_worker_threads_(0),
       config_(config),
       crypto_config_(kSourceAddressTokenSecret, QuicRandom::GetInstance()),
       supported_versions_(supported_versions),
-      packet_reader_(new QuicPacketReader()) {
-  Initialize();
+      packet_reader_(new QuicPacketReader(1)) {
+  Initialize(nullptr);
 }
 
-void QuicServer::Initialize() {
-#if MMSG_MORE
-  use_recvmmsg_ = true;
-#endif
+QuicServer::QuicServer(const QuicConfig& config,
+                       const QuicVersionVector& supported_versions,
+                       QuicServerConfigProtobuf* server_config)
+    : port_(0),
+      fd_(-1),
+      packets_dropped_(0),
+      overflow_supported_(false),
+      reuse_port_(false),
+      use_sendmmsg_(false),
+      use_gso_(false),
+      crypto_worker_threads_(0),
+      config_(config),
+      crypto_config_(kSourceAddressTokenSecret, QuicRandom::GetInstance()),
+      supported_versions_(supported_versions),
+      packet_reader_(new QuicPacketReader(1)) {
+  Initialize(server_config);
+}
 
+void QuicServer::Initialize(QuicServerConfigProtobuf* server_config) {
   // If an initial flow control window has not explicitly been set, then use a
   // sensible value for a server: 1 MB for session, 64 KB for each stream.
   const uint32 kInitialSessionFlowControlWindow = 1 * 1024 * 1024;  // 1 MB
@@ -100,13 +122,21 @@ void QuicServer::Initialize() {
   epoll_server_.set_timeout_in_us(50 * 1000);
   QuicEpollClock clock(&epoll_server_);
 
-  scoped_ptr<CryptoHandshakeMessage> scfg(
-      crypto_config_.AddDefaultConfig(
-          QuicRandom::GetInstance(), &clock,
-          QuicCryptoServerConfig::ConfigOptions()));
+  scoped_ptr<CryptoHandshakeMessage> scfg;
+  if (server_config != nullptr) {
+    scfg.reset(crypto_config_.AddConfig(server_config, clock.WallNow()));
+  } else {
+    scfg.reset(crypto_config_.AddDefaultConfig(
+        QuicRandom::GetInstance(), &clock,
+        QuicCryptoServerConfig::ConfigOptions()));
+  }
 }
 
 QuicServer::~QuicServer() {
+  // The sessions must go before the pool that may still hold their handshake
+  // jobs, and the pool's threads must stop while crypto_config_ is alive.
+  dispatcher_.reset();
+  handshake_worker_pool_.reset();
 }
 
 bool QuicServer::Listen(const IPEndPoint& address) {
@@ -137,6 +167,10 @@ bool QuicServer::Listen(const IPEndPoint& address) {
     overflow_supported_ = true;
   }
 
+  if (reuse_port_ && !QuicSocketUtils::SetReusePort(fd_)) {
+    return false;
+  }
+
   const uint32 kSocketBufferSize = 32 * 1024 * 1024; // 32 MB
 
   if (!QuicSocketUtils::SetReceiveBufferSize(fd_, kSocketBufferSize)) {
@@ -172,14 +206,36 @@ bool QuicServer::Listen(const IPEndPoint& address) {
     DVLOG(1) << "Kernel assigned port is " << port_;
   }
 
+  if (!strike_register_socket_.empty()) {
+    scoped_ptr<RemoteStrikeRegisterClient> strike_register_client(
+        new RemoteStrikeRegisterClient(&epoll_server_,
+                                       kStrikeRegisterTimeoutUs));
+    if (!strike_register_client->Connect(strike_register_socket_)) {
+      return false;
+    }
+    crypto_config_.SetStrikeRegisterClient(strike_register_client.release());
+  }
+
   epoll_server_.RegisterFD(fd_, this, kEpollFlags);
   dispatcher_.reset(CreateQuicDispatcher());
   dispatcher_->InitializeWithWriter(CreateWriter(fd_));
+  dispatcher_->set_trace_directory(trace_directory_);
+  if (crypto_worker_threads_ > 0) {
+    handshake_worker_pool_.reset(new CryptoHandshakeWorkerPool(
+        &crypto_config_, crypto_worker_threads_, this));
+    dispatcher_->set_handshake_worker_pool(handshake_worker_pool_.get());
+  }
 
   return true;
 }
 
-QuicDefaultPacketWriter* QuicServer::CreateWriter(int fd) {
+QuicPacketWriter* QuicServer::CreateWriter(int fd) {
+  if (use_gso_) {
+    return new QuicGsoPacketWriter(fd);
+  }
+  if (use_sendmmsg_) {
+    return new QuicBatchPacketWriter(fd);
+  }
   return new QuicDefaultPacketWriter(fd);
 }
 
@@ -192,8 +248,23 @@ QuicDispatcher* QuicServer::CreateQuicDispatcher() {
       new QuicEpollConnectionHelper(&epoll_server_));
 }
 
+ProcessPacketInterface* QuicServer::packet_processor() {
+  return dispatcher_.get();
+}
+
+void QuicServer::set_packets_per_read(int packets_per_read) {
+  if (packets_per_read > 1 && !QuicPacketReader::BatchReadsSupported()) {
+    LOG(WARNING) << "recvmmsg is not supported, reading one packet at a time.";
+    packets_per_read = 1;
+  }
+  packet_reader_.reset(new QuicPacketReader(packets_per_read));
+}
+
 void QuicServer::WaitForEvents() {
   epoll_server_.WaitForEventsAndExecuteCallbacks();
+  if (handshake_worker_pool_.get() != nullptr) {
+    handshake_worker_pool_->RunCompletedCallbacks();
+  }
 }
 
 void QuicServer::Shutdown() {
@@ -205,6 +276,10 @@ void QuicServer::Shutdown() {
   fd_ = -1;
 }
 
+void QuicServer::OnJobCompleted() {
+  epoll_server_.Wake();
+}
+
 void QuicServer::OnEvent(int fd, EpollEvent* event) {
   DCHECK_EQ(fd, fd_);
   event->out_ready_mask = 0;
@@ -213,15 +288,13 @@ void QuicServer::OnEvent(int fd, EpollEvent* event) {
     DVLOG(1) << "EPOLLIN";
     bool read = true;
     while (read) {
-      if (use_recvmmsg_) {
-        read = packet_reader_->ReadAndDispatchPackets(
-            fd_, port_, dispatcher_.get(),
-            overflow_supported_ ? &packets_dropped_ : nullptr);
-      } else {
-        read = QuicPacketReader::ReadAndDispatchSinglePacket(
-            fd_, port_, dispatcher_.get(),
-            overflow_supported_ ? &packets_dropped_ : nullptr);
-      }
+      // The connections' alarms are rescheduled once per read, rather than
+      // for every packet.
+      dispatcher_->StartPacketBatch();
+      read = packet_reader_->ReadAndDispatchPackets(
+          fd_, port_, packet_processor(),
+          overflow_supported_ ? &packets_dropped_ : nullptr);
+      dispatcher_->FinishPacketBatch();
     }
   }
   if (event->in_events & EPOLLOUT) {
@@ -11,9 +11,12 @@
 #ifndef NET_TOOLS_QUIC_QUIC_SERVER_H_
 #define NET_TOOLS_QUIC_QUIC_SERVER_H_
 
+#include <string>
+
 #include "base/basictypes.h"
 #include "base/memory/scoped_ptr.h"
 #include "net/base/ip_endpoint.h"
+#include "net/quic/crypto/crypto_handshake_worker_pool.h"
 #include "net/quic/crypto/quic_crypto_server_config.h"
 #include "net/quic/quic_config.h"
 #include "net/quic/quic_framer.h"
@@ -21,16 +24,27 @@
 #include "net/tools/quic/quic_default_packet_writer.h"
 
 namespace net {
+
+class QuicServerConfigProtobuf;
+
 namespace tools {
 
+class ProcessPacketInterface;
 class QuicDispatcher;
 class QuicPacketReader;
 
-class QuicServer : public EpollCallbackInterface {
+class QuicServer : public EpollCallbackInterface,
+                   public CryptoHandshakeWorkerPool::Delegate {
  public:
   QuicServer();
   QuicServer(const QuicConfig& config,
              const QuicVersionVector& supported_versions);
+  // Uses |server_config| as the server config instead of generating a random
+  // one, so that several servers can hand out the same SCFG.  Does not take
+  // ownership of |server_config|.
+  QuicServer(const QuicConfig& config,
+             const QuicVersionVector& supported_versions,
+             QuicServerConfigProtobuf* server_config);
 
   ~QuicServer() override;
 
@@ -51,6 +65,10 @@ class QuicServer : public EpollCallbackInterface {
 
   void OnShutdown(EpollServer* eps, int fd) override {}
 
+  // From CryptoHandshakeWorkerPool::Delegate.  Wakes the epoll server so that
+  // WaitForEvents() delivers the result.
+  void OnJobCompleted() override;
+
   void SetStrikeRegisterNoStartupPeriod() {
     crypto_config_.set_strike_register_no_startup_period();
   }
@@ -61,17 +79,71 @@ class QuicServer : public EpollCallbackInterface {
     crypto_config_.SetProofSource(source);
   }
 
+  // SetStrikeRegisterClient sets the client with which client nonces are
+  // checked, and takes ownership of |client|.  Must be called before Listen()
+  // and before any client hello arrives.
+  void SetStrikeRegisterClient(StrikeRegisterClient* client) {
+    crypto_config_.SetStrikeRegisterClient(client);
+  }
+
+  // If set before Listen(), the listening socket is opened with SO_REUSEPORT
+  // so that other servers in the same process or elsewhere can share the port.
+  void set_reuse_port(bool reuse_port) { reuse_port_ = reuse_port; }
+
+  // If set before Listen(), packets are written with a QuicBatchPacketWriter,
+  // which sends all packets a connection writes in one go with sendmmsg.
+  void set_use_sendmmsg(bool use_sendmmsg) { use_sendmmsg_ = use_sendmmsg; }
+
+  // If set before Listen(), packets are written with a QuicGsoPacketWriter,
+  // which hands runs of equal-sized packets to the kernel as one UDP_SEGMENT
+  // send.  Falls back to sendmmsg if the kernel does not support it.
+  void set_use_gso(bool use_gso) { use_gso_ = use_gso; }
+
+  // Sets the number of packets read with one recvmmsg call.  The default is
+  // one, which reads with recvmsg.  Must not be called from OnEvent().
+  void set_packets_per_read(int packets_per_read);
+
+  // If set to a positive number before Listen(), client hellos are processed
+  // on that many crypto worker threads instead of the epoll thread.
+  void set_crypto_worker_threads(int crypto_worker_threads) {
+    crypto_worker_threads_ = crypto_worker_threads;
+  }
+
+  // If set before Listen(), client nonces are checked by the
+  // StrikeRegisterServer listening on the Unix socket |socket_path| instead of
+  // in memory, so that servers in several processes share one register.  The
+  // server config must carry that server's orbit.
+  void set_strike_register_socket(const std::string& socket_path) {
+    strike_register_socket_ = socket_path;
+  }
+
+  // If set before Listen(), closed connections which kept a congestion
+  // control trace write it to a file in |directory|.
+  void set_trace_directory(const std::string& directory) {
+    trace_directory_ = directory;
+  }
+
+  const QuicPacketReader* packet_reader() const {
+    return packet_reader_.get();
+  }
+
   bool overflow_supported() { return overflow_supported_; }
 
   QuicPacketCount packets_dropped() { return packets_dropped_; }
 
   int port() { return port_; }
 
+  int fd() { return fd_; }
+
  protected:
-  virtual QuicDefaultPacketWriter* CreateWriter(int fd);
+  virtual QuicPacketWriter* CreateWriter(int fd);
 
   virtual QuicDispatcher* CreateQuicDispatcher();
 
+  // Returns the object incoming packets are handed to.  Defaults to the
+  // dispatcher.
+  virtual ProcessPacketInterface* packet_processor();
+
   const QuicConfig& config() const { return config_; }
   const QuicCryptoServerConfig& crypto_config() const {
     return crypto_config_;
@@ -84,8 +156,9 @@ class QuicServer : public EpollCallbackInterface {
   QuicDispatcher* dispatcher() { return dispatcher_.get(); }
 
  private:
-  // Initialize the internal state of the server.
-  void Initialize();
+  // Initialize the internal state of the server.  If |server_config| is null
+  // a default server config is generated.
+  void Initialize(QuicServerConfigProtobuf* server_config);
 
   // Accepts data from the framer and demuxes clients to sessions.
   scoped_ptr<QuicDispatcher> dispatcher_;
@@ -107,8 +180,23 @@ class QuicServer : public EpollCallbackInterface {
   // because the socket would otherwise overflow.
   bool overflow_supported_;
 
-  // If true, use recvmmsg for reading.
-  bool use_recvmmsg_;
+  // If true, set SO_REUSEPORT on the listening socket.
+  bool reuse_port_;
+
+  // If true, use sendmmsg for writing.
+  bool use_sendmmsg_;
+
+  // If true, use UDP_SEGMENT for writing.
+  bool use_gso_;
+
+  // Number of threads for |handshake_worker_pool_|; zero for none.
+  int crypto_worker_threads_;
+
+  // Unix socket of the strike register server; empty for a local register.
+  std::string strike_register_socket_;
+
+  // Where the dispatcher writes connection traces; empty for nowhere.
+  std::string trace_directory_;
 
   // config_ contains non-crypto parameters that are negotiated in the crypto
   // handshake.
@@ -124,6 +212,10 @@ class QuicServer : public EpollCallbackInterface {
 
   scoped_ptr<QuicPacketReader> packet_reader_;
 
+  // Processes client hellos off the epoll thread if crypto_worker_threads_ is
+  // set.  Must outlive |dispatcher_|.
+  scoped_ptr<CryptoHandshakeWorkerPool> handshake_worker_pool_;
+
   DISALLOW_COPY_AND_ASSIGN(QuicServer);
 };
 
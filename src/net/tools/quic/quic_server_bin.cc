@@ -13,14 +13,70 @@
 #include "base/command_line.h"
 #include "base/logging.h"
 #include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/threading/platform_thread.h"
 #include "net/base/ip_endpoint.h"
+#include "net/quic/crypto/crypto_server_config_protobuf.h"
+#include "net/quic/crypto/file_proof_source.h"
+#include "net/quic/crypto/quic_random.h"
+#include "net/quic/quic_clock.h"
+#include "net/quic/quic_flags.h"
 #include "net/quic/quic_protocol.h"
+#include "net/tools/epoll_server/monotonic_clock.h"
 
 #include "net/tools/quic/quic_server.h"
+#include "net/tools/quic/quic_server_worker_pool.h"
 #include "net/tools/quic/file_downloader_server_stream.h"
+#include "net/tools/quic/remote_strike_register_client.h"
+#include "net/tools/quic/strike_register_protocol.h"
 
 // The port the quic server will listen on.
 int32 FLAGS_port = 6121;
+// The number of threads, each with its own socket, serving the port.
+int32 FLAGS_workers = 1;
+// If true, batch outgoing packets into sendmmsg calls.
+bool FLAGS_sendmmsg = false;
+// If true, send runs of equal-sized packets with UDP generic segmentation
+// offload.
+bool FLAGS_gso = false;
+// The number of packets read with one recvmmsg call.
+int32 FLAGS_packets_per_read = 1;
+// The number of threads, per server thread, that process client hellos.  Zero
+// processes them on the server thread.
+int32 FLAGS_crypto_threads = 0;
+// Comma separated <hostname>:<chain.pem>:<key.pem> triples.  An empty
+// hostname sets the default chain.
+std::string FLAGS_certificate_chains = "";
+// The Unix socket of a strike_register_server to check client nonces with.
+// Empty keeps the strike register in memory.
+std::string FLAGS_strike_register_socket = "";
+// The directory closed connections write their congestion control traces to.
+std::string FLAGS_trace_dir = "";
+// If true, read the time from the calibrated TSC rather than CLOCK_MONOTONIC
+// when the CPU has an invariant one.
+bool FLAGS_tsc_clock = false;
+
+// The number of server config signatures each proof source caches.
+const size_t kMaxCachedSignatures = 64;
+
+// Returns a proof source serving FLAGS_certificate_chains, or null if a chain
+// can not be loaded.
+net::ProofSource* CreateProofSource() {
+  scoped_ptr<net::FileProofSource> proof_source(
+      new net::FileProofSource(kMaxCachedSignatures));
+  for (const std::string& entry : base::SplitString(
+           FLAGS_certificate_chains, ",", base::TRIM_WHITESPACE,
+           base::SPLIT_WANT_NONEMPTY)) {
+    std::vector<std::string> parts = base::SplitString(
+        entry, ":", base::TRIM_WHITESPACE, base::SPLIT_WANT_ALL);
+    if (parts.size() != 3 ||
+        !proof_source->AddCertificateChain(parts[0], parts[1], parts[2])) {
+      LOG(ERROR) << "Bad --certificate_chains entry: " << entry;
+      return nullptr;
+    }
+  }
+  return proof_source.release();
+}
 
 int main(int argc, char *argv[]) {
   base::AtExitManager exit_manager;
@@ -39,6 +95,19 @@ int main(int argc, char *argv[]) {
         "Options:\n"
         "-h, --help          show this help message and exit\n"
         "--port=<port>       specify the port to listen on\n"
+        "--workers=<n>       number of server threads sharing the port\n"
+        "--sendmmsg          batch outgoing packets with sendmmsg\n"
+        "--gso               send packet runs with UDP_SEGMENT offload\n"
+        "--packets_per_read=<n> read up to n packets per recvmmsg call\n"
+        "--crypto_threads=<n> process client hellos on n threads\n"
+        "--certificate_chains=<host>:<chain.pem>:<key.pem>[,...]\n"
+        "                    serve these PEM certificate chains\n"
+        "--strike_register_socket=<path> check client nonces with the\n"
+        "                    strike_register_server listening on path\n"
+        "--trace_events=<n>  keep the last n congestion control events of\n"
+        "                    each connection\n"
+        "--trace_dir=<dir>   write the traces of closed connections to dir\n"
+        "--tsc_clock         read the time from the TSC if it is invariant\n"
         "--dir=<dir>         directory containing files that\n"
         "                    can be downloaded by clients\n";
     std::cout << help_str;
@@ -56,12 +125,130 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  if (line->HasSwitch("workers")) {
+    if (!base::StringToInt(line->GetSwitchValueASCII("workers"),
+                           &FLAGS_workers) || FLAGS_workers < 1) {
+      LOG(ERROR) << "--workers must be a positive integer\n";
+      return 1;
+    }
+  }
+
+  if (line->HasSwitch("sendmmsg")) {
+    FLAGS_sendmmsg = true;
+  }
+  if (line->HasSwitch("gso")) {
+    FLAGS_gso = true;
+  }
+  if (line->HasSwitch("packets_per_read")) {
+    if (!base::StringToInt(line->GetSwitchValueASCII("packets_per_read"),
+                           &FLAGS_packets_per_read) ||
+        FLAGS_packets_per_read < 1) {
+      LOG(ERROR) << "--packets_per_read must be a positive integer\n";
+      return 1;
+    }
+  }
+  if (line->HasSwitch("crypto_threads")) {
+    if (!base::StringToInt(line->GetSwitchValueASCII("crypto_threads"),
+                           &FLAGS_crypto_threads) ||
+        FLAGS_crypto_threads < 0) {
+      LOG(ERROR) << "--crypto_threads must be a non-negative integer\n";
+      return 1;
+    }
+  }
+
+  if (line->HasSwitch("certificate_chains")) {
+    FLAGS_certificate_chains = line->GetSwitchValueASCII("certificate_chains");
+  }
+  if (line->HasSwitch("strike_register_socket")) {
+    FLAGS_strike_register_socket =
+        line->GetSwitchValueASCII("strike_register_socket");
+  }
+  if (line->HasSwitch("trace_events")) {
+    if (!base::StringToInt64(line->GetSwitchValueASCII("trace_events"),
+                             &FLAGS_quic_connection_trace_events) ||
+        FLAGS_quic_connection_trace_events < 0) {
+      LOG(ERROR) << "--trace_events must be a non-negative integer\n";
+      return 1;
+    }
+  }
+  if (line->HasSwitch("trace_dir")) {
+    FLAGS_trace_dir = line->GetSwitchValueASCII("trace_dir");
+  }
+  if (line->HasSwitch("tsc_clock")) {
+    FLAGS_tsc_clock = true;
+  }
+
+  // The clock must be switched before any thread reads it.
+  if (FLAGS_tsc_clock && !net::MonotonicClock::EnableTsc()) {
+    LOG(WARNING) << "No invariant TSC, using CLOCK_MONOTONIC";
+  }
+
+  // Nonces are checked by the strike register whose orbit they carry, so the
+  // server config takes the orbit of a shared one.
+  net::QuicCryptoServerConfig::ConfigOptions config_options;
+  if (!FLAGS_strike_register_socket.empty() &&
+      !net::tools::RemoteStrikeRegisterClient::GetOrbit(
+          FLAGS_strike_register_socket, net::tools::kStrikeRegisterTimeoutUs,
+          &config_options.orbit)) {
+    LOG(ERROR) << "No strike register at " << FLAGS_strike_register_socket;
+    return 1;
+  }
+
   net::IPAddressNumber ip;
   CHECK(net::ParseIPLiteralToNumber("::", &ip));
 
   net::QuicConfig config;
-  net::tools::QuicServer server(config, net::QuicSupportedVersions());
+  if (FLAGS_workers > 1) {
+    net::tools::QuicServerWorkerPool pool(config, net::QuicSupportedVersions(),
+                                          FLAGS_workers, config_options);
+    pool.SetStrikeRegisterNoStartupPeriod();
+    pool.set_use_sendmmsg(FLAGS_sendmmsg);
+    pool.set_use_gso(FLAGS_gso);
+    pool.set_packets_per_read(FLAGS_packets_per_read);
+    pool.set_crypto_worker_threads(FLAGS_crypto_threads);
+    if (!FLAGS_strike_register_socket.empty()) {
+      pool.set_strike_register_socket(FLAGS_strike_register_socket);
+    }
+    pool.set_trace_directory(FLAGS_trace_dir);
+    if (!FLAGS_certificate_chains.empty()) {
+      for (uint32 i = 0; i < pool.num_workers(); ++i) {
+        net::ProofSource* proof_source = CreateProofSource();
+        if (proof_source == nullptr) {
+          return 1;
+        }
+        pool.shard(i)->SetProofSource(proof_source);
+      }
+    }
+    if (!pool.Listen(net::IPEndPoint(ip, FLAGS_port)) || !pool.Start()) {
+      return 1;
+    }
+    while (1) {
+      base::PlatformThread::Sleep(base::TimeDelta::FromSeconds(1));
+    }
+  }
+
+  net::QuicClock clock;
+  scoped_ptr<net::QuicServerConfigProtobuf> server_config(
+      net::QuicCryptoServerConfig::GenerateConfig(
+          net::QuicRandom::GetInstance(), &clock, config_options));
+  net::tools::QuicServer server(config, net::QuicSupportedVersions(),
+                                server_config.get());
   server.SetStrikeRegisterNoStartupPeriod();
+  server.set_use_sendmmsg(FLAGS_sendmmsg);
+  server.set_use_gso(FLAGS_gso);
+  server.set_packets_per_read(FLAGS_packets_per_read);
+  server.set_crypto_worker_threads(FLAGS_crypto_threads);
+  if (!FLAGS_strike_register_socket.empty()) {
+    server.set_strike_register_socket(FLAGS_strike_register_socket);
+  }
+  server.set_trace_directory(FLAGS_trace_dir);
+  if (!FLAGS_certificate_chains.empty()) {
+    net::ProofSource* proof_source = CreateProofSource();
+    if (proof_source == nullptr) {
+      return 1;
+    }
+    server.SetProofSource(proof_source);
+  }
 
   int rc = server.Listen(net::IPEndPoint(ip, FLAGS_port));
   if (rc < 0) {
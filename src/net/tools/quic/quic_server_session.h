@@ -102,6 +102,13 @@ class QuicServerSession : public QuicSession {
         use_stateless_rejects_if_peer_supported);
   }
 
+  // Hands the crypto stream's ProcessClientHello calls to |pool|.  Does not
+  // take ownership of |pool|, which must outlive the session.
+  void set_handshake_worker_pool(CryptoHandshakeWorkerPool* pool) {
+    DCHECK(GetCryptoStream() != nullptr);
+    GetCryptoStream()->set_handshake_worker_pool(pool);
+  }
+
  protected:
   // QuicSession methods:
   ReliableQuicStream* CreateIncomingDynamicStream(QuicStreamId id) override;
@@ -0,0 +1,339 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_server_worker_pool.h"
+
+#include <string.h>
+
+#include "base/logging.h"
+#include "base/stl_util.h"
+#include "base/strings/stringprintf.h"
+#include "net/quic/crypto/crypto_server_config_protobuf.h"
+#include "net/quic/crypto/local_strike_register_client.h"
+#include "net/quic/crypto/quic_crypto_server_config.h"
+#include "net/quic/crypto/quic_random.h"
+#include "net/quic/quic_clock.h"
+#include "net/tools/quic/quic_socket_utils.h"
+
+namespace net {
+namespace tools {
+
+namespace {
+
+// The most client nonces the pool's strike register holds, across all shards.
+const uint32 kStrikeRegisterMaxEntries = 1 << 16;
+
+// The seconds around the current time for which the pool's strike register is
+// authoritative.
+const uint32 kStrikeRegisterWindowSecs = 600;
+
+// A shard's view of the strike register owned by the pool.
+class SharedStrikeRegisterClient : public StrikeRegisterClient {
+ public:
+  explicit SharedStrikeRegisterClient(StrikeRegisterClient* strike_register)
+      : strike_register_(strike_register) {}
+  ~SharedStrikeRegisterClient() override {}
+
+  bool IsKnownOrbit(base::StringPiece orbit) const override {
+    return strike_register_->IsKnownOrbit(orbit);
+  }
+
+  void VerifyNonceIsValidAndUnique(base::StringPiece nonce,
+                                   QuicWallTime now,
+                                   ResultCallback* cb) override {
+    strike_register_->VerifyNonceIsValidAndUnique(nonce, now, cb);
+  }
+
+ private:
+  StrikeRegisterClient* strike_register_;  // Not owned.
+
+  DISALLOW_COPY_AND_ASSIGN(SharedStrikeRegisterClient);
+};
+
+}  // namespace
+
+QuicServerShard::ForwardedPacket::ForwardedPacket(
+    const IPEndPoint& server_address,
+    const IPEndPoint& client_address,
+    const QuicEncryptedPacket& packet)
+    : server_address(server_address),
+      client_address(client_address),
+      packet(packet.Clone()) {}
+
+QuicServerShard::ForwardedPacket::~ForwardedPacket() {}
+
+QuicServerShard::QuicServerShard(const QuicConfig& config,
+                                 const QuicVersionVector& supported_versions,
+                                 QuicServerConfigProtobuf* server_config,
+                                 QuicServerWorkerPool* pool,
+                                 uint32 index)
+    : QuicServer(config, supported_versions, server_config),
+      pool_(pool),
+      index_(index),
+      packets_forwarded_(0) {
+  set_reuse_port(true);
+}
+
+QuicServerShard::~QuicServerShard() {
+  STLDeleteElements(&forwarded_packets_);
+}
+
+void QuicServerShard::ProcessPacket(const IPEndPoint& server_address,
+                                    const IPEndPoint& client_address,
+                                    const QuicEncryptedPacket& packet) {
+  QuicServerShard* owner = pool_->OwnerOf(packet);
+  if (owner == nullptr || owner == this) {
+    dispatcher()->ProcessPacket(server_address, client_address, packet);
+    return;
+  }
+  ++packets_forwarded_;
+  owner->ForwardPacket(server_address, client_address, packet);
+}
+
+void QuicServerShard::ForwardPacket(const IPEndPoint& server_address,
+                                    const IPEndPoint& client_address,
+                                    const QuicEncryptedPacket& packet) {
+  bool was_empty;
+  {
+    base::AutoLock locked(forwarded_packets_lock_);
+    was_empty = forwarded_packets_.empty();
+    forwarded_packets_.push_back(
+        new ForwardedPacket(server_address, client_address, packet));
+  }
+  // Only the first packet of a batch needs to wake the shard up, which also
+  // keeps the wake pipe from filling up under load.
+  if (was_empty) {
+    Wake();
+  }
+}
+
+void QuicServerShard::ProcessForwardedPackets() {
+  std::deque<ForwardedPacket*> packets;
+  {
+    base::AutoLock locked(forwarded_packets_lock_);
+    packets.swap(forwarded_packets_);
+  }
+  if (packets.empty()) {
+    return;
+  }
+  dispatcher()->StartPacketBatch();
+  for (const ForwardedPacket* forwarded : packets) {
+    dispatcher()->ProcessPacket(forwarded->server_address,
+                                forwarded->client_address, *forwarded->packet);
+  }
+  dispatcher()->FinishPacketBatch();
+  STLDeleteElements(&packets);
+}
+
+void QuicServerShard::Wake() {
+  epoll_server()->Wake();
+}
+
+ProcessPacketInterface* QuicServerShard::packet_processor() {
+  return this;
+}
+
+// Runs a shard's event loop until the pool is stopped.
+class QuicServerWorkerPool::Worker : public base::PlatformThread::Delegate {
+ public:
+  Worker(QuicServerWorkerPool* pool, QuicServerShard* shard)
+      : pool_(pool), shard_(shard) {}
+  ~Worker() override {}
+
+  bool Start() {
+    return base::PlatformThread::Create(0, this, &handle_);
+  }
+
+  void Join() {
+    base::PlatformThread::Join(handle_);
+  }
+
+  // base::PlatformThread::Delegate implementation.
+  void ThreadMain() override {
+    base::PlatformThread::SetName(
+        base::StringPrintf("QuicServerShard%u", shard_->index()));
+    while (!pool_->stopping()) {
+      shard_->WaitForEvents();
+      shard_->ProcessForwardedPackets();
+    }
+  }
+
+ private:
+  QuicServerWorkerPool* pool_;  // Not owned.
+  QuicServerShard* shard_;  // Not owned.
+  base::PlatformThreadHandle handle_;
+
+  DISALLOW_COPY_AND_ASSIGN(Worker);
+};
+
+QuicServerWorkerPool::QuicServerWorkerPool(
+    const QuicConfig& config,
+    const QuicVersionVector& supported_versions,
+    uint32 num_workers,
+    const QuicCryptoServerConfig::ConfigOptions& config_options)
+    : strike_register_no_startup_period_(false),
+      stopping_(0),
+      kernel_steering_(false),
+      port_(0) {
+  DCHECK_LT(0u, num_workers);
+  // All shards share one server config, so that a client which learned it from
+  // one shard can do a 0-RTT handshake with any other.  The orbit is chosen
+  // here so that the shared strike register can be created for it.
+  QuicCryptoServerConfig::ConfigOptions options = config_options;
+  if (options.orbit.size() != sizeof(orbit_)) {
+    DCHECK(options.orbit.empty());
+    QuicRandom::GetInstance()->RandBytes(orbit_, sizeof(orbit_));
+    options.orbit.assign(reinterpret_cast<const char*>(orbit_),
+                         sizeof(orbit_));
+  } else {
+    memcpy(orbit_, options.orbit.data(), sizeof(orbit_));
+  }
+  QuicClock clock;
+  scoped_ptr<QuicServerConfigProtobuf> server_config(
+      QuicCryptoServerConfig::GenerateConfig(
+          QuicRandom::GetInstance(), &clock, options));
+  for (uint32 i = 0; i < num_workers; ++i) {
+    shards_.push_back(new QuicServerShard(config, supported_versions,
+                                          server_config.get(), this, i));
+  }
+}
+
+QuicServerWorkerPool::~QuicServerWorkerPool() {
+  // The worker threads use the shards, which are destroyed with the pool.
+  StopWorkers();
+}
+
+bool QuicServerWorkerPool::Listen(const IPEndPoint& address) {
+  if (strike_register_socket_.empty()) {
+    // A 0-RTT hello accepted by one shard may be replayed to any other, so
+    // all of them check nonces in one register, with a shard per worker to
+    // keep the workers from contending for one lock.
+    QuicClock clock;
+    strike_register_.reset(new LocalStrikeRegisterClient(
+        shards_.size(), kStrikeRegisterMaxEntries,
+        static_cast<uint32>(clock.WallNow().ToUNIXSeconds()),
+        kStrikeRegisterWindowSecs, orbit_,
+        strike_register_no_startup_period_
+            ? StrikeRegister::NO_STARTUP_PERIOD_NEEDED
+            : StrikeRegister::DENY_REQUESTS_AT_STARTUP));
+    for (QuicServerShard* shard : shards_) {
+      shard->SetStrikeRegisterClient(
+          new SharedStrikeRegisterClient(strike_register_.get()));
+    }
+  }
+
+  IPEndPoint shard_address = address;
+  for (QuicServerShard* shard : shards_) {
+    if (!shard->Listen(shard_address)) {
+      return false;
+    }
+    // Later shards must join the group on the port the first one got.
+    shard_address = IPEndPoint(address.address(), shard->port());
+  }
+  port_ = shard_address.port();
+
+  if (shards_.size() > 1) {
+    kernel_steering_ = QuicSocketUtils::AttachConnectionIdSteering(
+        shards_[0]->fd(), shards_.size());
+  }
+  DVLOG(1) << "Listening on " << shard_address.ToString() << " with "
+           << shards_.size() << " shards, "
+           << (kernel_steering_ ? "kernel" : "user space")
+           << " connection ID steering";
+  return true;
+}
+
+bool QuicServerWorkerPool::Start() {
+  DCHECK(workers_.empty());
+  for (QuicServerShard* shard : shards_) {
+    Worker* worker = new Worker(this, shard);
+    workers_.push_back(worker);
+    if (!worker->Start()) {
+      LOG(ERROR) << "Failed to start thread for shard " << shard->index();
+      workers_.pop_back();
+      Shutdown();
+      return false;
+    }
+  }
+  return true;
+}
+
+void QuicServerWorkerPool::Shutdown() {
+  StopWorkers();
+  for (QuicServerShard* shard : shards_) {
+    shard->Shutdown();
+  }
+}
+
+void QuicServerWorkerPool::SetStrikeRegisterNoStartupPeriod() {
+  DCHECK(!strike_register_.get());
+  strike_register_no_startup_period_ = true;
+  for (QuicServerShard* shard : shards_) {
+    shard->SetStrikeRegisterNoStartupPeriod();
+  }
+}
+
+void QuicServerWorkerPool::set_use_sendmmsg(bool use_sendmmsg) {
+  for (QuicServerShard* shard : shards_) {
+    shard->set_use_sendmmsg(use_sendmmsg);
+  }
+}
+
+void QuicServerWorkerPool::set_use_gso(bool use_gso) {
+  for (QuicServerShard* shard : shards_) {
+    shard->set_use_gso(use_gso);
+  }
+}
+
+void QuicServerWorkerPool::set_packets_per_read(int packets_per_read) {
+  for (QuicServerShard* shard : shards_) {
+    shard->set_packets_per_read(packets_per_read);
+  }
+}
+
+void QuicServerWorkerPool::set_crypto_worker_threads(
+    int crypto_worker_threads) {
+  for (QuicServerShard* shard : shards_) {
+    shard->set_crypto_worker_threads(crypto_worker_threads);
+  }
+}
+
+void QuicServerWorkerPool::set_strike_register_socket(
+    const std::string& socket_path) {
+  strike_register_socket_ = socket_path;
+  for (QuicServerShard* shard : shards_) {
+    shard->set_strike_register_socket(socket_path);
+  }
+}
+
+void QuicServerWorkerPool::set_trace_directory(const std::string& directory) {
+  for (QuicServerShard* shard : shards_) {
+    shard->set_trace_directory(directory);
+  }
+}
+
+QuicServerShard* QuicServerWorkerPool::OwnerOf(
+    const QuicEncryptedPacket& packet) {
+  int index = QuicSocketUtils::ConnectionIdShard(
+      packet.data(), packet.length(), shards_.size());
+  return index < 0 ? nullptr : shards_[index];
+}
+
+bool QuicServerWorkerPool::stopping() const {
+  return base::subtle::Acquire_Load(&stopping_) != 0;
+}
+
+void QuicServerWorkerPool::StopWorkers() {
+  base::subtle::Release_Store(&stopping_, 1);
+  for (QuicServerShard* shard : shards_) {
+    shard->Wake();
+  }
+  for (Worker* worker : workers_) {
+    worker->Join();
+  }
+  workers_.clear();
+}
+
+}  // namespace tools
+}  // namespace net
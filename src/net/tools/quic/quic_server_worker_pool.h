@@ -0,0 +1,194 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// A pool of QuicServers which share one UDP port through SO_REUSEPORT.  Each
+// shard runs on its own thread with its own socket, EpollServer,
+// QuicDispatcher and QuicCryptoServerConfig, and all shards present the same
+// server config.  Since a client may send the same 0-RTT hello to any shard,
+// the shards check client nonces in one strike register, either in memory and
+// owned by the pool, or the StrikeRegisterServer set with
+// set_strike_register_socket().
+//
+// Packets are steered to shards by connection ID, so every packet of a
+// connection is handled by the shard that owns it.  When the kernel supports
+// SO_ATTACH_REUSEPORT_CBPF the steering happens in the kernel; otherwise the
+// shard that receives a packet for another shard's connection ID forwards it
+// to the owner.
+
+#ifndef NET_TOOLS_QUIC_QUIC_SERVER_WORKER_POOL_H_
+#define NET_TOOLS_QUIC_QUIC_SERVER_WORKER_POOL_H_
+
+#include <deque>
+#include <string>
+
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/platform_thread.h"
+#include "net/base/ip_endpoint.h"
+#include "net/quic/crypto/crypto_protocol.h"
+#include "net/quic/quic_config.h"
+#include "net/quic/quic_protocol.h"
+#include "net/tools/quic/quic_dispatcher.h"
+#include "net/tools/quic/quic_server.h"
+
+namespace net {
+
+class LocalStrikeRegisterClient;
+class QuicServerConfigProtobuf;
+
+namespace tools {
+
+class QuicServerWorkerPool;
+
+// One shard of a QuicServerWorkerPool.
+class QuicServerShard : public QuicServer,
+                        public ProcessPacketInterface {
+ public:
+  QuicServerShard(const QuicConfig& config,
+                  const QuicVersionVector& supported_versions,
+                  QuicServerConfigProtobuf* server_config,
+                  QuicServerWorkerPool* pool,
+                  uint32 index);
+  ~QuicServerShard() override;
+
+  // ProcessPacketInterface implementation.  Hands the packet to the
+  // dispatcher if this shard owns its connection ID, and forwards it to the
+  // owning shard otherwise.
+  void ProcessPacket(const IPEndPoint& server_address,
+                     const IPEndPoint& client_address,
+                     const QuicEncryptedPacket& packet) override;
+
+  // Queues |packet| for processing on this shard's thread, and wakes the
+  // shard up.  Packets read into a QuicPacketBuffer are queued without
+  // copying.  May be called from any thread.
+  void ForwardPacket(const IPEndPoint& server_address,
+                     const IPEndPoint& client_address,
+                     const QuicEncryptedPacket& packet);
+
+  // Processes packets queued by ForwardPacket.  Must be called on the shard's
+  // thread.
+  void ProcessForwardedPackets();
+
+  // Interrupts a blocking WaitForEvents().  May be called from any thread.
+  void Wake();
+
+  uint32 index() const { return index_; }
+
+  // Number of packets this shard handed to another shard.
+  uint64 packets_forwarded() const { return packets_forwarded_; }
+
+ protected:
+  ProcessPacketInterface* packet_processor() override;
+
+ private:
+  struct ForwardedPacket {
+    ForwardedPacket(const IPEndPoint& server_address,
+                    const IPEndPoint& client_address,
+                    const QuicEncryptedPacket& packet);
+    ~ForwardedPacket();
+
+    IPEndPoint server_address;
+    IPEndPoint client_address;
+    scoped_ptr<QuicEncryptedPacket> packet;
+
+   private:
+    DISALLOW_COPY_AND_ASSIGN(ForwardedPacket);
+  };
+
+  QuicServerWorkerPool* pool_;  // Not owned.
+  const uint32 index_;
+  uint64 packets_forwarded_;
+
+  // Protects |forwarded_packets_|, which other shards append to.
+  base::Lock forwarded_packets_lock_;
+  std::deque<ForwardedPacket*> forwarded_packets_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicServerShard);
+};
+
+class QuicServerWorkerPool {
+ public:
+  // The shards' server config is generated with |config_options|.
+  QuicServerWorkerPool(
+      const QuicConfig& config,
+      const QuicVersionVector& supported_versions,
+      uint32 num_workers,
+      const QuicCryptoServerConfig::ConfigOptions& config_options);
+  ~QuicServerWorkerPool();
+
+  // Creates one SO_REUSEPORT socket per worker bound to |address|.  If the
+  // port of |address| is zero, all workers share the kernel-assigned port.
+  // Unless a strike register socket is set, also creates the in-memory strike
+  // register shared by the shards.
+  bool Listen(const IPEndPoint& address);
+
+  // Starts one thread per worker, each of which handles events until
+  // Shutdown() is called.
+  bool Start();
+
+  // Stops and joins the worker threads, and then shuts the servers down.
+  void Shutdown();
+
+  // Must be called before Listen().
+  void SetStrikeRegisterNoStartupPeriod();
+
+  // Must be called before Listen().
+  void set_use_sendmmsg(bool use_sendmmsg);
+  void set_use_gso(bool use_gso);
+  void set_packets_per_read(int packets_per_read);
+  void set_crypto_worker_threads(int crypto_worker_threads);
+  void set_strike_register_socket(const std::string& socket_path);
+  void set_trace_directory(const std::string& directory);
+
+  // Returns the shard which owns the connection of |packet|, or null if the
+  // packet has no full connection ID, in which case any shard may handle it.
+  QuicServerShard* OwnerOf(const QuicEncryptedPacket& packet);
+
+  // True if connection ID steering is done by the kernel.
+  bool kernel_steering() const { return kernel_steering_; }
+
+  uint32 num_workers() const { return shards_.size(); }
+
+  QuicServerShard* shard(uint32 index) { return shards_[index]; }
+
+  int port() { return port_; }
+
+ private:
+  class Worker;
+
+  bool stopping() const;
+
+  // Stops and joins the worker threads, if they were started.
+  void StopWorkers();
+
+  // Orbit of the shards' server config.
+  uint8 orbit_[kOrbitSize];
+  bool strike_register_no_startup_period_;
+  std::string strike_register_socket_;
+  // The strike register shared by all shards, unless they use a
+  // StrikeRegisterServer.  Each shard's crypto config holds a client which
+  // forwards to it, so it must outlive the shards.
+  scoped_ptr<LocalStrikeRegisterClient> strike_register_;
+
+  // Shards, in the order in which their sockets joined the SO_REUSEPORT group.
+  ScopedVector<QuicServerShard> shards_;
+  ScopedVector<Worker> workers_;
+
+  // Set by Shutdown(), read by the worker threads.
+  base::subtle::Atomic32 stopping_;
+
+  bool kernel_steering_;
+
+  int port_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicServerWorkerPool);
+};
+
+}  // namespace tools
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_SERVER_WORKER_POOL_H_
@@ -0,0 +1,595 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_simulated_network.h"
+
+#include <sys/uio.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/memory/scoped_vector.h"
+#include "net/quic/crypto/crypto_handshake_message.h"
+#include "net/quic/crypto/null_decrypter.h"
+#include "net/quic/crypto/null_encrypter.h"
+#include "net/quic/crypto/quic_random.h"
+#include "net/quic/quic_config.h"
+#include "net/quic/quic_connection.h"
+#include "net/quic/quic_packet_writer.h"
+#include "net/quic/quic_send_buffer_slice.h"
+#include "net/quic/quic_utils.h"
+
+namespace net {
+namespace tools {
+
+namespace {
+
+// The stream the client sends its request and the server its response on.
+const QuicStreamId kFlowStreamId = 5;
+
+const char kRequest[] = "GET /";
+
+// The server sends the response from one slice of zeros, over and over.
+const size_t kResponseSliceSize = 64 * 1024;
+
+// Flows are not meant to time out while the simulation runs.
+const int64 kIdleTimeoutSecs = kMaximumIdleTimeoutSecs;
+
+// Queueing delays are counted in buckets of this many microseconds, up to
+// kNumDelayBuckets of them; longer ones share a last bucket.
+const int64 kDelayBucketUs = 100;
+const size_t kNumDelayBuckets = 50 * 1000;
+
+class SingleWriterFactory : public QuicConnection::PacketWriterFactory {
+ public:
+  explicit SingleWriterFactory(QuicPacketWriter* writer) : writer_(writer) {}
+  ~SingleWriterFactory() override {}
+
+  QuicPacketWriter* Create(QuicConnection* connection) const override {
+    return writer_;
+  }
+
+ private:
+  QuicPacketWriter* writer_;
+
+  DISALLOW_COPY_AND_ASSIGN(SingleWriterFactory);
+};
+
+}  // namespace
+
+QuicSimulatedPacket::QuicSimulatedPacket(const char* buffer,
+                                         size_t length,
+                                         const IPEndPoint& source,
+                                         const IPEndPoint& destination)
+    : contents(buffer, length),
+      source(source),
+      destination(destination),
+      queueing_delay(QuicTime::Delta::Zero()) {
+}
+
+QuicSimulatedLinkParameters::QuicSimulatedLinkParameters()
+    : bandwidth(QuicBandwidth::Zero()),
+      delay(QuicTime::Delta::Zero()),
+      queue_bytes(0),
+      loss_rate(0),
+      burst_loss_rate(0),
+      mean_burst_length(1) {
+}
+
+class QuicSimulatedLink::DeliveryDelegate : public QuicAlarm::Delegate {
+ public:
+  explicit DeliveryDelegate(QuicSimulatedLink* link) : link_(link) {}
+
+  QuicTime OnAlarm() override { return link_->OnDeliveryAlarm(); }
+
+ private:
+  QuicSimulatedLink* link_;
+
+  DISALLOW_COPY_AND_ASSIGN(DeliveryDelegate);
+};
+
+QuicSimulatedLink::QuicSimulatedLink(
+    QuicSimulator* simulator,
+    const QuicSimulatedLinkParameters& parameters,
+    QuicSimulatedPacketReceiver* output)
+    : simulator_(simulator),
+      parameters_(parameters),
+      output_(output),
+      link_free_time_(QuicTime::Zero()),
+      delivery_alarm_(
+          simulator->CreateNetworkAlarm(new DeliveryDelegate(this))),
+      in_burst_(false),
+      packets_received_(0),
+      packets_lost_(0),
+      packets_dropped_(0),
+      bytes_delivered_(0) {
+}
+
+QuicSimulatedLink::~QuicSimulatedLink() {
+  delivery_alarm_.reset();
+  for (const InFlightPacket& in_flight : in_flight_) {
+    delete in_flight.packet;
+  }
+}
+
+void QuicSimulatedLink::ReceivePacket(scoped_ptr<QuicSimulatedPacket> packet) {
+  ++packets_received_;
+  if (NextPacketLost()) {
+    ++packets_lost_;
+    return;
+  }
+
+  const QuicTime now = simulator_->Now();
+  const QuicByteCount length = packet->contents.size();
+  // The time at which the link starts sending the packet.
+  QuicTime send_time = now;
+  if (!parameters_.bandwidth.IsZero()) {
+    if (now < link_free_time_) {
+      if (parameters_.queue_bytes > 0 &&
+          parameters_.bandwidth.ToBytesPerPeriod(
+              link_free_time_.Subtract(now)) + length >
+              parameters_.queue_bytes) {
+        ++packets_dropped_;
+        return;
+      }
+      send_time = link_free_time_;
+    }
+    link_free_time_ =
+        send_time.Add(parameters_.bandwidth.TransferTime(length));
+  } else {
+    link_free_time_ = now;
+  }
+  packet->queueing_delay =
+      packet->queueing_delay.Add(send_time.Subtract(now));
+
+  // The delay is the same for every packet, so packets are delivered in the
+  // order they arrived.
+  const QuicTime delivery_time = link_free_time_.Add(parameters_.delay);
+  in_flight_.push_back(InFlightPacket(delivery_time, packet.release()));
+  if (!delivery_alarm_->IsSet()) {
+    delivery_alarm_->Set(delivery_time);
+  }
+}
+
+bool QuicSimulatedLink::NextPacketLost() {
+  bool lost = false;
+  if (parameters_.burst_loss_rate > 0) {
+    // A Gilbert model: a burst ends after each packet with probability
+    // 1 / mean_burst_length, and starts with the probability which puts
+    // burst_loss_rate of the packets in bursts.
+    const double end_probability =
+        1.0 / std::max(1.0, parameters_.mean_burst_length);
+    if (in_burst_) {
+      in_burst_ = !RandomEvent(end_probability);
+    } else {
+      in_burst_ = RandomEvent(end_probability * parameters_.burst_loss_rate /
+                              (1 - parameters_.burst_loss_rate));
+    }
+    lost = in_burst_;
+  }
+  if (!lost && parameters_.loss_rate > 0) {
+    lost = RandomEvent(parameters_.loss_rate);
+  }
+  return lost;
+}
+
+bool QuicSimulatedLink::RandomEvent(double p) {
+  const uint64 random = simulator_->GetRandomGenerator()->RandUint64();
+  return (random >> 11) * (1.0 / (1ULL << 53)) < p;
+}
+
+QuicTime QuicSimulatedLink::OnDeliveryAlarm() {
+  const QuicTime now = simulator_->Now();
+  while (!in_flight_.empty() && in_flight_.front().delivery_time <= now) {
+    scoped_ptr<QuicSimulatedPacket> packet(in_flight_.front().packet);
+    in_flight_.pop_front();
+    bytes_delivered_ += packet->contents.size();
+    output_->ReceivePacket(packet.Pass());
+  }
+  return in_flight_.empty() ? QuicTime::Zero()
+                            : in_flight_.front().delivery_time;
+}
+
+QuicSimulatedSwitch::QuicSimulatedSwitch() {}
+
+QuicSimulatedSwitch::~QuicSimulatedSwitch() {}
+
+void QuicSimulatedSwitch::AddRoute(const IPEndPoint& destination,
+                                   QuicSimulatedPacketReceiver* receiver) {
+  routes_[destination] = receiver;
+}
+
+void QuicSimulatedSwitch::ReceivePacket(
+    scoped_ptr<QuicSimulatedPacket> packet) {
+  std::map<IPEndPoint, QuicSimulatedPacketReceiver*>::const_iterator it =
+      routes_.find(packet->destination);
+  if (it == routes_.end()) {
+    DLOG(WARNING) << "No route to " << packet->destination.ToString();
+    return;
+  }
+  it->second->ReceivePacket(packet.Pass());
+}
+
+// One end of a flow: its connection, the connection's writer, and what the
+// client or the server does with the stream.
+class QuicSimulatedFlow::Endpoint : public QuicSimulatedPacketReceiver,
+                                    public QuicConnectionVisitorInterface,
+                                    public QuicPacketWriter {
+ public:
+  Endpoint(QuicSimulatedFlow* flow,
+           Perspective perspective,
+           const IPEndPoint& self_address,
+           const IPEndPoint& peer_address)
+      : flow_(flow),
+        perspective_(perspective),
+        self_address_(self_address),
+        peer_address_(peer_address),
+        output_(nullptr),
+        simulator_(nullptr),
+        read_interval_(QuicTime::Delta::Zero()),
+        sending_(false),
+        stopped_(false),
+        bytes_sent_(0) {}
+
+  ~Endpoint() override {}
+
+  void set_output(QuicSimulatedPacketReceiver* output) { output_ = output; }
+  void set_read_interval(QuicTime::Delta read_interval) {
+    read_interval_ = read_interval;
+  }
+
+  QuicConnection* connection() { return connection_.get(); }
+
+  // Creates a connection which behaves as if it had completed a handshake
+  // which negotiated |config|.
+  void Connect(QuicSimulator* simulator,
+               QuicConnectionId connection_id,
+               const QuicConfig& config) {
+    DCHECK(output_);
+    simulator_ = simulator;
+    if (!read_interval_.IsZero()) {
+      read_alarm_.reset(simulator->CreateNetworkAlarm(new ReadDelegate(this)));
+    }
+    connection_.reset(new QuicConnection(
+        connection_id, peer_address_, simulator, SingleWriterFactory(this),
+        /*owns_writer=*/false, perspective_, /*is_secure=*/false,
+        QuicSupportedVersions()));
+    connection_->set_visitor(this);
+    connection_->SetEncrypter(ENCRYPTION_FORWARD_SECURE, new NullEncrypter);
+    connection_->SetDecrypter(ENCRYPTION_FORWARD_SECURE, new NullDecrypter);
+    connection_->SetDefaultEncryptionLevel(ENCRYPTION_FORWARD_SECURE);
+    connection_->SetFromConfig(config);
+    connection_->OnHandshakeComplete();
+    if (perspective_ == Perspective::IS_SERVER) {
+      response_slice_ = new QuicSendBufferSlice(
+          base::StringPiece(std::string(kResponseSliceSize, '\0')));
+    }
+  }
+
+  void SendRequest() {
+    struct iovec iov = {const_cast<char*>(kRequest), sizeof(kRequest) - 1};
+    connection_->SendStreamData(kFlowStreamId,
+                                QuicIOVector(&iov, 1, iov.iov_len),
+                                /*offset=*/0, /*fin=*/true, MAY_FEC_PROTECT,
+                                nullptr);
+  }
+
+  void StopSending() {
+    stopped_ = true;
+    sending_ = false;
+  }
+
+  // QuicSimulatedPacketReceiver
+  void ReceivePacket(scoped_ptr<QuicSimulatedPacket> packet) override {
+    if (!connection_) {
+      return;
+    }
+    if (read_alarm_ == nullptr) {
+      ProcessPacket(*packet);
+      return;
+    }
+    unread_packets_.push_back(packet.release());
+    if (!read_alarm_->IsSet()) {
+      read_alarm_->Set(simulator_->Now().Add(read_interval_));
+    }
+  }
+
+  // QuicConnectionVisitorInterface
+  void OnStreamFrame(const QuicStreamFrame& frame) override {
+    if (frame.stream_id != kFlowStreamId) {
+      return;
+    }
+    if (perspective_ == Perspective::IS_CLIENT) {
+      flow_->OnResponseData(frame.offset, frame.data.length());
+      return;
+    }
+    // The connection writes once it has processed the packet.
+    if (frame.fin && !stopped_) {
+      sending_ = true;
+    }
+  }
+  void OnWindowUpdateFrame(const QuicWindowUpdateFrame& frame) override {}
+  void OnBlockedFrame(const QuicBlockedFrame& frame) override {}
+  void OnRstStream(const QuicRstStreamFrame& frame) override {}
+  void OnGoAway(const QuicGoAwayFrame& frame) override {}
+  void OnConnectionClosed(QuicErrorCode error, bool from_peer) override {
+    DVLOG(1) << "Connection closed: " << QuicUtils::ErrorToString(error);
+    sending_ = false;
+    flow_->OnConnectionClosed();
+  }
+  void OnWriteBlocked() override {}
+  void OnSuccessfulVersionNegotiation(const QuicVersion& version) override {}
+  void OnCanWrite() override {
+    // Sends until the send algorithm stops it, and is called again when it
+    // allows more.
+    while (sending_) {
+      struct iovec iov = {const_cast<char*>(response_slice_->data()),
+                          response_slice_->length()};
+      QuicConsumedData consumed = connection_->SendStreamData(
+          kFlowStreamId,
+          QuicIOVector(&iov, response_slice_->length(), response_slice_.get()),
+          bytes_sent_, /*fin=*/false, MAY_FEC_PROTECT, nullptr);
+      bytes_sent_ += consumed.bytes_consumed;
+      if (consumed.bytes_consumed < response_slice_->length()) {
+        break;
+      }
+    }
+  }
+  void OnCongestionWindowChange(QuicTime now) override {}
+  bool WillingAndAbleToWrite() const override { return sending_; }
+  bool HasPendingHandshake() const override { return false; }
+  bool HasOpenDynamicStreams() const override { return sending_; }
+
+  // QuicPacketWriter
+  WriteResult WritePacket(const char* buffer,
+                          size_t buf_len,
+                          const IPAddressNumber& self_address,
+                          const IPEndPoint& peer_address) override {
+    output_->ReceivePacket(make_scoped_ptr(
+        new QuicSimulatedPacket(buffer, buf_len, self_address_, peer_address)));
+    return WriteResult(WRITE_STATUS_OK, buf_len);
+  }
+  bool IsWriteBlockedDataBuffered() const override { return false; }
+  bool IsWriteBlocked() const override { return false; }
+  void SetWritable() override {}
+  WriteResult Flush() override { return WriteResult(WRITE_STATUS_OK, 0); }
+
+ private:
+  class ReadDelegate : public QuicAlarm::Delegate {
+   public:
+    explicit ReadDelegate(Endpoint* endpoint) : endpoint_(endpoint) {}
+
+    QuicTime OnAlarm() override {
+      endpoint_->ReadPackets();
+      return QuicTime::Zero();
+    }
+
+   private:
+    Endpoint* endpoint_;
+
+    DISALLOW_COPY_AND_ASSIGN(ReadDelegate);
+  };
+
+  void ProcessPacket(const QuicSimulatedPacket& packet) {
+    if (perspective_ == Perspective::IS_CLIENT) {
+      flow_->OnServerPacket(packet);
+    }
+    connection_->ProcessUdpPacket(
+        self_address_, packet.source,
+        QuicEncryptedPacket(packet.contents.data(), packet.contents.size()));
+  }
+
+  // Processes the packets which arrived since the last read as one batch,
+  // the way a server handles the packets of one recvmmsg call.
+  void ReadPackets() {
+    QuicConnection::ScopedAlarmBatcher alarm_batcher(connection_.get());
+    for (const QuicSimulatedPacket* packet : unread_packets_) {
+      ProcessPacket(*packet);
+    }
+    unread_packets_.clear();
+  }
+
+  QuicSimulatedFlow* flow_;
+  const Perspective perspective_;
+  const IPEndPoint self_address_;
+  const IPEndPoint peer_address_;
+  QuicSimulatedPacketReceiver* output_;  // Not owned.
+  QuicSimulator* simulator_;  // Not owned.
+  scoped_ptr<QuicConnection> connection_;
+
+  // How long packets wait to be read, or zero to process them as they
+  // arrive.
+  QuicTime::Delta read_interval_;
+  ScopedVector<QuicSimulatedPacket> unread_packets_;
+  scoped_ptr<QuicAlarm> read_alarm_;
+
+  // Whether the server is sending its response.
+  bool sending_;
+  bool stopped_;
+  QuicStreamOffset bytes_sent_;
+  scoped_refptr<QuicSendBufferSlice> response_slice_;
+
+  DISALLOW_COPY_AND_ASSIGN(Endpoint);
+};
+
+QuicSimulatedFlow::QuicSimulatedFlow(QuicSimulator* simulator,
+                                     const IPEndPoint& server_address,
+                                     const IPEndPoint& client_address,
+                                     const QuicTagVector& connection_options,
+                                     QuicByteCount receive_buffer_bytes)
+    : simulator_(simulator),
+      connection_options_(connection_options),
+      receive_buffer_bytes_(receive_buffer_bytes),
+      server_trace_events_(0),
+      read_interval_(QuicTime::Delta::Zero()),
+      server_(new Endpoint(this, Perspective::IS_SERVER, server_address,
+                           client_address)),
+      client_(new Endpoint(this, Perspective::IS_CLIENT, client_address,
+                           server_address)),
+      start_time_(QuicTime::Zero()),
+      stop_time_(QuicTime::Zero()),
+      bytes_delivered_(0),
+      bytes_delivered_at_stop_(0),
+      delay_histogram_(kNumDelayBuckets + 1),
+      num_delay_samples_(0),
+      total_queueing_delay_us_(0),
+      max_queueing_delay_us_(0),
+      closed_early_(false) {
+}
+
+QuicSimulatedFlow::~QuicSimulatedFlow() {
+  // Destroy the connections while both ends still exist.
+  server_.reset();
+  client_.reset();
+}
+
+void QuicSimulatedFlow::SetOutputs(QuicSimulatedPacketReceiver* server_output,
+                                   QuicSimulatedPacketReceiver* client_output) {
+  server_->set_output(server_output);
+  client_->set_output(client_output);
+}
+
+QuicSimulatedPacketReceiver* QuicSimulatedFlow::server() {
+  return server_.get();
+}
+
+QuicSimulatedPacketReceiver* QuicSimulatedFlow::client() {
+  return client_.get();
+}
+
+void QuicSimulatedFlow::Start() {
+  DCHECK(!started());
+  start_time_ = simulator_->Now();
+
+  // Negotiate the configs the way a handshake would.
+  const QuicTime::Delta idle_timeout =
+      QuicTime::Delta::FromSeconds(kIdleTimeoutSecs);
+  QuicConfig client_config;
+  client_config.SetIdleConnectionStateLifetime(idle_timeout, idle_timeout);
+  client_config.SetConnectionOptionsToSend(connection_options_);
+  if (receive_buffer_bytes_ > 0) {
+    client_config.SetSocketReceiveBufferToSend(receive_buffer_bytes_);
+  }
+  QuicConfig server_config;
+  server_config.SetIdleConnectionStateLifetime(idle_timeout, idle_timeout);
+  CryptoHandshakeMessage client_hello;
+  client_config.ToHandshakeMessage(&client_hello);
+  std::string error_details;
+  CHECK_EQ(QUIC_NO_ERROR, server_config.ProcessPeerHello(client_hello, CLIENT,
+                                                         &error_details))
+      << error_details;
+  CryptoHandshakeMessage server_hello;
+  server_config.ToHandshakeMessage(&server_hello);
+  CHECK_EQ(QUIC_NO_ERROR, client_config.ProcessPeerHello(server_hello, SERVER,
+                                                         &error_details))
+      << error_details;
+
+  const QuicConnectionId connection_id =
+      simulator_->GetRandomGenerator()->RandUint64();
+  server_->set_read_interval(read_interval_);
+  client_->set_read_interval(read_interval_);
+  server_->Connect(simulator_, connection_id, server_config);
+  if (server_trace_events_ > 0) {
+    server_->connection()->EnableTrace(server_trace_events_);
+  }
+  client_->Connect(simulator_, connection_id, client_config);
+  client_->SendRequest();
+}
+
+void QuicSimulatedFlow::Stop() {
+  DCHECK(started());
+  DCHECK(!stopped());
+  stop_time_ = simulator_->Now();
+  bytes_delivered_at_stop_ = bytes_delivered_;
+  server_->StopSending();
+  server_stats_ = server_->connection()->GetStats();
+  const QuicConnection* connection = server_->connection();
+  if (connection->trace() != nullptr) {
+    connection->trace()->Serialize(connection->connection_id(),
+                                   Perspective::IS_SERVER, &server_trace_);
+  }
+}
+
+QuicByteCount QuicSimulatedFlow::bytes_delivered() const {
+  return stopped() ? bytes_delivered_at_stop_ : bytes_delivered_;
+}
+
+QuicBandwidth QuicSimulatedFlow::Goodput() const {
+  if (!started()) {
+    return QuicBandwidth::Zero();
+  }
+  const QuicTime end_time = stopped() ? stop_time_ : simulator_->Now();
+  const QuicTime::Delta duration = end_time.Subtract(start_time_);
+  if (duration.IsZero()) {
+    return QuicBandwidth::Zero();
+  }
+  return QuicBandwidth::FromBytesAndTimeDelta(bytes_delivered(), duration);
+}
+
+double QuicSimulatedFlow::MeanQueueingDelayUs() const {
+  if (num_delay_samples_ == 0) {
+    return 0;
+  }
+  return static_cast<double>(total_queueing_delay_us_) / num_delay_samples_;
+}
+
+int64 QuicSimulatedFlow::QueueingDelayPercentileUs(double fraction) const {
+  if (num_delay_samples_ == 0) {
+    return 0;
+  }
+  const int64 rank = std::max<int64>(
+      1, static_cast<int64>(fraction * num_delay_samples_ + 0.5));
+  int64 count = 0;
+  for (size_t bucket = 0; bucket < kNumDelayBuckets; ++bucket) {
+    count += delay_histogram_[bucket];
+    if (count >= rank) {
+      // The top of the bucket, but never more than was seen.
+      return std::min<int64>((bucket + 1) * kDelayBucketUs,
+                             max_queueing_delay_us_);
+    }
+  }
+  return max_queueing_delay_us_;
+}
+
+void QuicSimulatedFlow::OnServerPacket(const QuicSimulatedPacket& packet) {
+  if (stopped()) {
+    return;
+  }
+  const int64 delay_us = packet.queueing_delay.ToMicroseconds();
+  const size_t bucket = static_cast<size_t>(
+      std::min<int64>(delay_us / kDelayBucketUs, kNumDelayBuckets));
+  ++delay_histogram_[bucket];
+  ++num_delay_samples_;
+  total_queueing_delay_us_ += delay_us;
+  max_queueing_delay_us_ = std::max(max_queueing_delay_us_, delay_us);
+}
+
+void QuicSimulatedFlow::OnResponseData(QuicStreamOffset offset,
+                                       QuicByteCount length) {
+  const QuicStreamOffset end = offset + length;
+  if (end <= bytes_delivered_) {
+    return;
+  }
+  if (offset > bytes_delivered_) {
+    QuicStreamOffset& pending_end = pending_ranges_[offset];
+    pending_end = std::max(pending_end, end);
+    return;
+  }
+  bytes_delivered_ = end;
+  while (!pending_ranges_.empty() &&
+         pending_ranges_.begin()->first <= bytes_delivered_) {
+    bytes_delivered_ =
+        std::max(bytes_delivered_, pending_ranges_.begin()->second);
+    pending_ranges_.erase(pending_ranges_.begin());
+  }
+}
+
+void QuicSimulatedFlow::OnConnectionClosed() {
+  if (!stopped()) {
+    closed_early_ = true;
+  }
+}
+
+}  // namespace tools
+}  // namespace net
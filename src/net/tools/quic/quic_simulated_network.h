@@ -0,0 +1,263 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// The network of a QuicSimulator: links with a bandwidth, a queue, a delay
+// and random or bursty loss, a switch which routes packets by address, and
+// flows, each a pair of real QuicConnections transferring bulk data.  Packets
+// go from one QuicSimulatedPacketReceiver to the next, so paths are built by
+// chaining them, and flows which share a link compete for it.
+
+#ifndef NET_TOOLS_QUIC_QUIC_SIMULATED_NETWORK_H_
+#define NET_TOOLS_QUIC_QUIC_SIMULATED_NETWORK_H_
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "net/base/ip_endpoint.h"
+#include "net/quic/quic_alarm.h"
+#include "net/quic/quic_bandwidth.h"
+#include "net/quic/quic_connection_stats.h"
+#include "net/quic/quic_protocol.h"
+#include "net/quic/quic_time.h"
+#include "net/tools/quic/quic_simulator.h"
+
+namespace net {
+namespace tools {
+
+struct QuicSimulatedPacket {
+  QuicSimulatedPacket(const char* buffer,
+                      size_t length,
+                      const IPEndPoint& source,
+                      const IPEndPoint& destination);
+
+  std::string contents;
+  IPEndPoint source;
+  IPEndPoint destination;
+  // The time the packet spent waiting for links to finish sending the
+  // packets ahead of it.
+  QuicTime::Delta queueing_delay;
+};
+
+class QuicSimulatedPacketReceiver {
+ public:
+  virtual ~QuicSimulatedPacketReceiver() {}
+
+  virtual void ReceivePacket(scoped_ptr<QuicSimulatedPacket> packet) = 0;
+};
+
+struct QuicSimulatedLinkParameters {
+  QuicSimulatedLinkParameters();
+
+  // The rate at which the link sends.  Zero is unlimited.
+  QuicBandwidth bandwidth;
+  // The propagation delay added to every packet.
+  QuicTime::Delta delay;
+  // The number of bytes which may wait for the link.  Packets which would
+  // exceed it are dropped.  Zero is unlimited.
+  QuicByteCount queue_bytes;
+  // The fraction of packets lost independently of each other.
+  double loss_rate;
+  // The fraction of packets lost in bursts, and the mean number of packets
+  // in a burst.
+  double burst_loss_rate;
+  double mean_burst_length;
+};
+
+// A one-way link.  Packets are lost at random as they arrive, then wait for
+// the link to send the ones before them, then for the delay, and are then
+// passed on in the order they arrived.
+class QuicSimulatedLink : public QuicSimulatedPacketReceiver {
+ public:
+  // |simulator| and |output| must outlive the link.
+  QuicSimulatedLink(QuicSimulator* simulator,
+                    const QuicSimulatedLinkParameters& parameters,
+                    QuicSimulatedPacketReceiver* output);
+  ~QuicSimulatedLink() override;
+
+  // QuicSimulatedPacketReceiver
+  void ReceivePacket(scoped_ptr<QuicSimulatedPacket> packet) override;
+
+  const QuicSimulatedLinkParameters& parameters() const { return parameters_; }
+
+  uint64 packets_received() const { return packets_received_; }
+  // The number of packets lost at random.
+  uint64 packets_lost() const { return packets_lost_; }
+  // The number of packets dropped by the full queue.
+  uint64 packets_dropped() const { return packets_dropped_; }
+  uint64 bytes_delivered() const { return bytes_delivered_; }
+
+ private:
+  class DeliveryDelegate;
+
+  struct InFlightPacket {
+    InFlightPacket(QuicTime delivery_time, QuicSimulatedPacket* packet)
+        : delivery_time(delivery_time), packet(packet) {}
+
+    QuicTime delivery_time;
+    QuicSimulatedPacket* packet;  // Owned.
+  };
+
+  // Returns true if the next packet is to be lost.
+  bool NextPacketLost();
+  // Returns true with probability |p|.
+  bool RandomEvent(double p);
+
+  // Passes on the packets which are due and returns the time at which the
+  // next one is, or QuicTime::Zero().
+  QuicTime OnDeliveryAlarm();
+
+  QuicSimulator* simulator_;  // Not owned.
+  const QuicSimulatedLinkParameters parameters_;
+  QuicSimulatedPacketReceiver* output_;  // Not owned.
+
+  // The time at which the link will have sent the packets it accepted.
+  QuicTime link_free_time_;
+  std::deque<InFlightPacket> in_flight_;
+  scoped_ptr<QuicAlarm> delivery_alarm_;
+  // Whether the bursty loss model is in a burst.
+  bool in_burst_;
+
+  uint64 packets_received_;
+  uint64 packets_lost_;
+  uint64 packets_dropped_;
+  uint64 bytes_delivered_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicSimulatedLink);
+};
+
+// Passes each packet to the receiver of its destination.
+class QuicSimulatedSwitch : public QuicSimulatedPacketReceiver {
+ public:
+  QuicSimulatedSwitch();
+  ~QuicSimulatedSwitch() override;
+
+  // |receiver| must outlive the switch.
+  void AddRoute(const IPEndPoint& destination,
+                QuicSimulatedPacketReceiver* receiver);
+
+  // QuicSimulatedPacketReceiver
+  void ReceivePacket(scoped_ptr<QuicSimulatedPacket> packet) override;
+
+ private:
+  std::map<IPEndPoint, QuicSimulatedPacketReceiver*> routes_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicSimulatedSwitch);
+};
+
+// A client which asks a server for data, which the server then sends as fast
+// as its send algorithm lets it until the flow is stopped.  Both ends are
+// QuicConnections with null encryption, configured as if they had done a
+// handshake, so the connection options the client sends pick the server's
+// send algorithm.
+class QuicSimulatedFlow {
+ public:
+  // |simulator| must outlive the flow.
+  QuicSimulatedFlow(QuicSimulator* simulator,
+                    const IPEndPoint& server_address,
+                    const IPEndPoint& client_address,
+                    const QuicTagVector& connection_options,
+                    QuicByteCount receive_buffer_bytes);
+  ~QuicSimulatedFlow();
+
+  // Sets where the server and the client send their packets.  Both must
+  // outlive the flow.
+  void SetOutputs(QuicSimulatedPacketReceiver* server_output,
+                  QuicSimulatedPacketReceiver* client_output);
+
+  // The ends of the flow, which packets to their addresses must reach.
+  QuicSimulatedPacketReceiver* server();
+  QuicSimulatedPacketReceiver* client();
+
+  // Has the server keep a trace of its last |num_events| congestion control
+  // events.  Must be called before Start().
+  void set_server_trace_events(size_t num_events) {
+    server_trace_events_ = num_events;
+  }
+
+  // Has both ends read the packets which arrived in the last |read_interval|
+  // at once, rather than each as it arrives, so that their connections batch
+  // alarm updates across them.  Must be called before Start().
+  void set_read_interval(QuicTime::Delta read_interval) {
+    read_interval_ = read_interval;
+  }
+
+  // Creates the connections, and has the client send its request.
+  void Start();
+  // Has the server stop sending new data, and records the flow's results.
+  void Stop();
+
+  bool started() const { return start_time_.IsInitialized(); }
+  bool stopped() const { return stop_time_.IsInitialized(); }
+  QuicTime start_time() const { return start_time_; }
+  QuicTime stop_time() const { return stop_time_; }
+
+  // The number of bytes the client received in order before the flow was
+  // stopped, or so far if it has not been.
+  QuicByteCount bytes_delivered() const;
+  // The rate at which the client received data while the flow ran.
+  QuicBandwidth Goodput() const;
+
+  // The queueing delay of the packets the server sent, in microseconds.
+  int64 num_delay_samples() const { return num_delay_samples_; }
+  double MeanQueueingDelayUs() const;
+  // Returns the queueing delay which |fraction| of the packets did not
+  // exceed, to the resolution of the histogram.
+  int64 QueueingDelayPercentileUs(double fraction) const;
+  int64 max_queueing_delay_us() const { return max_queueing_delay_us_; }
+
+  // The statistics of the server's connection when the flow was stopped.
+  const QuicConnectionStats& server_stats() const { return server_stats_; }
+  // Whether a connection closed before the flow was stopped.
+  bool closed_early() const { return closed_early_; }
+  // The server's serialized trace when the flow was stopped, or empty if it
+  // kept none.
+  const std::string& server_trace() const { return server_trace_; }
+
+ private:
+  class Endpoint;
+
+  // Called by the client for every packet from the server.
+  void OnServerPacket(const QuicSimulatedPacket& packet);
+  // Called by the client for every frame of the response.
+  void OnResponseData(QuicStreamOffset offset, QuicByteCount length);
+  void OnConnectionClosed();
+
+  QuicSimulator* simulator_;  // Not owned.
+  const QuicTagVector connection_options_;
+  const QuicByteCount receive_buffer_bytes_;
+  size_t server_trace_events_;
+  QuicTime::Delta read_interval_;
+  scoped_ptr<Endpoint> server_;
+  scoped_ptr<Endpoint> client_;
+
+  QuicTime start_time_;
+  QuicTime stop_time_;
+
+  // The bytes of the response received in order, and the ranges received
+  // beyond them, by start and end.
+  QuicByteCount bytes_delivered_;
+  QuicByteCount bytes_delivered_at_stop_;
+  std::map<QuicStreamOffset, QuicStreamOffset> pending_ranges_;
+
+  // A histogram of the queueing delay of the server's packets.
+  std::vector<int64> delay_histogram_;
+  int64 num_delay_samples_;
+  int64 total_queueing_delay_us_;
+  int64 max_queueing_delay_us_;
+
+  QuicConnectionStats server_stats_;
+  bool closed_early_;
+  std::string server_trace_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicSimulatedFlow);
+};
+
+}  // namespace tools
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_SIMULATED_NETWORK_H_
@@ -0,0 +1,186 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_simulator.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace net {
+namespace tools {
+
+namespace {
+
+// QuicTime::Zero() means uninitialized, so virtual time starts a while after
+// it.
+const int64 kStartTimeUs = 1000 * 1000;
+
+// The wall time at which every simulation starts, so that wall times do not
+// depend on when it runs either.
+const uint64 kStartWallTimeSeconds = 1420070400;  // 2015-01-01
+
+}  // namespace
+
+class QuicSimulator::Clock : public QuicClock {
+ public:
+  explicit Clock(const QuicSimulator* simulator) : simulator_(simulator) {}
+
+  QuicTime ApproximateNow() const override { return simulator_->Now(); }
+
+  QuicTime Now() const override { return simulator_->Now(); }
+
+  QuicWallTime WallNow() const override {
+    return QuicWallTime::FromUNIXSeconds(kStartWallTimeSeconds)
+        .Add(simulator_->Now().Subtract(simulator_->start_time()));
+  }
+
+ private:
+  const QuicSimulator* simulator_;
+
+  DISALLOW_COPY_AND_ASSIGN(Clock);
+};
+
+// xorshift64*, which is fast and repeatable.  It is not for cryptography,
+// which the simulated connections do not do.
+class QuicSimulator::Random : public QuicRandom {
+ public:
+  // xorshift gets stuck at zero.
+  explicit Random(uint64 seed) : state_(seed != 0 ? seed : 1) {}
+
+  void RandBytes(void* data, size_t len) override {
+    uint8* bytes = static_cast<uint8*>(data);
+    while (len > 0) {
+      const uint64 random = RandUint64();
+      const size_t chunk = std::min(len, sizeof(random));
+      memcpy(bytes, &random, chunk);
+      bytes += chunk;
+      len -= chunk;
+    }
+  }
+
+  uint64 RandUint64() override {
+    state_ ^= state_ >> 12;
+    state_ ^= state_ << 25;
+    state_ ^= state_ >> 27;
+    return state_ * 2685821657736338717ULL;
+  }
+
+  void Reseed(const void* additional_entropy, size_t entropy_len) override {}
+
+ private:
+  uint64 state_;
+
+  DISALLOW_COPY_AND_ASSIGN(Random);
+};
+
+class QuicSimulator::Alarm : public QuicAlarm {
+ public:
+  Alarm(QuicSimulator* simulator,
+        QuicAlarm::Delegate* delegate,
+        bool is_connection_alarm)
+      : QuicAlarm(delegate),
+        simulator_(simulator),
+        is_connection_alarm_(is_connection_alarm),
+        position_(simulator->unscheduled()) {}
+
+  ~Alarm() override { CancelImpl(); }
+
+  // Called by the simulator once it has unqueued the alarm.
+  void FireNow() {
+    position_ = simulator_->unscheduled();
+    Fire();
+  }
+
+  bool is_connection_alarm() const { return is_connection_alarm_; }
+
+ protected:
+  void SetImpl() override {
+    DCHECK(position_ == simulator_->unscheduled());
+    position_ = simulator_->Schedule(this);
+  }
+
+  void CancelImpl() override {
+    if (position_ != simulator_->unscheduled()) {
+      simulator_->Unschedule(position_);
+      position_ = simulator_->unscheduled();
+    }
+  }
+
+ private:
+  QuicSimulator* simulator_;
+  const bool is_connection_alarm_;
+  AlarmQueue::iterator position_;
+
+  DISALLOW_COPY_AND_ASSIGN(Alarm);
+};
+
+QuicSimulator::QuicSimulator(uint64 seed)
+    : start_time_(QuicTime::Zero().Add(
+          QuicTime::Delta::FromMicroseconds(kStartTimeUs))),
+      now_(start_time_),
+      clock_(new Clock(this)),
+      random_(new Random(seed)),
+      next_alarm_sequence_(0),
+      num_alarms_fired_(0),
+      num_connection_alarms_scheduled_(0) {
+}
+
+QuicSimulator::~QuicSimulator() {
+  // Alarms are owned by their connections, which must be gone by now.
+  DCHECK(alarms_.empty());
+}
+
+const QuicClock* QuicSimulator::GetClock() const {
+  return clock_.get();
+}
+
+QuicRandom* QuicSimulator::GetRandomGenerator() {
+  return random_.get();
+}
+
+QuicAlarm* QuicSimulator::CreateAlarm(QuicAlarm::Delegate* delegate) {
+  return new Alarm(this, delegate, /*is_connection_alarm=*/true);
+}
+
+QuicAlarm* QuicSimulator::CreateNetworkAlarm(QuicAlarm::Delegate* delegate) {
+  return new Alarm(this, delegate, /*is_connection_alarm=*/false);
+}
+
+void QuicSimulator::RunUntil(QuicTime end_time) {
+  while (!alarms_.empty()) {
+    AlarmQueue::iterator next = alarms_.begin();
+    if (next->first.first > end_time.ToDebuggingValue()) {
+      break;
+    }
+    // Alarms set in the past fire now; time never moves backwards.
+    now_ = std::max(now_, QuicTime::Zero().Add(
+                              QuicTime::Delta::FromMicroseconds(
+                                  next->first.first)));
+    Alarm* alarm = next->second;
+    alarms_.erase(next);
+    ++num_alarms_fired_;
+    alarm->FireNow();
+  }
+  now_ = std::max(now_, end_time);
+}
+
+QuicSimulator::AlarmQueue::iterator QuicSimulator::Schedule(Alarm* alarm) {
+  if (alarm->is_connection_alarm()) {
+    ++num_connection_alarms_scheduled_;
+  }
+  return alarms_.insert(std::make_pair(
+                            std::make_pair(alarm->deadline().ToDebuggingValue(),
+                                           next_alarm_sequence_++),
+                            alarm)).first;
+}
+
+void QuicSimulator::Unschedule(AlarmQueue::iterator position) {
+  alarms_.erase(position);
+}
+
+}  // namespace tools
+}  // namespace net
@@ -0,0 +1,87 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// A discrete event simulator for QUIC connections.  It is a
+// QuicConnectionHelperInterface whose clock only moves when the simulator
+// fires the next alarm, so connections driven by it run in virtual time, as
+// fast as the CPU allows, and the same seed always gives the same run.
+
+#ifndef NET_TOOLS_QUIC_QUIC_SIMULATOR_H_
+#define NET_TOOLS_QUIC_QUIC_SIMULATOR_H_
+
+#include <map>
+#include <utility>
+
+#include "base/basictypes.h"
+#include "net/quic/crypto/quic_random.h"
+#include "net/quic/quic_alarm.h"
+#include "net/quic/quic_clock.h"
+#include "net/quic/quic_connection.h"
+#include "net/quic/quic_time.h"
+
+namespace net {
+namespace tools {
+
+class QuicSimulator : public QuicConnectionHelperInterface {
+ public:
+  // |seed| seeds the random generator, and with it every random choice made
+  // by the connections and the simulated network.
+  explicit QuicSimulator(uint64 seed);
+  ~QuicSimulator() override;
+
+  // QuicConnectionHelperInterface
+  const QuicClock* GetClock() const override;
+  QuicRandom* GetRandomGenerator() override;
+  QuicAlarm* CreateAlarm(QuicAlarm::Delegate* delegate) override;
+
+  // Creates an alarm for the simulated network rather than a connection,
+  // which num_connection_alarms_scheduled() does not count.
+  QuicAlarm* CreateNetworkAlarm(QuicAlarm::Delegate* delegate);
+
+  // Fires alarms in order of their deadlines, those with the same deadline
+  // in the order they were set, until the next one is after |end_time| or
+  // none is left.  Then moves the clock to |end_time|.
+  void RunUntil(QuicTime end_time);
+
+  // The current virtual time.
+  QuicTime Now() const { return now_; }
+  // The virtual time at which the simulation started.
+  QuicTime start_time() const { return start_time_; }
+
+  uint64 num_alarms_fired() const { return num_alarms_fired_; }
+  // The number of times a connection's alarm was put in the queue, which
+  // for a real scheduler like EpollServer is a tree insertion.
+  uint64 num_connection_alarms_scheduled() const {
+    return num_connection_alarms_scheduled_;
+  }
+
+ private:
+  class Alarm;
+  class Clock;
+  class Random;
+
+  // Alarms are ordered by deadline, then by the order they were set in.
+  typedef std::map<std::pair<int64, uint64>, Alarm*> AlarmQueue;
+
+  // Queues |alarm| for its deadline and returns its position.
+  AlarmQueue::iterator Schedule(Alarm* alarm);
+  void Unschedule(AlarmQueue::iterator position);
+  AlarmQueue::iterator unscheduled() { return alarms_.end(); }
+
+  const QuicTime start_time_;
+  QuicTime now_;
+  scoped_ptr<Clock> clock_;
+  scoped_ptr<Random> random_;
+  AlarmQueue alarms_;
+  uint64 next_alarm_sequence_;
+  uint64 num_alarms_fired_;
+  uint64 num_connection_alarms_scheduled_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicSimulator);
+};
+
+}  // namespace tools
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_SIMULATOR_H_
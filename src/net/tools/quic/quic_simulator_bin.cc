@@ -0,0 +1,644 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// Runs flows of QuicConnections over a simulated bottleneck in virtual time,
+// to compare send algorithms without a network and without noise: the same
+// flags and --seed always give the same results.  Each flow has its own round
+// trip time and start and stop times, and all of them share the bottleneck,
+// which has a bandwidth, a drop-tail queue and random or bursty loss:
+//
+//   server --(rtt/2)--> bottleneck --> client
+//   server <--(rtt/2)-- client
+//
+// Results are printed as lines of JSON, one per flow, one per send algorithm
+// and one for the scenario,
+//
+//   {"simulation":"flow","params":{...},"results":{...}}
+//
+// with goodput, queueing delay at the bottleneck, Jain's fairness index and
+// how many simulated seconds ran per second of wall time.
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/basictypes.h"
+#include "base/command_line.h"
+#include "base/json/json_writer.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/time/time.h"
+#include "base/values.h"
+#include "net/base/ip_address_number.h"
+#include "net/base/ip_endpoint.h"
+#include "net/quic/crypto/crypto_protocol.h"
+#include "net/quic/quic_bandwidth.h"
+#include "net/quic/quic_flags.h"
+#include "net/quic/quic_protocol.h"
+#include "net/quic/quic_time.h"
+#include "net/tools/quic/quic_simulated_network.h"
+#include "net/tools/quic/quic_simulator.h"
+
+using std::string;
+
+// The send algorithm of each flow: cubic, cubic_bytes, reno, reno_bytes or
+// bbr.
+string FLAGS_flows = "cubic,bbr";
+// The round trip time of each flow without queueing.  For this and the
+// other per-flow lists, the last value is used for the remaining flows.
+string FLAGS_rtt_ms = "40";
+// When each flow starts sending.
+string FLAGS_start_s = "0";
+// When each flow stops sending.  Zero is at the end of the simulation.
+string FLAGS_stop_s = "0";
+// The simulated time.
+double FLAGS_duration_s = 60;
+// The bandwidth of the bottleneck.
+int32 FLAGS_bandwidth_kbps = 10000;
+// The drop-tail queue of the bottleneck.  Zero is the bandwidth-delay
+// product at the longest round trip time.
+int32 FLAGS_queue_bytes = 0;
+// Random loss at the bottleneck.
+double FLAGS_loss_percent = 0;
+// Bursty loss at the bottleneck, and the mean length of the bursts in
+// packets.
+double FLAGS_burst_loss_percent = 0;
+double FLAGS_burst_length = 5;
+// The socket receive buffer the clients report.  Zero reports none.
+int32 FLAGS_receive_buffer_bytes = 0;
+// How long packets wait for their endpoint to read them, in batches.  Zero
+// processes each packet as it arrives.
+int32 FLAGS_read_interval_us = 0;
+// Seeds every random choice of the simulation.
+int32 FLAGS_seed = 1;
+// Copied into the params of every result, e.g. to name the build.
+string FLAGS_label = "";
+// The file results are appended to.  Empty prints them.
+string FLAGS_output = "";
+// The file the servers' congestion control traces are written to, for
+// quic_trace_decoder.  Empty writes none.
+string FLAGS_trace_file = "";
+// The number of events each server's trace keeps.
+int32 FLAGS_trace_events = 1 << 16;
+
+namespace {
+
+struct FlowSpec {
+  string algorithm;
+  int32 rtt_ms;
+  double start_s;
+  double stop_s;
+};
+
+// Returns the connection options which select |algorithm|, or false if
+// there is no such algorithm.
+bool GetConnectionOptions(const string& algorithm,
+                          net::QuicTagVector* options) {
+  if (algorithm == "cubic") {
+  } else if (algorithm == "cubic_bytes") {
+    options->push_back(net::kBYTE);
+  } else if (algorithm == "reno") {
+    options->push_back(net::kRENO);
+  } else if (algorithm == "reno_bytes") {
+    options->push_back(net::kRENO);
+    options->push_back(net::kBYTE);
+  } else if (algorithm == "bbr") {
+    options->push_back(net::kTBBR);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Parses the comma separated |list| into |values|.
+template <typename T>
+bool ParseList(const string& name,
+               const string& list,
+               bool (*parse)(const base::StringPiece&, T*),
+               std::vector<T>* values) {
+  for (const string& item : base::SplitString(
+           list, ",", base::TRIM_WHITESPACE, base::SPLIT_WANT_NONEMPTY)) {
+    T value;
+    if (!parse(item, &value) || value < 0) {
+      LOG(ERROR) << "--" << name << " must be non-negative numbers\n";
+      return false;
+    }
+    values->push_back(value);
+  }
+  if (values->empty()) {
+    LOG(ERROR) << "--" << name << " must not be empty\n";
+    return false;
+  }
+  return true;
+}
+
+bool StringToDoubleValue(const base::StringPiece& input, double* output) {
+  return base::StringToDouble(input.as_string(), output);
+}
+
+// Returns the |index|th value of |values|, or the last one.
+template <typename T>
+T ValueAt(const std::vector<T>& values, size_t index) {
+  return values[std::min(index, values.size() - 1)];
+}
+
+// Returns the flows described by the flags, or false if they are invalid.
+bool GetFlowSpecs(std::vector<FlowSpec>* specs) {
+  std::vector<int> rtts_ms;
+  std::vector<double> starts_s;
+  std::vector<double> stops_s;
+  if (!ParseList<int>("rtt_ms", FLAGS_rtt_ms, &base::StringToInt,
+                      &rtts_ms) ||
+      !ParseList<double>("start_s", FLAGS_start_s, &StringToDoubleValue,
+                         &starts_s) ||
+      !ParseList<double>("stop_s", FLAGS_stop_s, &StringToDoubleValue,
+                         &stops_s)) {
+    return false;
+  }
+  for (const string& algorithm : base::SplitString(
+           FLAGS_flows, ",", base::TRIM_WHITESPACE,
+           base::SPLIT_WANT_NONEMPTY)) {
+    net::QuicTagVector options;
+    if (!GetConnectionOptions(algorithm, &options)) {
+      LOG(ERROR) << "Unknown send algorithm: " << algorithm;
+      return false;
+    }
+    const size_t index = specs->size();
+    FlowSpec spec;
+    spec.algorithm = algorithm;
+    spec.rtt_ms = ValueAt(rtts_ms, index);
+    spec.start_s = ValueAt(starts_s, index);
+    spec.stop_s = ValueAt(stops_s, index);
+    if (spec.stop_s == 0 || spec.stop_s > FLAGS_duration_s) {
+      spec.stop_s = FLAGS_duration_s;
+    }
+    if (spec.rtt_ms == 0 || spec.start_s >= spec.stop_s) {
+      LOG(ERROR) << "Flow " << index << " needs a round trip time and to "
+                 << "start before it stops";
+      return false;
+    }
+    specs->push_back(spec);
+  }
+  if (specs->empty()) {
+    LOG(ERROR) << "--flows must not be empty";
+    return false;
+  }
+  return true;
+}
+
+net::QuicTime::Delta SecondsToDelta(double seconds) {
+  return net::QuicTime::Delta::FromMicroseconds(
+      static_cast<int64>(seconds * 1000 * 1000));
+}
+
+// Returns Jain's fairness index of |values|: 1 if they are all equal, 1/n
+// if one has everything.
+double JainFairness(const std::vector<double>& values) {
+  double sum = 0;
+  double sum_of_squares = 0;
+  for (double value : values) {
+    sum += value;
+    sum_of_squares += value * value;
+  }
+  if (sum_of_squares == 0) {
+    return 1;
+  }
+  return sum * sum / (values.size() * sum_of_squares);
+}
+
+// The time at which a flow starts or stops.
+struct FlowEvent {
+  net::QuicTime time;
+  size_t flow;
+  bool start;
+
+  bool operator<(const FlowEvent& other) const {
+    return time < other.time;
+  }
+};
+
+class Simulation {
+ public:
+  Simulation(const std::vector<FlowSpec>& specs, std::ostream* out)
+      : specs_(specs), out_(out), simulator_(FLAGS_seed) {}
+
+  ~Simulation() {
+    // Everything holding alarms goes before the simulator.
+    flows_.clear();
+    links_.clear();
+    bottleneck_.reset();
+  }
+
+  void Run() {
+    Build();
+
+    std::vector<FlowEvent> events;
+    for (size_t i = 0; i < specs_.size(); ++i) {
+      FlowEvent start = {simulator_.start_time().Add(
+                             SecondsToDelta(specs_[i].start_s)),
+                         i, true};
+      FlowEvent stop = {simulator_.start_time().Add(
+                            SecondsToDelta(specs_[i].stop_s)),
+                        i, false};
+      events.push_back(start);
+      events.push_back(stop);
+    }
+    std::stable_sort(events.begin(), events.end());
+
+    const base::TimeTicks wall_start = base::TimeTicks::Now();
+    for (const FlowEvent& event : events) {
+      simulator_.RunUntil(event.time);
+      if (event.start) {
+        flows_[event.flow]->Start();
+      } else {
+        flows_[event.flow]->Stop();
+      }
+    }
+    simulator_.RunUntil(
+        simulator_.start_time().Add(SecondsToDelta(FLAGS_duration_s)));
+    wall_seconds_ = (base::TimeTicks::Now() - wall_start).InSecondsF();
+
+    PrintFlows();
+    PrintAlgorithms();
+    PrintScenario();
+    WriteTraces();
+  }
+
+ private:
+  void Build() {
+    int32 max_rtt_ms = 0;
+    for (const FlowSpec& spec : specs_) {
+      max_rtt_ms = std::max(max_rtt_ms, spec.rtt_ms);
+    }
+    net::tools::QuicSimulatedLinkParameters bottleneck;
+    bottleneck.bandwidth =
+        net::QuicBandwidth::FromKBitsPerSecond(FLAGS_bandwidth_kbps);
+    bottleneck.queue_bytes =
+        FLAGS_queue_bytes > 0
+            ? FLAGS_queue_bytes
+            : bottleneck.bandwidth.ToBytesPerPeriod(
+                  net::QuicTime::Delta::FromMilliseconds(max_rtt_ms));
+    bottleneck.loss_rate = FLAGS_loss_percent / 100;
+    bottleneck.burst_loss_rate = FLAGS_burst_loss_percent / 100;
+    bottleneck.mean_burst_length = FLAGS_burst_length;
+    bottleneck_queue_bytes_ = bottleneck.queue_bytes;
+    bottleneck_.reset(new net::tools::QuicSimulatedLink(
+        &simulator_, bottleneck, &client_switch_));
+
+    net::IPAddressNumber server_ip;
+    net::IPAddressNumber client_ip;
+    CHECK(net::ParseIPLiteralToNumber("10.0.0.1", &server_ip));
+    CHECK(net::ParseIPLiteralToNumber("10.0.0.2", &client_ip));
+    for (size_t i = 0; i < specs_.size(); ++i) {
+      const FlowSpec& spec = specs_[i];
+      // Flows are told apart by port.
+      const uint16 port = static_cast<uint16>(1024 + i);
+      const net::IPEndPoint server_address(server_ip, port);
+      const net::IPEndPoint client_address(client_ip, port);
+      net::QuicTagVector options;
+      CHECK(GetConnectionOptions(spec.algorithm, &options));
+      net::tools::QuicSimulatedFlow* flow = new net::tools::QuicSimulatedFlow(
+          &simulator_, server_address, client_address, options,
+          FLAGS_receive_buffer_bytes);
+      flow->set_read_interval(
+          net::QuicTime::Delta::FromMicroseconds(FLAGS_read_interval_us));
+      if (!FLAGS_trace_file.empty()) {
+        flow->set_server_trace_events(FLAGS_trace_events);
+      }
+      flows_.push_back(flow);
+
+      // Half the round trip is spent on each side of the bottleneck.
+      net::tools::QuicSimulatedLinkParameters half_rtt;
+      half_rtt.delay = net::QuicTime::Delta::FromMicroseconds(
+          spec.rtt_ms * 1000 / 2);
+      net::tools::QuicSimulatedLink* forward =
+          new net::tools::QuicSimulatedLink(&simulator_, half_rtt,
+                                            bottleneck_.get());
+      net::tools::QuicSimulatedLink* reverse =
+          new net::tools::QuicSimulatedLink(&simulator_, half_rtt,
+                                            flow->server());
+      links_.push_back(forward);
+      links_.push_back(reverse);
+      flow->SetOutputs(forward, reverse);
+      client_switch_.AddRoute(client_address, flow->client());
+    }
+  }
+
+  void PrintFlows() {
+    for (size_t i = 0; i < specs_.size(); ++i) {
+      const net::tools::QuicSimulatedFlow& flow = *flows_[i];
+      const net::QuicConnectionStats& stats = flow.server_stats();
+      scoped_ptr<base::DictionaryValue> results(new base::DictionaryValue);
+      results->SetInteger("flow", static_cast<int>(i));
+      results->SetString("algorithm", specs_[i].algorithm);
+      results->SetInteger("rtt_ms", specs_[i].rtt_ms);
+      results->SetDouble("start_s", specs_[i].start_s);
+      results->SetDouble("stop_s", specs_[i].stop_s);
+      results->SetDouble("bytes_delivered", flow.bytes_delivered());
+      results->SetDouble("goodput_kbps", flow.Goodput().ToKBitsPerSecond());
+      results->SetDouble("queueing_delay_mean_us", flow.MeanQueueingDelayUs());
+      results->SetDouble("queueing_delay_p50_us",
+                         flow.QueueingDelayPercentileUs(0.5));
+      results->SetDouble("queueing_delay_p95_us",
+                         flow.QueueingDelayPercentileUs(0.95));
+      results->SetDouble("queueing_delay_max_us", flow.max_queueing_delay_us());
+      results->SetDouble("packets_sent", stats.packets_sent);
+      results->SetDouble("packets_retransmitted", stats.packets_retransmitted);
+      results->SetDouble("packets_lost", stats.packets_lost);
+      results->SetDouble("rto_count", stats.rto_count);
+      results->SetDouble("srtt_us", stats.srtt_us);
+      results->SetDouble("min_rtt_us", stats.min_rtt_us);
+      results->SetBoolean("closed_early", flow.closed_early());
+      Print("flow", results.Pass());
+    }
+  }
+
+  void PrintAlgorithms() {
+    std::vector<string> algorithms;
+    for (const FlowSpec& spec : specs_) {
+      if (std::find(algorithms.begin(), algorithms.end(), spec.algorithm) ==
+          algorithms.end()) {
+        algorithms.push_back(spec.algorithm);
+      }
+    }
+    for (const string& algorithm : algorithms) {
+      std::vector<double> goodputs_kbps;
+      double delay_sum_us = 0;
+      int64 delay_samples = 0;
+      for (size_t i = 0; i < specs_.size(); ++i) {
+        if (specs_[i].algorithm != algorithm) {
+          continue;
+        }
+        const net::tools::QuicSimulatedFlow& flow = *flows_[i];
+        goodputs_kbps.push_back(flow.Goodput().ToKBitsPerSecond());
+        delay_sum_us += flow.MeanQueueingDelayUs() * flow.num_delay_samples();
+        delay_samples += flow.num_delay_samples();
+      }
+      double total_kbps = 0;
+      for (double goodput_kbps : goodputs_kbps) {
+        total_kbps += goodput_kbps;
+      }
+      scoped_ptr<base::DictionaryValue> results(new base::DictionaryValue);
+      results->SetString("algorithm", algorithm);
+      results->SetInteger("flows", static_cast<int>(goodputs_kbps.size()));
+      results->SetDouble("goodput_total_kbps", total_kbps);
+      results->SetDouble("goodput_mean_kbps",
+                         total_kbps / goodputs_kbps.size());
+      results->SetDouble("jain_fairness", JainFairness(goodputs_kbps));
+      results->SetDouble(
+          "queueing_delay_mean_us",
+          delay_samples > 0 ? delay_sum_us / delay_samples : 0);
+      Print("algorithm", results.Pass());
+    }
+  }
+
+  void PrintScenario() {
+    std::vector<double> goodputs_kbps;
+    for (const net::tools::QuicSimulatedFlow* flow : flows_) {
+      goodputs_kbps.push_back(flow->Goodput().ToKBitsPerSecond());
+    }
+    const double capacity_bytes =
+        FLAGS_bandwidth_kbps * 1000.0 / 8 * FLAGS_duration_s;
+    scoped_ptr<base::DictionaryValue> results(new base::DictionaryValue);
+    results->SetInteger("flows", static_cast<int>(flows_.size()));
+    results->SetDouble("jain_fairness", JainFairness(goodputs_kbps));
+    results->SetDouble("bottleneck_queue_bytes", bottleneck_queue_bytes_);
+    results->SetDouble(
+        "bottleneck_utilization",
+        capacity_bytes > 0 ? bottleneck_->bytes_delivered() / capacity_bytes
+                           : 0);
+    results->SetDouble("bottleneck_packets_dropped",
+                       bottleneck_->packets_dropped());
+    results->SetDouble("bottleneck_packets_lost", bottleneck_->packets_lost());
+    results->SetDouble("alarms_fired", simulator_.num_alarms_fired());
+    // Every packet crosses one of the per-flow links first.
+    double packets = 0;
+    for (const net::tools::QuicSimulatedLink* link : links_) {
+      packets += link->packets_received();
+    }
+    const double connection_alarms_scheduled =
+        simulator_.num_connection_alarms_scheduled();
+    results->SetDouble("connection_alarms_scheduled",
+                       connection_alarms_scheduled);
+    results->SetDouble(
+        "connection_alarms_scheduled_per_packet",
+        packets > 0 ? connection_alarms_scheduled / packets : 0);
+    results->SetDouble("wall_s", wall_seconds_);
+    results->SetDouble(
+        "simulated_s_per_wall_s",
+        wall_seconds_ > 0 ? FLAGS_duration_s / wall_seconds_ : 0);
+    Print("scenario", results.Pass());
+  }
+
+  void WriteTraces() {
+    if (FLAGS_trace_file.empty()) {
+      return;
+    }
+    std::ofstream file(FLAGS_trace_file.c_str(),
+                       std::ios::out | std::ios::binary | std::ios::trunc);
+    for (const net::tools::QuicSimulatedFlow* flow : flows_) {
+      file.write(flow->server_trace().data(), flow->server_trace().size());
+    }
+    if (!file) {
+      LOG(ERROR) << "Unable to write traces to " << FLAGS_trace_file;
+    }
+  }
+
+  void Print(const string& simulation,
+             scoped_ptr<base::DictionaryValue> results) {
+    base::DictionaryValue line;
+    line.SetString("simulation", simulation);
+    line.Set("params", GetParams().Pass());
+    line.Set("results", results.Pass());
+    string json;
+    base::JSONWriter::Write(line, &json);
+    *out_ << json << std::endl;
+  }
+
+  static scoped_ptr<base::DictionaryValue> GetParams() {
+    scoped_ptr<base::DictionaryValue> params(new base::DictionaryValue);
+    params->SetString("label", FLAGS_label);
+    params->SetString("flows", FLAGS_flows);
+    params->SetString("rtt_ms", FLAGS_rtt_ms);
+    params->SetString("start_s", FLAGS_start_s);
+    params->SetString("stop_s", FLAGS_stop_s);
+    params->SetDouble("duration_s", FLAGS_duration_s);
+    params->SetInteger("bandwidth_kbps", FLAGS_bandwidth_kbps);
+    params->SetInteger("queue_bytes", FLAGS_queue_bytes);
+    params->SetDouble("loss_percent", FLAGS_loss_percent);
+    params->SetDouble("burst_loss_percent", FLAGS_burst_loss_percent);
+    params->SetDouble("burst_length", FLAGS_burst_length);
+    params->SetInteger("receive_buffer_bytes", FLAGS_receive_buffer_bytes);
+    params->SetInteger("read_interval_us", FLAGS_read_interval_us);
+    params->SetInteger("seed", FLAGS_seed);
+    return params.Pass();
+  }
+
+  const std::vector<FlowSpec> specs_;
+  std::ostream* out_;  // Not owned.
+
+  net::tools::QuicSimulator simulator_;
+  net::tools::QuicSimulatedSwitch client_switch_;
+  scoped_ptr<net::tools::QuicSimulatedLink> bottleneck_;
+  ScopedVector<net::tools::QuicSimulatedLink> links_;
+  ScopedVector<net::tools::QuicSimulatedFlow> flows_;
+  net::QuicByteCount bottleneck_queue_bytes_ = 0;
+  double wall_seconds_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(Simulation);
+};
+
+bool ParseNonNegativeInt(const base::CommandLine* line,
+                         const string& name,
+                         int32* value) {
+  if (!line->HasSwitch(name)) {
+    return true;
+  }
+  if (!base::StringToInt(line->GetSwitchValueASCII(name), value) ||
+      *value < 0) {
+    LOG(ERROR) << "--" << name << " must be a non-negative integer\n";
+    return false;
+  }
+  return true;
+}
+
+bool ParsePercent(const base::CommandLine* line,
+                  const string& name,
+                  double* value) {
+  if (!line->HasSwitch(name)) {
+    return true;
+  }
+  if (!base::StringToDouble(line->GetSwitchValueASCII(name), value) ||
+      *value < 0 || *value >= 100) {
+    LOG(ERROR) << "--" << name << " must be at least 0 and below 100\n";
+    return false;
+  }
+  return true;
+}
+
+bool ParsePositiveDouble(const base::CommandLine* line,
+                         const string& name,
+                         double* value) {
+  if (!line->HasSwitch(name)) {
+    return true;
+  }
+  if (!base::StringToDouble(line->GetSwitchValueASCII(name), value) ||
+      *value <= 0) {
+    LOG(ERROR) << "--" << name << " must be a positive number\n";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  base::AtExitManager exit_manager;
+
+  base::CommandLine::Init(argc, argv);
+  base::CommandLine* line = base::CommandLine::ForCurrentProcess();
+
+  logging::LoggingSettings settings;
+  settings.logging_dest = logging::LOG_TO_SYSTEM_DEBUG_LOG;
+  CHECK(logging::InitLogging(settings));
+
+  if (line->HasSwitch("h") || line->HasSwitch("help")) {
+    const char* help_str =
+        "Usage: quic_simulator [options]\n"
+        "\n"
+        "Options:\n"
+        "-h, --help          show this help message and exit\n"
+        "--flows=<list>      send algorithm of each flow: cubic, cubic_bytes,\n"
+        "                    reno, reno_bytes or bbr\n"
+        "--rtt_ms=<list>     round trip time of each flow\n"
+        "--start_s=<list>    when each flow starts\n"
+        "--stop_s=<list>     when each flow stops, 0 for the end\n"
+        "--duration_s=<x>    simulated time\n"
+        "--bandwidth_kbps=<n> bandwidth of the bottleneck\n"
+        "--queue_bytes=<n>   drop-tail queue of the bottleneck, 0 for a BDP\n"
+        "--loss_percent=<x>  random loss at the bottleneck\n"
+        "--burst_loss_percent=<x> bursty loss at the bottleneck\n"
+        "--burst_length=<x>  mean packets per loss burst\n"
+        "--receive_buffer_bytes=<n> receive buffer the clients report\n"
+        "--read_interval_us=<n> read packets in batches this often\n"
+        "--seed=<n>          seed for every random choice\n"
+        "--label=<string>    copied into the params of every result\n"
+        "--output=<file>     append results to file instead of printing\n"
+        "--trace_file=<file> write the servers' congestion control traces\n"
+        "                    to file, for quic_trace_decoder\n"
+        "--trace_events=<n>  events each server's trace keeps\n"
+        "\n"
+        "For the per-flow lists, the last value is used for the remaining\n"
+        "flows.\n";
+    std::cout << help_str;
+    exit(0);
+  }
+
+  if (line->HasSwitch("flows")) {
+    FLAGS_flows = line->GetSwitchValueASCII("flows");
+  }
+  if (line->HasSwitch("rtt_ms")) {
+    FLAGS_rtt_ms = line->GetSwitchValueASCII("rtt_ms");
+  }
+  if (line->HasSwitch("start_s")) {
+    FLAGS_start_s = line->GetSwitchValueASCII("start_s");
+  }
+  if (line->HasSwitch("stop_s")) {
+    FLAGS_stop_s = line->GetSwitchValueASCII("stop_s");
+  }
+  if (!ParsePositiveDouble(line, "duration_s", &FLAGS_duration_s) ||
+      !ParsePositiveDouble(line, "burst_length", &FLAGS_burst_length) ||
+      !ParsePercent(line, "loss_percent", &FLAGS_loss_percent) ||
+      !ParsePercent(line, "burst_loss_percent", &FLAGS_burst_loss_percent) ||
+      !ParseNonNegativeInt(line, "bandwidth_kbps", &FLAGS_bandwidth_kbps) ||
+      !ParseNonNegativeInt(line, "queue_bytes", &FLAGS_queue_bytes) ||
+      !ParseNonNegativeInt(line, "receive_buffer_bytes",
+                           &FLAGS_receive_buffer_bytes) ||
+      !ParseNonNegativeInt(line, "read_interval_us",
+                           &FLAGS_read_interval_us) ||
+      !ParseNonNegativeInt(line, "seed", &FLAGS_seed) ||
+      !ParseNonNegativeInt(line, "trace_events", &FLAGS_trace_events)) {
+    return 1;
+  }
+  if (FLAGS_bandwidth_kbps == 0) {
+    LOG(ERROR) << "--bandwidth_kbps must be positive\n";
+    return 1;
+  }
+  if (line->HasSwitch("label")) {
+    FLAGS_label = line->GetSwitchValueASCII("label");
+  }
+  if (line->HasSwitch("output")) {
+    FLAGS_output = line->GetSwitchValueASCII("output");
+  }
+  if (line->HasSwitch("trace_file")) {
+    FLAGS_trace_file = line->GetSwitchValueASCII("trace_file");
+  }
+
+  std::vector<FlowSpec> specs;
+  if (!GetFlowSpecs(&specs)) {
+    return 1;
+  }
+
+  // Servers only use BBR when allowed to.
+  FLAGS_quic_allow_bbr = true;
+
+  std::ofstream output;
+  if (!FLAGS_output.empty()) {
+    output.open(FLAGS_output.c_str(), std::ios::app);
+    if (!output.is_open()) {
+      LOG(ERROR) << "Unable to open " << FLAGS_output;
+      return 1;
+    }
+  }
+
+  Simulation simulation(specs, output.is_open() ? &output : &std::cout);
+  simulation.Run();
+  return 0;
+}
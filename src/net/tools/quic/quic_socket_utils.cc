@@ -5,6 +5,7 @@
 #include "net/tools/quic/quic_socket_utils.h"
 
 #include <errno.h>
+#include <linux/filter.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/uio.h>
@@ -19,6 +20,14 @@
 #define SO_RXQ_OVFL 40
 #endif
 
+#ifndef SO_REUSEPORT
+#define SO_REUSEPORT 15
+#endif
+
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+
 namespace net {
 namespace tools {
 
@@ -95,6 +104,66 @@ bool QuicSocketUtils::SetReceiveBufferSize(int fd, size_t size) {
   return true;
 }
 
+// static
+bool QuicSocketUtils::SetReusePort(int fd) {
+  int reuse_port = 1;
+  if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &reuse_port,
+                 sizeof(reuse_port)) != 0) {
+    LOG(ERROR) << "Failed to set SO_REUSEPORT: " << strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+// static
+bool QuicSocketUtils::AttachConnectionIdSteering(int fd, uint32 num_sockets) {
+  DCHECK_LT(0u, num_sockets);
+  // Mirrors ConnectionIdShard().  Offsets are relative to the UDP payload, and
+  // BPF_W loads are in network byte order.
+  sock_filter code[] = {
+    // A = public flags.
+    {BPF_LD | BPF_B | BPF_ABS, 0, 0, 0},
+    {BPF_ALU | BPF_AND | BPF_K, 0, 0, PACKET_PUBLIC_FLAGS_8BYTE_CONNECTION_ID},
+    // Packets without a full connection ID fall back to the receive hash.
+    {BPF_JMP | BPF_JEQ | BPF_K, 0, 3, PACKET_PUBLIC_FLAGS_8BYTE_CONNECTION_ID},
+    // A = first four bytes of the connection ID.
+    {BPF_LD | BPF_W | BPF_ABS, 0, 0, 1},
+    {BPF_ALU | BPF_MOD | BPF_K, 0, 0, num_sockets},
+    {BPF_RET | BPF_A, 0, 0, 0},
+    // A = receive hash.
+    {BPF_LD | BPF_W | BPF_ABS, 0, 0,
+     static_cast<uint32>(SKF_AD_OFF + SKF_AD_RXHASH)},
+    {BPF_ALU | BPF_MOD | BPF_K, 0, 0, num_sockets},
+    {BPF_RET | BPF_A, 0, 0, 0},
+  };
+  sock_fprog program = {static_cast<unsigned short>(arraysize(code)), code};
+  if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program,
+                 sizeof(program)) != 0) {
+    DLOG(WARNING) << "SO_ATTACH_REUSEPORT_CBPF not supported: "
+                  << strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+// static
+int QuicSocketUtils::ConnectionIdShard(const char* packet,
+                                       size_t packet_length,
+                                       uint32 num_sockets) {
+  DCHECK_LT(0u, num_sockets);
+  if (packet_length < 1 + PACKET_8BYTE_CONNECTION_ID ||
+      (packet[0] & PACKET_PUBLIC_FLAGS_8BYTE_CONNECTION_ID) !=
+          PACKET_PUBLIC_FLAGS_8BYTE_CONNECTION_ID) {
+    return -1;
+  }
+  const uint8* data = reinterpret_cast<const uint8*>(packet + 1);
+  uint32 key = (static_cast<uint32>(data[0]) << 24) |
+               (static_cast<uint32>(data[1]) << 16) |
+               (static_cast<uint32>(data[2]) << 8) |
+               static_cast<uint32>(data[3]);
+  return key % num_sockets;
+}
+
 // static
 int QuicSocketUtils::ReadPacket(int fd, char* buffer, size_t buf_len,
                                 QuicPacketCount* dropped_packets,
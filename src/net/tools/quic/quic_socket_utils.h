@@ -41,6 +41,26 @@ class QuicSocketUtils {
   // Sets the receive buffer size to |size| and returns false if it fails.
   static bool SetReceiveBufferSize(int fd, size_t size);
 
+  // Sets SO_REUSEPORT on the socket so that several sockets can bind the same
+  // address and have the kernel spread incoming packets among them.  Returns
+  // false if it fails.
+  static bool SetReusePort(int fd);
+
+  // Attaches a classic BPF program to the SO_REUSEPORT group of |fd| which
+  // steers packets carrying an 8 byte connection ID to socket
+  // ConnectionIdShard(packet, num_sockets) in the group, and everything else by
+  // receive hash.  Returns false if the kernel does not support
+  // SO_ATTACH_REUSEPORT_CBPF.
+  static bool AttachConnectionIdSteering(int fd, uint32 num_sockets);
+
+  // Returns the index of the socket in a group of |num_sockets| that the
+  // steering program installed by AttachConnectionIdSteering picks for the
+  // |packet_length| bytes at |packet|, or -1 if the packet has no 8 byte
+  // connection ID and is therefore steered by the kernel's receive hash.
+  static int ConnectionIdShard(const char* packet,
+                               size_t packet_length,
+                               uint32 num_sockets);
+
   // Reads buf_len from the socket.  If reading is successful, returns bytes
   // read and sets peer_address to the peer address.  Otherwise returns -1.
   //
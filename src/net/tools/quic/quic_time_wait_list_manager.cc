@@ -5,10 +5,14 @@
 #include "net/tools/quic/quic_time_wait_list_manager.h"
 
 #include <errno.h>
+#include <string.h>
+
+#include <algorithm>
 
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/stl_util.h"
+#include "net/base/ip_address_number.h"
 #include "net/base/ip_endpoint.h"
 #include "net/quic/crypto/crypto_protocol.h"
 #include "net/quic/crypto/quic_decrypter.h"
@@ -25,6 +29,25 @@ using base::StringPiece;
 namespace net {
 namespace tools {
 
+namespace {
+
+// The rate limit lets this much time's worth of responses through at once.
+const int64 kResponseBurstUs = 100 * 1000;
+
+// Returns the interval between responses allowed by
+// FLAGS_quic_time_wait_list_max_responses_per_second, or zero for no limit.
+QuicTime::Delta GetResponseInterval() {
+  const int64 max_responses_per_second =
+      FLAGS_quic_time_wait_list_max_responses_per_second;
+  if (max_responses_per_second <= 0) {
+    return QuicTime::Delta::Zero();
+  }
+  return QuicTime::Delta::FromMicroseconds(
+      std::max<int64>(1, 1000 * 1000 / max_responses_per_second));
+}
+
+}  // namespace
+
 // A very simple alarm that just informs the QuicTimeWaitListManager to clean
 // up old connection_ids. This alarm should be cancelled  and deleted before
 // the QuicTimeWaitListManager is deleted.
@@ -48,6 +71,24 @@ class ConnectionIdCleanUpAlarm : public QuicAlarm::Delegate {
   DISALLOW_COPY_AND_ASSIGN(ConnectionIdCleanUpAlarm);
 };
 
+// Flushes the writer once the responses to a batch of packets are written.
+class ResponseFlushAlarm : public QuicAlarm::Delegate {
+ public:
+  explicit ResponseFlushAlarm(QuicTimeWaitListManager* time_wait_list_manager)
+      : time_wait_list_manager_(time_wait_list_manager) {}
+
+  QuicTime OnAlarm() override {
+    time_wait_list_manager_->FlushResponses();
+    return QuicTime::Zero();
+  }
+
+ private:
+  // Not owned.
+  QuicTimeWaitListManager* time_wait_list_manager_;
+
+  DISALLOW_COPY_AND_ASSIGN(ResponseFlushAlarm);
+};
+
 
 // This class stores pending public reset packets to be sent to clients.
 // server_address - server address on which a packet what was received for
@@ -78,6 +119,102 @@ class QuicTimeWaitListManager::QueuedPacket {
   DISALLOW_COPY_AND_ASSIGN(QueuedPacket);
 };
 
+// A public reset packet for client addresses of one size.  Only the connection
+// ID, the nonce proof, the rejected sequence number and the client address
+// differ between responses, and they sit at fixed offsets, so they are written
+// over those of the previous response.
+class QuicTimeWaitListManager::PublicResetTemplate {
+ public:
+  explicit PublicResetTemplate(size_t address_size)
+      : address_size_(address_size),
+        length_(0),
+        address_offset_(0),
+        sequence_number_offset_(0),
+        nonce_proof_offset_(0) {}
+
+  // Builds the packet with |manager|, and checks that patching it gives the
+  // packets the manager builds.  Returns false if it does not, in which case
+  // the template is not ready.
+  bool Init(QuicTimeWaitListManager* manager) {
+    QuicPublicResetPacket packet;
+    packet.public_header.reset_flag = true;
+    packet.client_address = IPEndPoint(IPAddressNumber(address_size_, 0), 0);
+    scoped_ptr<QuicEncryptedPacket> built(manager->BuildPublicReset(packet));
+    const size_t encoded_address_size =
+        sizeof(uint16) + address_size_ + sizeof(uint16);
+    if (!built.get() ||
+        built->length() < kPublicFlagsSize + PACKET_8BYTE_CONNECTION_ID +
+                              sizeof(QuicPublicResetNonceProof) +
+                              sizeof(QuicPacketSequenceNumber) +
+                              encoded_address_size) {
+      return false;
+    }
+    length_ = built->length();
+    buffer_.reset(new char[length_]);
+    memcpy(buffer_.get(), built->data(), length_);
+    packet_.reset(new QuicEncryptedPacket(buffer_.get(), length_));
+    // The values of the reset message follow its tag index in the order of
+    // their tags, RNON, RSEQ and CADR, and the client address ends the packet.
+    address_offset_ = length_ - encoded_address_size;
+    sequence_number_offset_ =
+        address_offset_ - sizeof(QuicPacketSequenceNumber);
+    nonce_proof_offset_ =
+        sequence_number_offset_ - sizeof(QuicPublicResetNonceProof);
+
+    IPAddressNumber address(address_size_);
+    for (size_t i = 0; i < address.size(); ++i) {
+      address[i] = static_cast<uint8>(i + 1);
+    }
+    packet.public_header.connection_id = UINT64_C(0x0123456789abcdef);
+    packet.nonce_proof = UINT64_C(0xfedcba9876543210);
+    packet.rejected_sequence_number = UINT64_C(0x0011223344556677);
+    packet.client_address = IPEndPoint(address, 0x1234);
+    scoped_ptr<QuicEncryptedPacket> expected(manager->BuildPublicReset(packet));
+    const QuicEncryptedPacket& patched =
+        Fill(packet.public_header.connection_id, packet.nonce_proof,
+             packet.rejected_sequence_number, packet.client_address);
+    if (!expected.get() ||
+        expected->AsStringPiece() != patched.AsStringPiece()) {
+      packet_.reset();
+      return false;
+    }
+    return true;
+  }
+
+  bool ready() const { return packet_.get() != nullptr; }
+
+  // Returns the public reset with the given fields.  It is valid until the
+  // next call.
+  const QuicEncryptedPacket& Fill(QuicConnectionId connection_id,
+                                  QuicPublicResetNonceProof nonce_proof,
+                                  QuicPacketSequenceNumber sequence_number,
+                                  const IPEndPoint& client_address) {
+    DCHECK_EQ(address_size_, client_address.address().size());
+    char* buffer = buffer_.get();
+    memcpy(buffer + kPublicFlagsSize, &connection_id, sizeof(connection_id));
+    memcpy(buffer + nonce_proof_offset_, &nonce_proof, sizeof(nonce_proof));
+    memcpy(buffer + sequence_number_offset_, &sequence_number,
+           sizeof(sequence_number));
+    // The address family is the same for every address of this size.
+    char* address = buffer + address_offset_ + sizeof(uint16);
+    memcpy(address, &client_address.address()[0], address_size_);
+    const uint16 port = client_address.port();
+    memcpy(address + address_size_, &port, sizeof(port));
+    return *packet_;
+  }
+
+ private:
+  const size_t address_size_;
+  size_t length_;
+  scoped_ptr<char[]> buffer_;
+  scoped_ptr<QuicEncryptedPacket> packet_;
+  size_t address_offset_;
+  size_t sequence_number_offset_;
+  size_t nonce_proof_offset_;
+
+  DISALLOW_COPY_AND_ASSIGN(PublicResetTemplate);
+};
+
 QuicTimeWaitListManager::QuicTimeWaitListManager(
     QuicPacketWriter* writer,
     QuicServerSessionVisitor* visitor,
@@ -89,12 +226,18 @@ QuicTimeWaitListManager::QuicTimeWaitListManager(
           helper->CreateAlarm(new ConnectionIdCleanUpAlarm(this))),
       clock_(helper->GetClock()),
       writer_(writer),
-      visitor_(visitor) {
+      visitor_(visitor),
+      flush_alarm_(helper->CreateAlarm(new ResponseFlushAlarm(this))),
+      response_interval_(GetResponseInterval()),
+      next_response_time_(QuicTime::Zero()),
+      num_responses_sent_(0),
+      num_responses_suppressed_(0) {
   SetConnectionIdCleanUpAlarm();
 }
 
 QuicTimeWaitListManager::~QuicTimeWaitListManager() {
   connection_id_clean_up_alarm_->Cancel();
+  flush_alarm_->Cancel();
   STLDeleteElements(&pending_packets_queue_);
   for (ConnectionIdMap::iterator it = connection_id_map_.begin();
        it != connection_id_map_.end();
@@ -125,6 +268,8 @@ void QuicTimeWaitListManager::AddConnectionIdToTimeWait(
   ConnectionIdData data(num_packets, version, clock_->ApproximateNow(),
                         close_packet, connection_rejected_statelessly);
   connection_id_map_.insert(std::make_pair(connection_id, data));
+  connection_id_order_.push_back(
+      std::make_pair(connection_id, data.time_added));
   if (new_connection_id) {
     visitor_->OnConnectionAddedToTimeWaitList(connection_id);
   }
@@ -171,19 +316,24 @@ void QuicTimeWaitListManager::ProcessPacket(
   if (!ShouldSendResponse(connection_data->num_packets)) {
     return;
   }
+  if (connection_data->connection_rejected_statelessly) {
+    DVLOG(3) << "Time wait list not sending response for connection "
+             << connection_id << " due to previous stateless reject.";
+    return;
+  }
+  if (!AllowResponse()) {
+    return;
+  }
   if (connection_data->close_packet) {
     QueuedPacket* queued_packet = new QueuedPacket(
         server_address, client_address, connection_data->close_packet->Clone());
     // Takes ownership of the packet.
     SendOrQueuePacket(queued_packet);
-  } else if (!connection_data->connection_rejected_statelessly) {
+  } else {
     SendPublicReset(server_address,
                     client_address,
                     connection_id,
                     sequence_number);
-  } else {
-    DVLOG(3) << "Time wait list not sending response for connection "
-             << connection_id << " due to previous stateless reject.";
   }
 }
 
@@ -194,18 +344,51 @@ bool QuicTimeWaitListManager::ShouldSendResponse(int received_packet_count) {
   return (received_packet_count & (received_packet_count - 1)) == 0;
 }
 
+bool QuicTimeWaitListManager::AllowResponse() {
+  if (response_interval_.IsZero()) {
+    return true;
+  }
+  // Each response moves |next_response_time_| on by one interval, and it
+  // falls back to now while no responses are sent, so at most a burst's
+  // worth of responses go out at once and the rate stays under the limit.
+  const QuicTime now = clock_->ApproximateNow();
+  if (next_response_time_ < now) {
+    next_response_time_ = now;
+  }
+  if (next_response_time_.Subtract(now) >=
+      QuicTime::Delta::FromMicroseconds(kResponseBurstUs)) {
+    ++num_responses_suppressed_;
+    return false;
+  }
+  next_response_time_ = next_response_time_.Add(response_interval_);
+  return true;
+}
+
 void QuicTimeWaitListManager::SendPublicReset(
     const IPEndPoint& server_address,
     const IPEndPoint& client_address,
     QuicConnectionId connection_id,
     QuicPacketSequenceNumber rejected_sequence_number) {
+  // TODO(satyamshekhar): generate a valid nonce for this connection_id.
+  const QuicPublicResetNonceProof nonce_proof = 1010101;
+  PublicResetTemplate* reset_template =
+      GetPublicResetTemplate(client_address.address().size());
+  if (reset_template) {
+    const QuicEncryptedPacket& reset = reset_template->Fill(
+        connection_id, nonce_proof, rejected_sequence_number, client_address);
+    if (!WriteToWire(server_address, client_address, reset)) {
+      pending_packets_queue_.push_back(
+          new QueuedPacket(server_address, client_address, reset.Clone()));
+    }
+    return;
+  }
+
   QuicPublicResetPacket packet;
   packet.public_header.connection_id = connection_id;
   packet.public_header.reset_flag = true;
   packet.public_header.version_flag = false;
   packet.rejected_sequence_number = rejected_sequence_number;
-  // TODO(satyamshekhar): generate a valid nonce for this connection_id.
-  packet.nonce_proof = 1010101;
+  packet.nonce_proof = nonce_proof;
   packet.client_address = client_address;
   QueuedPacket* queued_packet = new QueuedPacket(
       server_address,
@@ -220,6 +403,28 @@ QuicEncryptedPacket* QuicTimeWaitListManager::BuildPublicReset(
   return QuicFramer::BuildPublicResetPacket(packet);
 }
 
+QuicTimeWaitListManager::PublicResetTemplate*
+QuicTimeWaitListManager::GetPublicResetTemplate(size_t address_size) {
+  scoped_ptr<PublicResetTemplate>* reset_template;
+  if (address_size == kIPv4AddressSize) {
+    reset_template = &ipv4_public_reset_;
+  } else if (address_size == kIPv6AddressSize) {
+    reset_template = &ipv6_public_reset_;
+  } else {
+    return nullptr;
+  }
+  if (!reset_template->get()) {
+    reset_template->reset(new PublicResetTemplate(address_size));
+    if (!(*reset_template)->Init(this)) {
+      // The template stays around, not ready, so that this is only tried
+      // once and the framer builds every public reset instead.
+      LOG(DFATAL) << "Unable to build a public reset template for "
+                  << address_size << " byte addresses";
+    }
+  }
+  return (*reset_template)->ready() ? reset_template->get() : nullptr;
+}
+
 // Either sends the packet and deletes it or makes pending queue the
 // owner of the packet.
 void QuicTimeWaitListManager::SendOrQueuePacket(QueuedPacket* packet) {
@@ -232,15 +437,21 @@ void QuicTimeWaitListManager::SendOrQueuePacket(QueuedPacket* packet) {
 }
 
 bool QuicTimeWaitListManager::WriteToWire(QueuedPacket* queued_packet) {
+  return WriteToWire(queued_packet->server_address(),
+                     queued_packet->client_address(),
+                     *queued_packet->packet());
+}
+
+bool QuicTimeWaitListManager::WriteToWire(const IPEndPoint& server_address,
+                                          const IPEndPoint& client_address,
+                                          const QuicEncryptedPacket& packet) {
   if (writer_->IsWriteBlocked()) {
     visitor_->OnWriteBlocked(this);
     return false;
   }
   WriteResult result = writer_->WritePacket(
-      queued_packet->packet()->data(),
-      queued_packet->packet()->length(),
-      queued_packet->server_address().address(),
-      queued_packet->client_address());
+      packet.data(), packet.length(), server_address.address(),
+      client_address);
   if (result.status == WRITE_STATUS_BLOCKED) {
     // If blocked and unbuffered, return false to retry sending.
     DCHECK(writer_->IsWriteBlocked());
@@ -248,18 +459,33 @@ bool QuicTimeWaitListManager::WriteToWire(QueuedPacket* queued_packet) {
     return writer_->IsWriteBlockedDataBuffered();
   } else if (result.status == WRITE_STATUS_ERROR) {
     LOG(WARNING) << "Received unknown error while sending reset packet to "
-                 << queued_packet->client_address().ToString() << ": "
+                 << client_address.ToString() << ": "
                  << strerror(result.error_code);
+    return true;
+  }
+  ++num_responses_sent_;
+  // The responses to all packets handled before the alarm fires go out in
+  // one flush.
+  if (!flush_alarm_->IsSet()) {
+    flush_alarm_->Set(clock_->ApproximateNow());
   }
   return true;
 }
 
+void QuicTimeWaitListManager::FlushResponses() {
+  // The packets have been handed to the writer, so a blocked flush leaves
+  // them buffered there rather than in the pending queue.
+  if (writer_->Flush().status == WRITE_STATUS_BLOCKED) {
+    visitor_->OnWriteBlocked(this);
+  }
+}
+
 void QuicTimeWaitListManager::SetConnectionIdCleanUpAlarm() {
   connection_id_clean_up_alarm_->Cancel();
   QuicTime::Delta next_alarm_interval = QuicTime::Delta::Zero();
-  if (!connection_id_map_.empty()) {
-    QuicTime oldest_connection_id =
-        connection_id_map_.begin()->second.time_added;
+  ConnectionIdMap::iterator oldest = FindOldestConnection();
+  if (oldest != connection_id_map_.end()) {
+    QuicTime oldest_connection_id = oldest->second.time_added;
     QuicTime now = clock_->ApproximateNow();
     if (now.Subtract(oldest_connection_id) < time_wait_period_) {
       next_alarm_interval = oldest_connection_id.Add(time_wait_period_)
@@ -278,10 +504,10 @@ void QuicTimeWaitListManager::SetConnectionIdCleanUpAlarm() {
 
 bool QuicTimeWaitListManager::MaybeExpireOldestConnection(
     QuicTime expiration_time) {
-  if (connection_id_map_.empty()) {
+  ConnectionIdMap::iterator it = FindOldestConnection();
+  if (it == connection_id_map_.end()) {
     return false;
   }
-  ConnectionIdMap::iterator it = connection_id_map_.begin();
   QuicTime oldest_connection_id_time = it->second.time_added;
   if (oldest_connection_id_time > expiration_time) {
     // Too recent, don't retire.
@@ -291,10 +517,27 @@ bool QuicTimeWaitListManager::MaybeExpireOldestConnection(
   const QuicConnectionId connection_id = it->first;
   delete it->second.close_packet;
   connection_id_map_.erase(it);
+  connection_id_order_.pop_front();
   visitor_->OnConnectionRemovedFromTimeWaitList(connection_id);
   return true;
 }
 
+QuicTimeWaitListManager::ConnectionIdMap::iterator
+QuicTimeWaitListManager::FindOldestConnection() {
+  while (!connection_id_order_.empty()) {
+    const std::pair<QuicConnectionId, QuicTime>& oldest =
+        connection_id_order_.front();
+    ConnectionIdMap::iterator it = connection_id_map_.find(oldest.first);
+    if (it != connection_id_map_.end() &&
+        it->second.time_added == oldest.second) {
+      return it;
+    }
+    connection_id_order_.pop_front();
+  }
+  DCHECK(connection_id_map_.empty());
+  return connection_id_map_.end();
+}
+
 void QuicTimeWaitListManager::CleanUpOldConnectionIds() {
   QuicTime now = clock_->ApproximateNow();
   QuicTime expiration = now.Subtract(time_wait_period_);
@@ -4,17 +4,21 @@
 //
 // Handles packets for connection_ids in time wait state by discarding the
 // packet and sending the clients a public reset packet with exponential
-// backoff.
+// backoff.  Public resets are patched into a prebuilt packet rather than
+// framed for each response, responses written while handling one batch of
+// packets are flushed together, and all responses are rate limited by
+// FLAGS_quic_time_wait_list_max_responses_per_second.
 
 #ifndef NET_TOOLS_QUIC_QUIC_TIME_WAIT_LIST_MANAGER_H_
 #define NET_TOOLS_QUIC_QUIC_TIME_WAIT_LIST_MANAGER_H_
 
 #include <deque>
+#include <utility>
 
 #include "base/basictypes.h"
-#include "net/base/linked_hash_map.h"
 #include "net/quic/quic_blocked_writer_interface.h"
 #include "net/quic/quic_connection.h"
+#include "net/quic/quic_connection_id_map.h"
 #include "net/quic/quic_framer.h"
 #include "net/quic/quic_packet_writer.h"
 #include "net/quic/quic_protocol.h"
@@ -75,8 +79,9 @@ class QuicTimeWaitListManager : public QuicBlockedWriterInterface {
   // Called when a packet is received for a connection_id that is in time wait
   // state. Sends a public reset packet to the client which sent this
   // connection_id. Sending of the public reset packet is throttled by using
-  // exponential back off. DCHECKs for the connection_id to be in time wait
-  // state. virtual to override in tests.
+  // exponential back off, and responses to all connections are rate limited.
+  // DCHECKs for the connection_id to be in time wait state. virtual to
+  // override in tests.
   virtual void ProcessPacket(const IPEndPoint& server_address,
                              const IPEndPoint& client_address,
                              QuicConnectionId connection_id,
@@ -100,9 +105,20 @@ class QuicTimeWaitListManager : public QuicBlockedWriterInterface {
   // QuicVersion associated with it.
   QuicVersion GetQuicVersionFromConnectionId(QuicConnectionId connection_id);
 
+  // Sends the responses written since the last flush.  Runs from an alarm
+  // set when the first of them is written.
+  void FlushResponses();
+
   // The number of connections on the time-wait list.
   size_t num_connections() const { return connection_id_map_.size(); }
 
+  // The number of responses, public resets or connection close packets,
+  // handed to the writer.
+  uint64 num_responses_sent() const { return num_responses_sent_; }
+
+  // The number of responses not sent because of the rate limit.
+  uint64 num_responses_suppressed() const { return num_responses_suppressed_; }
+
  protected:
   virtual QuicEncryptedPacket* BuildPublicReset(
       const QuicPublicResetPacket& packet);
@@ -113,11 +129,20 @@ class QuicTimeWaitListManager : public QuicBlockedWriterInterface {
   // Internal structure to store pending public reset packets.
   class QueuedPacket;
 
+  // A public reset packet for client addresses of one family, into which the
+  // fields of each response are patched.
+  class PublicResetTemplate;
+
   // Decides if a packet should be sent for this connection_id based on the
   // number of received packets.
   bool ShouldSendResponse(int received_packet_count);
 
+  // Returns true if the rate limit allows sending a response now, and counts
+  // the response as suppressed otherwise.
+  bool AllowResponse();
+
   // Creates a public reset packet and sends it or queues it to be sent later.
+  // Uses the template for the family of |client_address| if there is one.
   void SendPublicReset(const IPEndPoint& server_address,
                        const IPEndPoint& client_address,
                        QuicConnectionId connection_id,
@@ -132,6 +157,14 @@ class QuicTimeWaitListManager : public QuicBlockedWriterInterface {
   // the packet and retry sending. In case of all other errors we drop the
   // packet.
   bool WriteToWire(QueuedPacket* packet);
+  bool WriteToWire(const IPEndPoint& server_address,
+                   const IPEndPoint& client_address,
+                   const QuicEncryptedPacket& packet);
+
+  // Returns the public reset template for client addresses of
+  // |address_size| bytes, building it on first use, or nullptr if the
+  // packets for such addresses can not be patched.
+  PublicResetTemplate* GetPublicResetTemplate(size_t address_size);
 
   // Register the alarm server to wake up at appropriate time.
   void SetConnectionIdCleanUpAlarm();
@@ -149,6 +182,13 @@ class QuicTimeWaitListManager : public QuicBlockedWriterInterface {
   // received after the termination of the connection bound to the
   // connection_id.
   struct ConnectionIdData {
+    // For the empty slots of the map.
+    ConnectionIdData()
+        : num_packets(0),
+          version(QUIC_VERSION_UNSUPPORTED),
+          time_added(QuicTime::Zero()),
+          close_packet(nullptr),
+          connection_rejected_statelessly(false) {}
     ConnectionIdData(int num_packets_,
                      QuicVersion version_,
                      QuicTime time_added_,
@@ -166,10 +206,20 @@ class QuicTimeWaitListManager : public QuicBlockedWriterInterface {
     bool connection_rejected_statelessly;
   };
 
-  // linked_hash_map allows lookup by ConnectionId and traversal in add order.
-  typedef linked_hash_map<QuicConnectionId, ConnectionIdData> ConnectionIdMap;
+  typedef QuicConnectionIdMap<ConnectionIdData> ConnectionIdMap;
   ConnectionIdMap connection_id_map_;
 
+  // The connection IDs in the order in which they were added, with the time
+  // they were added.  An entry whose connection ID has no record, or a record
+  // added at another time, was left behind by a record that has since been
+  // removed or replaced, and is skipped.
+  std::deque<std::pair<QuicConnectionId, QuicTime>> connection_id_order_;
+
+  // Drops the entries left behind by removed or replaced records from the
+  // front of connection_id_order_, and returns the record of the connection
+  // that has been in time wait longest, or connection_id_map_.end().
+  ConnectionIdMap::iterator FindOldestConnection();
+
   // Pending public reset packets that need to be sent out to the client
   // when we are given a chance to write by the dispatcher.
   std::deque<QueuedPacket*> pending_packets_queue_;
@@ -190,6 +240,24 @@ class QuicTimeWaitListManager : public QuicBlockedWriterInterface {
   // Interface that manages blocked writers.
   QuicServerSessionVisitor* visitor_;
 
+  // Alarm which flushes the writer after a batch of responses.
+  scoped_ptr<QuicAlarm> flush_alarm_;
+
+  // Public reset templates for IPv4 and IPv6 clients, built on first use.
+  scoped_ptr<PublicResetTemplate> ipv4_public_reset_;
+  scoped_ptr<PublicResetTemplate> ipv6_public_reset_;
+
+  // The interval between responses allowed by the rate limit, or zero if
+  // there is no limit.
+  const QuicTime::Delta response_interval_;
+  // The time at which the rate limit would allow the next response if
+  // responses came no faster than one per |response_interval_|.  Responses are
+  // allowed while it is less than kResponseBurstUs ahead of now.
+  QuicTime next_response_time_;
+
+  uint64 num_responses_sent_;
+  uint64 num_responses_suppressed_;
+
   DISALLOW_COPY_AND_ASSIGN(QuicTimeWaitListManager);
 };
 
@@ -0,0 +1,202 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// Decodes the congestion control traces written by quic_server --trace_dir
+// and quic_simulator --trace_file into a time series, one row per event, as
+// CSV or as lines of JSON.  Each file may hold any number of traces.
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/basictypes.h"
+#include "base/command_line.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_piece.h"
+#include "net/quic/quic_connection_trace.h"
+#include "net/quic/quic_protocol.h"
+
+using std::string;
+
+// csv or json.
+string FLAGS_format = "csv";
+
+namespace {
+
+// The columns of a row, each with a value which is a JSON number unless
+// |quoted|.
+struct Column {
+  Column(const char* name, const string& value, bool quoted)
+      : name(name), value(value), quoted(quoted) {}
+
+  const char* name;
+  string value;
+  bool quoted;
+};
+
+void GetColumns(const net::QuicTraceHeader& header,
+                const net::QuicTraceEvent& event,
+                int64 start_time_us,
+                std::vector<Column>* columns) {
+  columns->clear();
+  // Connection IDs are quoted, as JSON numbers are doubles.
+  columns->push_back(
+      Column("connection_id", base::Uint64ToString(header.connection_id),
+             true));
+  columns->push_back(
+      Column("perspective",
+             header.perspective ==
+                     static_cast<uint32>(net::Perspective::IS_SERVER)
+                 ? "server"
+                 : "client",
+             true));
+  columns->push_back(
+      Column("time_us", base::Int64ToString(event.time_us), false));
+  columns->push_back(Column(
+      "elapsed_us", base::Int64ToString(event.time_us - start_time_us),
+      false));
+  columns->push_back(Column(
+      "event", net::QuicConnectionTrace::EventTypeToString(event.type), true));
+  columns->push_back(Column(
+      "in_slow_start",
+      (event.flags & net::QuicTraceEvent::IN_SLOW_START) ? "1" : "0", false));
+  columns->push_back(Column(
+      "in_recovery",
+      (event.flags & net::QuicTraceEvent::IN_RECOVERY) ? "1" : "0", false));
+  columns->push_back(Column("congestion_window",
+                            base::Uint64ToString(event.congestion_window),
+                            false));
+  columns->push_back(Column("slow_start_threshold",
+                            base::Uint64ToString(event.slow_start_threshold),
+                            false));
+  columns->push_back(Column("bytes_in_flight",
+                            base::Uint64ToString(event.bytes_in_flight),
+                            false));
+  columns->push_back(Column("smoothed_rtt_us",
+                            base::Int64ToString(event.smoothed_rtt_us),
+                            false));
+  columns->push_back(
+      Column("min_rtt_us", base::Int64ToString(event.min_rtt_us), false));
+  columns->push_back(
+      Column("pacing_rate_bytes_per_second",
+             base::Uint64ToString(event.pacing_rate_bytes_per_second), false));
+  columns->push_back(Column(
+      "bandwidth_estimate_bytes_per_second",
+      base::Uint64ToString(event.bandwidth_estimate_bytes_per_second), false));
+  columns->push_back(Column(
+      "packets_acked", base::UintToString(event.packets_acked), false));
+  columns->push_back(
+      Column("packets_lost", base::UintToString(event.packets_lost), false));
+}
+
+void PrintCsvHeader(const std::vector<Column>& columns) {
+  for (size_t i = 0; i < columns.size(); ++i) {
+    std::cout << (i > 0 ? "," : "") << columns[i].name;
+  }
+  std::cout << "\n";
+}
+
+void PrintRow(const std::vector<Column>& columns) {
+  if (FLAGS_format == "csv") {
+    for (size_t i = 0; i < columns.size(); ++i) {
+      std::cout << (i > 0 ? "," : "") << columns[i].value;
+    }
+    std::cout << "\n";
+    return;
+  }
+  std::cout << "{";
+  for (size_t i = 0; i < columns.size(); ++i) {
+    const char* quote = columns[i].quoted ? "\"" : "";
+    std::cout << (i > 0 ? "," : "") << "\"" << columns[i].name << "\":"
+              << quote << columns[i].value << quote;
+  }
+  std::cout << "}\n";
+}
+
+// Prints every trace in the file at |path|.  Returns false if it can not be
+// read or holds anything but whole traces.
+bool DecodeFile(const string& path, bool* printed_header) {
+  std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+  if (!file.is_open()) {
+    LOG(ERROR) << "Unable to open " << path;
+    return false;
+  }
+  std::stringstream contents;
+  contents << file.rdbuf();
+  const string data = contents.str();
+
+  base::StringPiece remaining(data);
+  net::QuicTraceHeader header;
+  std::vector<net::QuicTraceEvent> events;
+  std::vector<Column> columns;
+  while (!remaining.empty()) {
+    const size_t consumed =
+        net::QuicConnectionTrace::Parse(remaining, &header, &events);
+    if (consumed == 0) {
+      LOG(ERROR) << path << " holds a malformed trace at offset "
+                 << data.size() - remaining.size();
+      return false;
+    }
+    remaining.remove_prefix(consumed);
+    if (header.num_recorded > header.num_events) {
+      LOG(WARNING) << "Trace of connection " << header.connection_id
+                   << " lost its first "
+                   << header.num_recorded - header.num_events << " events";
+    }
+    for (const net::QuicTraceEvent& event : events) {
+      GetColumns(header, event, events.front().time_us, &columns);
+      if (!*printed_header && FLAGS_format == "csv") {
+        PrintCsvHeader(columns);
+      }
+      *printed_header = true;
+      PrintRow(columns);
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  base::AtExitManager exit_manager;
+
+  base::CommandLine::Init(argc, argv);
+  base::CommandLine* line = base::CommandLine::ForCurrentProcess();
+
+  logging::LoggingSettings settings;
+  settings.logging_dest = logging::LOG_TO_SYSTEM_DEBUG_LOG;
+  CHECK(logging::InitLogging(settings));
+
+  const base::CommandLine::StringVector& files = line->GetArgs();
+  if (line->HasSwitch("h") || line->HasSwitch("help") || files.empty()) {
+    const char* help_str =
+        "Usage: quic_trace_decoder [options] <trace file>...\n"
+        "\n"
+        "Options:\n"
+        "-h, --help          show this help message and exit\n"
+        "--format=<format>   csv, or json for a line of JSON per event\n";
+    std::cout << help_str;
+    exit(0);
+  }
+
+  if (line->HasSwitch("format")) {
+    FLAGS_format = line->GetSwitchValueASCII("format");
+    if (FLAGS_format != "csv" && FLAGS_format != "json") {
+      LOG(ERROR) << "--format must be csv or json\n";
+      return 1;
+    }
+  }
+
+  bool printed_header = false;
+  for (const string& file : files) {
+    if (!DecodeFile(file, &printed_header)) {
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,93 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/quic_trace_writer.h"
+
+#include <fstream>
+
+#include "base/logging.h"
+
+using std::string;
+
+namespace net {
+namespace tools {
+
+namespace {
+
+void WriteFile(const string& path, const string& data) {
+  std::ofstream file(path.c_str(), std::ios::out | std::ios::binary);
+  file.write(data.data(), data.size());
+  if (!file) {
+    LOG(ERROR) << "Unable to write trace to " << path;
+  }
+}
+
+}  // namespace
+
+QuicTraceWriter::QuicTraceWriter(size_t max_queued_bytes)
+    : max_queued_bytes_(max_queued_bytes),
+      trace_available_(&lock_),
+      queued_bytes_(0),
+      num_dropped_traces_(0),
+      shutting_down_(false),
+      started_(false) {
+  started_ = base::PlatformThread::Create(0, this, &handle_);
+  LOG_IF(DFATAL, !started_) << "Failed to start the trace writer thread";
+}
+
+QuicTraceWriter::~QuicTraceWriter() {
+  {
+    base::AutoLock locked(lock_);
+    shutting_down_ = true;
+    trace_available_.Signal();
+  }
+  if (started_) {
+    base::PlatformThread::Join(handle_);
+  }
+  LOG_IF(WARNING, num_dropped_traces_ > 0)
+      << "Dropped " << num_dropped_traces_ << " traces";
+}
+
+void QuicTraceWriter::Write(const string& path, string* data) {
+  if (!started_) {
+    WriteFile(path, *data);
+    data->clear();
+    return;
+  }
+  base::AutoLock locked(lock_);
+  if (queued_bytes_ + data->size() > max_queued_bytes_) {
+    ++num_dropped_traces_;
+    data->clear();
+    return;
+  }
+  queued_bytes_ += data->size();
+  queued_traces_.push_back(std::make_pair(path, string()));
+  queued_traces_.back().second.swap(*data);
+  trace_available_.Signal();
+}
+
+void QuicTraceWriter::ThreadMain() {
+  base::PlatformThread::SetName("QuicTraceWriter");
+  base::AutoLock locked(lock_);
+  for (;;) {
+    while (queued_traces_.empty() && !shutting_down_) {
+      trace_available_.Wait();
+    }
+    // Traces queued before the shutdown are still written.
+    if (queued_traces_.empty()) {
+      return;
+    }
+    std::pair<string, string> trace;
+    trace.swap(queued_traces_.front());
+    queued_traces_.pop_front();
+    {
+      base::AutoUnlock unlocked(lock_);
+      WriteFile(trace.first, trace.second);
+    }
+    queued_bytes_ -= trace.second.size();
+  }
+}
+
+}  // namespace tools
+}  // namespace net
@@ -0,0 +1,60 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// QuicTraceWriter writes serialized congestion control traces to files on a
+// thread of its own, so that a slow disk does not hold up the event loop
+// which closes the connections.
+
+#ifndef NET_TOOLS_QUIC_QUIC_TRACE_WRITER_H_
+#define NET_TOOLS_QUIC_QUIC_TRACE_WRITER_H_
+
+#include <deque>
+#include <string>
+#include <utility>
+
+#include "base/basictypes.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/platform_thread.h"
+
+namespace net {
+namespace tools {
+
+class QuicTraceWriter : public base::PlatformThread::Delegate {
+ public:
+  // Starts the writer thread.  Traces which are queued while more than
+  // |max_queued_bytes| are waiting to be written are dropped.
+  explicit QuicTraceWriter(size_t max_queued_bytes);
+  // Writes the traces still queued, then joins the writer thread.
+  ~QuicTraceWriter() override;
+
+  // Queues |data| to be written to |path|.  Takes the contents of |data|,
+  // leaving it empty.
+  void Write(const std::string& path, std::string* data);
+
+  // base::PlatformThread::Delegate implementation.
+  void ThreadMain() override;
+
+ private:
+  const size_t max_queued_bytes_;
+
+  base::Lock lock_;
+  // Signalled when a trace is queued or the writer shuts down.
+  base::ConditionVariable trace_available_;
+  // (path, data) of the traces waiting to be written.
+  std::deque<std::pair<std::string, std::string>> queued_traces_;
+  size_t queued_bytes_;
+  uint64 num_dropped_traces_;
+  bool shutting_down_;
+
+  bool started_;
+  base::PlatformThreadHandle handle_;
+
+  DISALLOW_COPY_AND_ASSIGN(QuicTraceWriter);
+};
+
+}  // namespace tools
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_QUIC_TRACE_WRITER_H_
@@ -0,0 +1,406 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/remote_strike_register_client.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "base/logging.h"
+#include "base/posix/eintr_wrapper.h"
+#include "net/quic/crypto/crypto_protocol.h"
+#include "net/tools/quic/strike_register_protocol.h"
+
+using base::StringPiece;
+using std::string;
+
+namespace net {
+namespace tools {
+
+namespace {
+
+// The minimum time between attempts to reconnect.
+const int64 kReconnectIntervalUs = 1000 * 1000;
+
+// Answers are read in chunks of up to this many.
+const size_t kAnswersPerRead = 1024;
+
+}  // namespace
+
+class RemoteStrikeRegisterClient::TimeoutAlarm : public EpollAlarm {
+ public:
+  explicit TimeoutAlarm(RemoteStrikeRegisterClient* client)
+      : client_(client) {}
+
+  int64 OnAlarm() override {
+    EpollAlarm::OnAlarm();
+    return client_->OnTimeoutAlarm();
+  }
+
+ private:
+  RemoteStrikeRegisterClient* client_;
+
+  DISALLOW_COPY_AND_ASSIGN(TimeoutAlarm);
+};
+
+RemoteStrikeRegisterClient::RemoteStrikeRegisterClient(
+    EpollServer* epoll_server,
+    int64 timeout_us)
+    : epoll_server_(epoll_server),
+      timeout_us_(timeout_us),
+      fd_(-1),
+      state_(DISCONNECTED),
+      hello_deadline_us_(0),
+      has_orbit_(false),
+      next_reconnect_us_(0),
+      timeout_alarm_(new TimeoutAlarm(this)),
+      num_requests_(0),
+      num_batches_(0) {
+}
+
+RemoteStrikeRegisterClient::~RemoteStrikeRegisterClient() {
+  // Callbacks of the failed requests must not reconnect.
+  socket_path_.clear();
+  Disconnect(STRIKE_REGISTER_FAILURE);
+}
+
+bool RemoteStrikeRegisterClient::Connect(const string& socket_path) {
+  DCHECK_EQ(DISCONNECTED, state_);
+  socket_path_ = socket_path;
+  uint8 orbit[kOrbitSize];
+  int fd = ConnectAndReadHello(socket_path, timeout_us_, orbit);
+  if (fd < 0) {
+    return false;
+  }
+  if (!AcceptOrbit(orbit)) {
+    close(fd);
+    return false;
+  }
+  fd_ = fd;
+  state_ = CONNECTED;
+  epoll_server_->RegisterFD(fd_, this, EPOLLIN);
+  return true;
+}
+
+// static
+bool RemoteStrikeRegisterClient::GetOrbit(const string& socket_path,
+                                          int64 timeout_us,
+                                          string* orbit) {
+  uint8 orbit_bytes[kOrbitSize];
+  int fd = ConnectAndReadHello(socket_path, timeout_us, orbit_bytes);
+  if (fd < 0) {
+    return false;
+  }
+  close(fd);
+  orbit->assign(reinterpret_cast<const char*>(orbit_bytes),
+                sizeof(orbit_bytes));
+  return true;
+}
+
+bool RemoteStrikeRegisterClient::IsKnownOrbit(StringPiece orbit) const {
+  return has_orbit_ && orbit.length() == kOrbitSize &&
+         memcmp(orbit.data(), orbit_, kOrbitSize) == 0;
+}
+
+void RemoteStrikeRegisterClient::VerifyNonceIsValidAndUnique(
+    StringPiece nonce,
+    QuicWallTime now,
+    ResultCallback* cb) {
+  if (nonce.length() != kNonceSize) {
+    cb->Run(false, NONCE_INVALID_FAILURE);
+    return;
+  }
+  if (!connected()) {
+    MaybeReconnect();
+    cb->Run(false, STRIKE_REGISTER_FAILURE);
+    return;
+  }
+
+  if (write_buffer_.empty()) {
+    // Send this request, and any others made before then, once the epoll
+    // server has handled the events of this iteration.
+    epoll_server_->SetFDReady(fd_, EPOLLOUT);
+  }
+  const uint32 current_time = static_cast<uint32>(now.ToUNIXSeconds());
+  write_buffer_.append(reinterpret_cast<const char*>(&current_time),
+                       sizeof(current_time));
+  nonce.AppendToString(&write_buffer_);
+
+  PendingRequest request;
+  request.callback = cb;
+  request.deadline_us = epoll_server_->ApproximateNowInUsec() + timeout_us_;
+  pending_.push_back(request);
+  ++num_requests_;
+  if (!timeout_alarm_->registered()) {
+    epoll_server_->RegisterAlarm(request.deadline_us, timeout_alarm_.get());
+  }
+}
+
+void RemoteStrikeRegisterClient::OnEvent(int fd, EpollEvent* event) {
+  DCHECK_EQ(fd, fd_);
+  if (state_ == AWAITING_HELLO) {
+    // A closed or failed socket reads as such.
+    if (event->in_events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+      ReadHello();
+    }
+    return;
+  }
+  if (event->in_events & EPOLLIN) {
+    ReadAnswers();
+  }
+  if (connected() && (event->in_events & EPOLLOUT)) {
+    WriteRequests();
+  }
+  if (connected() && (event->in_events & (EPOLLERR | EPOLLHUP))) {
+    LOG(WARNING) << "Lost the strike register connection";
+    Disconnect(STRIKE_REGISTER_FAILURE);
+  }
+}
+
+// static
+int RemoteStrikeRegisterClient::ConnectSocket(const string& socket_path,
+                                              bool non_blocking) {
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    LOG(ERROR) << "Socket path is too long: " << socket_path;
+    return -1;
+  }
+  memcpy(address.sun_path, socket_path.data(), socket_path.size());
+
+  int type = SOCK_STREAM | SOCK_CLOEXEC;
+  if (non_blocking) {
+    type |= SOCK_NONBLOCK;
+  }
+  int fd = socket(AF_UNIX, type, 0);
+  if (fd < 0) {
+    LOG(ERROR) << "socket() failed: " << strerror(errno);
+    return -1;
+  }
+  // A Unix socket connects or fails at once; a non-blocking one fails with
+  // EAGAIN rather than wait for room in the server's backlog.
+  if (HANDLE_EINTR(connect(fd, reinterpret_cast<const sockaddr*>(&address),
+                           sizeof(address))) < 0) {
+    LOG(WARNING) << "Unable to connect to the strike register at "
+                 << socket_path << ": " << strerror(errno);
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// static
+int RemoteStrikeRegisterClient::ConnectAndReadHello(const string& socket_path,
+                                                    int64 timeout_us,
+                                                    uint8 orbit[8]) {
+  int fd = ConnectSocket(socket_path, false);
+  if (fd < 0) {
+    return -1;
+  }
+  timeval timeout;
+  timeout.tv_sec = timeout_us / 1000000;
+  timeout.tv_usec = timeout_us % 1000000;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  char hello[kStrikeRegisterHelloSize];
+  size_t received = 0;
+  while (received < sizeof(hello)) {
+    ssize_t rv = HANDLE_EINTR(
+        read(fd, hello + received, sizeof(hello) - received));
+    if (rv <= 0) {
+      LOG(WARNING) << "No hello from the strike register at " << socket_path;
+      close(fd);
+      return -1;
+    }
+    received += rv;
+  }
+  if (!ParseHello(socket_path, hello, orbit)) {
+    close(fd);
+    return -1;
+  }
+
+  // From here on the socket is driven by the epoll server.
+  if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0) {
+    LOG(ERROR) << "fcntl() failed: " << strerror(errno);
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// static
+bool RemoteStrikeRegisterClient::ParseHello(const string& socket_path,
+                                            const char* hello,
+                                            uint8 orbit[8]) {
+  uint32 version;
+  memcpy(&version, hello, sizeof(version));
+  if (version != kStrikeRegisterProtocolVersion) {
+    LOG(WARNING) << "The strike register at " << socket_path
+                 << " speaks version " << version;
+    return false;
+  }
+  memcpy(orbit, hello + sizeof(version), kOrbitSize);
+  return true;
+}
+
+bool RemoteStrikeRegisterClient::AcceptOrbit(const uint8 orbit[8]) {
+  // Server configs are bound to an orbit, so a server which came back with
+  // another one can not check their nonces.
+  if (has_orbit_ && memcmp(orbit, orbit_, sizeof(orbit_)) != 0) {
+    LOG(ERROR) << "The strike register at " << socket_path_
+               << " changed its orbit";
+    return false;
+  }
+  memcpy(orbit_, orbit, sizeof(orbit_));
+  has_orbit_ = true;
+  return true;
+}
+
+void RemoteStrikeRegisterClient::MaybeReconnect() {
+  if (state_ != DISCONNECTED || socket_path_.empty()) {
+    return;
+  }
+  const int64 now_us = epoll_server_->ApproximateNowInUsec();
+  if (now_us < next_reconnect_us_) {
+    return;
+  }
+  next_reconnect_us_ = now_us + kReconnectIntervalUs;
+  int fd = ConnectSocket(socket_path_, true);
+  if (fd < 0) {
+    return;
+  }
+  fd_ = fd;
+  state_ = AWAITING_HELLO;
+  hello_.clear();
+  hello_deadline_us_ = now_us + timeout_us_;
+  epoll_server_->RegisterFD(fd_, this, EPOLLIN);
+  timeout_alarm_->UnregisterIfRegistered();
+  epoll_server_->RegisterAlarm(hello_deadline_us_, timeout_alarm_.get());
+}
+
+void RemoteStrikeRegisterClient::ReadHello() {
+  char buffer[kStrikeRegisterHelloSize];
+  // Only the hello is read, since answers follow it on the same socket.
+  ssize_t rv = HANDLE_EINTR(
+      read(fd_, buffer, kStrikeRegisterHelloSize - hello_.size()));
+  if (rv < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+    return;
+  }
+  if (rv <= 0) {
+    LOG(WARNING) << "No hello from the strike register at " << socket_path_;
+    Disconnect(STRIKE_REGISTER_FAILURE);
+    return;
+  }
+  hello_.append(buffer, rv);
+  if (hello_.size() < kStrikeRegisterHelloSize) {
+    return;
+  }
+  uint8 orbit[kOrbitSize];
+  if (!ParseHello(socket_path_, hello_.data(), orbit) ||
+      !AcceptOrbit(orbit)) {
+    Disconnect(STRIKE_REGISTER_FAILURE);
+    return;
+  }
+  DVLOG(1) << "Reconnected to the strike register at " << socket_path_;
+  state_ = CONNECTED;
+}
+
+void RemoteStrikeRegisterClient::WriteRequests() {
+  if (write_buffer_.empty()) {
+    return;
+  }
+  ssize_t rv = HANDLE_EINTR(
+      send(fd_, write_buffer_.data(), write_buffer_.size(), MSG_NOSIGNAL));
+  if (rv < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      epoll_server_->StartWrite(fd_);
+      return;
+    }
+    LOG(WARNING) << "Strike register send() failed: " << strerror(errno);
+    Disconnect(STRIKE_REGISTER_FAILURE);
+    return;
+  }
+  ++num_batches_;
+  write_buffer_.erase(0, rv);
+  if (write_buffer_.empty()) {
+    epoll_server_->StopWrite(fd_);
+  } else {
+    epoll_server_->StartWrite(fd_);
+  }
+}
+
+void RemoteStrikeRegisterClient::ReadAnswers() {
+  uint8 answers[kAnswersPerRead * kStrikeRegisterResponseSize];
+  while (connected()) {
+    ssize_t rv = HANDLE_EINTR(read(fd_, answers, sizeof(answers)));
+    if (rv < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return;
+    }
+    if (rv <= 0) {
+      LOG(WARNING) << "Lost the strike register connection";
+      Disconnect(STRIKE_REGISTER_FAILURE);
+      return;
+    }
+    for (ssize_t i = 0; i < rv; ++i) {
+      if (pending_.empty() || answers[i] > STRIKE_REGISTER_FAILURE) {
+        LOG(WARNING) << "Unexpected answer from the strike register";
+        Disconnect(STRIKE_REGISTER_FAILURE);
+        return;
+      }
+      const InsertStatus status = static_cast<InsertStatus>(answers[i]);
+      ResultCallback* callback = pending_.front().callback;
+      pending_.pop_front();
+      callback->Run(status == NONCE_OK, status);
+    }
+  }
+}
+
+void RemoteStrikeRegisterClient::Disconnect(InsertStatus status) {
+  if (fd_ >= 0) {
+    epoll_server_->UnregisterFD(fd_);
+    close(fd_);
+    fd_ = -1;
+  }
+  state_ = DISCONNECTED;
+  hello_.clear();
+  write_buffer_.clear();
+  // The callbacks may submit new requests.
+  std::deque<PendingRequest> failed;
+  failed.swap(pending_);
+  for (const PendingRequest& request : failed) {
+    request.callback->Run(false, status);
+  }
+}
+
+int64 RemoteStrikeRegisterClient::OnTimeoutAlarm() {
+  if (state_ == AWAITING_HELLO) {
+    // No requests are sent before the hello, so none are pending.
+    if (hello_deadline_us_ > epoll_server_->ApproximateNowInUsec()) {
+      return hello_deadline_us_;
+    }
+    LOG(WARNING) << "No hello from the strike register at " << socket_path_;
+    Disconnect(STRIKE_REGISTER_FAILURE);
+    return 0;
+  }
+  if (pending_.empty()) {
+    return 0;
+  }
+  if (pending_.front().deadline_us > epoll_server_->ApproximateNowInUsec()) {
+    return pending_.front().deadline_us;
+  }
+  // Answers come in order, so the connection can not be used once one of
+  // them is given up on.
+  LOG(WARNING) << "Strike register request timed out";
+  Disconnect(STRIKE_REGISTER_TIMEOUT);
+  return 0;
+}
+
+}  // namespace tools
+}  // namespace net
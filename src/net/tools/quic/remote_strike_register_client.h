@@ -0,0 +1,154 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_QUIC_REMOTE_STRIKE_REGISTER_CLIENT_H_
+#define NET_TOOLS_QUIC_REMOTE_STRIKE_REGISTER_CLIENT_H_
+
+#include <deque>
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_piece.h"
+#include "net/quic/crypto/strike_register_client.h"
+#include "net/tools/epoll_server/epoll_server.h"
+
+namespace net {
+namespace tools {
+
+// StrikeRegisterClient which checks nonces with a StrikeRegisterServer over a
+// Unix socket, so that QUIC servers in several processes sharing a server
+// config reject each other's replays.  Nonces submitted during one iteration
+// of the epoll server go out in a single write at the end of the iteration,
+// and their answers come back together.
+//
+// Requests which are not answered within the timeout fail with
+// STRIKE_REGISTER_TIMEOUT and drop the connection.  Until a connection is
+// back, requests fail with STRIKE_REGISTER_FAILURE.  A request made while
+// there is no connection starts a reconnect, at most once a second, which
+// never blocks: the socket is connected without waiting, and the server's
+// hello is read when the epoll server reports it.  All methods must be called
+// on the thread of the epoll server.
+class RemoteStrikeRegisterClient : public StrikeRegisterClient,
+                                   public EpollCallbackInterface {
+ public:
+  // Does not take ownership of |epoll_server|.
+  RemoteStrikeRegisterClient(EpollServer* epoll_server, int64 timeout_us);
+  ~RemoteStrikeRegisterClient() override;
+
+  // Connects to the server listening on |socket_path| and learns its orbit.
+  // Blocks until the server's hello arrives or the timeout passes.
+  bool Connect(const std::string& socket_path);
+
+  // Sets |orbit| to the orbit of the server listening on |socket_path|, so
+  // that a server config using it can be generated before any client exists.
+  static bool GetOrbit(const std::string& socket_path,
+                       int64 timeout_us,
+                       std::string* orbit);
+
+  // StrikeRegisterClient implementation.
+  bool IsKnownOrbit(base::StringPiece orbit) const override;
+  void VerifyNonceIsValidAndUnique(base::StringPiece nonce,
+                                   QuicWallTime now,
+                                   ResultCallback* cb) override;
+
+  // From EpollCallbackInterface
+  void OnRegistration(EpollServer* eps, int fd, int event_mask) override {}
+  void OnModification(int fd, int event_mask) override {}
+  void OnEvent(int fd, EpollEvent* event) override;
+  void OnUnregistration(int fd, bool replaced) override {}
+  void OnShutdown(EpollServer* eps, int fd) override {}
+
+  // True once the server's hello has arrived on the current connection.
+  bool connected() const { return state_ == CONNECTED; }
+
+  // The number of nonces sent to the server.
+  uint64 num_requests() const { return num_requests_; }
+  // The number of writes they were sent in.
+  uint64 num_batches() const { return num_batches_; }
+
+ private:
+  class TimeoutAlarm;
+
+  enum State {
+    DISCONNECTED,
+    // Connected, waiting for the server's hello.
+    AWAITING_HELLO,
+    CONNECTED,
+  };
+
+  struct PendingRequest {
+    ResultCallback* callback;
+    int64 deadline_us;
+  };
+
+  // Returns a socket connected to |socket_path|, made non-blocking first if
+  // |non_blocking|, or -1 on failure.
+  static int ConnectSocket(const std::string& socket_path, bool non_blocking);
+
+  // Connects to |socket_path| and waits for the hello, whose orbit it puts in
+  // |orbit|.  Returns the socket, made non-blocking, or -1 on failure.
+  static int ConnectAndReadHello(const std::string& socket_path,
+                                 int64 timeout_us,
+                                 uint8 orbit[8]);
+
+  // Sets |orbit| to the orbit of |hello|.  Returns false if the server speaks
+  // another protocol version.
+  static bool ParseHello(const std::string& socket_path,
+                         const char* hello,
+                         uint8 orbit[8]);
+
+  // Returns false if |orbit| is not the one the server had before, since the
+  // server configs in use are bound to it.
+  bool AcceptOrbit(const uint8 orbit[8]);
+
+  // Starts connecting to |socket_path_| again unless that was tried within
+  // the last second.
+  void MaybeReconnect();
+
+  // Reads what has arrived of the server's hello, and starts using the
+  // connection once all of it has.
+  void ReadHello();
+
+  void WriteRequests();
+  void ReadAnswers();
+
+  // Closes the connection and fails all pending requests with |status|.
+  void Disconnect(InsertStatus status);
+
+  // Fails the requests whose deadline has passed, and gives up on a hello
+  // which did not arrive in time.  Returns the time at which to check again,
+  // or zero.
+  int64 OnTimeoutAlarm();
+
+  EpollServer* epoll_server_;  // Not owned.
+  const int64 timeout_us_;
+  std::string socket_path_;
+  int fd_;
+  State state_;
+  // The part of the hello received so far while AWAITING_HELLO.
+  std::string hello_;
+  // The time by which the hello must arrive while AWAITING_HELLO.
+  int64 hello_deadline_us_;
+  bool has_orbit_;
+  uint8 orbit_[8];
+  // The earliest time at which to try reconnecting.
+  int64 next_reconnect_us_;
+
+  // Requests waiting to be written.
+  std::string write_buffer_;
+  // Requests sent or waiting to be sent, in order.
+  std::deque<PendingRequest> pending_;
+  scoped_ptr<TimeoutAlarm> timeout_alarm_;
+
+  uint64 num_requests_;
+  uint64 num_batches_;
+
+  DISALLOW_COPY_AND_ASSIGN(RemoteStrikeRegisterClient);
+};
+
+}  // namespace tools
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_REMOTE_STRIKE_REGISTER_CLIENT_H_
@@ -0,0 +1,418 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// Checks a strike_register_server binary end to end.  Forks the daemon on a
+// private socket and talks to it with RemoteStrikeRegisterClients:
+//
+//   duplicate  two clients submit the same nonces; each is accepted once.
+//   bad_orbit  nonces of another orbit are rejected.
+//   bad_time   nonces outside the window are rejected.
+//   hung       while the daemon is stopped, requests time out, and
+//              reconnecting does not block; the hello arrives once it runs.
+//   killed     after the daemon is killed, pending and new requests fail,
+//              and a restarted daemon is used again.
+//
+// Prints one line per scenario and exits with 1 if any failed.
+
+#include <signal.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "base/at_exit.h"
+#include "base/basictypes.h"
+#include "base/command_line.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/stringprintf.h"
+#include "net/quic/crypto/crypto_protocol.h"
+#include "net/quic/crypto/strike_register_client.h"
+#include "net/quic/quic_time.h"
+#include "net/tools/epoll_server/epoll_server.h"
+#include "net/tools/quic/remote_strike_register_client.h"
+
+using std::string;
+
+// The strike_register_server binary.  Next to this one if empty.
+string FLAGS_server = "";
+// The Unix socket the daemon listens on.  In /tmp if empty.
+string FLAGS_socket = "";
+// The number of nonces each client submits in the duplicate scenario.
+int32 FLAGS_nonces = 1000;
+
+namespace net {
+namespace tools {
+namespace {
+
+const uint8 kOrbit[kOrbitSize] = {0x51, 0x55, 0x49, 0x43, 0x01, 0x02, 0x03,
+                                  0x04};
+const uint32 kWindowSecs = 600;
+const int64 kTimeoutUs = 1000 * 1000;
+
+// Counts the answers to a client's requests.
+struct Answers {
+  Answers() : done(0), accepted(0) {}
+
+  int done;
+  int accepted;
+  std::map<InsertStatus, int> rejected;
+};
+
+class CountingCallback : public StrikeRegisterClient::ResultCallback {
+ public:
+  explicit CountingCallback(Answers* answers) : answers_(answers) {}
+
+ protected:
+  void RunImpl(bool nonce_is_valid_and_unique,
+               InsertStatus nonce_error) override {
+    ++answers_->done;
+    if (nonce_is_valid_and_unique) {
+      ++answers_->accepted;
+    } else {
+      ++answers_->rejected[nonce_error];
+    }
+  }
+
+ private:
+  Answers* answers_;  // Not owned.
+
+  DISALLOW_COPY_AND_ASSIGN(CountingCallback);
+};
+
+// Returns a nonce of |orbit| made at |time|, whose random bytes are derived
+// from |id|.
+string MakeNonce(uint32 time, const uint8 orbit[kOrbitSize], uint64 id) {
+  uint8 nonce[kNonceSize];
+  nonce[0] = static_cast<uint8>(time >> 24);
+  nonce[1] = static_cast<uint8>(time >> 16);
+  nonce[2] = static_cast<uint8>(time >> 8);
+  nonce[3] = static_cast<uint8>(time);
+  memcpy(nonce + 4, orbit, kOrbitSize);
+  memset(nonce + 4 + kOrbitSize, 0, kNonceSize - 4 - kOrbitSize);
+  memcpy(nonce + 4 + kOrbitSize, &id, sizeof(id));
+  return string(reinterpret_cast<const char*>(nonce), sizeof(nonce));
+}
+
+// Runs |epoll_server| until |answers| holds |count| answers or the timeout
+// passes.
+bool WaitForAnswers(EpollServer* epoll_server, const Answers& answers,
+                    int count) {
+  const int64 deadline_us = epoll_server->NowInUsec() + 2 * kTimeoutUs;
+  while (answers.done < count) {
+    if (epoll_server->NowInUsec() > deadline_us) {
+      return false;
+    }
+    epoll_server->WaitForEventsAndExecuteCallbacks();
+  }
+  return true;
+}
+
+// Runs |epoll_server| until |client| has the hello of its new connection or
+// the timeout passes.
+bool WaitForConnection(EpollServer* epoll_server,
+                       const RemoteStrikeRegisterClient& client) {
+  const int64 deadline_us = epoll_server->NowInUsec() + 2 * kTimeoutUs;
+  while (!client.connected()) {
+    if (epoll_server->NowInUsec() > deadline_us) {
+      return false;
+    }
+    epoll_server->WaitForEventsAndExecuteCallbacks();
+  }
+  return true;
+}
+
+bool Report(const string& scenario, bool passed, const string& details) {
+  std::cout << (passed ? "PASS " : "FAIL ") << scenario << ": " << details
+            << std::endl;
+  return passed;
+}
+
+class Checker {
+ public:
+  Checker(const string& server, const string& socket)
+      : server_(server), socket_(socket), daemon_pid_(-1) {
+    epoll_server_.set_timeout_in_us(10 * 1000);
+  }
+
+  ~Checker() { KillDaemon(); }
+
+  // Forks and execs the daemon, and waits until it says hello.
+  bool StartDaemon() {
+    daemon_pid_ = fork();
+    if (daemon_pid_ < 0) {
+      LOG(ERROR) << "fork() failed";
+      return false;
+    }
+    if (daemon_pid_ == 0) {
+      const string socket_arg = "--socket=" + socket_;
+      const string orbit_arg =
+          "--orbit=" + base::HexEncode(kOrbit, sizeof(kOrbit));
+      const string window_arg =
+          base::StringPrintf("--window_secs=%u", kWindowSecs);
+      execl(server_.c_str(), server_.c_str(), socket_arg.c_str(),
+            orbit_arg.c_str(), window_arg.c_str(), "--no_startup_period",
+            static_cast<char*>(nullptr));
+      _exit(127);
+    }
+    for (int i = 0; i < 50; ++i) {
+      string orbit;
+      if (RemoteStrikeRegisterClient::GetOrbit(socket_, kTimeoutUs, &orbit)) {
+        return orbit == string(reinterpret_cast<const char*>(kOrbit),
+                               sizeof(kOrbit));
+      }
+      usleep(100 * 1000);
+    }
+    LOG(ERROR) << "No strike register at " << socket_ << " from " << server_;
+    return false;
+  }
+
+  void KillDaemon() {
+    if (daemon_pid_ > 0) {
+      kill(daemon_pid_, SIGKILL);
+      waitpid(daemon_pid_, nullptr, 0);
+      daemon_pid_ = -1;
+    }
+  }
+
+  bool CheckDuplicate() {
+    RemoteStrikeRegisterClient first(&epoll_server_, kTimeoutUs);
+    RemoteStrikeRegisterClient second(&epoll_server_, kTimeoutUs);
+    if (!first.Connect(socket_) || !second.Connect(socket_)) {
+      return Report("duplicate", false, "unable to connect");
+    }
+    const QuicWallTime now = Now();
+    Answers answers;
+    for (int i = 0; i < FLAGS_nonces; ++i) {
+      const string nonce = MakeNonce(now.ToUNIXSeconds(), kOrbit, i);
+      first.VerifyNonceIsValidAndUnique(nonce, now,
+                                        new CountingCallback(&answers));
+      second.VerifyNonceIsValidAndUnique(nonce, now,
+                                         new CountingCallback(&answers));
+    }
+    const bool answered = WaitForAnswers(&epoll_server_, answers,
+                                         2 * FLAGS_nonces);
+    const int duplicates = answers.rejected[NONCE_NOT_UNIQUE_FAILURE];
+    return Report(
+        "duplicate",
+        answered && answers.accepted == FLAGS_nonces &&
+            duplicates == FLAGS_nonces,
+        base::StringPrintf("%d accepted, %d duplicates of %d nonces sent "
+                           "twice in %d batches",
+                           answers.accepted, duplicates, FLAGS_nonces,
+                           static_cast<int>(first.num_batches() +
+                                            second.num_batches())));
+  }
+
+  bool CheckBadOrbit() {
+    RemoteStrikeRegisterClient client(&epoll_server_, kTimeoutUs);
+    if (!client.Connect(socket_)) {
+      return Report("bad_orbit", false, "unable to connect");
+    }
+    uint8 other_orbit[kOrbitSize];
+    memcpy(other_orbit, kOrbit, sizeof(other_orbit));
+    other_orbit[0] ^= 1;
+    const QuicWallTime now = Now();
+    Answers answers;
+    client.VerifyNonceIsValidAndUnique(
+        MakeNonce(now.ToUNIXSeconds(), other_orbit, 0), now,
+        new CountingCallback(&answers));
+    const bool answered = WaitForAnswers(&epoll_server_, answers, 1);
+    return Report("bad_orbit",
+                  answered && client.IsKnownOrbit(StringPieceOf(kOrbit)) &&
+                      !client.IsKnownOrbit(StringPieceOf(other_orbit)) &&
+                      answers.rejected[NONCE_INVALID_ORBIT_FAILURE] == 1,
+                  "nonce of another orbit rejected");
+  }
+
+  bool CheckBadTime() {
+    RemoteStrikeRegisterClient client(&epoll_server_, kTimeoutUs);
+    if (!client.Connect(socket_)) {
+      return Report("bad_time", false, "unable to connect");
+    }
+    const QuicWallTime now = Now();
+    const uint32 seconds = static_cast<uint32>(now.ToUNIXSeconds());
+    Answers answers;
+    client.VerifyNonceIsValidAndUnique(
+        MakeNonce(seconds - 2 * kWindowSecs, kOrbit, 1), now,
+        new CountingCallback(&answers));
+    client.VerifyNonceIsValidAndUnique(
+        MakeNonce(seconds + 2 * kWindowSecs, kOrbit, 2), now,
+        new CountingCallback(&answers));
+    const bool answered = WaitForAnswers(&epoll_server_, answers, 2);
+    return Report("bad_time",
+                  answered && answers.rejected[NONCE_INVALID_TIME_FAILURE] == 2,
+                  "nonces from before and after the window rejected");
+  }
+
+  bool CheckHung() {
+    RemoteStrikeRegisterClient client(&epoll_server_, kTimeoutUs);
+    if (!client.Connect(socket_)) {
+      return Report("hung", false, "unable to connect");
+    }
+    const QuicWallTime now = Now();
+    const uint32 seconds = static_cast<uint32>(now.ToUNIXSeconds());
+    Answers answers;
+    kill(daemon_pid_, SIGSTOP);
+    client.VerifyNonceIsValidAndUnique(MakeNonce(seconds, kOrbit, 1 << 21),
+                                       now, new CountingCallback(&answers));
+    const bool timed_out = WaitForAnswers(&epoll_server_, answers, 1) &&
+                           answers.rejected[STRIKE_REGISTER_TIMEOUT] == 1;
+
+    // The stopped daemon's socket still accepts connections, but no hello
+    // comes back.  The request which starts the reconnect fails at once.
+    sleep(1);
+    epoll_server_.WaitForEventsAndExecuteCallbacks();
+    const int64 start_us = epoll_server_.NowInUsec();
+    client.VerifyNonceIsValidAndUnique(
+        MakeNonce(seconds, kOrbit, (1 << 21) + 1), now,
+        new CountingCallback(&answers));
+    const int64 blocked_us = epoll_server_.NowInUsec() - start_us;
+    const bool not_blocked = answers.done == 2 &&
+                             answers.rejected[STRIKE_REGISTER_FAILURE] == 1 &&
+                             blocked_us < kTimeoutUs / 10;
+
+    kill(daemon_pid_, SIGCONT);
+    const bool reconnected = WaitForConnection(&epoll_server_, client);
+    return Report("hung", timed_out && not_blocked && reconnected,
+                  base::StringPrintf(
+                      "request %s, reconnect blocked for %d us, hello %s",
+                      timed_out ? "timed out" : "did not time out",
+                      static_cast<int>(blocked_us),
+                      reconnected ? "received" : "not received"));
+  }
+
+  bool CheckKilled() {
+    RemoteStrikeRegisterClient client(&epoll_server_, kTimeoutUs);
+    if (!client.Connect(socket_)) {
+      return Report("killed", false, "unable to connect");
+    }
+    const QuicWallTime now = Now();
+    const uint32 seconds = static_cast<uint32>(now.ToUNIXSeconds());
+    Answers answers;
+    client.VerifyNonceIsValidAndUnique(MakeNonce(seconds, kOrbit, 1 << 20),
+                                       now, new CountingCallback(&answers));
+    KillDaemon();
+    const bool pending_answered = WaitForAnswers(&epoll_server_, answers, 1);
+    client.VerifyNonceIsValidAndUnique(
+        MakeNonce(seconds, kOrbit, (1 << 20) + 1), now,
+        new CountingCallback(&answers));
+    const bool new_answered = WaitForAnswers(&epoll_server_, answers, 2);
+    const bool failed = pending_answered && new_answered &&
+                        answers.accepted == 0 &&
+                        answers.rejected[STRIKE_REGISTER_FAILURE] == 2 &&
+                        !client.connected();
+
+    // The client reconnects at most once a second.
+    if (!StartDaemon()) {
+      return Report("killed", false, "unable to restart the daemon");
+    }
+    sleep(1);
+    epoll_server_.WaitForEventsAndExecuteCallbacks();
+    // The request which starts the reconnect fails; the next one, made once
+    // the hello has arrived, is answered by the new daemon.
+    client.VerifyNonceIsValidAndUnique(
+        MakeNonce(seconds, kOrbit, (1 << 20) + 2), now,
+        new CountingCallback(&answers));
+    bool reconnected = WaitForConnection(&epoll_server_, client);
+    if (reconnected) {
+      client.VerifyNonceIsValidAndUnique(
+          MakeNonce(seconds, kOrbit, (1 << 20) + 3), now,
+          new CountingCallback(&answers));
+      reconnected = WaitForAnswers(&epoll_server_, answers, 4) &&
+                    answers.accepted == 1;
+    }
+    return Report("killed", failed && reconnected,
+                  base::StringPrintf("pending and new requests %s, restarted "
+                                     "daemon %s",
+                                     failed ? "failed" : "did not fail",
+                                     reconnected ? "used" : "not used"));
+  }
+
+ private:
+  QuicWallTime Now() {
+    return QuicWallTime::FromUNIXSeconds(static_cast<uint64>(time(nullptr)));
+  }
+
+  static base::StringPiece StringPieceOf(const uint8 orbit[kOrbitSize]) {
+    return base::StringPiece(reinterpret_cast<const char*>(orbit),
+                             kOrbitSize);
+  }
+
+  const string server_;
+  const string socket_;
+  pid_t daemon_pid_;
+  EpollServer epoll_server_;
+
+  DISALLOW_COPY_AND_ASSIGN(Checker);
+};
+
+}  // namespace
+}  // namespace tools
+}  // namespace net
+
+int main(int argc, char* argv[]) {
+  base::AtExitManager exit_manager;
+
+  base::CommandLine::Init(argc, argv);
+  base::CommandLine* line = base::CommandLine::ForCurrentProcess();
+
+  logging::LoggingSettings settings;
+  settings.logging_dest = logging::LOG_TO_SYSTEM_DEBUG_LOG;
+  CHECK(logging::InitLogging(settings));
+
+  if (line->HasSwitch("h") || line->HasSwitch("help")) {
+    const char* help_str =
+        "Usage: strike_register_check [options]\n"
+        "\n"
+        "Options:\n"
+        "-h, --help          show this help message and exit\n"
+        "--server=<path>     strike_register_server binary to check\n"
+        "--socket=<path>     Unix socket for the daemon to listen on\n"
+        "--nonces=<n>        nonces per client in the duplicate scenario\n";
+    std::cout << help_str;
+    exit(0);
+  }
+
+  if (line->HasSwitch("server")) {
+    FLAGS_server = line->GetSwitchValueASCII("server");
+  } else {
+    const string self = argv[0];
+    const size_t slash = self.rfind('/');
+    FLAGS_server = (slash == string::npos ? string("./")
+                                          : self.substr(0, slash + 1)) +
+                   "strike_register_server";
+  }
+  if (line->HasSwitch("socket")) {
+    FLAGS_socket = line->GetSwitchValueASCII("socket");
+  } else {
+    FLAGS_socket =
+        base::StringPrintf("/tmp/strike_register_check.%d", getpid());
+  }
+  if (line->HasSwitch("nonces")) {
+    if (!base::StringToInt(line->GetSwitchValueASCII("nonces"),
+                           &FLAGS_nonces) || FLAGS_nonces < 1) {
+      LOG(ERROR) << "--nonces must be a positive integer\n";
+      return 1;
+    }
+  }
+
+  net::tools::Checker checker(FLAGS_server, FLAGS_socket);
+  if (!checker.StartDaemon()) {
+    std::cout << "FAIL unable to start " << FLAGS_server << std::endl;
+    return 1;
+  }
+  bool passed = checker.CheckDuplicate();
+  passed &= checker.CheckBadOrbit();
+  passed &= checker.CheckBadTime();
+  passed &= checker.CheckHung();
+  passed &= checker.CheckKilled();
+  checker.KillDaemon();
+  unlink(FLAGS_socket.c_str());
+  return passed ? 0 : 1;
+}
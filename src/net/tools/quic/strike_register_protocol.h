@@ -0,0 +1,42 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// The protocol spoken between RemoteStrikeRegisterClient and
+// StrikeRegisterServer over a Unix stream socket.  Both ends run on one host,
+// so integers are sent in host byte order.
+//
+// On accepting a connection the server sends a hello of
+// kStrikeRegisterHelloSize bytes: the uint32 protocol version followed by the
+// kOrbitSize byte orbit of its strike register.  After that the client sends
+// requests of kStrikeRegisterRequestSize bytes, each the uint32 current time
+// in UNIX seconds followed by the kNonceSize byte nonce, and the server
+// answers each with a single InsertStatus byte.  Answers come in request
+// order, so neither side needs request IDs, and any number of requests may be
+// sent in one write.
+
+#ifndef NET_TOOLS_QUIC_STRIKE_REGISTER_PROTOCOL_H_
+#define NET_TOOLS_QUIC_STRIKE_REGISTER_PROTOCOL_H_
+
+#include <stddef.h>
+
+#include "base/basictypes.h"
+#include "net/quic/crypto/crypto_protocol.h"
+
+namespace net {
+namespace tools {
+
+const uint32 kStrikeRegisterProtocolVersion = 1;
+
+const size_t kStrikeRegisterHelloSize = sizeof(uint32) + kOrbitSize;
+const size_t kStrikeRegisterRequestSize = sizeof(uint32) + kNonceSize;
+const size_t kStrikeRegisterResponseSize = 1;
+
+// How long QuicServer waits for answers before rejecting client hellos with
+// STRIKE_REGISTER_TIMEOUT.
+const int64 kStrikeRegisterTimeoutUs = 100 * 1000;
+
+}  // namespace tools
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_STRIKE_REGISTER_PROTOCOL_H_
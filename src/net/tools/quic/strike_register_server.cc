@@ -0,0 +1,207 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/quic/strike_register_server.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "base/logging.h"
+#include "base/posix/eintr_wrapper.h"
+#include "net/quic/quic_clock.h"
+#include "net/tools/quic/strike_register_protocol.h"
+
+using std::string;
+
+namespace net {
+namespace tools {
+
+namespace {
+
+// Requests are read in chunks of up to this many.
+const size_t kRequestsPerRead = 256;
+
+}  // namespace
+
+StrikeRegisterServer::StrikeRegisterServer(EpollServer* epoll_server,
+                                           unsigned max_entries,
+                                           uint32 window_secs,
+                                           const uint8 orbit[8],
+                                           StrikeRegister::StartupType startup)
+    : epoll_server_(epoll_server),
+      strike_register_(
+          max_entries,
+          static_cast<uint32>(QuicClock().WallNow().ToUNIXSeconds()),
+          window_secs,
+          orbit,
+          startup),
+      listen_fd_(-1),
+      num_requests_(0),
+      num_batches_(0) {
+  memcpy(orbit_, orbit, sizeof(orbit_));
+}
+
+StrikeRegisterServer::~StrikeRegisterServer() {
+  Shutdown();
+}
+
+bool StrikeRegisterServer::Listen(const string& socket_path) {
+  DCHECK_EQ(-1, listen_fd_);
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    LOG(ERROR) << "Socket path is too long: " << socket_path;
+    return false;
+  }
+  memcpy(address.sun_path, socket_path.data(), socket_path.size());
+
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_fd_ < 0) {
+    LOG(ERROR) << "socket() failed: " << strerror(errno);
+    return false;
+  }
+  unlink(socket_path.c_str());
+  if (bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address),
+           sizeof(address)) < 0 ||
+      listen(listen_fd_, SOMAXCONN) < 0) {
+    LOG(ERROR) << "Unable to listen on " << socket_path << ": "
+               << strerror(errno);
+    close(listen_fd_);
+    listen_fd_ = -1;
+    return false;
+  }
+  socket_path_ = socket_path;
+  epoll_server_->RegisterFD(listen_fd_, this, EPOLLIN);
+  return true;
+}
+
+void StrikeRegisterServer::Shutdown() {
+  while (!connections_.empty()) {
+    CloseConnection(connections_.begin()->first);
+  }
+  if (listen_fd_ >= 0) {
+    epoll_server_->UnregisterFD(listen_fd_);
+    close(listen_fd_);
+    listen_fd_ = -1;
+    unlink(socket_path_.c_str());
+  }
+}
+
+void StrikeRegisterServer::OnEvent(int fd, EpollEvent* event) {
+  if (fd == listen_fd_) {
+    AcceptConnections();
+    return;
+  }
+  std::map<int, Connection>::iterator it = connections_.find(fd);
+  if (it == connections_.end()) {
+    return;
+  }
+  if ((event->in_events & EPOLLIN) && !ReadRequests(fd, &it->second)) {
+    return;
+  }
+  if ((event->in_events & EPOLLOUT) && !WriteAnswers(fd, &it->second)) {
+    return;
+  }
+  if (event->in_events & EPOLLERR) {
+    CloseConnection(fd);
+  }
+}
+
+void StrikeRegisterServer::AcceptConnections() {
+  while (true) {
+    int fd = HANDLE_EINTR(
+        accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC));
+    if (fd < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        LOG(WARNING) << "accept() failed: " << strerror(errno);
+      }
+      return;
+    }
+    DVLOG(1) << "Strike register connection " << fd;
+    Connection* connection = &connections_[fd];
+    epoll_server_->RegisterFD(fd, this, EPOLLIN);
+
+    char hello[kStrikeRegisterHelloSize];
+    memcpy(hello, &kStrikeRegisterProtocolVersion,
+           sizeof(kStrikeRegisterProtocolVersion));
+    memcpy(hello + sizeof(kStrikeRegisterProtocolVersion), orbit_,
+           sizeof(orbit_));
+    connection->write_buffer.assign(hello, sizeof(hello));
+    WriteAnswers(fd, connection);
+  }
+}
+
+bool StrikeRegisterServer::ReadRequests(int fd, Connection* connection) {
+  char buffer[kRequestsPerRead * kStrikeRegisterRequestSize];
+  bool answered = false;
+  while (true) {
+    ssize_t rv = HANDLE_EINTR(read(fd, buffer, sizeof(buffer)));
+    if (rv < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+    if (rv <= 0) {
+      DVLOG_IF(1, rv < 0) << "read() failed: " << strerror(errno);
+      CloseConnection(fd);
+      return false;
+    }
+
+    string* requests = &connection->read_buffer;
+    requests->append(buffer, rv);
+    size_t offset = 0;
+    for (; offset + kStrikeRegisterRequestSize <= requests->size();
+         offset += kStrikeRegisterRequestSize) {
+      const char* request = requests->data() + offset;
+      uint32 current_time;
+      memcpy(&current_time, request, sizeof(current_time));
+      InsertStatus status = strike_register_.Insert(
+          reinterpret_cast<const uint8*>(request + sizeof(current_time)),
+          current_time);
+      connection->write_buffer.push_back(static_cast<char>(status));
+      ++num_requests_;
+    }
+    if (offset > 0) {
+      requests->erase(0, offset);
+      answered = true;
+    }
+  }
+  if (!answered) {
+    return true;
+  }
+  ++num_batches_;
+  return WriteAnswers(fd, connection);
+}
+
+bool StrikeRegisterServer::WriteAnswers(int fd, Connection* connection) {
+  string* answers = &connection->write_buffer;
+  while (!answers->empty()) {
+    ssize_t rv = HANDLE_EINTR(
+        send(fd, answers->data(), answers->size(), MSG_NOSIGNAL));
+    if (rv < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        epoll_server_->StartWrite(fd);
+        return true;
+      }
+      DVLOG(1) << "send() failed: " << strerror(errno);
+      CloseConnection(fd);
+      return false;
+    }
+    answers->erase(0, rv);
+  }
+  epoll_server_->StopWrite(fd);
+  return true;
+}
+
+void StrikeRegisterServer::CloseConnection(int fd) {
+  DVLOG(1) << "Closing strike register connection " << fd;
+  epoll_server_->UnregisterFD(fd);
+  close(fd);
+  connections_.erase(fd);
+}
+
+}  // namespace tools
+}  // namespace net
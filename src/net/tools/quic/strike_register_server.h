@@ -0,0 +1,91 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// A strike register shared by QUIC servers in several processes.  Servers
+// connect with RemoteStrikeRegisterClient over a Unix stream socket and speak
+// the protocol in strike_register_protocol.h.
+
+#ifndef NET_TOOLS_QUIC_STRIKE_REGISTER_SERVER_H_
+#define NET_TOOLS_QUIC_STRIKE_REGISTER_SERVER_H_
+
+#include <map>
+#include <string>
+
+#include "base/basictypes.h"
+#include "net/quic/crypto/strike_register.h"
+#include "net/tools/epoll_server/epoll_server.h"
+
+namespace net {
+namespace tools {
+
+class StrikeRegisterServer : public EpollCallbackInterface {
+ public:
+  // The arguments other than |epoll_server| are as for StrikeRegister, which
+  // is created at the current wall time.  Nonces are checked against the time
+  // sent with them.  Does not take ownership of |epoll_server|.
+  StrikeRegisterServer(EpollServer* epoll_server,
+                       unsigned max_entries,
+                       uint32 window_secs,
+                       const uint8 orbit[8],
+                       StrikeRegister::StartupType startup);
+  ~StrikeRegisterServer() override;
+
+  // Listens on the Unix socket |socket_path|, replacing any file already
+  // there.
+  bool Listen(const std::string& socket_path);
+
+  // Closes the listening socket and all connections.
+  void Shutdown();
+
+  // From EpollCallbackInterface
+  void OnRegistration(EpollServer* eps, int fd, int event_mask) override {}
+  void OnModification(int fd, int event_mask) override {}
+  void OnEvent(int fd, EpollEvent* event) override;
+  void OnUnregistration(int fd, bool replaced) override {}
+  void OnShutdown(EpollServer* eps, int fd) override {}
+
+  // The number of nonces checked.
+  uint64 num_requests() const { return num_requests_; }
+  // The number of socket events which delivered requests.  Clients batch
+  // requests, so this is usually much smaller than num_requests().
+  uint64 num_batches() const { return num_batches_; }
+
+  size_t num_connections() const { return connections_.size(); }
+
+ private:
+  struct Connection {
+    // Bytes read which do not yet make up a whole request.
+    std::string read_buffer;
+    // Answers not yet written.
+    std::string write_buffer;
+  };
+
+  void AcceptConnections();
+
+  // Reads and answers all available requests on |fd|.  Returns false if the
+  // connection has been closed.
+  bool ReadRequests(int fd, Connection* connection);
+
+  // Writes as much of the connection's pending answers as the socket takes.
+  // Returns false if the connection has been closed.
+  bool WriteAnswers(int fd, Connection* connection);
+
+  void CloseConnection(int fd);
+
+  EpollServer* epoll_server_;  // Not owned.
+  StrikeRegister strike_register_;
+  uint8 orbit_[8];
+  int listen_fd_;
+  std::string socket_path_;
+  std::map<int, Connection> connections_;
+  uint64 num_requests_;
+  uint64 num_batches_;
+
+  DISALLOW_COPY_AND_ASSIGN(StrikeRegisterServer);
+};
+
+}  // namespace tools
+}  // namespace net
+
+#endif  // NET_TOOLS_QUIC_STRIKE_REGISTER_SERVER_H_
@@ -0,0 +1,106 @@
+// Copyright 2015 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+//
+// A binary wrapper for StrikeRegisterServer.  Serves the strike register of
+// quic_servers started with --strike_register_socket until it's killed.
+
+#include <string.h>
+
+#include <iostream>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/basictypes.h"
+#include "base/command_line.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "net/quic/crypto/crypto_protocol.h"
+#include "net/quic/crypto/quic_random.h"
+#include "net/tools/epoll_server/epoll_server.h"
+#include "net/tools/quic/strike_register_server.h"
+
+// The Unix socket to listen on.
+std::string FLAGS_socket = "/tmp/quic_strike_register";
+// The number of nonces remembered.
+int32 FLAGS_max_entries = 1 << 20;
+// The number of seconds around the current time in which nonces are accepted.
+int32 FLAGS_window_secs = 600;
+// The orbit, in hex.  Random if empty.
+std::string FLAGS_orbit = "";
+
+int main(int argc, char *argv[]) {
+  base::AtExitManager exit_manager;
+
+  base::CommandLine::Init(argc, argv);
+  base::CommandLine* line = base::CommandLine::ForCurrentProcess();
+
+  logging::LoggingSettings settings;
+  settings.logging_dest = logging::LOG_TO_SYSTEM_DEBUG_LOG;
+  CHECK(logging::InitLogging(settings));
+
+  if (line->HasSwitch("h") || line->HasSwitch("help")) {
+    const char* help_str =
+        "Usage: strike_register_server [options]\n"
+        "\n"
+        "Options:\n"
+        "-h, --help          show this help message and exit\n"
+        "--socket=<path>     Unix socket to listen on\n"
+        "--max_entries=<n>   number of nonces to remember\n"
+        "--window_secs=<n>   accept nonces this close to the current time\n"
+        "--orbit=<hex>       8 byte orbit, random by default\n"
+        "--no_startup_period accept nonces immediately after starting\n";
+    std::cout << help_str;
+    exit(0);
+  }
+
+  if (line->HasSwitch("socket")) {
+    FLAGS_socket = line->GetSwitchValueASCII("socket");
+  }
+  if (line->HasSwitch("max_entries")) {
+    if (!base::StringToInt(line->GetSwitchValueASCII("max_entries"),
+                           &FLAGS_max_entries) || FLAGS_max_entries < 2) {
+      LOG(ERROR) << "--max_entries must be at least 2\n";
+      return 1;
+    }
+  }
+  if (line->HasSwitch("window_secs")) {
+    if (!base::StringToInt(line->GetSwitchValueASCII("window_secs"),
+                           &FLAGS_window_secs) || FLAGS_window_secs < 1) {
+      LOG(ERROR) << "--window_secs must be a positive integer\n";
+      return 1;
+    }
+  }
+
+  uint8 orbit[net::kOrbitSize];
+  if (line->HasSwitch("orbit")) {
+    std::vector<uint8> bytes;
+    if (!base::HexStringToBytes(line->GetSwitchValueASCII("orbit"), &bytes) ||
+        bytes.size() != sizeof(orbit)) {
+      LOG(ERROR) << "--orbit must be " << sizeof(orbit) << " bytes of hex\n";
+      return 1;
+    }
+    memcpy(orbit, &bytes[0], sizeof(orbit));
+  } else {
+    net::QuicRandom::GetInstance()->RandBytes(orbit, sizeof(orbit));
+  }
+
+  // Servers which lost their register may have accepted any nonce of the
+  // window, so by default a new one accepts nothing until the window passes.
+  const net::StrikeRegister::StartupType startup =
+      line->HasSwitch("no_startup_period")
+          ? net::StrikeRegister::NO_STARTUP_PERIOD_NEEDED
+          : net::StrikeRegister::DENY_REQUESTS_AT_STARTUP;
+
+  net::EpollServer epoll_server;
+  epoll_server.set_timeout_in_us(50 * 1000);
+  net::tools::StrikeRegisterServer server(&epoll_server, FLAGS_max_entries,
+                                          FLAGS_window_secs, orbit, startup);
+  if (!server.Listen(FLAGS_socket)) {
+    return 1;
+  }
+
+  while (1) {
+    epoll_server.WaitForEventsAndExecuteCallbacks();
+  }
+}